@@ -0,0 +1,293 @@
+/*
+  Fits the LCPO parameters used in src/sasa_lcpo.c.
+
+  The exact SASA (calculated using the Gauss-Bonnet algorithm, which
+  agrees with Lee & Richards in the limit of infinitely many slices)
+  is used as reference. Structures are read using the ProtOr, NACCESS
+  and OONS classifiers, and separate models are treated as separate
+  structures. Parameters are fitted by least squares for each
+  combination of radius and number of bonds, each radius, each number
+  of bonds and for all atoms. The parameter table is written to
+  stdout, and the errors for the training and test sets to stderr.
+
+  Build from the top directory after running configure and make:
+
+    cc -O2 -Isrc scripts/lcpo_fit.c \
+        src/libfreesasa.a -lm -lpthread -o lcpo_fit
+
+  Usage:
+
+    ./lcpo_fit train1.pdb ... [-t test1.pdb ...]
+ */
+
+#include "../src/sasa_lcpo.c"
+#include <stdio.h>
+
+#define MAX_KEYS 256
+#define MIN_ATOMS 50
+#define N_RADII_CLASSIFIERS 3
+#define N_ITERATIONS 10
+
+struct atom_data {
+    double terms[4], ref, lr20;
+    double radius;
+    int n_bond, is_test, inside;
+};
+
+struct fit {
+    double radius;
+    int n_bond;
+    double M[16], b[4];
+    int n;
+    double p[4];
+};
+
+static struct atom_data *atoms = NULL;
+static int n_atoms = 0, capacity = 0;
+static struct fit fits[MAX_KEYS];
+static int n_fits = 0;
+
+static struct fit *
+get_fit(double radius, int n_bond)
+{
+    int i;
+    for (i = 0; i < n_fits; ++i) {
+        if (fabs(fits[i].radius - radius) < 1e-6 && fits[i].n_bond == n_bond)
+            return &fits[i];
+    }
+    assert(n_fits < MAX_KEYS);
+    memset(&fits[n_fits], 0, sizeof(struct fit));
+    fits[n_fits].radius = radius;
+    fits[n_fits].n_bond = n_bond;
+    return &fits[n_fits++];
+}
+
+static void
+add_structure(const freesasa_structure *s, int is_test)
+{
+    const coord_t *c = freesasa_structure_xyz(s);
+    const double *r = freesasa_structure_radius(s);
+    const int n = freesasa_structure_n(s);
+    freesasa_parameters param = freesasa_default_parameters;
+    freesasa_result *exact, *lr20;
+    double *sasa = malloc(sizeof(double) * n);
+    lcpo_data lcpo;
+    int i, j, n_bond;
+
+    param.n_threads = 1;
+    param.alg = FREESASA_GAUSS_BONNET;
+    exact = freesasa_calc_coord(freesasa_coord_all(c), r, n, &param);
+    param.alg = FREESASA_LEE_RICHARDS;
+    lr20 = freesasa_calc_coord(freesasa_coord_all(c), r, n, &param);
+    assert(exact && lr20 && sasa);
+    if (init_lcpo(&lcpo, sasa, NULL, c, r, param.probe_radius, 1)) abort();
+
+    if (n_atoms + n > capacity) {
+        capacity = 2*(n_atoms + n);
+        atoms = realloc(atoms, sizeof(struct atom_data) * capacity);
+        assert(atoms);
+    }
+
+    for (i = 0; i < n; ++i) {
+        struct atom_data *a = &atoms[n_atoms++];
+        n_bond = 0;
+        for (j = 0; j < lcpo.adj->nn[i]; ++j) {
+            if (lcpo.dist[lcpo.offset[i] + j] < LCPO_BOND_CUTOFF) ++n_bond;
+        }
+        a->n_bond = n_bond > 4 ? 4 : n_bond;
+        a->radius = r[i];
+        a->ref = exact->sasa[i];
+        a->lr20 = lr20->sasa[i];
+        a->is_test = is_test;
+        a->inside = inside_neighbor(&lcpo, i);
+        lcpo_terms(&lcpo, i, 0, a->terms, lcpo.p[i], NULL);
+    }
+
+    release_lcpo(&lcpo);
+    freesasa_result_free(exact);
+    freesasa_result_free(lr20);
+    free(sasa);
+}
+
+static void
+read_file(const char *filename, int is_test)
+{
+    const freesasa_classifier *classifiers[N_RADII_CLASSIFIERS] = {
+        &freesasa_protor_classifier, &freesasa_naccess_classifier, &freesasa_oons_classifier
+    };
+    freesasa_structure **ss;
+    FILE *f;
+    int i, k, n;
+
+    for (k = 0; k < N_RADII_CLASSIFIERS; ++k) {
+        f = fopen(filename, "r");
+        if (f == NULL) {
+            fprintf(stderr, "can't open %s\n", filename);
+            exit(1);
+        }
+        ss = freesasa_structure_array(f, &n, classifiers[k], FREESASA_SEPARATE_MODELS);
+        fclose(f);
+        if (ss == NULL) exit(1);
+        for (i = 0; i < n; ++i) {
+            add_structure(ss[i], is_test);
+            freesasa_structure_free(ss[i]);
+        }
+        free(ss);
+    }
+}
+
+static double
+predict(const double *p, const struct atom_data *a)
+{
+    return p[0]*a->terms[0] + p[1]*a->terms[1] + p[2]*a->terms[2] + p[3]*a->terms[3];
+}
+
+/*
+  Add atom to fit. Since negative values are truncated to zero, buried
+  atoms that are already predicted to be buried are left out after the
+  first iteration.
+ */
+static void
+accumulate(struct fit *f, const struct atom_data *a, int iteration)
+{
+    int k, l;
+    if (iteration > 0 && a->ref == 0 && predict(f->p, a) <= 0) return;
+    for (k = 0; k < 4; ++k) {
+        for (l = 0; l < 4; ++l) f->M[4*k+l] += a->terms[k]*a->terms[l];
+        f->b[k] += a->terms[k]*a->ref;
+    }
+    ++f->n;
+}
+
+/* Solve the normal equations, scaled to unit diagonal, using Gaussian elimination */
+static void
+solve(struct fit *f)
+{
+    double A[4][5], scale[4], t;
+    int i, j, k, piv;
+
+    for (i = 0; i < 4; ++i) scale[i] = f->M[5*i] > 0 ? 1/sqrt(f->M[5*i]) : 1;
+    for (i = 0; i < 4; ++i) {
+        for (j = 0; j < 4; ++j) A[i][j] = f->M[4*i+j]*scale[i]*scale[j];
+        A[i][i] += 1e-12;
+        A[i][4] = f->b[i]*scale[i];
+    }
+    for (i = 0; i < 4; ++i) {
+        piv = i;
+        for (j = i+1; j < 4; ++j) if (fabs(A[j][i]) > fabs(A[piv][i])) piv = j;
+        for (k = 0; k < 5; ++k) { t = A[i][k]; A[i][k] = A[piv][k]; A[piv][k] = t; }
+        for (j = 0; j < 4; ++j) {
+            if (j == i) continue;
+            t = A[j][i]/A[i][i];
+            for (k = i; k < 5; ++k) A[j][k] -= t*A[i][k];
+        }
+    }
+    for (i = 0; i < 4; ++i) f->p[i] = A[i][4]/A[i][i]*scale[i];
+}
+
+static int
+compare_fits(const void *a, const void *b)
+{
+    const struct fit *fa = a, *fb = b;
+    if (fa->radius != fb->radius) return fa->radius < fb->radius ? -1 : 1;
+    return fa->n_bond - fb->n_bond;
+}
+
+static const double *
+lookup(const struct atom_data *a)
+{
+    const struct fit *best = NULL;
+    int i, score, best_score = -1;
+    for (i = 0; i < n_fits; ++i) {
+        const struct fit *f = &fits[i];
+        if (f->n < MIN_ATOMS) continue;
+        score = 0;
+        if (f->radius > 0) {
+            if (fabs(f->radius - a->radius) > LCPO_RADIUS_TOL) continue;
+            score += 2;
+        }
+        if (f->n_bond >= 0) {
+            if (f->n_bond != a->n_bond) continue;
+            score += 1;
+        }
+        if (score > best_score) {
+            best_score = score;
+            best = f;
+        }
+    }
+    return best->p;
+}
+
+static void
+report(int is_test)
+{
+    double e2 = 0, e2_lr = 0, tot = 0, tot_ref = 0, tot_lr = 0, v;
+    const double *p;
+    int i, n = 0;
+
+    for (i = 0; i < n_atoms; ++i) {
+        const struct atom_data *a = &atoms[i];
+        if (a->is_test != is_test) continue;
+        p = lookup(a);
+        v = a->inside ? 0 : predict(p, a);
+        if (v < 0) v = 0;
+        e2 += (v - a->ref)*(v - a->ref);
+        e2_lr += (a->lr20 - a->ref)*(a->lr20 - a->ref);
+        tot += v;
+        tot_ref += a->ref;
+        tot_lr += a->lr20;
+        ++n;
+    }
+    if (n == 0) return;
+    fprintf(stderr, "%s set: %d atoms\n", is_test ? "Test" : "Training", n);
+    fprintf(stderr, "  LCPO:      RMS error per atom %.2f Å^2, total %+.2f%%\n",
+            sqrt(e2/n), 100*(tot - tot_ref)/tot_ref);
+    fprintf(stderr, "  L&R (20):  RMS error per atom %.2f Å^2, total %+.2f%%\n",
+            sqrt(e2_lr/n), 100*(tot_lr - tot_ref)/tot_ref);
+}
+
+int
+main(int argc, char **argv)
+{
+    int i, iteration, is_test = 0;
+
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-t") == 0) is_test = 1;
+        else read_file(argv[i], is_test);
+    }
+
+    for (iteration = 0; iteration < N_ITERATIONS; ++iteration) {
+        for (i = 0; i < n_fits; ++i) {
+            memset(fits[i].M, 0, sizeof(fits[i].M));
+            memset(fits[i].b, 0, sizeof(fits[i].b));
+            fits[i].n = 0;
+        }
+        for (i = 0; i < n_atoms; ++i) {
+            const struct atom_data *a = &atoms[i];
+            if (a->is_test || a->inside) continue;
+            accumulate(get_fit(0, -1), a, iteration);
+            accumulate(get_fit(0, a->n_bond), a, iteration);
+            accumulate(get_fit(a->radius, -1), a, iteration);
+            accumulate(get_fit(a->radius, a->n_bond), a, iteration);
+        }
+        for (i = 0; i < n_fits; ++i) {
+            if (fits[i].n >= MIN_ATOMS) solve(&fits[i]);
+        }
+    }
+
+    qsort(fits, n_fits, sizeof(struct fit), compare_fits);
+    for (i = 0; i < n_fits; ++i) {
+        if (fits[i].n < MIN_ATOMS) continue;
+        printf("    {%.2f, %d, {%.6g, %.6g, %.6g, %.6g}},\n",
+               fits[i].radius, fits[i].n_bond,
+               fits[i].p[0], fits[i].p[1], fits[i].p[2], fits[i].p[3]);
+    }
+
+    report(0);
+    report(1);
+
+    free(atoms);
+    return 0;
+}
@@ -0,0 +1,55 @@
+/* needed for the CPU_SET macros and pthread_setaffinity_np() */
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <assert.h>
+
+#if USE_THREADS && HAVE_PTHREAD_SETAFFINITY_NP && HAVE_SCHED_GETAFFINITY
+# include <pthread.h>
+# include <sched.h>
+# define USE_AFFINITY 1
+#else
+# define USE_AFFINITY 0
+#endif
+
+#include "freesasa_internal.h"
+
+int
+freesasa_pin_thread(int thread_index)
+{
+#if USE_AFFINITY
+    cpu_set_t allowed, cpu;
+    int i, k, n_allowed;
+
+    assert(thread_index >= 0);
+
+    /* only use the CPUs the process is allowed to run on (taskset,
+       cgroups, etc), numbered in order */
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed)) {
+        return freesasa_warn("could not get CPU affinity of process, "
+                             "threads will not be pinned");
+    }
+    n_allowed = CPU_COUNT(&allowed);
+    if (n_allowed == 0) return FREESASA_WARN;
+
+    k = thread_index % n_allowed;
+    for (i = 0; i < CPU_SETSIZE; ++i) {
+        if (CPU_ISSET(i, &allowed) && k-- == 0) break;
+    }
+    assert(i < CPU_SETSIZE);
+
+    CPU_ZERO(&cpu);
+    CPU_SET(i, &cpu);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu)) {
+        return freesasa_warn("could not pin thread %d to CPU %d", thread_index, i);
+    }
+
+    return FREESASA_SUCCESS;
+#else
+    (void) thread_index;
+    return FREESASA_WARN;
+#endif
+}
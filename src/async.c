@@ -0,0 +1,277 @@
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <assert.h>
+#include <stdlib.h>
+
+#if USE_THREADS
+# include <pthread.h>
+#endif
+
+#include "freesasa_internal.h"
+
+struct freesasa_progress {
+    int n_done;
+    int n_total;
+    int cancel;
+#if USE_THREADS
+    pthread_mutex_t lock;
+#endif
+};
+
+struct freesasa_async {
+    freesasa_progress progress;
+    const coord_t *xyz;
+    coord_t *own_xyz; /* only set if the coordinates were linked here */
+    const double *radii;
+    freesasa_parameters param;
+    freesasa_result *result;
+    freesasa_async_state state; /* protected by progress.lock */
+#if USE_THREADS
+    pthread_t thread;
+    int joined;
+#endif
+};
+
+static void
+progress_lock(freesasa_progress *p)
+{
+#if USE_THREADS
+    pthread_mutex_lock(&p->lock);
+#endif
+}
+
+static void
+progress_unlock(freesasa_progress *p)
+{
+#if USE_THREADS
+    pthread_mutex_unlock(&p->lock);
+#endif
+}
+
+int
+freesasa_progress_tick(freesasa_progress *p,
+                       int *n_pending)
+{
+    if (p == NULL) return 0;
+    if (++*n_pending < FREESASA_PROGRESS_INTERVAL) return 0;
+    return freesasa_progress_flush(p, n_pending);
+}
+
+int
+freesasa_progress_flush(freesasa_progress *p,
+                        int *n_pending)
+{
+    int cancel;
+
+    if (p == NULL) return 0;
+
+    progress_lock(p);
+    p->n_done += *n_pending;
+    cancel = p->cancel;
+    progress_unlock(p);
+    *n_pending = 0;
+
+    return cancel;
+}
+
+int
+freesasa_progress_cancelled(freesasa_progress *p)
+{
+    int cancel;
+
+    if (p == NULL) return 0;
+
+    progress_lock(p);
+    cancel = p->cancel;
+    progress_unlock(p);
+
+    return cancel;
+}
+
+static void
+async_run(freesasa_async *a)
+{
+    freesasa_result *result =
+        freesasa_calc_subset(a->xyz, a->radii, freesasa_coord_n(a->xyz),
+                             &a->param, &a->progress);
+
+    progress_lock(&a->progress);
+    if (a->progress.cancel) {
+        a->state = FREESASA_ASYNC_CANCELLED;
+    } else if (result == NULL) {
+        a->state = FREESASA_ASYNC_FAILED;
+    } else {
+        a->result = result;
+        a->state = FREESASA_ASYNC_DONE;
+    }
+    progress_unlock(&a->progress);
+
+    /* the calculation can finish before noticing the cancellation */
+    if (a->result != result) freesasa_result_free(result);
+}
+
+#if USE_THREADS
+static void *
+async_thread(void *arg)
+{
+    freesasa_async *a = (freesasa_async *) arg;
+
+    async_run(a);
+    pthread_exit(NULL);
+}
+#endif
+
+/** Start the calculation, takes ownership of own_xyz */
+static freesasa_async *
+async_start(const coord_t *xyz,
+            coord_t *own_xyz,
+            const double *radii,
+            const freesasa_parameters *parameters)
+{
+    freesasa_async *a = malloc(sizeof(freesasa_async));
+#if USE_THREADS
+    int res;
+#endif
+
+    if (a == NULL) {
+        freesasa_coord_free(own_xyz);
+        mem_fail();
+        return NULL;
+    }
+
+    if (parameters == NULL) parameters = &freesasa_default_parameters;
+
+    a->progress.n_done = 0;
+    a->progress.n_total = freesasa_coord_n(xyz);
+    a->progress.cancel = 0;
+    a->xyz = xyz;
+    a->own_xyz = own_xyz;
+    a->radii = radii;
+    a->param = *parameters;
+    a->result = NULL;
+    a->state = FREESASA_ASYNC_RUNNING;
+
+#if USE_THREADS
+    a->joined = 0;
+    res = pthread_mutex_init(&a->progress.lock, NULL);
+    if (res) {
+        fail_msg(freesasa_thread_error(res));
+        freesasa_coord_free(own_xyz);
+        free(a);
+        return NULL;
+    }
+    res = freesasa_thread_create(&a->thread, async_thread, (void *) a);
+    if (res) {
+        fail_msg(freesasa_thread_error(res));
+        pthread_mutex_destroy(&a->progress.lock);
+        freesasa_coord_free(own_xyz);
+        free(a);
+        return NULL;
+    }
+#else
+    async_run(a);
+#endif
+
+    return a;
+}
+
+freesasa_async *
+freesasa_calc_structure_async(const freesasa_structure *structure,
+                              const freesasa_parameters *parameters)
+{
+    assert(structure);
+
+    return async_start(freesasa_structure_xyz(structure), NULL,
+                       freesasa_structure_radius(structure), parameters);
+}
+
+freesasa_async *
+freesasa_calc_coord_async(const double *xyz,
+                          const double *radii,
+                          int n,
+                          const freesasa_parameters *parameters)
+{
+    coord_t *coord;
+
+    assert(xyz);
+    assert(radii);
+    assert(n > 0);
+
+    coord = freesasa_coord_new_linked(xyz, n);
+    if (coord == NULL) {
+        fail_msg("");
+        return NULL;
+    }
+
+    return async_start(coord, coord, radii, parameters);
+}
+
+freesasa_async_state
+freesasa_async_status(freesasa_async *async,
+                      int *n_done,
+                      int *n_total)
+{
+    freesasa_async_state state;
+
+    assert(async);
+
+    progress_lock(&async->progress);
+    state = async->state;
+    if (n_done) *n_done = async->progress.n_done;
+    if (n_total) *n_total = async->progress.n_total;
+    progress_unlock(&async->progress);
+
+    return state;
+}
+
+void
+freesasa_async_cancel(freesasa_async *async)
+{
+    assert(async);
+
+    progress_lock(&async->progress);
+    if (async->state == FREESASA_ASYNC_RUNNING) async->progress.cancel = 1;
+    progress_unlock(&async->progress);
+}
+
+freesasa_result *
+freesasa_async_wait(freesasa_async *async)
+{
+    freesasa_result *result;
+#if USE_THREADS
+    int res;
+#endif
+
+    assert(async);
+
+#if USE_THREADS
+    if (!async->joined) {
+        res = pthread_join(async->thread, NULL);
+        if (res) {
+            fail_msg(freesasa_thread_error(res));
+            return NULL;
+        }
+        async->joined = 1;
+    }
+#endif
+
+    result = async->result;
+    async->result = NULL;
+
+    return result;
+}
+
+void
+freesasa_async_free(freesasa_async *async)
+{
+    if (async) {
+        freesasa_async_cancel(async);
+        freesasa_result_free(freesasa_async_wait(async));
+        freesasa_coord_free(async->own_xyz);
+#if USE_THREADS
+        pthread_mutex_destroy(&async->progress.lock);
+#endif
+        free(async);
+    }
+}
@@ -0,0 +1,258 @@
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <assert.h>
+#include <stdlib.h>
+
+#if USE_THREADS
+# include <pthread.h>
+#endif
+
+#include "freesasa_internal.h"
+
+/* the molecules calculated by one thread */
+typedef struct {
+    const double *xyz;
+    const double *radii;
+    const int *offsets;
+    int first, last; /* range of molecules */
+    int n_max; /* largest molecule */
+    double *sasa;
+    double *total;
+    freesasa_parameters param; /* single-threaded */
+    int n_unconverged;
+    int return_value;
+} batch_block;
+
+static void
+batch_calc(batch_block *b)
+{
+    freesasa_sr_workspace *sr = NULL;
+    freesasa_lr_workspace *lr = NULL;
+    coord_t *coord = NULL;
+    const double *xyz, *radii;
+    double *sasa;
+    int m, i, n, ret = FREESASA_SUCCESS;
+
+    b->return_value = FREESASA_SUCCESS;
+    b->n_unconverged = 0;
+
+    if (b->first >= b->last || b->n_max == 0) {
+        for (m = b->first; m < b->last; ++m) {
+            if (b->total) b->total[m] = 0;
+        }
+        return;
+    }
+
+    switch (b->param.alg) {
+    case FREESASA_SHRAKE_RUPLEY:
+        sr = freesasa_sr_workspace_new(b->n_max, &b->param);
+        if (sr == NULL) ret = FREESASA_FAIL;
+        break;
+    case FREESASA_LEE_RICHARDS:
+        lr = freesasa_lr_workspace_new(b->n_max, &b->param);
+        if (lr == NULL) ret = FREESASA_FAIL;
+        break;
+    default:
+        coord = freesasa_coord_new();
+        if (coord == NULL) ret = FREESASA_FAIL;
+        break;
+    }
+    if (ret == FREESASA_FAIL) {
+        b->return_value = fail_msg("");
+        return;
+    }
+
+    for (m = b->first; m < b->last; ++m) {
+        n = b->offsets[m+1] - b->offsets[m];
+        xyz = b->xyz + 3*b->offsets[m];
+        radii = b->radii + b->offsets[m];
+        sasa = b->sasa + b->offsets[m];
+
+        if (n > 0) {
+            switch (b->param.alg) {
+            case FREESASA_SHRAKE_RUPLEY:
+                ret = freesasa_sr_workspace_calc(sr, sasa, xyz, radii, n,
+                                                 NULL, &b->n_unconverged);
+                break;
+            case FREESASA_LEE_RICHARDS:
+                ret = freesasa_lr_workspace_calc(lr, sasa, xyz, radii, n,
+                                                 NULL, &b->n_unconverged);
+                break;
+            case FREESASA_GAUSS_BONNET:
+                freesasa_coord_relink(coord, xyz, n);
+                ret = freesasa_gauss_bonnet(sasa, coord, radii, n, &b->param, NULL);
+                break;
+            case FREESASA_LCPO:
+                freesasa_coord_relink(coord, xyz, n);
+                ret = freesasa_lcpo(sasa, NULL, coord, radii, n, &b->param, NULL);
+                break;
+            default:
+                assert(0); /* should never get here */
+                break;
+            }
+            if (ret == FREESASA_FAIL) {
+                b->return_value = fail_msg("failed to calculate molecule %d", m);
+                break;
+            }
+        }
+
+        if (b->total) {
+            b->total[m] = 0;
+            for (i = 0; i < n; ++i) b->total[m] += sasa[i];
+        }
+    }
+
+    freesasa_sr_workspace_free(sr);
+    freesasa_lr_workspace_free(lr);
+    freesasa_coord_free(coord);
+}
+
+#if USE_THREADS
+static void *
+batch_thread(void *arg)
+{
+    batch_calc((batch_block *) arg);
+    pthread_exit(NULL);
+}
+
+static int
+batch_do_threads(batch_block *block,
+                 int n_threads)
+{
+    pthread_t *thread = malloc(sizeof(pthread_t) * n_threads);
+    int res, t, threads_created = 0, return_value = FREESASA_SUCCESS;
+
+    if (thread == NULL) return mem_fail();
+
+    for (t = 0; t < n_threads; ++t) {
+        res = freesasa_thread_create(&thread[t], batch_thread, (void *) &block[t]);
+        if (res) {
+            return_value = fail_msg(freesasa_thread_error(res));
+            break;
+        }
+        ++threads_created;
+    }
+    for (t = 0; t < threads_created; ++t) {
+        res = pthread_join(thread[t], NULL);
+        if (res) {
+            return_value = fail_msg(freesasa_thread_error(res));
+        }
+    }
+
+    free(thread);
+
+    return return_value;
+}
+#endif /* USE_THREADS */
+
+/** The first molecule that starts at or after atom a (by bisection) */
+static int
+first_molecule(const int *offsets,
+               int n_molecules,
+               int a)
+{
+    int lo = 0, hi = n_molecules, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi)/2;
+        if (offsets[mid] < a) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return lo;
+}
+
+int
+freesasa_calc_coord_batch(const double *xyz,
+                          const double *radii,
+                          const int *offsets,
+                          int n_molecules,
+                          double *sasa,
+                          double *total,
+                          const freesasa_parameters *parameters)
+{
+    batch_block *block;
+    int n_threads, n_atoms, n_max = 0, n_unconverged = 0,
+        return_value = FREESASA_SUCCESS, m, t;
+
+    assert(xyz);
+    assert(radii);
+    assert(offsets);
+    assert(sasa);
+
+    if (parameters == NULL) parameters = &freesasa_default_parameters;
+
+    if (n_molecules < 0) return fail_msg("negative number of molecules");
+    if (n_molecules == 0) return FREESASA_SUCCESS;
+    if (parameters->calc_gradient || parameters->calc_surface_dots) {
+        return fail_msg("gradients and surface dots can not be calculated in batch mode");
+    }
+
+    for (m = 0; m < n_molecules; ++m) {
+        if (offsets[m] < 0 || offsets[m+1] < offsets[m]) {
+            return fail_msg("offsets of molecules must be non-negative and in increasing order");
+        }
+        if (offsets[m+1] - offsets[m] > n_max) n_max = offsets[m+1] - offsets[m];
+    }
+    n_atoms = offsets[n_molecules] - offsets[0];
+
+    n_threads = parameters->n_threads;
+    if (n_threads < 1) return fail_msg("number of threads must be 1 or larger");
+    if (n_threads > n_molecules) n_threads = n_molecules;
+#if !USE_THREADS
+    if (n_threads > 1) {
+        return_value = freesasa_warn("in %s(): program compiled for single-threaded use, "
+                                     "but multiple threads were requested, will "
+                                     "proceed in single-threaded mode\n",
+                                     __func__);
+        n_threads = 1;
+    }
+#endif
+
+    block = malloc(sizeof(batch_block) * n_threads);
+    if (block == NULL) return mem_fail();
+
+    /* divide the atoms evenly over the threads, in blocks of whole
+       molecules */
+    for (t = 0; t < n_threads; ++t) {
+        block[t].xyz = xyz;
+        block[t].radii = radii;
+        block[t].offsets = offsets;
+        block[t].sasa = sasa;
+        block[t].total = total;
+        block[t].n_max = n_max;
+        block[t].param = *parameters;
+        block[t].param.n_threads = 1;
+        block[t].n_unconverged = 0;
+        block[t].return_value = FREESASA_SUCCESS;
+        block[t].first = t == 0 ? 0 :
+            first_molecule(offsets, n_molecules,
+                           offsets[0] + (int) ((double) n_atoms * t / n_threads));
+        if (t > 0) block[t-1].last = block[t].first;
+    }
+    block[n_threads-1].last = n_molecules;
+
+    if (n_threads == 1) {
+        batch_calc(&block[0]);
+    } else {
+#if USE_THREADS
+        return_value = batch_do_threads(block, n_threads);
+#endif
+    }
+
+    for (t = 0; t < n_threads; ++t) {
+        if (block[t].return_value == FREESASA_FAIL) return_value = FREESASA_FAIL;
+        n_unconverged += block[t].n_unconverged;
+    }
+    free(block);
+
+    if (return_value == FREESASA_FAIL) return fail_msg("");
+
+    if (n_unconverged > 0) {
+        return_value = freesasa_warn("%d atoms did not reach the target error",
+                                     n_unconverged);
+    }
+
+    return return_value;
+}
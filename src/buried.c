@@ -0,0 +1,318 @@
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <assert.h>
+#include <math.h>
+
+#include "freesasa_internal.h"
+#include "buried.h"
+
+/* Number of times a face is subdivided before giving up. The faces
+   of the icosahedron have angular radius 37 degrees, each
+   subdivision halves that. */
+#define BURIED_MAX_DEPTH 3
+
+/* safety margin for the containment test */
+#define BURIED_EPS 1e-10
+
+#define ICO_A 0.5257311121191336
+#define ICO_B 0.85065080835204
+
+static const double ico_vertex[12][3] = {
+    {0, -ICO_A, -ICO_B}, {-ICO_A, -ICO_B, 0}, {-ICO_B, 0, -ICO_A},
+    {0, -ICO_A, ICO_B},  {-ICO_A, ICO_B, 0},  {ICO_B, 0, -ICO_A},
+    {0, ICO_A, -ICO_B},  {ICO_A, -ICO_B, 0},  {-ICO_B, 0, ICO_A},
+    {0, ICO_A, ICO_B},   {ICO_A, ICO_B, 0},   {ICO_B, 0, ICO_A}
+};
+
+static const int ico_face[20][3] = {
+    {0, 1, 2},  {0, 1, 7},  {0, 2, 6},  {0, 5, 6},   {0, 5, 7},
+    {1, 2, 8},  {1, 3, 7},  {1, 3, 8},  {2, 4, 6},   {2, 4, 8},
+    {3, 7, 11}, {3, 8, 9},  {3, 9, 11}, {4, 6, 10},  {4, 8, 9},
+    {4, 9, 10}, {5, 6, 10}, {5, 7, 11}, {5, 10, 11}, {9, 10, 11}
+};
+
+static inline double
+dot(const double *a,
+    const double *b)
+{
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+/** normalized midpoint of a and b, on the unit sphere */
+static void
+midpoint(double *m,
+         const double *a,
+         const double *b)
+{
+    double l;
+    m[0] = a[0] + b[0];
+    m[1] = a[1] + b[1];
+    m[2] = a[2] + b[2];
+    l = sqrt(dot(m, m));
+    m[0] /= l; m[1] /= l; m[2] /= l;
+}
+
+static inline void
+swap_caps(double *a,
+          double *b)
+{
+    double tmp;
+    int k;
+    for (k = 0; k < 5; ++k) {
+        tmp = a[k]; a[k] = b[k]; b[k] = tmp;
+    }
+}
+
+/**
+    Is the spherical triangle abc buried by one of the n first caps.
+    The circumscribed cap of the triangle (direction m, angular radius
+    theta) is inside cap j (direction w, angular radius alpha) if
+    angle(m,w) + theta <= alpha.
+
+    The caps that intersect the circumscribed cap are moved to the
+    front of the array, only these have to be considered when the
+    triangle is subdivided. The cap that buries the triangle is moved
+    to the front, it is likely to also bury the next one.
+
+    Returns 0 if the center of the triangle is exposed, or if it
+    can't be shown to be buried after BURIED_MAX_DEPTH subdivisions.
+ */
+static int
+face_buried(const double *a,
+            const double *b,
+            const double *c,
+            double *caps,
+            int n,
+            int depth)
+{
+    double m[3], u[3], v[3], ab[3], bc[3], ca[3], l, cos_t, sin_t, cos_phi;
+    double *w;
+    int k, n_rel = 0, center_buried = 0;
+
+    /* circumcenter */
+    u[0] = b[0] - a[0]; u[1] = b[1] - a[1]; u[2] = b[2] - a[2];
+    v[0] = c[0] - a[0]; v[1] = c[1] - a[1]; v[2] = c[2] - a[2];
+    m[0] = u[1]*v[2] - u[2]*v[1];
+    m[1] = u[2]*v[0] - u[0]*v[2];
+    m[2] = u[0]*v[1] - u[1]*v[0];
+    l = sqrt(dot(m, m));
+    if (dot(m, a) < 0) l = -l;
+    m[0] /= l; m[1] /= l; m[2] /= l;
+
+    cos_t = fmin(dot(m, a), fmin(dot(m, b), dot(m, c)));
+    sin_t = sqrt(1 - cos_t*cos_t);
+
+    for (k = 0; k < n; ++k) {
+        w = caps + 5*k;
+        cos_phi = dot(m, w);
+        if (cos_phi >= w[3]) {
+            center_buried = 1;
+            /* alpha >= theta and cos(phi) >= cos(alpha - theta) */
+            if (w[3] <= cos_t &&
+                cos_phi >= w[3]*cos_t + w[4]*sin_t + BURIED_EPS) {
+                swap_caps(caps, w);
+                return 1;
+            }
+        }
+        /* phi < alpha + theta, with margin */
+        if (cos_phi > w[3]*cos_t - w[4]*sin_t - BURIED_EPS) {
+            swap_caps(caps + 5*n_rel, w);
+            ++n_rel;
+        }
+    }
+
+    if (!center_buried || depth == BURIED_MAX_DEPTH) return 0;
+
+    midpoint(ab, a, b);
+    midpoint(bc, b, c);
+    midpoint(ca, c, a);
+
+    return face_buried(a, ab, ca, caps, n_rel, depth + 1)
+        && face_buried(ab, b, bc, caps, n_rel, depth + 1)
+        && face_buried(ca, bc, c, caps, n_rel, depth + 1)
+        && face_buried(ab, bc, ca, caps, n_rel, depth + 1);
+}
+
+/** freesasa_atom_buried() with shift subtracted from all radii */
+static int
+atom_buried_shifted(int i,
+                    const double *radii,
+                    double shift,
+                    const nb_list *nb,
+                    double *work)
+{
+    const double Ri = radii[i] - shift;
+    const int nni = nb->nn[i], *nbi = nb->nb[i];
+    double dx, dy, dz, d, Rj, kappa, *cap;
+    int j, jj, f, n_caps = 0;
+
+    for (jj = 0; jj < nni; ++jj) {
+        j = nbi[jj];
+        Rj = radii[j] - shift;
+        dx = nb->xd[i][jj];
+        dy = nb->yd[i][jj];
+        dz = nb->zd[i][jj];
+        d = sqrt(dx*dx + dy*dy + dz*dz);
+
+        /* i completely inside j */
+        if (d + Ri < Rj) return 1;
+        /* identical spheres, or no contact */
+        if (d == 0 || d >= Ri + Rj) continue;
+
+        /* cosine of the angular radius of the cap buried by j */
+        kappa = (Ri*Ri + d*d - Rj*Rj)/(2*Ri*d);
+        if (kappa >= 1) continue; /* j inside i */
+
+        cap = work + 5*n_caps;
+        cap[0] = dx/d;
+        cap[1] = dy/d;
+        cap[2] = dz/d;
+        cap[3] = kappa;
+        cap[4] = sqrt(1 - kappa*kappa);
+        ++n_caps;
+    }
+
+    if (n_caps == 0) return 0;
+
+    for (f = 0; f < 20; ++f) {
+        if (!face_buried(ico_vertex[ico_face[f][0]],
+                         ico_vertex[ico_face[f][1]],
+                         ico_vertex[ico_face[f][2]],
+                         work, n_caps, 0))
+            return 0;
+    }
+
+    return 1;
+}
+
+int
+freesasa_atom_buried(int i,
+                     const double *radii,
+                     const nb_list *nb,
+                     double *work)
+{
+    return atom_buried_shifted(i, radii, 0, nb, work);
+}
+
+int
+freesasa_atom_buried_probes(int i,
+                            const double *radii,
+                            const double *shift,
+                            int n_probes,
+                            const nb_list *nb,
+                            double *work)
+{
+    int lo = 0, hi = n_probes, mid;
+
+    /* a sphere that is buried with a given probe, is buried with all
+       larger probes too, find the first buried one by bisection */
+    if (!atom_buried_shifted(i, radii, shift[n_probes-1], nb, work)) return n_probes;
+    hi = n_probes - 1;
+    while (lo < hi) {
+        mid = (lo + hi)/2;
+        if (atom_buried_shifted(i, radii, shift[mid], nb, work)) hi = mid;
+        else lo = mid + 1;
+    }
+
+    return lo;
+}
+
+#if USE_CHECK
+#include <check.h>
+
+START_TEST (test_icosahedron)
+{
+    int f, k;
+    double m[3];
+
+    for (k = 0; k < 12; ++k) {
+        ck_assert(fabs(dot(ico_vertex[k], ico_vertex[k]) - 1) < 1e-12);
+    }
+    /* all faces are equilateral with the same edge length */
+    for (f = 0; f < 20; ++f) {
+        for (k = 0; k < 3; ++k) {
+            ck_assert(fabs(dot(ico_vertex[ico_face[f][k]], ico_vertex[ico_face[f][(k+1)%3]])
+                           - 1/sqrt(5)) < 1e-12);
+        }
+    }
+    midpoint(m, ico_vertex[0], ico_vertex[1]);
+    ck_assert(fabs(dot(m, m) - 1) < 1e-12);
+}
+END_TEST
+
+START_TEST (test_atom_buried)
+{
+    /* atom 0 surrounded by an octahedron of larger spheres, which
+       are partially exposed, atom 7 is inside atom 6 and atom 8 has
+       no neighbors */
+    double v[] = {0,0,0,  2,0,0, -2,0,0, 0,2,0, 0,-2,0,  0,0,2,  0,0,-2,
+                  0,0,-2.5,  10,10,10};
+    double r[] = {1.8, 2.5, 2.5, 2.5, 2.5, 2.5, 2.5, 0.5, 1};
+    double work[FREESASA_BURIED_WORK_SIZE(8)];
+    coord_t *xyz = freesasa_coord_new_linked(v, 9);
+    nb_list *nb = freesasa_nb_new(xyz, r);
+    int i;
+
+    ck_assert_ptr_ne(nb, NULL);
+    ck_assert(freesasa_atom_buried(0, r, nb, work));
+    for (i = 1; i < 7; ++i) {
+        ck_assert(!freesasa_atom_buried(i, r, nb, work));
+    }
+    ck_assert(freesasa_atom_buried(7, r, nb, work));
+    ck_assert(!freesasa_atom_buried(8, r, nb, work));
+
+    /* remove one of the spheres around atom 0 */
+    r[5] = 0.1;
+    freesasa_nb_free(nb);
+    nb = freesasa_nb_new(xyz, r);
+    ck_assert(!freesasa_atom_buried(0, r, nb, work));
+
+    freesasa_nb_free(nb);
+    freesasa_coord_free(xyz);
+}
+END_TEST
+
+START_TEST (test_atom_buried_probes)
+{
+    /* atom 0 surrounded by an octahedron of spheres with the same
+       radius, the caps are large enough to cover the sphere if the
+       probe radius is large (the cos of their angular radius is
+       1/(1 + probe), and needs to be below 1/sqrt(3)) */
+    double v[] = {0,0,0,  2,0,0, -2,0,0, 0,2,0, 0,-2,0,  0,0,2,  0,0,-2};
+    double r[7];
+    double shift[] = {5, 4.5, 2, 0}; /* probes 0, 0.5, 3 and 5 */
+    double work[FREESASA_BURIED_WORK_SIZE(6)];
+    coord_t *xyz = freesasa_coord_new_linked(v, 7);
+    nb_list *nb;
+    int i;
+
+    for (i = 0; i < 7; ++i) r[i] = 1 + 5;
+    nb = freesasa_nb_new(xyz, r);
+    ck_assert_ptr_ne(nb, NULL);
+
+    ck_assert_int_eq(freesasa_atom_buried_probes(0, r, shift, 4, nb, work), 2);
+    ck_assert_int_eq(freesasa_atom_buried_probes(0, r, shift, 2, nb, work), 2);
+    ck_assert_int_eq(freesasa_atom_buried_probes(0, r, shift + 2, 2, nb, work), 0);
+    ck_assert_int_eq(freesasa_atom_buried_probes(0, r, shift + 1, 3, nb, work), 1);
+    for (i = 1; i < 7; ++i) {
+        ck_assert_int_eq(freesasa_atom_buried_probes(i, r, shift, 4, nb, work), 4);
+    }
+
+    freesasa_nb_free(nb);
+    freesasa_coord_free(xyz);
+}
+END_TEST
+
+TCase *
+test_buried_static()
+{
+    TCase *tc = tcase_create("buried.c static");
+    tcase_add_test(tc, test_icosahedron);
+    tcase_add_test(tc, test_atom_buried);
+    tcase_add_test(tc, test_atom_buried_probes);
+
+    return tc;
+}
+
+#endif /* USE_CHECK */
@@ -0,0 +1,74 @@
+#ifndef FREESASA_BURIED_H
+#define FREESASA_BURIED_H
+
+#include "coord.h"
+#include "nb.h"
+
+/**
+   @file
+
+   Conservative test for atoms that are completely buried by their
+   neighbors. Used by the S&R and L&R calculations to skip atoms that
+   can't have any SASA.
+
+   Each neighbor j of atom i buries a spherical cap of sphere i. The
+   surface of sphere i is tiled by the faces of a recursively
+   subdivided icosahedron, and a face is buried if the cap
+   circumscribing it is inside one of the neighbor caps. Faces that
+   can't be shown to be buried are subdivided a few times. The test
+   gives up as soon as the center of a face is exposed, which makes it
+   cheap for exposed atoms.
+ */
+
+/** Number of doubles needed in the work array of
+    freesasa_atom_buried() for an atom with n neighbors */
+#define FREESASA_BURIED_WORK_SIZE(n) (5*(n))
+
+/**
+    Check if the surface of a sphere is completely buried by its
+    neighbors.
+
+    Never gives false positives, but atoms where the exposed area is
+    zero or very small can give false negatives.
+
+    @param i Index of the sphere.
+    @param radii Radii of all spheres (including probe radius).
+    @param nb Neighbor list calculated from the coordinates and radii.
+    @param work Work array with space for at least
+      FREESASA_BURIED_WORK_SIZE(nb->nn[i]) doubles.
+    @return 1 if the sphere is certainly buried, 0 else.
+ */
+int
+freesasa_atom_buried(int i,
+                     const double *radii,
+                     const nb_list *nb,
+                     double *work);
+
+/**
+    Check if the surface of a sphere is buried for several probe
+    radii.
+
+    A sphere that is buried with a given probe radius is also buried
+    with all larger probe radii, this can be used to find the smallest
+    one that buries it with a few calls to freesasa_atom_buried().
+
+    @param i Index of the sphere.
+    @param radii Radii of all spheres, including the largest probe radius.
+    @param shift For each probe radius, the largest probe radius minus
+      this one, in decreasing order (i.e. increasing probe radius).
+    @param n_probes Number of probe radii.
+    @param nb Neighbor list calculated from the coordinates and radii.
+    @param work Work array, as for freesasa_atom_buried().
+    @return The index of the first probe radius in shift for which the
+      sphere is certainly buried, n_probes if it is not buried for any
+      of them.
+ */
+int
+freesasa_atom_buried_probes(int i,
+                            const double *radii,
+                            const double *shift,
+                            int n_probes,
+                            const nb_list *nb,
+                            double *work);
+
+#endif /* FREESASA_BURIED_H */
@@ -17,6 +17,7 @@ freesasa_coord_new()
         c->xyz = NULL;
         c->n = 0;
         c->is_linked = 0;
+        c->is_periodic = 0;
     } else {
         mem_fail();
     }
@@ -59,6 +60,8 @@ freesasa_coord_clone(const coord_t *src)
         fail_msg("");
         return NULL;
     }
+    c->is_periodic = src->is_periodic;
+    memcpy(c->box, src->box, sizeof(c->box));
 
     return c;
 }
@@ -87,6 +90,20 @@ freesasa_coord_new_linked(const double *xyz,
     return c;
 }
 
+void
+freesasa_coord_relink(coord_t *c,
+                      const double *xyz,
+                      int n)
+{
+    assert(c);
+    assert(xyz);
+    assert(c->is_linked || c->xyz == NULL);
+
+    c->xyz = (double*)xyz;
+    c->n = n;
+    c->is_linked = 1;
+}
+
 int
 freesasa_coord_append(coord_t *c,
                       const double *xyz,
@@ -336,3 +353,39 @@ freesasa_coord_scale(coord_t *c,
         c->xyz[i] *= s;
     }
 }
+
+int
+freesasa_coord_set_periodic(coord_t *c,
+                            const double *box)
+{
+    const double *a, *b, *cc;
+    double volume;
+
+    assert(c);
+
+    if (box == NULL) {
+        c->is_periodic = 0;
+        return FREESASA_SUCCESS;
+    }
+
+    a = box; b = box + 3; cc = box + 6;
+    volume = a[0]*(b[1]*cc[2] - b[2]*cc[1])
+        + a[1]*(b[2]*cc[0] - b[0]*cc[2])
+        + a[2]*(b[0]*cc[1] - b[1]*cc[0]);
+    if (!(fabs(volume) > 0)) {
+        return fail_msg("the box vectors of a periodic box have to be linearly independent");
+    }
+
+    memcpy(c->box, box, sizeof(c->box));
+    c->is_periodic = 1;
+
+    return FREESASA_SUCCESS;
+}
+
+const double *
+freesasa_coord_periodic(const coord_t *c)
+{
+    assert(c);
+
+    return c->is_periodic ? c->box : NULL;
+}
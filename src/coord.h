@@ -35,6 +35,12 @@ typedef struct coord_t {
     /** array of all coordinates, dimension 3*n,
         x_1,y_1,z_1,...,x_n,y_n,z_n. */
     double *xyz; 
+
+    /** 1 if the coordinates are in a periodic box, else 0 */
+    int is_periodic;
+
+    /** The box vectors a, b and c, if periodic */
+    double box[9];
 } coord_t;
 
 /**
@@ -108,6 +114,22 @@ coord_t *
 freesasa_coord_new_linked(const double *xyz,
                           int n);
 
+/**
+    Link an existing linked ::coord_t object to a new array.
+
+    Allows one object to be reused for a series of arrays, without
+    allocating memory for each.
+
+    @param coord A ::coord_t object created by
+      freesasa_coord_new_linked() (or an empty one).
+    @param xyz Array of coordinates x1,y1,z1,x2,y2,z2,...
+    @param n Number of coordinates (array has size 3*n).
+ */
+void
+freesasa_coord_relink(coord_t *coord,
+                      const double *xyz,
+                      int n);
+
 /**
     Append coordinates to ::coord_t object from one array.
 
@@ -349,6 +371,34 @@ void
 freesasa_coord_scale(coord_t *coord,
                      double a);
 
+/**
+    Make the coordinates periodic.
+
+    The coordinates are assumed to be in an infinite lattice of
+    copies, translated by integer combinations of the box vectors. The
+    box can be triclinic, and the coordinates don't have to be inside
+    it.
+
+    @param coord A ::coord_t object
+    @param box The box vectors a, b and c (9 values), or NULL to
+      remove periodicity.
+    @return ::FREESASA_SUCCESS. ::FREESASA_FAIL if the box vectors
+      are linearly dependent.
+ */
+int
+freesasa_coord_set_periodic(coord_t *coord,
+                            const double *box);
+
+/**
+    The periodic box of the coordinates.
+
+    @param coord A ::coord_t object
+    @return The box vectors a, b and c (9 values), NULL if the
+      coordinates are not periodic.
+ */
+const double *
+freesasa_coord_periodic(const coord_t *coord) __attrib_pure__;
+
 #undef __attrib_pure__
 
 #endif
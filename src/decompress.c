@@ -0,0 +1,588 @@
+/* needed for fopencookie() */
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/types.h>
+#if USE_THREADS
+# include <pthread.h>
+#endif
+#if USE_ZLIB
+# include <zlib.h>
+#endif
+#if USE_ZSTD
+# include <zstd.h>
+#endif
+
+#include "freesasa_internal.h"
+
+/**
+   Transparent decompression of input. The decompressed data is read
+   through a FILE created by fopencookie() (glibc) or funopen() (BSD,
+   macOS), so that the parsers can read it as any other stream. If
+   threads are available and requested, decompression runs ahead of
+   the reader in a separate thread, with a few blocks in between.
+
+   The same kind of stream passes input through unchanged, when bytes
+   have been read from a pipe to check the format, and can't be put
+   back.
+ */
+
+#if HAVE_FOPENCOOKIE || HAVE_FUNOPEN
+# define USE_DECOMPRESS 1
+#else
+# define USE_DECOMPRESS 0
+#endif
+
+/* magic numbers of gzip files and zstd frames */
+static const unsigned char gzip_magic[] = {0x1f, 0x8b};
+static const unsigned char zstd_magic[] = {0x28, 0xb5, 0x2f, 0xfd};
+#define MAGIC_MAX_SIZE 4
+
+#if USE_DECOMPRESS
+
+/* size of the blocks of compressed and decompressed data */
+#define DECOMPRESS_BLOCK (1 << 18)
+/* number of decompressed blocks a decompression thread works ahead */
+#define DECOMPRESS_N_BLOCKS 4
+
+enum codec {DECOMPRESS_GZIP, DECOMPRESS_ZSTD, DECOMPRESS_COPY};
+
+struct block {
+    char *data;
+    size_t len;
+};
+
+struct decoder {
+    FILE *input;
+    enum codec codec;
+    unsigned char *in; /* compressed data */
+    int input_eof;
+    int at_end; /* at the end of a gzip member or zstd frame */
+#if USE_ZLIB
+    z_stream z;
+#endif
+#if USE_ZSTD
+    ZSTD_DStream *zs;
+    ZSTD_inBuffer zin;
+#endif
+    const unsigned char *copy_next; /* uncompressed input */
+    size_t copy_avail;
+
+    /* decompressed blocks, only one is used without a thread */
+    struct block block[DECOMPRESS_N_BLOCKS];
+    int first, n_full; /* ring buffer of full blocks */
+    size_t pos; /* read position in the first block */
+    int done; /* no more blocks will be filled */
+    int error;
+
+    int threaded;
+#if USE_THREADS
+    int closing;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+};
+
+/* read more compressed input, if the buffer is empty */
+static int
+decoder_read_input(struct decoder *d,
+                   const unsigned char **next,
+                   size_t *avail)
+{
+    size_t n;
+
+    if (*avail > 0 || d->input_eof) return FREESASA_SUCCESS;
+
+    n = fread(d->in, 1, DECOMPRESS_BLOCK, d->input);
+    if (n == 0) {
+        if (ferror(d->input)) return fail_msg("error reading compressed input");
+        d->input_eof = 1;
+    }
+    *next = d->in;
+    *avail = n;
+
+    return FREESASA_SUCCESS;
+}
+
+#if USE_ZLIB
+static long
+gzip_fill(struct decoder *d,
+          char *out,
+          size_t size)
+{
+    z_stream *z = &d->z;
+    const unsigned char *next;
+    size_t avail;
+    uInt in_before, out_before;
+    int ret;
+
+    z->next_out = (Bytef *) out;
+    z->avail_out = size;
+
+    while (z->avail_out > 0) {
+        next = z->next_in;
+        avail = z->avail_in;
+        if (decoder_read_input(d, &next, &avail)) return -1;
+        z->next_in = (Bytef *) next;
+        z->avail_in = avail;
+
+        in_before = z->avail_in;
+        out_before = z->avail_out;
+        ret = inflate(z, Z_NO_FLUSH);
+        if (z->avail_in < in_before) d->at_end = 0;
+
+        if (ret == Z_STREAM_END) {
+            /* concatenated gzip members are read as one */
+            d->at_end = 1;
+            if (inflateReset(z) != Z_OK) return fail_msg("invalid gzip input");
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            return fail_msg("invalid gzip input: %s", z->msg ? z->msg : "unknown error");
+        } else if (d->input_eof && z->avail_in == 0 && z->avail_out == out_before) {
+            if (!d->at_end) return fail_msg("unexpected end of gzip input");
+            break;
+        }
+    }
+
+    return size - z->avail_out;
+}
+#endif /* USE_ZLIB */
+
+#if USE_ZSTD
+static long
+zstd_fill(struct decoder *d,
+          char *out,
+          size_t size)
+{
+    ZSTD_outBuffer zout;
+    const unsigned char *next;
+    size_t avail, ret, out_before;
+
+    zout.dst = out;
+    zout.size = size;
+    zout.pos = 0;
+
+    while (zout.pos < zout.size) {
+        next = (const unsigned char *) d->zin.src + d->zin.pos;
+        avail = d->zin.size - d->zin.pos;
+        if (decoder_read_input(d, &next, &avail)) return -1;
+        d->zin.src = next;
+        d->zin.size = avail;
+        d->zin.pos = 0;
+
+        out_before = zout.pos;
+        ret = ZSTD_decompressStream(d->zs, &zout, &d->zin);
+        if (ZSTD_isError(ret)) {
+            return fail_msg("invalid zstd input: %s", ZSTD_getErrorName(ret));
+        }
+        /* 0 means that a frame has been decoded and flushed, without
+           progress it is the size of the next frame header */
+        if (d->zin.pos > 0 || zout.pos > out_before) d->at_end = (ret == 0);
+        else if (d->input_eof) {
+            if (!d->at_end) return fail_msg("unexpected end of zstd input");
+            break;
+        }
+    }
+
+    return zout.pos;
+}
+#endif /* USE_ZSTD */
+
+/* input that isn't compressed */
+static long
+copy_fill(struct decoder *d,
+          char *out,
+          size_t size)
+{
+    size_t n = 0, m;
+
+    while (n < size) {
+        if (decoder_read_input(d, &d->copy_next, &d->copy_avail)) return -1;
+        if (d->copy_avail == 0) break;
+        m = d->copy_avail < size - n ? d->copy_avail : size - n;
+        memcpy(out + n, d->copy_next, m);
+        d->copy_next += m;
+        d->copy_avail -= m;
+        n += m;
+    }
+
+    return n;
+}
+
+/* Fill a block with decompressed data, returns the number of
+   bytes, 0 at the end of the input and -1 on errors. */
+static long
+decoder_fill(struct decoder *d,
+             char *out,
+             size_t size)
+{
+    switch (d->codec) {
+#if USE_ZLIB
+    case DECOMPRESS_GZIP: return gzip_fill(d, out, size);
+#endif
+#if USE_ZSTD
+    case DECOMPRESS_ZSTD: return zstd_fill(d, out, size);
+#endif
+    case DECOMPRESS_COPY: return copy_fill(d, out, size);
+    default: break;
+    }
+    assert(0);
+    return -1;
+}
+
+static void
+decoder_free(struct decoder *d)
+{
+    int i;
+
+    if (d == NULL) return;
+
+#if USE_ZLIB
+    if (d->codec == DECOMPRESS_GZIP) inflateEnd(&d->z);
+#endif
+#if USE_ZSTD
+    if (d->codec == DECOMPRESS_ZSTD) ZSTD_freeDStream(d->zs);
+#endif
+    for (i = 0; i < DECOMPRESS_N_BLOCKS; ++i) free(d->block[i].data);
+    free(d->in);
+    free(d);
+}
+
+#if USE_THREADS
+/* fills the blocks ahead of the reader, until the end of the input
+   or until the stream is closed */
+static void *
+decoder_thread(void *arg)
+{
+    struct decoder *d = (struct decoder *) arg;
+    struct block *b;
+    long n;
+    int last = 0;
+
+    while (!last) {
+        pthread_mutex_lock(&d->lock);
+        while (d->n_full == DECOMPRESS_N_BLOCKS && !d->closing) {
+            pthread_cond_wait(&d->cond, &d->lock);
+        }
+        if (d->closing) {
+            pthread_mutex_unlock(&d->lock);
+            break;
+        }
+        b = &d->block[(d->first + d->n_full) % DECOMPRESS_N_BLOCKS];
+        pthread_mutex_unlock(&d->lock);
+
+        /* the reader does not touch empty blocks */
+        n = decoder_fill(d, b->data, DECOMPRESS_BLOCK);
+
+        pthread_mutex_lock(&d->lock);
+        if (n > 0) {
+            b->len = n;
+            ++d->n_full;
+        }
+        if (n < (long) DECOMPRESS_BLOCK) {
+            d->error = (n < 0);
+            d->done = 1;
+            last = 1;
+        }
+        pthread_cond_broadcast(&d->cond);
+        pthread_mutex_unlock(&d->lock);
+    }
+
+    return NULL;
+}
+#endif /* USE_THREADS */
+
+static long
+decoder_read(struct decoder *d,
+             char *buf,
+             size_t size)
+{
+    struct block *b;
+    size_t n;
+    long ret;
+
+    if (!d->threaded) {
+        if (d->error) return -1;
+        ret = decoder_fill(d, buf, size);
+        if (ret < 0) d->error = 1;
+        return ret;
+    }
+
+#if USE_THREADS
+    pthread_mutex_lock(&d->lock);
+    while (d->n_full == 0 && !d->done) {
+        pthread_cond_wait(&d->cond, &d->lock);
+    }
+    if (d->n_full == 0) {
+        ret = d->error ? -1 : 0;
+        pthread_mutex_unlock(&d->lock);
+        return ret;
+    }
+    b = &d->block[d->first];
+    pthread_mutex_unlock(&d->lock);
+
+    /* the decoder does not touch full blocks */
+    n = b->len - d->pos;
+    if (n > size) n = size;
+    memcpy(buf, b->data + d->pos, n);
+    d->pos += n;
+
+    if (d->pos == b->len) {
+        pthread_mutex_lock(&d->lock);
+        d->first = (d->first + 1) % DECOMPRESS_N_BLOCKS;
+        --d->n_full;
+        d->pos = 0;
+        pthread_cond_broadcast(&d->cond);
+        pthread_mutex_unlock(&d->lock);
+    }
+
+    return n;
+#else
+    (void) b; (void) n;
+    assert(0);
+    return -1;
+#endif
+}
+
+static int
+decoder_close(struct decoder *d)
+{
+#if USE_THREADS
+    if (d->threaded) {
+        pthread_mutex_lock(&d->lock);
+        d->closing = 1;
+        pthread_cond_broadcast(&d->cond);
+        pthread_mutex_unlock(&d->lock);
+        pthread_join(d->thread, NULL);
+        pthread_mutex_destroy(&d->lock);
+        pthread_cond_destroy(&d->cond);
+    }
+#endif
+    decoder_free(d);
+    return 0;
+}
+
+#if HAVE_FOPENCOOKIE
+static ssize_t
+cookie_read(void *cookie, char *buf, size_t size)
+{
+    return decoder_read((struct decoder *) cookie, buf, size);
+}
+
+static int
+cookie_close(void *cookie)
+{
+    return decoder_close((struct decoder *) cookie);
+}
+#else
+static int
+cookie_read(void *cookie, char *buf, int size)
+{
+    return (int) decoder_read((struct decoder *) cookie, buf, size);
+}
+
+static int
+cookie_close(void *cookie)
+{
+    return decoder_close((struct decoder *) cookie);
+}
+#endif
+
+/* head contains n_head bytes already read from input */
+static struct decoder *
+decoder_new(FILE *input,
+            enum codec codec,
+            const unsigned char *head,
+            size_t n_head,
+            int n_threads)
+{
+    struct decoder *d = malloc(sizeof(struct decoder));
+    int i, n_blocks;
+
+    if (d == NULL) {
+        mem_fail();
+        return NULL;
+    }
+
+    d->input = input;
+    d->codec = codec;
+    d->input_eof = 0;
+    d->at_end = 0;
+    d->first = d->n_full = 0;
+    d->pos = 0;
+    d->done = d->error = 0;
+    d->threaded = USE_THREADS && n_threads > 1;
+    for (i = 0; i < DECOMPRESS_N_BLOCKS; ++i) d->block[i].data = NULL;
+
+    d->in = malloc(DECOMPRESS_BLOCK);
+    n_blocks = d->threaded ? DECOMPRESS_N_BLOCKS : 0;
+    for (i = 0; i < n_blocks; ++i) {
+        d->block[i].data = malloc(DECOMPRESS_BLOCK);
+        d->block[i].len = 0;
+        if (d->block[i].data == NULL) break;
+    }
+    if (d->in == NULL || i < n_blocks) {
+        mem_fail();
+        d->codec = -1; /* nothing to release */
+        decoder_free(d);
+        return NULL;
+    }
+    memcpy(d->in, head, n_head);
+
+    switch (codec) {
+#if USE_ZLIB
+    case DECOMPRESS_GZIP:
+        d->z.zalloc = Z_NULL;
+        d->z.zfree = Z_NULL;
+        d->z.opaque = Z_NULL;
+        d->z.next_in = d->in;
+        d->z.avail_in = n_head;
+        /* 32 means that gzip and zlib headers are detected */
+        if (inflateInit2(&d->z, 15 + 32) != Z_OK) {
+            fail_msg("could not initialize gzip decoder");
+            d->codec = -1;
+            decoder_free(d);
+            return NULL;
+        }
+        break;
+#endif
+#if USE_ZSTD
+    case DECOMPRESS_ZSTD:
+        d->zin.src = d->in;
+        d->zin.size = n_head;
+        d->zin.pos = 0;
+        d->zs = ZSTD_createDStream();
+        if (d->zs == NULL || ZSTD_isError(ZSTD_initDStream(d->zs))) {
+            fail_msg("could not initialize zstd decoder");
+            if (d->zs == NULL) d->codec = -1;
+            decoder_free(d);
+            return NULL;
+        }
+        break;
+#endif
+    case DECOMPRESS_COPY:
+        d->copy_next = d->in;
+        d->copy_avail = n_head;
+        break;
+    default:
+        assert(0);
+    }
+
+    return d;
+}
+
+static FILE *
+decompress_open(FILE *input,
+                enum codec codec,
+                const unsigned char *head,
+                size_t n_head,
+                int n_threads)
+{
+    struct decoder *d = decoder_new(input, codec, head, n_head, n_threads);
+    FILE *out;
+#if HAVE_FOPENCOOKIE
+    cookie_io_functions_t io = {cookie_read, NULL, NULL, cookie_close};
+#endif
+
+    if (d == NULL) return NULL;
+
+#if USE_THREADS
+    if (d->threaded) {
+        int res;
+        d->closing = 0;
+        pthread_mutex_init(&d->lock, NULL);
+        pthread_cond_init(&d->cond, NULL);
+        res = freesasa_thread_create(&d->thread, decoder_thread, d);
+        if (res) {
+            /* decompress in the reader instead */
+            freesasa_warn("%s, decompressing without a separate thread",
+                          freesasa_thread_error(res));
+            pthread_mutex_destroy(&d->lock);
+            pthread_cond_destroy(&d->cond);
+            d->threaded = 0;
+        }
+    }
+#endif
+
+#if HAVE_FOPENCOOKIE
+    out = fopencookie(d, "r", io);
+#else
+    out = funopen(d, cookie_read, NULL, NULL, cookie_close);
+#endif
+    if (out == NULL) {
+        decoder_close(d);
+        fail_msg("could not open decompressed stream");
+    }
+
+    return out;
+}
+
+#endif /* USE_DECOMPRESS */
+
+FILE *
+freesasa_decompress(FILE *input,
+                    int n_threads)
+{
+    unsigned char head[MAGIC_MAX_SIZE];
+    size_t n;
+    int c;
+
+    assert(input);
+    assert(n_threads > 0);
+
+    /* one character can always be pushed back, also to a pipe */
+    c = getc(input);
+    if (c == EOF) return input;
+    if (c != gzip_magic[0] && c != zstd_magic[0]) {
+        if (ungetc(c, input) == EOF) {
+            fail_msg("could not read input");
+            return NULL;
+        }
+        return input;
+    }
+
+    /* the first byte can also start uncompressed input, check the
+       rest of the magic number */
+    head[0] = c;
+    n = c == gzip_magic[0] ? sizeof(gzip_magic) : sizeof(zstd_magic);
+    n = 1 + fread(head + 1, 1, n - 1, input);
+    if (ferror(input)) {
+        fail_msg("could not read input");
+        return NULL;
+    }
+
+    if (n == sizeof(gzip_magic) && memcmp(head, gzip_magic, n) == 0) {
+#if USE_DECOMPRESS && USE_ZLIB
+        return decompress_open(input, DECOMPRESS_GZIP, head, n, n_threads);
+#else
+        fail_msg("input is gzip-compressed, FreeSASA was built without support for it");
+        return NULL;
+#endif
+    }
+    if (n == sizeof(zstd_magic) && memcmp(head, zstd_magic, n) == 0) {
+#if USE_DECOMPRESS && USE_ZSTD
+        return decompress_open(input, DECOMPRESS_ZSTD, head, n, n_threads);
+#else
+        fail_msg("input is zstd-compressed, FreeSASA was built without support for it");
+        return NULL;
+#endif
+    }
+
+    /* not compressed, go back to the start, or pass the bytes that
+       were read on to the reader if that isn't possible */
+    if (fseek(input, -(long) n, SEEK_CUR) == 0) return input;
+    clearerr(input);
+#if USE_DECOMPRESS
+    return decompress_open(input, DECOMPRESS_COPY, head, n, 1);
+#else
+    fail_msg("could not read input");
+    return NULL;
+#endif
+}
@@ -0,0 +1,199 @@
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freesasa_internal.h"
+
+#define DOTS_MAGIC "FSASADOT"
+#define DOTS_VERSION 1
+
+freesasa_surface_dots *
+freesasa_surface_dots_new(void)
+{
+    freesasa_surface_dots *dots = malloc(sizeof(freesasa_surface_dots));
+
+    if (dots == NULL) {
+        mem_fail();
+        return NULL;
+    }
+
+    dots->n = 0;
+    dots->xyz = NULL;
+    dots->normal = NULL;
+    dots->atom = NULL;
+
+    return dots;
+}
+
+void
+freesasa_surface_dots_free(freesasa_surface_dots *dots)
+{
+    if (dots) {
+        free(dots->xyz);
+        free(dots->normal);
+        free(dots->atom);
+        free(dots);
+    }
+}
+
+int
+freesasa_surface_dots_reserve(freesasa_surface_dots *dots,
+                              int *capacity,
+                              int n_extra)
+{
+    int size = *capacity;
+    double *xyz, *normal;
+    int *atom;
+
+    assert(dots);
+    assert(n_extra >= 0);
+
+    if (dots->n + n_extra <= size) return FREESASA_SUCCESS;
+
+    while (size < dots->n + n_extra) size = size > 0 ? 2*size : 1024;
+
+    xyz = realloc(dots->xyz, sizeof(double) * 3 * size);
+    if (xyz == NULL) return mem_fail();
+    dots->xyz = xyz;
+
+    normal = realloc(dots->normal, sizeof(double) * 3 * size);
+    if (normal == NULL) return mem_fail();
+    dots->normal = normal;
+
+    atom = realloc(dots->atom, sizeof(int) * size);
+    if (atom == NULL) return mem_fail();
+    dots->atom = atom;
+
+    *capacity = size;
+
+    return FREESASA_SUCCESS;
+}
+
+int
+freesasa_surface_dots_append(freesasa_surface_dots *dots,
+                             int *capacity,
+                             const freesasa_surface_dots *src)
+{
+    assert(dots);
+    assert(src);
+
+    if (src->n == 0) return FREESASA_SUCCESS;
+
+    if (freesasa_surface_dots_reserve(dots, capacity, src->n))
+        return fail_msg("");
+
+    memcpy(dots->xyz + 3*dots->n, src->xyz, sizeof(double) * 3 * src->n);
+    memcpy(dots->normal + 3*dots->n, src->normal, sizeof(double) * 3 * src->n);
+    memcpy(dots->atom + dots->n, src->atom, sizeof(int) * src->n);
+    dots->n += src->n;
+
+    return FREESASA_SUCCESS;
+}
+
+freesasa_surface_dots *
+freesasa_surface_dots_clone(const freesasa_surface_dots *dots)
+{
+    freesasa_surface_dots *clone = freesasa_surface_dots_new();
+    int capacity = 0;
+
+    if (clone == NULL ||
+        freesasa_surface_dots_append(clone, &capacity, dots)) {
+        freesasa_surface_dots_free(clone);
+        fail_msg("");
+        return NULL;
+    }
+
+    return clone;
+}
+
+static int
+write_dots_xyz(FILE *output,
+               const freesasa_surface_dots *dots,
+               const char *name,
+               int normals)
+{
+    const double *v, *n;
+    int i;
+
+    fprintf(output, "%d\n", dots->n);
+    fprintf(output, "%s surface dots%s%s\n", freesasa_string,
+            name ? ", " : "", name ? name : "");
+
+    for (i = 0; i < dots->n; ++i) {
+        v = dots->xyz + 3*i;
+        fprintf(output, "X %10.4f %10.4f %10.4f", v[0], v[1], v[2]);
+        if (normals) {
+            n = dots->normal + 3*i;
+            fprintf(output, " %8.5f %8.5f %8.5f", n[0], n[1], n[2]);
+        }
+        fprintf(output, " %d\n", dots->atom[i]);
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+static int
+write_dots_binary(FILE *output,
+                  const freesasa_surface_dots *dots,
+                  int normals)
+{
+    int32_t header[3], atom;
+    float v[6];
+    int i, k, nv = normals ? 6 : 3;
+
+    header[0] = DOTS_VERSION;
+    header[1] = normals ? 1 : 0;
+    header[2] = dots->n;
+
+    fwrite(DOTS_MAGIC, 1, strlen(DOTS_MAGIC), output);
+    fwrite(header, sizeof(int32_t), 3, output);
+
+    for (i = 0; i < dots->n; ++i) {
+        for (k = 0; k < 3; ++k) {
+            v[k] = (float) dots->xyz[3*i+k];
+            if (normals) v[3+k] = (float) dots->normal[3*i+k];
+        }
+        atom = dots->atom[i];
+        fwrite(v, sizeof(float), nv, output);
+        fwrite(&atom, sizeof(int32_t), 1, output);
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+int
+freesasa_write_surface_dots(FILE *output,
+                            const freesasa_result *result,
+                            const char *name,
+                            int options)
+{
+    int normals = options & FREESASA_DOTS_NORMALS;
+
+    assert(output);
+    assert(result);
+
+    if (result->dots == NULL) {
+        return fail_msg("result has no surface dots, they have to be "
+                        "requested before the calculation");
+    }
+
+    if (options & FREESASA_DOTS_XYZ) {
+        write_dots_xyz(output, result->dots, name, normals);
+    } else if (options & FREESASA_DOTS_BINARY) {
+        write_dots_binary(output, result->dots, normals);
+    } else {
+        return fail_msg("no valid surface dot format specified");
+    }
+
+    fflush(output);
+    if (ferror(output)) {
+        return fail_msg(strerror(errno));
+    }
+
+    return FREESASA_SUCCESS;
+}
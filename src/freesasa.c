@@ -9,6 +9,7 @@
 #endif
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <assert.h>
 
 #include "freesasa_internal.h"
@@ -40,11 +41,17 @@ const freesasa_parameters freesasa_default_parameters = {
     FREESASA_DEF_PROBE_RADIUS,
     FREESASA_DEF_SR_N,
     FREESASA_DEF_LR_N,
-    DEF_NUMBER_THREADS
+    DEF_NUMBER_THREADS,
+    0,
+    0,
+    0,
+    0,
+    0,
+    0
 };
 
-static freesasa_result *
-result_new(int n)
+freesasa_result *
+freesasa_result_new(int n)
 {
     freesasa_result *result = malloc(sizeof(freesasa_result));
 
@@ -53,6 +60,8 @@ result_new(int n)
         return NULL;
     }
 
+    result->gradient = NULL;
+    result->dots = NULL;
     result->sasa = malloc(sizeof(double)  * n);
 
     if (result->sasa == NULL) {
@@ -62,6 +71,7 @@ result_new(int n)
     }
 
     result->n_atoms = n;
+    result->n_skipped = 0;
 
     return result;
 }
@@ -71,23 +81,139 @@ freesasa_result_free(freesasa_result *r)
 {
     if (r) {
         free(r->sasa);
+        free(r->gradient);
+        freesasa_surface_dots_free(r->dots);
         free(r);
     }
 }
 
+double
+freesasa_target_atom_error(const freesasa_parameters *param,
+                           int n_atoms)
+{
+    double target = param->target_atom_error, per_atom;
+
+    if (param->target_total_error > 0 && n_atoms > 0) {
+        per_atom = param->target_total_error / sqrt(n_atoms);
+        if (target <= 0 || per_atom < target) target = per_atom;
+    }
+
+    return target > 0 ? target : 0;
+}
+
+double
+freesasa_sort_probes(int *order,
+                     double *shift,
+                     const double *probe_radii,
+                     int n_probes)
+{
+    int k, l, tmp;
+    double probe_max;
+
+    /* insertion sort, the lists are short */
+    for (k = 0; k < n_probes; ++k) {
+        order[k] = k;
+        for (l = k; l > 0 && probe_radii[order[l-1]] > probe_radii[order[l]]; --l) {
+            tmp = order[l]; order[l] = order[l-1]; order[l-1] = tmp;
+        }
+    }
+
+    probe_max = probe_radii[order[n_probes-1]];
+    for (k = 0; k < n_probes; ++k) {
+        shift[k] = probe_max - probe_radii[order[k]];
+    }
+
+    return probe_max;
+}
+
+/** Calculate SASA of the first n_calc atoms with the algorithm
+    specified in parameters, gradient, dots and progress can be NULL */
+static int
+calc_sasa(double *sasa,
+          double *gradient,
+          int *n_skipped,
+          freesasa_surface_dots *dots,
+          const coord_t *c,
+          const double *radii,
+          int n_calc,
+          const freesasa_parameters *parameters,
+          freesasa_progress *progress)
+{
+    int ret = FREESASA_SUCCESS;
+
+    switch(parameters->alg) {
+    case FREESASA_SHRAKE_RUPLEY:
+        ret = freesasa_shrake_rupley(sasa, n_skipped, dots, c, radii, n_calc,
+                                     parameters, progress);
+        break;
+    case FREESASA_LEE_RICHARDS:
+        ret = freesasa_lee_richards(sasa, gradient, n_skipped, c, radii, n_calc,
+                                    parameters, progress);
+        break;
+    case FREESASA_GAUSS_BONNET:
+        ret = freesasa_gauss_bonnet(sasa, c, radii, n_calc, parameters, progress);
+        break;
+    case FREESASA_LCPO:
+        ret = freesasa_lcpo(sasa, gradient, c, radii, n_calc, parameters, progress);
+        break;
+    default:
+        assert(0); /* should never get here */
+        break;
+    }
+
+    return ret;
+}
+
+/** Check that the options in parameters can be combined, for a
+    calculation of the first n_calc atoms in c */
+static int
+check_parameters(const coord_t *c,
+                 int n_calc,
+                 const freesasa_parameters *parameters)
+{
+    if (parameters->calc_gradient) {
+        if (freesasa_coord_periodic(c) != NULL) {
+            return fail_msg("gradients can not be calculated with periodic boundary conditions");
+        }
+        if (parameters->alg != FREESASA_LEE_RICHARDS && parameters->alg != FREESASA_LCPO) {
+            return fail_msg("gradients can only be calculated with L&R and LCPO");
+        }
+        if (n_calc < freesasa_coord_n(c)) {
+            return fail_msg("gradients can only be calculated if all atoms are included");
+        }
+    }
+
+    if (parameters->calc_surface_dots && parameters->alg != FREESASA_SHRAKE_RUPLEY) {
+        return fail_msg("surface dots can only be calculated with S&R");
+    }
+
+    return FREESASA_SUCCESS;
+}
+
 freesasa_result*
 freesasa_calc(const coord_t *c,
               const double *radii,
               const freesasa_parameters *parameters)
+{
+    return freesasa_calc_subset(c, radii, freesasa_coord_n(c), parameters, NULL);
+}
 
+freesasa_result*
+freesasa_calc_subset(const coord_t *c,
+                     const double *radii,
+                     int n_calc,
+                     const freesasa_parameters *parameters,
+                     freesasa_progress *progress)
 {
     freesasa_result *result;
+    double *sasa;
     int ret = FREESASA_SUCCESS, i;
 
     assert(c);
     assert(radii);
+    assert(n_calc >= 0 && n_calc <= freesasa_coord_n(c));
 
-    result = result_new(freesasa_coord_n(c));
+    result = freesasa_result_new(n_calc);
 
     if (result == NULL) {
         fail_msg("");
@@ -96,16 +222,46 @@ freesasa_calc(const coord_t *c,
 
     if (parameters == NULL) parameters = &freesasa_default_parameters;
 
-    switch(parameters->alg) {
-    case FREESASA_SHRAKE_RUPLEY:
-        ret = freesasa_shrake_rupley(result->sasa, c, radii, parameters);
-        break;
-    case FREESASA_LEE_RICHARDS:
-        ret = freesasa_lee_richards(result->sasa, c, radii, parameters);
-        break;
-    default:
-        assert(0); /* should never get here */
-        break;
+    if (check_parameters(c, n_calc, parameters) == FREESASA_FAIL) {
+        fail_msg("");
+        freesasa_result_free(result);
+        return NULL;
+    }
+
+    if (parameters->calc_gradient) {
+        result->gradient = malloc(sizeof(double) * 3 * freesasa_coord_n(c));
+        if (result->gradient == NULL) {
+            mem_fail();
+            freesasa_result_free(result);
+            return NULL;
+        }
+    }
+
+    if (parameters->calc_surface_dots) {
+        result->dots = freesasa_surface_dots_new();
+        if (result->dots == NULL) {
+            fail_msg("");
+            freesasa_result_free(result);
+            return NULL;
+        }
+    }
+
+    /* the algorithms use the sasa array for all atoms */
+    sasa = result->sasa;
+    if (n_calc < freesasa_coord_n(c)) {
+        sasa = malloc(sizeof(double) * freesasa_coord_n(c));
+        if (sasa == NULL) {
+            mem_fail();
+            freesasa_result_free(result);
+            return NULL;
+        }
+    }
+
+    ret = calc_sasa(sasa, result->gradient, &result->n_skipped, result->dots,
+                    c, radii, n_calc, parameters, progress);
+    if (sasa != result->sasa) {
+        memcpy(result->sasa, sasa, sizeof(double) * n_calc);
+        free(sasa);
     }
     if (ret == FREESASA_FAIL) {
         freesasa_result_free(result);
@@ -113,7 +269,7 @@ freesasa_calc(const coord_t *c,
     }
 
     result->total = 0;
-    for (i = 0; i < freesasa_coord_n(c); ++i) {
+    for (i = 0; i < n_calc; ++i) {
         result->total += result->sasa[i];
     }
     result->parameters = *parameters;
@@ -143,6 +299,137 @@ freesasa_calc_coord(const double *xyz,
     return result;
 }
 
+/** Calculate SASA into caller's arrays, coordinates in the coord
+    object */
+static int
+calc_coord_buffer(double *sasa,
+                  double *total,
+                  const coord_t *coord,
+                  const double *radii,
+                  const freesasa_parameters *parameters)
+{
+    int i, ret;
+
+    if (parameters == NULL) parameters = &freesasa_default_parameters;
+
+    if (check_parameters(coord, freesasa_coord_n(coord), parameters) == FREESASA_FAIL) {
+        return fail_msg("");
+    }
+
+    if (parameters->calc_gradient || parameters->calc_surface_dots) {
+        return fail_msg("gradients and surface dots need a freesasa_result, "
+                        "use freesasa_calc_coord()");
+    }
+
+    ret = calc_sasa(sasa, NULL, NULL, NULL, coord, radii, freesasa_coord_n(coord),
+                    parameters, NULL);
+    if (ret == FREESASA_FAIL) return fail_msg("");
+
+    if (total) {
+        *total = 0;
+        for (i = 0; i < freesasa_coord_n(coord); ++i) {
+            *total += sasa[i];
+        }
+    }
+
+    return ret;
+}
+
+int
+freesasa_calc_coord_strided(const double *x,
+                            const double *y,
+                            const double *z,
+                            int stride,
+                            const double *radii,
+                            int n,
+                            double *sasa,
+                            double *total,
+                            const freesasa_parameters *parameters)
+{
+    coord_t *coord = NULL;
+    double *xyz = NULL;
+    int i, ret;
+
+    assert(x); assert(y); assert(z);
+    assert(radii);
+    assert(sasa);
+
+    if (stride < 1) return fail_msg("stride has to be 1 or larger");
+    if (n < 0) return fail_msg("negative number of atoms");
+    if (n == 0) {
+        if (total) *total = 0;
+        return FREESASA_SUCCESS;
+    }
+
+    /* the calculations use interleaved coordinates, only copy if
+       the input has another layout */
+    if (stride == 3 && y == x + 1 && z == x + 2) {
+        coord = freesasa_coord_new_linked(x, n);
+    } else {
+        xyz = malloc(sizeof(double) * 3 * n);
+        if (xyz == NULL) return mem_fail();
+        for (i = 0; i < n; ++i) {
+            xyz[3*i]   = x[i*stride];
+            xyz[3*i+1] = y[i*stride];
+            xyz[3*i+2] = z[i*stride];
+        }
+        coord = freesasa_coord_new_linked(xyz, n);
+    }
+
+    if (coord == NULL) ret = fail_msg("");
+    else ret = calc_coord_buffer(sasa, total, coord, radii, parameters);
+
+    freesasa_coord_free(coord);
+    free(xyz);
+
+    return ret;
+}
+
+int
+freesasa_calc_coord_strided_float(const float *x,
+                                  const float *y,
+                                  const float *z,
+                                  int stride,
+                                  const double *radii,
+                                  int n,
+                                  double *sasa,
+                                  double *total,
+                                  const freesasa_parameters *parameters)
+{
+    coord_t *coord = NULL;
+    double *xyz = NULL;
+    int i, ret;
+
+    assert(x); assert(y); assert(z);
+    assert(radii);
+    assert(sasa);
+
+    if (stride < 1) return fail_msg("stride has to be 1 or larger");
+    if (n < 0) return fail_msg("negative number of atoms");
+    if (n == 0) {
+        if (total) *total = 0;
+        return FREESASA_SUCCESS;
+    }
+
+    /* the calculations are done in double precision */
+    xyz = malloc(sizeof(double) * 3 * n);
+    if (xyz == NULL) return mem_fail();
+    for (i = 0; i < n; ++i) {
+        xyz[3*i]   = x[i*stride];
+        xyz[3*i+1] = y[i*stride];
+        xyz[3*i+2] = z[i*stride];
+    }
+
+    coord = freesasa_coord_new_linked(xyz, n);
+    if (coord == NULL) ret = fail_msg("");
+    else ret = calc_coord_buffer(sasa, total, coord, radii, parameters);
+
+    freesasa_coord_free(coord);
+    free(xyz);
+
+    return ret;
+}
+
 freesasa_result*
 freesasa_calc_structure(const freesasa_structure* structure,
                         const freesasa_parameters* parameters)
@@ -154,6 +441,147 @@ freesasa_calc_structure(const freesasa_structure* structure,
                          parameters);
 }
 
+void
+freesasa_probe_result_free(freesasa_probe_result *r)
+{
+    if (r) {
+        free(r->sasa);
+        free(r->total);
+        free(r->probe_radius);
+        free(r);
+    }
+}
+
+static freesasa_probe_result *
+probe_result_new(int n_atoms,
+                 int n_probes)
+{
+    freesasa_probe_result *result = malloc(sizeof(freesasa_probe_result));
+
+    if (result == NULL) {
+        mem_fail();
+        return NULL;
+    }
+
+    result->sasa = malloc(sizeof(double) * n_atoms * n_probes);
+    result->total = malloc(sizeof(double) * n_probes);
+    result->probe_radius = malloc(sizeof(double) * n_probes);
+
+    if (result->sasa == NULL || result->total == NULL ||
+        result->probe_radius == NULL) {
+        mem_fail();
+        freesasa_probe_result_free(result);
+        return NULL;
+    }
+
+    result->n_atoms = n_atoms;
+    result->n_probes = n_probes;
+    result->n_skipped = 0;
+
+    return result;
+}
+
+static freesasa_probe_result *
+calc_probes(const coord_t *c,
+            const double *radii,
+            const double *probe_radii,
+            int n_probes,
+            const freesasa_parameters *parameters)
+{
+    freesasa_probe_result *result;
+    const int n_atoms = freesasa_coord_n(c);
+    int ret = FREESASA_SUCCESS, i, k;
+
+    assert(c);
+    assert(radii);
+    assert(probe_radii);
+
+    if (parameters == NULL) parameters = &freesasa_default_parameters;
+
+    if (n_probes <= 0) {
+        fail_msg("at least one probe radius needed");
+        return NULL;
+    }
+    for (k = 0; k < n_probes; ++k) {
+        if (probe_radii[k] < 0) {
+            fail_msg("probe radius %f invalid, must be >= 0", probe_radii[k]);
+            return NULL;
+        }
+    }
+
+    result = probe_result_new(n_atoms, n_probes);
+    if (result == NULL) {
+        fail_msg("");
+        return NULL;
+    }
+
+    switch(parameters->alg) {
+    case FREESASA_SHRAKE_RUPLEY:
+        ret = freesasa_shrake_rupley_probes(result->sasa, &result->n_skipped, c, radii,
+                                            probe_radii, n_probes, parameters);
+        break;
+    case FREESASA_LEE_RICHARDS:
+        ret = freesasa_lee_richards_probes(result->sasa, &result->n_skipped, c, radii,
+                                           probe_radii, n_probes, parameters);
+        break;
+    default:
+        ret = fail_msg("multiple probe radii can only be used with L&R and S&R");
+        break;
+    }
+    if (ret == FREESASA_FAIL) {
+        freesasa_probe_result_free(result);
+        return NULL;
+    }
+
+    for (k = 0; k < n_probes; ++k) {
+        result->probe_radius[k] = probe_radii[k];
+        result->total[k] = 0;
+        for (i = 0; i < n_atoms; ++i) {
+            result->total[k] += result->sasa[i*n_probes + k];
+        }
+    }
+    result->parameters = *parameters;
+
+    return result;
+}
+
+freesasa_probe_result *
+freesasa_calc_coord_probes(const double *xyz,
+                           const double *radii,
+                           int n,
+                           const double *probe_radii,
+                           int n_probes,
+                           const freesasa_parameters *parameters)
+{
+    coord_t *coord = NULL;
+    freesasa_probe_result *result = NULL;
+
+    assert(xyz);
+    assert(radii);
+    assert(n > 0);
+
+    coord = freesasa_coord_new_linked(xyz, n);
+    if (coord != NULL) result = calc_probes(coord, radii, probe_radii, n_probes, parameters);
+    if (result == NULL) fail_msg("");
+
+    freesasa_coord_free(coord);
+
+    return result;
+}
+
+freesasa_probe_result *
+freesasa_calc_structure_probes(const freesasa_structure *structure,
+                               const double *probe_radii,
+                               int n_probes,
+                               const freesasa_parameters *parameters)
+{
+    assert(structure);
+
+    return calc_probes(freesasa_structure_xyz(structure),
+                       freesasa_structure_radius(structure),
+                       probe_radii, n_probes, parameters);
+}
+
 freesasa_node *
 freesasa_calc_tree(const freesasa_structure *structure,
                    const freesasa_parameters *parameters,
@@ -238,7 +666,7 @@ freesasa_tree_export(FILE *file,
 freesasa_result *
 freesasa_result_clone(const freesasa_result *result)
 {
-    freesasa_result *clone = result_new(result->n_atoms);
+    freesasa_result *clone = freesasa_result_new(result->n_atoms);
 
     if (clone == NULL) {
         fail_msg("");
@@ -248,8 +676,28 @@ freesasa_result_clone(const freesasa_result *result)
     clone->n_atoms = result->n_atoms;
     clone->total = result->total;
     clone->parameters = result->parameters;
+    clone->n_skipped = result->n_skipped;
     memcpy(clone->sasa, result->sasa, sizeof(double) * clone->n_atoms);
 
+    if (result->gradient) {
+        clone->gradient = malloc(sizeof(double) * 3 * clone->n_atoms);
+        if (clone->gradient == NULL) {
+            mem_fail();
+            freesasa_result_free(clone);
+            return NULL;
+        }
+        memcpy(clone->gradient, result->gradient, sizeof(double) * 3 * clone->n_atoms);
+    }
+
+    if (result->dots) {
+        clone->dots = freesasa_surface_dots_clone(result->dots);
+        if (clone->dots == NULL) {
+            fail_msg("");
+            freesasa_result_free(clone);
+            return NULL;
+        }
+    }
+
     return clone;
 }
 
@@ -261,6 +709,10 @@ freesasa_alg_name(freesasa_algorithm alg)
         return "Shrake & Rupley";
     case FREESASA_LEE_RICHARDS:
         return "Lee & Richards";
+    case FREESASA_GAUSS_BONNET:
+        return "Gauss-Bonnet";
+    case FREESASA_LCPO:
+        return "LCPO";
     }
     assert(0 && "Illegal algorithm");
 }
@@ -88,7 +88,9 @@ extern "C"{
 /** @brief The FreeSASA algorithms. @ingroup core */
 typedef enum {
     FREESASA_LEE_RICHARDS, /**< Lee & Richards' algorithm. */
-    FREESASA_SHRAKE_RUPLEY /**< Shrake & Rupley's algorithm. */
+    FREESASA_SHRAKE_RUPLEY, /**< Shrake & Rupley's algorithm. */
+    FREESASA_GAUSS_BONNET, /**< Analytical calculation using the Gauss-Bonnet theorem. */
+    FREESASA_LCPO /**< Fast approximation from pairwise and triplet overlaps. */
 } freesasa_algorithm;
 
 /**
@@ -205,6 +207,19 @@ enum freesasa_output_options {
     FREESASA_OUTPUT_SKIP_REL=1<<12,
 };
 
+/**
+   @brief Surface dot output options
+
+   Controls the format of freesasa_write_surface_dots().
+
+   @ingroup core
+ */
+enum freesasa_dots_options {
+    FREESASA_DOTS_XYZ=1, /**< XYZ file, one line per point with element `X`. */
+    FREESASA_DOTS_BINARY=1<<1, /**< Compact binary format, see freesasa_write_surface_dots(). */
+    FREESASA_DOTS_NORMALS=1<<2, /**< Include the surface normals. */
+};
+
 /**
    The maximum length of a selection name
    @see freesasa_select_area()
@@ -222,6 +237,25 @@ typedef struct {
     int shrake_rupley_n_points;   /**< Number of test points in S&R calculation. */
     int lee_richards_n_slices;    /**< Number of slices per atom in L&R calculation. */
     int n_threads;                /**< Number of threads to use, if compiled with thread-support. */
+    double target_atom_error;     /**< If > 0, refine the resolution of each atom in S&R and L&R
+                                       until the estimated error is below this value (in Å²).
+                                       The resolution parameters are used as starting point. */
+    double target_total_error;    /**< If > 0, refine the resolution of each atom in S&R and L&R
+                                       until the estimated error of the total is below this
+                                       value (in Å²). */
+    int calc_gradient;            /**< If non-zero, calculate the gradient of the total SASA
+                                       with respect to the coordinates (only L&R and LCPO,
+                                       not with adaptive resolution). */
+    int calc_surface_dots;        /**< If non-zero, store the exposed test points of the S&R
+                                       calculation (only S&R, with one probe radius). */
+    int numa_aware;               /**< If non-zero, S&R and L&R give each thread a spatially
+                                       compact set of atoms, and each thread builds the
+                                       neighbor lists of its own atoms, so that the memory
+                                       is placed on the NUMA node it runs on (first touch).
+                                       Only with several threads, not for periodic
+                                       coordinates or surface dots. */
+    int pin_threads;              /**< If non-zero, the threads of S&R and L&R are pinned to
+                                       one CPU each (where supported). */
 } freesasa_parameters;
 
 /**
@@ -242,6 +276,31 @@ extern const freesasa_parameters freesasa_default_parameters;
  */
 typedef struct freesasa_structure freesasa_structure;
 
+/**
+   @brief Reader of structures from a stream of PDB input
+
+   Reads the input in one pass, without seeking, see
+   freesasa_structure_stream_new().
+
+   @ingroup structure
+ */
+typedef struct freesasa_structure_stream freesasa_structure_stream;
+
+/**
+   Struct to store the exposed surface points of an S&R calculation,
+   see freesasa_parameters::calc_surface_dots.
+
+   The points are ordered by atom.
+
+   @ingroup core
+ */
+typedef struct {
+    int n;          /**< Number of points. */
+    double *xyz;    /**< Coordinates of the points, in the form x1,y1,z1,...,xn,yn,zn. */
+    double *normal; /**< Outward unit normal of the surface at each point, same layout as xyz. */
+    int *atom;      /**< Index of the atom each point belongs to. */
+} freesasa_surface_dots;
+
 /**
    Struct to store results of SASA calculation
 
@@ -252,8 +311,111 @@ typedef struct {
     double *sasa; /**< SASA of each atom in Ångström^2. */
     int n_atoms;  /**< Number of atoms. */
     freesasa_parameters parameters; /**< Parameters used when generating result. */
+    int n_skipped; /**< Number of atoms that were found to be completely buried before
+                        the calculation, and skipped (only S&R and L&R). */
+    double *gradient; /**< Gradient of the total SASA with respect to the coordinates,
+                           in the form dx1,dy1,dz1,...,dxn,dyn,dzn (in Ångström). `NULL`
+                           unless freesasa_parameters::calc_gradient is set. */
+    freesasa_surface_dots *dots; /**< Exposed surface points, `NULL` unless
+                                      freesasa_parameters::calc_surface_dots is set. */
 } freesasa_result;
 
+/**
+   Struct to store results of SASA calculation with several probe
+   radii, see freesasa_calc_coord_probes().
+
+   @ingroup core
+ */
+typedef struct {
+    double *total;        /**< Total SASA for each probe radius, in Ångström^2. */
+    double *sasa;         /**< SASA of each atom for each probe radius, in Ångström^2.
+                               Atom i and probe k at `sasa[i*n_probes + k]`. */
+    double *probe_radius; /**< The probe radii (in Ångström). */
+    int n_atoms;          /**< Number of atoms. */
+    int n_probes;         /**< Number of probe radii. */
+    freesasa_parameters parameters; /**< Parameters used when generating result
+                                         (the probe radius is not used). */
+    int n_skipped;        /**< Number of combinations of atoms and probe radii where the
+                               atom was found to be completely buried before the
+                               calculation, and skipped. */
+} freesasa_probe_result;
+
+/**
+   @brief Asynchronous calculation
+
+   Handle for a calculation running in the background, started by
+   freesasa_calc_structure_async() or freesasa_calc_coord_async().
+
+   @ingroup core
+ */
+typedef struct freesasa_async freesasa_async;
+
+/**
+   @brief State of an asynchronous calculation
+   @see freesasa_async_status()
+   @ingroup core
+ */
+typedef enum {
+    FREESASA_ASYNC_RUNNING, /**< The calculation has not finished. */
+    FREESASA_ASYNC_DONE, /**< The result is ready. */
+    FREESASA_ASYNC_FAILED, /**< The calculation failed. */
+    FREESASA_ASYNC_CANCELLED /**< The calculation was cancelled and has stopped. */
+} freesasa_async_state;
+
+/**
+   @brief Atom input for freesasa_calc_slabs()
+
+   Should store the coordinates (3 values) and the radius of the next
+   atom. Returns 1 if an atom was read, 0 at the end of the input and
+   ::FREESASA_FAIL on errors.
+
+   @ingroup core
+ */
+typedef int (*freesasa_atom_reader)(double *xyz, double *radius, void *data);
+
+/**
+   @brief Result output for freesasa_calc_slabs()
+
+   Receives the SASA of the atom with the given index, the atoms are
+   numbered in the order they were read. Returns ::FREESASA_SUCCESS,
+   or ::FREESASA_FAIL to stop the calculation.
+
+   @ingroup core
+ */
+typedef int (*freesasa_sasa_writer)(int index, double sasa, void *data);
+
+/**
+   @brief Preprocessed receptor
+
+   A receptor with its SASA and a spatial index of its atoms, created
+   by freesasa_receptor_from_coord() or
+   freesasa_receptor_from_structure(), for the calculation of many
+   ligand poses with freesasa_receptor_calc_pose().
+
+   @ingroup core
+ */
+typedef struct freesasa_receptor freesasa_receptor;
+
+/**
+   Struct to store the result of a ligand pose, see
+   freesasa_receptor_calc_pose().
+
+   @ingroup core
+ */
+typedef struct {
+    double delta_total;    /**< SASA of the complex minus SASA of the free receptor
+                                and free ligand, in Ångström^2. */
+    double ligand_total;   /**< Total SASA of the ligand in the complex. */
+    double ligand_free;    /**< Total SASA of the free ligand. */
+    double *ligand_sasa;   /**< SASA of each ligand atom in the complex. */
+    int n_ligand;          /**< Number of ligand atoms. */
+    int *contact;          /**< Indices of the receptor atoms in contact with the ligand,
+                                in increasing order. */
+    double *contact_delta; /**< Change in SASA of each receptor atom in `contact`, the SASA
+                                of all other receptor atoms is unchanged. */
+    int n_contact;         /**< Number of receptor atoms in contact with the ligand. */
+} freesasa_pose_result;
+
 /**
    Struct to store integrated SASA values for either a full structure
    or a subset thereof.
@@ -391,6 +553,773 @@ freesasa_calc_coord(const double *xyz,
                     int n,
                     const freesasa_parameters *parameters);
 
+/**
+    Calculates SASA for a batch of molecules.
+
+    Intended for large numbers of small molecules, such as ligand
+    libraries. The coordinates and radii of all
+    molecules are concatenated, molecule m consists of the atoms from
+    `offsets[m]` to `offsets[m+1]-1`. The molecules are divided
+    between the threads (freesasa_parameters::n_threads), each of
+    which calculates one molecule at a time, in a work space that is
+    allocated once. The neighbor lists are calculated by comparing
+    all pairs of atoms, which is faster than cell lists for small
+    molecules, but scales badly for large ones.
+
+    For S&R and L&R no memory is allocated per molecule. For the
+    other algorithms the molecules are calculated one by one with the
+    usual functions, in parallel.
+
+    The calculation of the areas dominates even for small molecules,
+    so compared to one call to freesasa_calc_coord() per molecule
+    with one thread the gain is modest, at most about 20 %. With
+    several threads the gain is larger, since the molecules are
+    calculated in parallel instead of starting threads for each
+    molecule.
+
+    @param xyz Array of coordinates in the form
+      x1,y1,z1,x2,y2,z2,...,xn,yn,zn, for all molecules.
+    @param radii Radii of all atoms.
+    @param offsets Index of the first atom of each molecule, followed
+      by the total number of atoms (`n_molecules + 1` non-decreasing
+      values).
+    @param n_molecules Number of molecules.
+    @param sasa The SASA of each atom is written here, the array
+      should have space for `offsets[n_molecules]` values.
+    @param total If not `NULL`, the total SASA of each molecule is
+      written here (`n_molecules` values).
+    @param parameters Parameters for the calculation, if `NULL`
+      defaults are used. Gradients and surface dots are not
+      available.
+
+    @return ::FREESASA_SUCCESS on success, ::FREESASA_WARN if some
+      atoms did not reach the target error in adaptive mode or
+      multiple threads were requested when compiled without thread
+      support. ::FREESASA_FAIL if the offsets or parameters are
+      invalid or memory allocation failed.
+
+    @ingroup core
+ */
+int
+freesasa_calc_coord_batch(const double *xyz,
+                          const double *radii,
+                          const int *offsets,
+                          int n_molecules,
+                          double *sasa,
+                          double *total,
+                          const freesasa_parameters *parameters);
+
+/**
+    Calculates SASA for several structures, in parallel.
+
+    All threads (freesasa_parameters::n_threads) share one pool of
+    tasks, so that they are kept busy for any mix of structure sizes.
+    With S&R and L&R each structure is divided into chunks of atoms,
+    and the threads take chunks from the structures in order, moving
+    on to the next structure when all chunks of the previous ones have
+    been handed out. A single large structure is thus calculated by
+    all threads, while many small ones are calculated side by side.
+    The neighbor lists are calculated chunk by chunk, by the thread
+    that calculates the chunk. For the other algorithms, and for
+    gradients or surface dots, each structure is one task, calculated
+    with one thread.
+
+    The results do not depend on the number of threads, and agree
+    with freesasa_calc_structure() for each structure, except for
+    rounding errors from the order in which neighbors are listed.
+
+    @param structures The structures.
+    @param n Number of structures.
+    @param results The result of each structure is stored here (`n`
+      values), `NULL` for structures where the calculation failed.
+      The results should be freed with freesasa_result_free().
+    @param parameters Parameters for the calculation, if `NULL`
+      defaults are used.
+
+    @return ::FREESASA_SUCCESS on success, ::FREESASA_WARN if some
+      atoms did not reach the target error in adaptive mode or
+      multiple threads were requested when compiled without thread
+      support. ::FREESASA_FAIL if any of the calculations failed, or
+      if the parameters are invalid (in which case no results are
+      stored).
+
+    @ingroup core
+ */
+int
+freesasa_calc_structures(const freesasa_structure **structures,
+                         int n,
+                         freesasa_result **results,
+                         const freesasa_parameters *parameters);
+
+/**
+    Starts a SASA calculation for a structure in the background.
+
+    The calculation runs in a separate thread (which in turn uses
+    freesasa_parameters::n_threads threads), the function returns
+    immediately. Use freesasa_async_status() to follow the progress,
+    freesasa_async_wait() to get the result and freesasa_async_cancel()
+    to stop it. The handle has to be freed with freesasa_async_free().
+
+    The structure must not be modified or freed until the calculation
+    has finished, i.e. until freesasa_async_wait() or
+    freesasa_async_free() has returned.
+
+    If the library is compiled without thread support the calculation
+    is done before the function returns.
+
+    @param structure The structure.
+    @param parameters Parameters for the calculation, if `NULL`
+      defaults are used. They are copied.
+
+    @return The handle, or `NULL` if the calculation could not be
+      started (memory allocation or thread creation failed). Errors in
+      the calculation itself are reported by freesasa_async_status()
+      and freesasa_async_wait().
+
+    @ingroup core
+ */
+freesasa_async *
+freesasa_calc_structure_async(const freesasa_structure *structure,
+                              const freesasa_parameters *parameters);
+
+/**
+    Starts a SASA calculation for an array of coordinates in the
+    background.
+
+    Same as freesasa_calc_structure_async(), with input as in
+    freesasa_calc_coord(). The arrays xyz and radii are not copied,
+    and must not be modified or freed until the calculation has
+    finished.
+
+    @param xyz Array of coordinates in the form x1,y1,z1,x2,y2,z2,...,xn,yn,zn.
+    @param radii Radii, this array should have same number of elements
+      as there are coordinates.
+    @param n Number of coordinates (i.e. xyz has size 3*n, radii size n).
+    @param parameters Parameters for the calculation, if `NULL`
+      defaults are used.
+
+    @return The handle, or `NULL` if the calculation could not be
+      started.
+
+    @ingroup core
+ */
+freesasa_async *
+freesasa_calc_coord_async(const double *xyz,
+                          const double *radii,
+                          int n,
+                          const freesasa_parameters *parameters);
+
+/**
+    Progress of an asynchronous calculation.
+
+    Doesn't block. The number of atoms done is updated in blocks of a
+    few atoms per thread, and only counts the main calculation, not
+    the setup of neighbor lists etc.
+
+    @param async The calculation.
+    @param n_done If not `NULL`, the number of atoms done is written
+      here.
+    @param n_total If not `NULL`, the total number of atoms is written
+      here.
+
+    @return The state of the calculation.
+
+    @ingroup core
+ */
+freesasa_async_state
+freesasa_async_status(freesasa_async *async,
+                      int *n_done,
+                      int *n_total);
+
+/**
+    Cancels an asynchronous calculation.
+
+    Doesn't block. The threads doing the calculation stop after their
+    current block of atoms, and the partial results are discarded.
+    Has no effect if the calculation has already finished.
+
+    @param async The calculation.
+
+    @ingroup core
+ */
+void
+freesasa_async_cancel(freesasa_async *async);
+
+/**
+    Waits for an asynchronous calculation to finish.
+
+    The result is handed over to the caller, and should be freed with
+    freesasa_result_free(). Subsequent calls return `NULL`.
+
+    @param async The calculation.
+
+    @return The result, `NULL` if the calculation failed or was
+      cancelled.
+
+    @ingroup core
+ */
+freesasa_result *
+freesasa_async_wait(freesasa_async *async);
+
+/**
+    Frees an asynchronous calculation handle.
+
+    If the calculation is still running it is cancelled, and the
+    function waits for it to stop. A result that has not been
+    retrieved with freesasa_async_wait() is freed.
+
+    @param async The calculation, can be `NULL`.
+
+    @ingroup core
+ */
+void
+freesasa_async_free(freesasa_async *async);
+
+/**
+    Calculates SASA for coordinates in caller-owned arrays, writing
+    the result to a caller-owned array.
+
+    The coordinates of atom i are `x[i*stride]`, `y[i*stride]` and
+    `z[i*stride]`. This covers interleaved arrays
+    (`y == x+1`, `z == x+2`, `stride == 3`), separate arrays for each
+    component (`stride == 1`) and arrays of larger structs. The
+    calculations use interleaved coordinates, if the input already has
+    that layout it is used directly, otherwise it is copied. No
+    freesasa_result is allocated.
+
+    @param x Pointer to the x-coordinate of the first atom.
+    @param y Pointer to the y-coordinate of the first atom.
+    @param z Pointer to the z-coordinate of the first atom.
+    @param stride Distance between consecutive atoms, in number of
+      doubles.
+    @param radii Radii of the atoms.
+    @param n Number of atoms.
+    @param sasa The SASA of each atom is written here (n values).
+    @param total If not `NULL`, the total SASA is written here.
+    @param parameters Parameters for the calculation, if `NULL`
+      defaults are used. Gradients and surface dots are not
+      available.
+
+    @return ::FREESASA_SUCCESS on success, ::FREESASA_WARN if
+      multiple threads were requested when compiled without thread
+      support. ::FREESASA_FAIL if the stride or parameters are invalid
+      or memory allocation failed.
+
+    @ingroup core
+ */
+int
+freesasa_calc_coord_strided(const double *x,
+                            const double *y,
+                            const double *z,
+                            int stride,
+                            const double *radii,
+                            int n,
+                            double *sasa,
+                            double *total,
+                            const freesasa_parameters *parameters);
+
+/**
+    Calculates SASA for single precision coordinates in caller-owned
+    arrays.
+
+    Same as freesasa_calc_coord_strided(), but for `float` input, as
+    used by many trajectory formats. The stride is in number of floats.
+    The coordinates are always converted to double precision before
+    the calculation.
+
+    @param x Pointer to the x-coordinate of the first atom.
+    @param y Pointer to the y-coordinate of the first atom.
+    @param z Pointer to the z-coordinate of the first atom.
+    @param stride Distance between consecutive atoms, in number of
+      floats.
+    @param radii Radii of the atoms.
+    @param n Number of atoms.
+    @param sasa The SASA of each atom is written here (n values).
+    @param total If not `NULL`, the total SASA is written here.
+    @param parameters Parameters for the calculation, if `NULL`
+      defaults are used. Gradients and surface dots are not
+      available.
+
+    @return Same as freesasa_calc_coord_strided().
+
+    @ingroup core
+ */
+int
+freesasa_calc_coord_strided_float(const float *x,
+                                  const float *y,
+                                  const float *z,
+                                  int stride,
+                                  const double *radii,
+                                  int n,
+                                  double *sasa,
+                                  double *total,
+                                  const freesasa_parameters *parameters);
+
+/**
+    Calculates SASA for a symmetric assembly from its asymmetric unit.
+
+    The assembly consists of one copy of the structure for each
+    symmetry operator. Each operator is a 3x4 matrix (R|t), stored as
+    12 consecutive doubles by rows, mapping a coordinate x to R x + t,
+    as in the BIOMT records of PDB files. Only the atoms of the
+    asymmetric unit are calculated, in contact with the atoms of the
+    other copies that are close enough to bury them. This makes the
+    calculation roughly as fast as for the structure alone, instead of
+    scaling with the number of copies.
+
+    The returned result contains the SASA of the atoms in the
+    asymmetric unit (in the context of the full assembly). If the
+    operators are exact symmetries of the assembly, all copies have
+    the same SASA, and the SASA of the whole assembly is the number of
+    operators times the total of the result. The identity should be
+    one of the operators, if it is missing the structure itself is
+    still included in the assembly.
+
+    @param structure The asymmetric unit.
+    @param operators Array of 12 * n_operators values.
+    @param n_operators Number of operators.
+    @param parameters Parameters for the calculation, if `NULL`
+      defaults are used. Gradients are not available.
+
+    @return The result of the calculation for the asymmetric unit,
+      `NULL` if the operators are not rotations and translations, if
+      the calculation failed or if memory allocation failed.
+
+    @see freesasa_symmetry_from_pdb()
+    @see freesasa_symmetry_from_file()
+    @ingroup core
+ */
+freesasa_result *
+freesasa_calc_structure_symmetric(const freesasa_structure *structure,
+                                  const double *operators,
+                                  int n_operators,
+                                  const freesasa_parameters *parameters);
+
+/**
+    Same as freesasa_calc_structure_symmetric(), with input as in
+    freesasa_calc_coord().
+
+    @param xyz Array of coordinates of the asymmetric unit in the
+      format x1,y1,z1,x2,y2,z2,...,xn,yn,zn.
+    @param radii Radii, this array should have same number of elements
+      as there are coordinates.
+    @param n Number of coordinates (i.e. xyz has size 3*n, radii size
+      n).
+    @param operators Array of 12 * n_operators values.
+    @param n_operators Number of operators.
+    @param parameters Parameters for the calculation, if `NULL`
+      defaults are used. Gradients are not available.
+
+    @return The result of the calculation for the asymmetric unit,
+      `NULL` on failure.
+
+    @ingroup core
+ */
+freesasa_result *
+freesasa_calc_coord_symmetric(const double *xyz,
+                              const double *radii,
+                              int n,
+                              const double *operators,
+                              int n_operators,
+                              const freesasa_parameters *parameters);
+
+/**
+    Reads symmetry operators from the BIOMT records of a PDB file.
+
+    Reads the `REMARK 350 BIOMT` records of the first biomolecule, the
+    operators can be used with freesasa_calc_structure_symmetric().
+    Reading starts at the current position of the file and stops at
+    the first atom, the position of the file is not restored.
+
+    @param pdb Input PDB file.
+    @param operators The operators are stored in a newly allocated
+      array (12 values per operator), to be freed by the caller using
+      `free()`. Set to `NULL` if there are no operators.
+
+    @return The number of operators read, 0 if there were none.
+      ::FREESASA_FAIL if the records are malformed, the matrices are
+      not rotations or memory allocation failed.
+
+    @ingroup core
+ */
+int
+freesasa_symmetry_from_pdb(FILE *pdb,
+                           double **operators);
+
+/**
+    Reads symmetry operators from a text file.
+
+    Each operator is given as 12 numbers, the three rows of the matrix
+    (R|t), i.e. "r11 r12 r13 t1 r21 r22 r23 t2 r31 r32 r33 t3", how
+    the numbers are distributed over lines doesn't matter. Lines
+    starting with '#' are ignored.
+
+    @param file Input file.
+    @param operators The operators are stored in a newly allocated
+      array (12 values per operator), to be freed by the caller using
+      `free()`.
+
+    @return The number of operators read. ::FREESASA_FAIL if the file
+      is malformed, the number of values is not a multiple of 12, the
+      matrices are not rotations or memory allocation failed.
+
+    @ingroup core
+ */
+int
+freesasa_symmetry_from_file(FILE *file,
+                            double **operators);
+
+/**
+    Calculates SASA with periodic boundary conditions.
+
+    The structure is assumed to be in an infinite lattice of copies,
+    translated by integer combinations of the box vectors, as in a
+    molecular dynamics simulation box. Contacts between atoms are
+    found through the nearest periodic image, which is cheaper than
+    adding image atoms to the structure explicitly. The box can be
+    orthorhombic or triclinic and the atoms don't have to be inside
+    it.
+
+    The box has to be at least three times the largest contact
+    distance, i.e. 6 times the largest atomic radius plus probe
+    radius, wide in each direction.
+
+    @param structure The structure.
+    @param box The box vectors a, b and c, 9 values.
+    @param parameters Parameters for the calculation, if `NULL`
+      defaults are used. Gradients are not available.
+
+    @return The result of the calculation, `NULL` if the box is too
+      small or degenerate, if the calculation failed or if memory
+      allocation failed.
+
+    @see freesasa_periodic_box_from_pdb()
+    @see freesasa_periodic_box_from_cell()
+
+    @ingroup core
+ */
+freesasa_result *
+freesasa_calc_structure_periodic(const freesasa_structure *structure,
+                                 const double *box,
+                                 const freesasa_parameters *parameters);
+
+/**
+    Calculates SASA for a set of coordinates with periodic boundary
+    conditions.
+
+    See freesasa_calc_structure_periodic() for details.
+
+    @param xyz Array of coordinates in the format x1,y1,z1,x2,y2,z2,...
+    @param radii Radii, this array should have same number of
+      elements as there are coordinates (i.e. xyz has size 3*n, radii
+      size n).
+    @param n Number of coordinates.
+    @param box The box vectors a, b and c, 9 values.
+    @param parameters Parameters for the calculation, if `NULL`
+      defaults are used. Gradients are not available.
+
+    @return The result of the calculation, `NULL` on failure.
+
+    @ingroup core
+ */
+freesasa_result *
+freesasa_calc_coord_periodic(const double *xyz,
+                             const double *radii,
+                             int n,
+                             const double *box,
+                             const freesasa_parameters *parameters);
+
+/**
+    Converts unit cell parameters to box vectors.
+
+    The vector a is put along the x-axis and b in the xy-plane, as in
+    PDB files.
+
+    @param cell The cell parameters a, b, c (Å), alpha, beta and gamma
+      (degrees).
+    @param box The box vectors a, b and c are stored here (9 values).
+
+    @return ::FREESASA_SUCCESS. ::FREESASA_FAIL if the parameters
+      don't describe a valid cell.
+
+    @ingroup core
+ */
+int
+freesasa_periodic_box_from_cell(const double *cell,
+                                double *box);
+
+/**
+    Reads the periodic box from the CRYST1 record of a PDB file.
+
+    Reading starts at the current position of the file and stops at
+    the first atom, the position of the file is not restored.
+
+    @param pdb Input PDB file.
+    @param box The box vectors a, b and c are stored here (9 values).
+
+    @return 1 if a box was read, 0 if there is no CRYST1 record.
+      ::FREESASA_FAIL if the record is malformed or doesn't describe
+      a valid cell.
+
+    @ingroup core
+ */
+int
+freesasa_periodic_box_from_pdb(FILE *pdb,
+                               double *box);
+
+/**
+    Calculates SASA for very large systems, one slab at a time.
+
+    For systems that are too large to keep all coordinates, neighbor
+    lists and results in memory at once. The atoms are read from
+    `input` and stored in temporary files, divided into slabs of
+    width `slab_width` along the longest axis of the system. Each slab
+    is then calculated separately, together with a halo of the atoms
+    of the neighboring slabs that are close enough to bury them (twice
+    the largest radius plus probe radius), and the SASA of its atoms
+    is passed to `output` before the next slab is read. The results are
+    the same as for a calculation of the whole system, but the memory
+    use is determined by the number of atoms in a slab and its halo.
+
+    The atoms are passed to `output` slab by slab, not in the order
+    they were read. Each slab is calculated using the number of
+    threads in the parameters.
+
+    @param input Function that reads the next atom.
+    @param input_data Passed to `input`.
+    @param output Function that receives the SASA of each atom.
+    @param output_data Passed to `output`.
+    @param slab_width Width of the slabs (Å), should be considerably
+      larger than the halo for efficiency, but small enough for a slab
+      to fit in memory.
+    @param total The total SASA is stored here, can be `NULL`.
+    @param parameters Parameters for the calculation, if `NULL`
+      defaults are used. Gradients and surface dots are not available.
+
+    @return ::FREESASA_SUCCESS on success. ::FREESASA_FAIL if reading
+      the input, writing the output, the temporary files, the
+      calculation or memory allocation failed.
+
+    @ingroup core
+ */
+int
+freesasa_calc_slabs(freesasa_atom_reader input,
+                    void *input_data,
+                    freesasa_sasa_writer output,
+                    void *output_data,
+                    double slab_width,
+                    double *total,
+                    const freesasa_parameters *parameters);
+
+/**
+    Preprocesses a receptor for the calculation of ligand poses.
+
+    Calculates the SASA of the free receptor, and sorts its atoms into
+    a grid, so that the receptor atoms in contact with a ligand can be
+    found without looking at the rest of the receptor. The coordinates
+    and radii are copied.
+
+    Return value is dynamically allocated, should be freed with
+    freesasa_receptor_free().
+
+    @param xyz Array of coordinates in the form x1,y1,z1,x2,y2,z2,...,xn,yn,zn.
+    @param radii Radii, this array should have n elements.
+    @param n Number of receptor atoms.
+    @param parameters Parameters for the receptor and all poses, if
+      `NULL` defaults are used. Gradients, surface dots and target
+      total errors are not available.
+
+    @return The receptor, `NULL` if something went wrong.
+
+    @ingroup core
+ */
+freesasa_receptor *
+freesasa_receptor_from_coord(const double *xyz,
+                             const double *radii,
+                             int n,
+                             const freesasa_parameters *parameters);
+
+/**
+    Preprocesses a receptor structure for the calculation of ligand poses.
+
+    @see freesasa_receptor_from_coord()
+
+    @param structure The receptor.
+    @param parameters Parameters, as for freesasa_receptor_from_coord().
+
+    @return The receptor, `NULL` if something went wrong.
+
+    @ingroup core
+ */
+freesasa_receptor *
+freesasa_receptor_from_structure(const freesasa_structure *structure,
+                                 const freesasa_parameters *parameters);
+
+/**
+    Frees a receptor.
+
+    @param receptor The receptor, can be `NULL`.
+
+    @ingroup core
+ */
+void
+freesasa_receptor_free(freesasa_receptor *receptor);
+
+/**
+    The SASA of the free receptor.
+
+    @param receptor The receptor.
+
+    @return The result, owned by the receptor.
+
+    @ingroup core
+ */
+const freesasa_result *
+freesasa_receptor_result(const freesasa_receptor *receptor);
+
+/**
+    Calculates the SASA of a ligand pose in complex with a receptor.
+
+    Only the ligand and the receptor atoms in contact with it are
+    calculated, with the receptor atoms that are close enough to bury
+    those as context. The cost depends on the size of the ligand and
+    the interface, not on the size of the receptor, and the results
+    are the same as for a calculation of the whole complex.
+
+    Each pose is calculated in a single thread. The receptor is not
+    modified, so several poses can be calculated in parallel.
+
+    Return value is dynamically allocated, should be freed with
+    freesasa_pose_result_free().
+
+    @param receptor The receptor.
+    @param xyz Coordinates of the ligand, in the form x1,y1,z1,...,xn,yn,zn.
+    @param radii Radii of the ligand, this array should have n elements.
+    @param n Number of ligand atoms.
+
+    @return The result, `NULL` if something went wrong.
+
+    @ingroup core
+ */
+freesasa_pose_result *
+freesasa_receptor_calc_pose(const freesasa_receptor *receptor,
+                            const double *xyz,
+                            const double *radii,
+                            int n);
+
+/**
+    Frees a pose result.
+
+    @param result The result, can be `NULL`.
+
+    @ingroup core
+ */
+void
+freesasa_pose_result_free(freesasa_pose_result *result);
+
+/**
+    Calculates SASA for several probe radii in one pass.
+
+    The neighbor list is only calculated once, for the largest probe
+    radius, and each atom is calculated for all probe radii before
+    moving on to the next. Most of the time is spent on the
+    calculation for each probe radius, so this is only somewhat
+    faster than one call to freesasa_calc_coord() per probe radius,
+    mostly at low resolution. Only available for L&R and S&R.
+
+    Return value is dynamically allocated, should be freed with
+    freesasa_probe_result_free().
+
+    @param xyz Array of coordinates in the form x1,y1,z1,x2,y2,z2,...,xn,yn,zn.
+    @param radii Radii, this array should have n elements.
+    @param n Number of coordinates (i.e. xyz has size 3*n, radii size n).
+    @param probe_radii Array of probe radii (>= 0), in any order.
+    @param n_probes Number of probe radii.
+    @param parameters Parameters for the calculation, if `NULL`
+      defaults are used. The value of `probe_radius` is ignored.
+
+    @return The result of the calculation, `NULL` if something went wrong.
+
+    @ingroup core
+ */
+freesasa_probe_result *
+freesasa_calc_coord_probes(const double *xyz,
+                           const double *radii,
+                           int n,
+                           const double *probe_radii,
+                           int n_probes,
+                           const freesasa_parameters *parameters);
+
+/**
+    Calculates SASA for several probe radii for a given structure.
+
+    See freesasa_calc_coord_probes().
+
+    @param structure The structure
+    @param probe_radii Array of probe radii (>= 0), in any order.
+    @param n_probes Number of probe radii.
+    @param parameters Parameters for the calculation, if `NULL`
+      defaults are used. The value of `probe_radius` is ignored.
+
+    @return The result of the calculation, `NULL` if something went wrong.
+
+    @ingroup core
+ */
+freesasa_probe_result *
+freesasa_calc_structure_probes(const freesasa_structure *structure,
+                               const double *probe_radii,
+                               int n_probes,
+                               const freesasa_parameters *parameters);
+
+/**
+    Frees a ::freesasa_probe_result object.
+
+    @param result the object to be freed.
+
+    @ingroup core
+ */
+void
+freesasa_probe_result_free(freesasa_probe_result *result);
+
+/**
+    Write the exposed surface points of a calculation.
+
+    The result has to be calculated by S&R with
+    freesasa_parameters::calc_surface_dots set.
+
+    With ::FREESASA_DOTS_XYZ the output is an XYZ file, the first
+    line has the number of points, the second line is a comment with
+    the name, followed by one line per point `X x y z atom`, or `X x
+    y z nx ny nz atom` with ::FREESASA_DOTS_NORMALS. The atom index
+    starts at 0. Several results written to the same file make a
+    multi-frame XYZ file.
+
+    With ::FREESASA_DOTS_BINARY the output is the 8 character magic
+    string `FSASADOT`, followed by three 32-bit integers: format
+    version (1), flags (1 if there are normals) and number of points.
+    Then for each point three 32-bit floats with the coordinates,
+    three with the normal (if included), and a 32-bit integer with
+    the atom index. Native byte order.
+
+    @param output Output file.
+    @param result The result.
+    @param name Name to write in the comment line of XYZ output, can
+      be `NULL`.
+    @param options Either ::FREESASA_DOTS_XYZ or
+      ::FREESASA_DOTS_BINARY, optionally combined with
+      ::FREESASA_DOTS_NORMALS.
+    @return ::FREESASA_SUCCESS on success. ::FREESASA_FAIL if the
+      result has no surface points, if the options are invalid, or if
+      there were problems writing to the file.
+
+    @ingroup core
+ */
+int
+freesasa_write_surface_dots(FILE *output,
+                            const freesasa_result *result,
+                            const char *name,
+                            int options);
+
 /**
     Calculates SASA for a structure and returns as a tree of
     ::freesasa_node.
@@ -623,6 +1552,10 @@ freesasa_set_verbosity(freesasa_verbosity v);
 /**
     Get the current verbosity level
 
+    Returns the level set for the calling thread by
+    freesasa_set_thread_verbosity() if there is one, otherwise the
+    global level.
+
     @return the verbosity level.
 
     @ingroup core
@@ -646,7 +1579,9 @@ freesasa_set_err_out(FILE *err);
 /**
     Get pointer to error file.
 
-    `NULL` means `stderr` is used.
+    Returns the stream set for the calling thread by
+    freesasa_set_thread_err_out() if there is one, otherwise the
+    global one. `NULL` means `stderr` is used.
 
     @return The error file.
 
@@ -655,6 +1590,58 @@ freesasa_set_err_out(FILE *err);
 FILE *
 freesasa_get_err_out(void);
 
+/**
+    Set the verbosity level of the calling thread.
+
+    Overrides the global level set by freesasa_set_verbosity() for
+    all diagnostics emitted by the calling thread, and by the threads
+    of the calculations it starts, including asynchronous ones (see
+    freesasa_calc_structure_async()).
+    Other threads are not affected, which allows independent callers
+    in a multithreaded program to silence or enable messages
+    without interfering with each other.
+
+    The override stays in place until freesasa_clear_thread_state()
+    is called or the thread exits.
+
+    @param v the verbosity level
+    @return ::FREESASA_SUCCESS. ::FREESASA_WARN if v is invalid,
+      ::FREESASA_FAIL if memory allocation failed.
+
+    @ingroup core
+ */
+int
+freesasa_set_thread_verbosity(freesasa_verbosity v);
+
+/**
+    Set where the calling thread writes errors.
+
+    Overrides freesasa_set_err_out() for the calling thread, and for
+    the threads of the calculations it starts. Each message is written
+    while holding the lock of the stream, so messages from different
+    threads sharing a stream are not interleaved.
+
+    @param err The file to write to. If `NULL`, the thread uses the
+      global error stream again.
+    @return ::FREESASA_SUCCESS, ::FREESASA_FAIL if memory allocation
+      failed.
+
+    @ingroup core
+ */
+int
+freesasa_set_thread_err_out(FILE *err);
+
+/**
+    Remove the per-thread verbosity and error stream of the calling
+    thread.
+
+    The thread falls back to the global settings.
+
+    @ingroup core
+ */
+void
+freesasa_clear_thread_state(void);
+
 /**
     Allocate empty structure.
 
@@ -736,6 +1723,35 @@ freesasa_structure_from_pdb(FILE *pdb,
                             const freesasa_classifier *classifier,
                             int options);
 
+/**
+    Init structure with coordinates from pdb-file, using several
+    threads.
+
+    Equivalent to freesasa_structure_from_pdb(), but the ATOM and
+    HETATM records are split in blocks of consecutive lines, which
+    are parsed and classified by one thread each. The atoms are then
+    added to the structure in the order of the file, so residues,
+    chains, alternate coordinates and messages are handled as by
+    freesasa_structure_from_pdb(), and the structure is the same.
+    Small files are parsed in fewer threads, or only in the calling
+    thread.
+
+    @param pdb A PDB file
+    @param classifier A freesasa_classifier to determine radius of
+      atom. If `NULL` default classifier is used.
+    @param options As for freesasa_structure_from_pdb().
+    @param n_threads Number of threads, at least 1.
+    @return The generated structure. Returns `NULL` and prints error
+      if input is invalid or memory allocation failure.
+
+    @ingroup structure
+ */
+freesasa_structure*
+freesasa_structure_from_pdb_parallel(FILE *pdb,
+                                     const freesasa_classifier *classifier,
+                                     int options,
+                                     int n_threads);
+
 /**
     Init array of structures from PDB.
 
@@ -769,6 +1785,121 @@ freesasa_structure_array(FILE *pdb,
                          const freesasa_classifier *classifier,
                          int options);
 
+/**
+    Start reading structures from a stream of PDB input.
+
+    The input is read in one pass, forward only, so it can be a pipe
+    or a socket, and only the structure that is being read is kept in
+    memory. It can contain several concatenated entries (PDB files),
+    each ending with an `END` record. Each call to
+    freesasa_structure_stream_next() reads the next structure,
+    depending on the options:
+
+      - Default: one structure per entry, from its first model, as
+        freesasa_structure_from_pdb().
+
+      - ::FREESASA_JOIN_MODELS: one structure per entry, with all
+        its models.
+
+      - ::FREESASA_SEPARATE_MODELS: one structure per model. The
+        models are numbered in order within each entry, as in
+        freesasa_structure_array().
+
+      - ::FREESASA_SEPARATE_CHAINS: each of the above is split into
+        one structure per chain (views, see
+        freesasa_structure_view_atoms()).
+
+    Entries and models without atoms are skipped. The other options
+    are as for freesasa_structure_from_pdb(), and the atoms of each
+    structure are parsed with `n_threads` threads, as in
+    freesasa_structure_from_pdb_parallel().
+
+    The input is not closed by freesasa_structure_stream_free().
+
+    @param input The input.
+    @param classifier A freesasa_classifier to determine radius of
+      atom. If `NULL` default classifier is used. Should not be freed
+      before the stream.
+    @param options Bitfield, see above.
+    @param n_threads Number of threads, at least 1.
+    @return The stream, or `NULL` if memory allocation failure.
+
+    @ingroup structure
+ */
+freesasa_structure_stream *
+freesasa_structure_stream_new(FILE *input,
+                              const freesasa_classifier *classifier,
+                              int options,
+                              int n_threads);
+
+/**
+    Read the next structure from a stream.
+
+    Reads the input until the next structure is complete (see
+    freesasa_structure_stream_new()). After an error the stream
+    should only be freed.
+
+    @param stream The stream.
+    @param structure The structure is stored here, it should be freed
+      with freesasa_structure_free(). `NULL` if there are no more
+      structures, or on errors.
+    @return 1 if a structure was read, 0 at the end of the input, and
+      ::FREESASA_FAIL if the input is invalid or memory allocation
+      failure.
+
+    @ingroup structure
+ */
+int
+freesasa_structure_stream_next(freesasa_structure_stream *stream,
+                               freesasa_structure **structure);
+
+/**
+    Free a stream.
+
+    Structures that have been read are not affected.
+
+    @param stream The stream.
+
+    @ingroup structure
+ */
+void
+freesasa_structure_stream_free(freesasa_structure_stream *stream);
+
+/**
+    Open a stream for reading possibly compressed input.
+
+    The format is detected from the magic number at the start of the
+    input (`1f 8b` for gzip, `28 b5 2f fd` for zstd). Gzip
+    (concatenated members are read as one) and zstd input is
+    decompressed while it is read, other input is returned as it
+    is. The input can be a pipe: if the first byte matches a magic
+    number, but the following don't, and the bytes that were read
+    can't be put back, the input is read through a new stream that
+    starts with them.
+
+    The decompressed stream can not be rewound, and is passed to the
+    parsers as any other stream, for example to
+    freesasa_structure_stream_new(). If `n_threads > 1` the input is
+    decompressed ahead of the reader in a separate thread. The
+    stream should be closed with `fclose()`, which doesn't close
+    `input`.
+
+    Which formats are supported depends on the libraries available
+    when FreeSASA was built.
+
+    @param input The input.
+    @param n_threads Number of threads, at least 1.
+    @return `input` if it isn't compressed, a new stream if it is
+      (or if the start of a pipe had to be read), and `NULL` if the
+      format isn't supported by this build, or on memory allocation
+      failure.
+
+    @ingroup structure
+ */
+FILE *
+freesasa_decompress(FILE *input,
+                    int n_threads);
+
 /**
     Add individual atom to structure using default behavior.
 
@@ -853,6 +1984,56 @@ freesasa_structure_add_atom_wopt(freesasa_structure *structure,
                                  const freesasa_classifier *classifier,
                                  int options);
 
+/**
+    Create a structure from arrays of atom data.
+
+    Builds the structure in one pass, which is much faster than
+    calling freesasa_structure_add_atom_wopt() for each atom. Each
+    combination of residue and atom name is only classified once,
+    the residue reference areas are looked up once per residue name,
+    and all atoms and strings are allocated in a few blocks.
+
+    Residues and chains are delimited as for
+    freesasa_structure_add_atom(): a new residue starts when the
+    residue number or chain label changes. Atom names should follow
+    the PDB convention (e.g. `" CA "`), shorter names are assumed to
+    start with a one-letter element when the element has to be
+    guessed.
+
+    Return value is dynamically allocated, should be freed with
+    freesasa_structure_free().
+
+    @param n Number of atoms.
+    @param atom_names Atom names.
+    @param residue_names Residue names.
+    @param residue_numbers Residue numbers, as strings.
+    @param chain_labels Chain labels, one per atom.
+    @param xyz Coordinates in the form x1,y1,z1,...,xn,yn,zn.
+    @param radii Radii, if `NULL` the radii are determined by the classifier.
+    @param classes Atom classes, if `NULL` they are determined by the classifier.
+    @param classifier A classifier, if `NULL` the default classifier is used.
+    @param options Only ::FREESASA_SKIP_UNKNOWN and
+      ::FREESASA_HALT_AT_UNKNOWN are used, and only when `radii` is
+      `NULL`, as in freesasa_structure_add_atom_wopt().
+
+    @return The structure. `NULL` if an unknown atom was encountered
+      with ::FREESASA_HALT_AT_UNKNOWN, if all atoms were skipped, a
+      radius was negative, or memory allocation failed.
+
+    @ingroup structure
+ */
+freesasa_structure*
+freesasa_structure_from_arrays(int n,
+                               const char **atom_names,
+                               const char **residue_names,
+                               const char **residue_numbers,
+                               const char *chain_labels,
+                               const double *xyz,
+                               const double *radii,
+                               const freesasa_atom_class *classes,
+                               const freesasa_classifier *classifier,
+                               int options);
+
 /**
     Create new structure consisting of a selection chains from the
     provided structure.
@@ -880,6 +2061,61 @@ freesasa_structure_get_chains(const freesasa_structure *structure,
                               const freesasa_classifier* classifier,
                               int options);
 
+/**
+    Create a view of a selection of chains of a structure.
+
+    A view is a structure that shares the atoms, classes, radii and
+    coordinates of its parent, only the residue and chain tables are
+    built, and it can be used wherever a structure can. If the chains
+    are contiguous in the parent, nothing is copied, and changing the
+    radii of the view changes those of the parent. The atoms are in
+    the same order as in the parent.
+
+    The parent is kept alive until all its views have been freed, so
+    the views and the parent can be freed in any order, but not
+    concurrently from different threads. Atoms can not be added to
+    views or to structures that have views.
+
+    Return value is dynamically allocated, should be freed with
+    freesasa_structure_free().
+
+    @param structure The parent structure.
+    @param chains String of chain labels (e.g. `"AB"`).
+
+    @return The view. Returns `NULL` if one or more of the requested
+    chains don't match any in the structure or if memory allocation
+    fails.
+
+    @ingroup structure
+ */
+freesasa_structure*
+freesasa_structure_view_chains(const freesasa_structure *structure,
+                               const char *chains);
+
+/**
+    Create a view of a range of atoms of a structure.
+
+    The view shares atoms, radii and coordinates with its parent, see
+    freesasa_structure_view_chains(). If the range starts or ends in
+    the middle of a residue, the view contains part of that residue.
+
+    Return value is dynamically allocated, should be freed with
+    freesasa_structure_free().
+
+    @param structure The parent structure.
+    @param first The first atom of the view.
+    @param last The last atom of the view.
+
+    @return The view. Returns `NULL` if the range is outside the
+    structure or if memory allocation fails.
+
+    @ingroup structure
+ */
+freesasa_structure*
+freesasa_structure_view_atoms(const freesasa_structure *structure,
+                              int first,
+                              int last);
+
 /**
     Get string listing all chains in structure.
 
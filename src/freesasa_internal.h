@@ -9,6 +9,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#if USE_THREADS
+# include <pthread.h>
+#endif
+
 #include "freesasa.h"
 #include "coord.h"
 
@@ -55,24 +59,439 @@ extern const freesasa_nodearea freesasa_nodearea_null;
 # define inline
 #endif
 
+/**
+    Progress of a calculation, shared between the threads doing the
+    calculation and the thread polling it (see freesasa_async).
+
+    The calculations report the number of atoms done, and check for
+    cancellation, in blocks of ::FREESASA_PROGRESS_INTERVAL atoms, so
+    that the lock is rarely taken. All functions accept `NULL`, which
+    means progress is not tracked.
+ */
+typedef struct freesasa_progress freesasa_progress;
+
+/** Number of atoms a thread calculates between progress reports */
+#define FREESASA_PROGRESS_INTERVAL 32
+
+/**
+    Count one atom as done.
+
+    @param p The progress object.
+    @param n_pending Number of atoms done by this thread but not yet
+      reported. Incremented, and reported when it reaches
+      ::FREESASA_PROGRESS_INTERVAL.
+    @return 1 if the calculation has been cancelled, 0 else.
+ */
+int
+freesasa_progress_tick(freesasa_progress *p,
+                       int *n_pending);
+
+/**
+    Report the atoms not yet reported by freesasa_progress_tick().
+
+    @param p The progress object.
+    @param n_pending Number of atoms not yet reported, set to 0.
+    @return 1 if the calculation has been cancelled, 0 else.
+ */
+int
+freesasa_progress_flush(freesasa_progress *p,
+                        int *n_pending);
+
+/**
+    Has the calculation been cancelled.
+
+    @param p The progress object.
+    @return 1 if cancelled, 0 else (also if p is NULL).
+ */
+int
+freesasa_progress_cancelled(freesasa_progress *p);
+
 /**
     Calculate SASA using S&R algorithm.
 
     @param sasa The results are written to this array, the user has to
     make sure it is large enough.
+    @param n_skipped If not NULL, the number of atoms found to be
+    buried before the calculation (see freesasa_atom_buried()), and
+    skipped, is written here.
+    @param dots If not NULL, the exposed test points are appended to
+    this object, in order of atom index.
     @param c Coordinates of the object to calculate SASA for.
     @param radii Array of radii for each sphere.
+    @param n_calc Only the SASA of the first n_calc atoms is
+    calculated, the remaining atoms only bury them (at most the
+    number of atoms in c).
     @param param Parameters specifying resolution, probe radius and
     number of threads. If NULL :.freesasa_default_parameters is used.
+    @param progress If not NULL, progress is reported here, and the
+    calculation stops early if it is cancelled.
     @return ::FREESASA_SUCCESS on success, ::FREESASA_WARN if multiple
     threads are requested when compiled in single-threaded mode (with
-    error message). ::FREESASA_FAIL if memory allocation failure.
+    error message). ::FREESASA_FAIL if memory allocation failure, or
+    (without error message) if the calculation was cancelled.
  */
 int
 freesasa_shrake_rupley(double *sasa,
+                       int *n_skipped,
+                       freesasa_surface_dots *dots,
                        const coord_t *c,
                        const double *radii,
-                       const freesasa_parameters *param);
+                       int n_calc,
+                       const freesasa_parameters *param,
+                       freesasa_progress *progress);
+
+/**
+    Work space for S&R calculations on a series of small molecules,
+    see freesasa_sr_workspace_new().
+ */
+typedef struct freesasa_sr_workspace freesasa_sr_workspace;
+
+/**
+    Work space for L&R calculations on a series of small molecules,
+    see freesasa_lr_workspace_new().
+ */
+typedef struct freesasa_lr_workspace freesasa_lr_workspace;
+
+/**
+    Allocate a work space for S&R calculations on molecules with at
+    most n_max atoms.
+
+    All memory needed for the calculations is allocated here, the
+    test points are only generated once and the neighbor lists are
+    reused. The calculations are single-threaded.
+
+    @param n_max Largest number of atoms in a molecule (> 0).
+    @param param Parameters, if NULL defaults are used. The number of
+      threads is ignored.
+    @return The work space, NULL if parameters are invalid or memory
+      allocation failed. Free with freesasa_sr_workspace_free().
+ */
+freesasa_sr_workspace *
+freesasa_sr_workspace_new(int n_max,
+                          const freesasa_parameters *param);
+
+/**
+    Free an S&R work space.
+
+    @param w The work space (can be NULL).
+ */
+void
+freesasa_sr_workspace_free(freesasa_sr_workspace *w);
+
+/**
+    Calculate the SASA of one molecule using an S&R work space.
+
+    @param w The work space.
+    @param sasa The SASA of each atom is written here (n values).
+    @param xyz Coordinates of the molecule (3*n values).
+    @param radii Radii of the atoms (without probe).
+    @param n Number of atoms, 0 < n <= n_max of the work space.
+    @param n_skipped If not NULL, the number of atoms skipped as
+      buried is added to this.
+    @param n_unconverged If not NULL, the number of atoms that didn't
+      reach the target error in adaptive mode is added to this.
+    @return ::FREESASA_SUCCESS, or ::FREESASA_FAIL if memory
+      allocation failed.
+ */
+int
+freesasa_sr_workspace_calc(freesasa_sr_workspace *w,
+                           double *sasa,
+                           const double *xyz,
+                           const double *radii,
+                           int n,
+                           int *n_skipped,
+                           int *n_unconverged);
+
+/**
+    Allocate a work space for L&R calculations on molecules with at
+    most n_max atoms. See freesasa_sr_workspace_new().
+
+    @param n_max Largest number of atoms in a molecule (> 0).
+    @param param Parameters, if NULL defaults are used. The number of
+      threads is ignored.
+    @return The work space, NULL if parameters are invalid or memory
+      allocation failed. Free with freesasa_lr_workspace_free().
+ */
+freesasa_lr_workspace *
+freesasa_lr_workspace_new(int n_max,
+                          const freesasa_parameters *param);
+
+/**
+    Free an L&R work space.
+
+    @param w The work space (can be NULL).
+ */
+void
+freesasa_lr_workspace_free(freesasa_lr_workspace *w);
+
+/**
+    Calculate the SASA of one molecule using an L&R work space. See
+    freesasa_sr_workspace_calc().
+
+    @param w The work space.
+    @param sasa The SASA of each atom is written here (n values).
+    @param xyz Coordinates of the molecule (3*n values).
+    @param radii Radii of the atoms (without probe).
+    @param n Number of atoms, 0 < n <= n_max of the work space.
+    @param n_skipped As for freesasa_sr_workspace_calc().
+    @param n_unconverged As for freesasa_sr_workspace_calc().
+    @return ::FREESASA_SUCCESS, or ::FREESASA_FAIL if memory
+      allocation failed.
+ */
+int
+freesasa_lr_workspace_calc(freesasa_lr_workspace *w,
+                           double *sasa,
+                           const double *xyz,
+                           const double *radii,
+                           int n,
+                           int *n_skipped,
+                           int *n_unconverged);
+
+/**
+    An S&R calculation on one molecule that is divided into chunks of
+    atoms, which can be calculated by different workers in any order,
+    see freesasa_sr_job_new().
+ */
+typedef struct freesasa_sr_job freesasa_sr_job;
+
+/**
+    An L&R calculation divided into chunks of atoms, see
+    freesasa_sr_job.
+ */
+typedef struct freesasa_lr_job freesasa_lr_job;
+
+/**
+    Prepare an S&R calculation that is divided into chunks.
+
+    Only the cell lists are calculated here, the neighbor lists are
+    filled by freesasa_sr_job_calc(), for the atoms of each chunk, so
+    that the setup of a large molecule doesn't have to be done by a
+    single thread. The work arrays of each worker are allocated the
+    first time it is used, and grown as needed. Surface dots,
+    gradients and multiple probes are not supported.
+
+    @param sasa The SASA of each atom is written here (one value per
+      atom). Initialized to 0.
+    @param xyz Coordinates (not periodic, at least one atom).
+    @param r Radii of the atoms (without probe).
+    @param param Parameters, if NULL defaults are used. The number of
+      threads is ignored.
+    @param n_workers Number of workers that will calculate chunks.
+    @return The job, NULL if parameters are invalid or memory
+      allocation failed. Free with freesasa_sr_job_free().
+ */
+freesasa_sr_job *
+freesasa_sr_job_new(double *sasa,
+                    const coord_t *xyz,
+                    const double *r,
+                    const freesasa_parameters *param,
+                    int n_workers);
+
+/**
+    Calculate the SASA of one chunk of atoms.
+
+    Different workers can calculate different chunks at the same
+    time, but each worker index can only be used by one thread at a
+    time, and the chunks should not overlap.
+
+    @param job The job.
+    @param first The first atom of the chunk.
+    @param n Number of atoms in the chunk (> 0).
+    @param worker Index of the worker (0 <= worker < n_workers).
+    @return ::FREESASA_SUCCESS, or ::FREESASA_FAIL if memory
+      allocation failed.
+ */
+int
+freesasa_sr_job_calc(freesasa_sr_job *job,
+                     int first,
+                     int n,
+                     int worker);
+
+/**
+    Statistics of a finished job.
+
+    @param job The job, all chunks calculated.
+    @param n_skipped If not NULL, the number of atoms skipped as
+      buried is added to this.
+    @return ::FREESASA_SUCCESS, or ::FREESASA_WARN (with message) if
+      some atoms did not reach the target error in adaptive mode.
+ */
+int
+freesasa_sr_job_report(const freesasa_sr_job *job,
+                       int *n_skipped);
+
+/**
+    Free an S&R job.
+
+    @param job The job (can be NULL).
+ */
+void
+freesasa_sr_job_free(freesasa_sr_job *job);
+
+/**
+    Prepare an L&R calculation that is divided into chunks. See
+    freesasa_sr_job_new().
+
+    @param sasa The SASA of each atom is written here.
+    @param xyz Coordinates (not periodic, at least one atom).
+    @param radii Radii of the atoms (without probe).
+    @param param Parameters, if NULL defaults are used. The number of
+      threads is ignored.
+    @param n_workers Number of workers that will calculate chunks.
+    @return The job, NULL if parameters are invalid or memory
+      allocation failed. Free with freesasa_lr_job_free().
+ */
+freesasa_lr_job *
+freesasa_lr_job_new(double *sasa,
+                    const coord_t *xyz,
+                    const double *radii,
+                    const freesasa_parameters *param,
+                    int n_workers);
+
+/**
+    Calculate the SASA of one chunk of atoms. See
+    freesasa_sr_job_calc().
+
+    @param job The job.
+    @param first The first atom of the chunk.
+    @param n Number of atoms in the chunk (> 0).
+    @param worker Index of the worker (0 <= worker < n_workers).
+    @return ::FREESASA_SUCCESS, or ::FREESASA_FAIL if memory
+      allocation failed.
+ */
+int
+freesasa_lr_job_calc(freesasa_lr_job *job,
+                     int first,
+                     int n,
+                     int worker);
+
+/**
+    Statistics of a finished job. See freesasa_sr_job_report().
+
+    @param job The job, all chunks calculated.
+    @param n_skipped If not NULL, the number of atoms skipped as
+      buried is added to this.
+    @return ::FREESASA_SUCCESS, or ::FREESASA_WARN (with message) if
+      some atoms did not reach the target error in adaptive mode.
+ */
+int
+freesasa_lr_job_report(const freesasa_lr_job *job,
+                       int *n_skipped);
+
+/**
+    Free an L&R job.
+
+    @param job The job (can be NULL).
+ */
+void
+freesasa_lr_job_free(freesasa_lr_job *job);
+
+/**
+    Allocate an empty ::freesasa_surface_dots object.
+
+    @return The new object, NULL if memory allocation failed.
+ */
+freesasa_surface_dots *
+freesasa_surface_dots_new(void);
+
+/**
+    Free a ::freesasa_surface_dots object and its contents.
+
+    @param dots The object (can be NULL).
+ */
+void
+freesasa_surface_dots_free(freesasa_surface_dots *dots);
+
+/**
+    Make sure there is space for more points in a
+    ::freesasa_surface_dots object.
+
+    @param dots The object.
+    @param capacity The number of points the arrays in dots have space
+    for, updated if they are reallocated (0 for a new object).
+    @param n_extra Number of points to add.
+    @return ::FREESASA_SUCCESS, or ::FREESASA_FAIL if memory
+    allocation failed.
+ */
+int
+freesasa_surface_dots_reserve(freesasa_surface_dots *dots,
+                              int *capacity,
+                              int n_extra);
+
+/**
+    Append the points in one ::freesasa_surface_dots object to
+    another.
+
+    @param dots The object to append to.
+    @param capacity As for freesasa_surface_dots_reserve().
+    @param src The points to append.
+    @return ::FREESASA_SUCCESS, or ::FREESASA_FAIL if memory
+    allocation failed.
+ */
+int
+freesasa_surface_dots_append(freesasa_surface_dots *dots,
+                             int *capacity,
+                             const freesasa_surface_dots *src);
+
+/**
+    Clone a ::freesasa_surface_dots object.
+
+    @param dots The object to clone.
+    @return The clone, NULL if memory allocation failed.
+ */
+freesasa_surface_dots *
+freesasa_surface_dots_clone(const freesasa_surface_dots *dots);
+
+/**
+    Sort probe radii.
+
+    Used by the calculations with several probe radii, which process
+    the probe radii in order of increasing size and offset them from
+    the largest one.
+
+    @param order The indices of the probe radii in increasing order of
+    radius are written here (n_probes elements).
+    @param shift The largest probe radius minus each of the probe
+    radii, in the same order, is written here (n_probes elements).
+    @param probe_radii The probe radii.
+    @param n_probes Number of probe radii (> 0).
+    @return The largest probe radius.
+ */
+double
+freesasa_sort_probes(int *order,
+                     double *shift,
+                     const double *probe_radii,
+                     int n_probes);
+
+/**
+    Calculate SASA using S&R algorithm, for several probe radii.
+
+    The neighbor list is calculated once, for the largest probe
+    radius, and all probe radii are evaluated for an atom before
+    moving on to the next.
+
+    @param sasa The results are written to this array, which should
+    have space for n_probes values per atom. The SASA of atom i with
+    probe k is stored in sasa[i*n_probes + k].
+    @param n_skipped As for freesasa_shrake_rupley(), but counts
+    combinations of atoms and probe radii.
+    @param c Coordinates of the object to calculate SASA for.
+    @param radii Array of radii for each sphere (without probe).
+    @param probe_radii The probe radii.
+    @param n_probes Number of probe radii.
+    @param param Parameters specifying resolution and number of
+    threads, the probe radius is ignored. If NULL
+    :.freesasa_default_parameters is used.
+    @return Same as freesasa_shrake_rupley().
+ */
+int
+freesasa_shrake_rupley_probes(double *sasa,
+                              int *n_skipped,
+                              const coord_t *c,
+                              const double *radii,
+                              const double *probe_radii,
+                              int n_probes,
+                              const freesasa_parameters *param);
 
 /**
     Calculate SASA using L&R algorithm.
@@ -86,19 +505,156 @@ freesasa_shrake_rupley(double *sasa,
 
     @param sasa The results are written to this array, the user has to
     make sure it is large enough.
+    @param gradient If not NULL, the gradient of the total SASA with
+    respect to the coordinates is written to this array (3 values per
+    atom). This is the exact derivative of the L&R approximation of
+    the SASA at the given resolution. Can't be used with adaptive
+    resolution.
+    @param n_skipped If not NULL, the number of atoms found to be
+    buried before the calculation (see freesasa_atom_buried()), and
+    skipped, is written here.
     @param c Coordinates of the object to calculate SASA for.
     @param radii Array of radii for each sphere.
+    @param n_calc As for freesasa_shrake_rupley().
     @param param Parameters specifying resolution, probe radius and
     number of threads. If NULL :.freesasa_default_parameters is used.
+    @param progress As for freesasa_shrake_rupley().
     @return ::FREESASA_SUCCESS on success, ::FREESASA_WARN if
     multiple threads are requested when compiled in single-threaded
     mode (with error message). ::FREESASA_FAIL if memory allocation
-    failure.
+    failure, if gradients are requested in adaptive mode, or (without
+    error message) if the calculation was cancelled.
  */
 int freesasa_lee_richards(double* sasa,
+                          double *gradient,
+                          int *n_skipped,
                           const coord_t *c,
                           const double *radii,
-                          const freesasa_parameters *param);
+                          int n_calc,
+                          const freesasa_parameters *param,
+                          freesasa_progress *progress);
+
+/**
+    Calculate SASA using L&R algorithm, for several probe radii.
+
+    Works as freesasa_shrake_rupley_probes().
+
+    @param sasa The results are written to this array, which should
+    have space for n_probes values per atom. The SASA of atom i with
+    probe k is stored in sasa[i*n_probes + k].
+    @param n_skipped As for freesasa_lee_richards(), but counts
+    combinations of atoms and probe radii.
+    @param c Coordinates of the object to calculate SASA for.
+    @param radii Array of radii for each sphere (without probe).
+    @param probe_radii The probe radii.
+    @param n_probes Number of probe radii.
+    @param param Parameters specifying resolution and number of
+    threads, the probe radius is ignored. If NULL
+    :.freesasa_default_parameters is used.
+    @return Same as freesasa_lee_richards().
+ */
+int freesasa_lee_richards_probes(double *sasa,
+                                 int *n_skipped,
+                                 const coord_t *c,
+                                 const double *radii,
+                                 const double *probe_radii,
+                                 int n_probes,
+                                 const freesasa_parameters *param);
+
+/**
+    Length of the parts of the circle [0, 2*PI] that are not covered
+    by the arcs, used by L&R.
+
+    @param arc The arcs, as pairs of start and end angle, none of
+    them crossing 0. Sorted by the function.
+    @param n Number of arcs.
+    @return The exposed length (in radians).
+ */
+double
+freesasa_exposed_arc_length(double *arc,
+                            int n);
+
+/**
+    Per atom error target for adaptive resolution in S&R and L&R.
+
+    Combines ::freesasa_parameters.target_atom_error and
+    ::freesasa_parameters.target_total_error. The errors of different
+    atoms are independent, of either sign, so the error of the total
+    grows as the square root of the number of atoms, and each atom gets
+    the total target divided by sqrt(n_atoms).
+
+    @param param The parameters.
+    @param n_atoms Number of atoms in the calculation.
+    @return The per atom target (in Å²), 0 if no target is set.
+ */
+double
+freesasa_target_atom_error(const freesasa_parameters *param,
+                           int n_atoms);
+
+/**
+    Calculate SASA analytically using the Gauss-Bonnet theorem.
+
+    The exposed part of each sphere is bounded by arcs of the circles
+    where it intersects its neighbors; the area follows from the arc
+    lengths and the angles at the vertices where arcs meet. The result
+    is exact up to floating point precision, the resolution parameters
+    are ignored.
+
+    @param sasa The results are written to this array, the user has to
+    make sure it is large enough.
+    @param c Coordinates of the object to calculate SASA for.
+    @param radii Array of radii for each sphere.
+    @param n_calc As for freesasa_shrake_rupley().
+    @param param Parameters specifying probe radius and number of
+    threads. If NULL :.freesasa_default_parameters is used.
+    @param progress As for freesasa_shrake_rupley().
+    @return ::FREESASA_SUCCESS on success, ::FREESASA_WARN if
+    multiple threads are requested when compiled in single-threaded
+    mode (with error message). ::FREESASA_FAIL if memory allocation
+    failure, or (without error message) if the calculation was
+    cancelled.
+ */
+int freesasa_gauss_bonnet(double* sasa,
+                          const coord_t *c,
+                          const double *radii,
+                          int n_calc,
+                          const freesasa_parameters *param,
+                          freesasa_progress *progress);
+
+/**
+    Calculate approximate SASA using the LCPO method.
+
+    SASA is estimated from the areas of pairwise and triplet overlaps
+    between spheres, using parameters fitted for the radii of the
+    built-in classifiers and a probe radius of 1.4 Å. Typical errors
+    are about 4 Å^2 per atom, and a few percent for the total SASA of
+    a protein (more for small exposed structures).
+
+    @param sasa The results are written to this array, the user has to
+    make sure it is large enough.
+    @param gradient If not NULL, the gradient of the total SASA with
+    respect to the coordinates is written to this array (3 values per
+    atom).
+    @param c Coordinates of the object to calculate SASA for.
+    @param radii Array of radii for each sphere.
+    @param n_calc As for freesasa_shrake_rupley().
+    @param param Parameters specifying probe radius and number of
+    threads. If NULL :.freesasa_default_parameters is used.
+    @param progress As for freesasa_shrake_rupley().
+    @return ::FREESASA_SUCCESS on success, ::FREESASA_WARN if
+    multiple threads are requested when compiled in single-threaded
+    mode, or if the probe radius differs from the one used to fit
+    the parameters (with error message). ::FREESASA_FAIL if memory
+    allocation failure, or (without error message) if the
+    calculation was cancelled.
+ */
+int freesasa_lcpo(double *sasa,
+                  double *gradient,
+                  const coord_t *c,
+                  const double *radii,
+                  int n_calc,
+                  const freesasa_parameters *param,
+                  freesasa_progress *progress);
 
 /**
     Calculate SASA based on a coordinate object, radii and parameters
@@ -119,6 +675,27 @@ freesasa_calc(const coord_t *c,
               const double *radii,
               const freesasa_parameters *parameters);
 
+/**
+    Same as freesasa_calc(), but only calculates the SASA of the first
+    atoms, and reports progress.
+
+    @param c Coordinates
+    @param radii Atomi radii
+    @param n_calc Only the first n_calc atoms are calculated, the
+      remaining ones only bury them. The result has n_calc atoms.
+      Gradients can only be calculated if all atoms are included.
+    @param parameters Parameters
+    @param progress Progress object, can be NULL.
+    @return Result of calculation, NULL if something went wrong or
+      the calculation was cancelled.
+ */
+freesasa_result*
+freesasa_calc_subset(const coord_t *c,
+                     const double *radii,
+                     int n_calc,
+                     const freesasa_parameters *parameters,
+                     freesasa_progress *progress);
+
 int
 freesasa_write_log(FILE *log,
                    freesasa_node *root);
@@ -224,6 +801,13 @@ int
 freesasa_write_log(FILE *log,
                    freesasa_node *root);
 
+/**
+    Allocate a results object for n atoms, without gradient or
+    surface dots, the SASA values are uninitialized.
+*/
+freesasa_result *
+freesasa_result_new(int n);
+
 /**
     Clone results object
 */
@@ -417,6 +1001,162 @@ freesasa_mem_fail(const char* file,
 const char*
 freesasa_thread_error(int error_code);
 
+#if USE_THREADS
+/**
+    Start a thread, like `pthread_create()` with default attributes.
+
+    The new thread uses the diagnostic settings of the calling thread
+    (see freesasa_set_thread_verbosity()) while it runs `fn`. All
+    threads of the library should be started this way.
+
+    @param thread The thread.
+    @param fn The function to run.
+    @param arg The argument of `fn`.
+    @return 0 on success, otherwise an error code as for
+      `pthread_create()`, which can be passed to
+      freesasa_thread_error().
+ */
+int
+freesasa_thread_create(pthread_t *thread,
+                       void *(*fn)(void *),
+                       void *arg);
+#endif /* USE_THREADS */
+
+/**
+    Call a function for each element of an array, in parallel.
+
+    `fn(args + i*size)` is called for `i = 0..n-1`, the first in the
+    calling thread and the others in one thread each (see
+    freesasa_thread_create()). Calls whose threads could not be
+    started are made in the calling thread, so all calls are made
+    when the function returns. Without thread support the calls are
+    made one after the other.
+
+    @param fn The function, which should report its status in its
+      argument.
+    @param args Array of arguments.
+    @param size Size of each argument.
+    @param n Number of calls.
+    @return ::FREESASA_SUCCESS, or ::FREESASA_FAIL if a thread could
+      not be joined.
+ */
+int
+freesasa_run_parallel(void (*fn)(void *),
+                      void *args,
+                      size_t size,
+                      int n);
+
+/**
+    Output that is written either directly to a file or to a buffer
+    in memory, so that parts of a file can be formatted in parallel
+    and written in order afterwards.
+
+    Initialize with `file` set to the file, or with all fields zero
+    to use a buffer.
+ */
+typedef struct {
+    FILE *file; /**< written to directly if not NULL */
+    char *buf; /**< the text, if file is NULL */
+    size_t len; /**< length of the text */
+    size_t size; /**< size of buf */
+    int fail; /**< set if memory allocation failed */
+} freesasa_out;
+
+/**
+    Print to a ::freesasa_out object.
+
+    @param out The output.
+    @param format Format string, followed by arguments, as printf().
+    @return ::FREESASA_SUCCESS, or ::FREESASA_FAIL if writing failed
+      or memory allocation failed (also all later calls fail then).
+ */
+int
+freesasa_out_printf(freesasa_out *out,
+                    const char *format,
+                    ...);
+
+/**
+    Write the buffered text of a ::freesasa_out object to a file and
+    free the buffer.
+
+    @param out The output, using a buffer.
+    @param file The file.
+    @return ::FREESASA_SUCCESS, or ::FREESASA_FAIL if writing or an
+      earlier memory allocation failed.
+ */
+int
+freesasa_out_write(freesasa_out *out,
+                   FILE *file);
+
+/**
+    Pin the calling thread to one CPU.
+
+    Thread `thread_index` of a calculation is pinned to the
+    `thread_index`-th CPU the process is allowed to run on (modulo the
+    number of such CPUs), so that consecutive threads fill the cores
+    of one socket before the next.
+
+    @param thread_index Index of the thread in its calculation.
+    @return ::FREESASA_SUCCESS, or ::FREESASA_WARN if the thread could
+      not be pinned or the platform doesn't support it (a warning is
+      printed only if pinning failed).
+ */
+int
+freesasa_pin_thread(int thread_index);
+
+/**
+    Diagnostic settings of one thread, overriding the process-wide
+    verbosity and error stream (see freesasa_set_thread_verbosity()
+    and freesasa_set_thread_err_out()).
+ */
+struct freesasa_thread_state {
+    int has_verbosity; /**< verbosity overrides the global one */
+    freesasa_verbosity verbosity; /**< verbosity of the thread */
+    FILE *err_out; /**< error stream of the thread, NULL if not set */
+};
+
+/**
+    The diagnostic settings of the calling thread.
+
+    @param create If the thread has no settings yet, allocate them
+      (otherwise `NULL` is returned).
+    @return The settings, or `NULL` if there are none (or allocation
+      failed).
+ */
+struct freesasa_thread_state *
+freesasa_thread_state(int create);
+
+/**
+    Copy the diagnostic settings of the calling thread.
+
+    Used to hand the caller's settings to threads started on its
+    behalf (see freesasa_async).
+
+    @param state Output, all fields are cleared if the calling
+      thread has no settings.
+ */
+void
+freesasa_thread_state_get(struct freesasa_thread_state *state);
+
+/**
+    Install diagnostic settings in the calling thread.
+
+    @param state The settings (from freesasa_thread_state_get()).
+    @return ::FREESASA_SUCCESS, or ::FREESASA_FAIL if memory
+      allocation failed.
+ */
+int
+freesasa_thread_state_set(const struct freesasa_thread_state *state);
+
+/**
+    The error stream for the calling thread.
+
+    @return The thread's stream if set, otherwise the global one,
+      otherwise `stderr`.
+ */
+FILE *
+freesasa_err_stream(void);
+
 /**
     Prints fail message with function name, file name, and line number.
 
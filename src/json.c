@@ -214,7 +214,7 @@ freesasa_node2json(freesasa_node *node,
 static json_object *
 parameters2json(const freesasa_parameters *p)
 {
-    json_object *obj = json_object_new_object(), *res;
+    json_object *obj = json_object_new_object(), *res = NULL;
 
     json_object_object_add(obj, "algorithm", json_object_new_string(freesasa_alg_name(p->alg)));
     json_object_object_add(obj, "probe-radius", json_object_new_double(p->probe_radius));
@@ -226,11 +226,22 @@ parameters2json(const freesasa_parameters *p)
     case FREESASA_LEE_RICHARDS:
         res = json_object_new_int(p->lee_richards_n_slices);
         break;
+    case FREESASA_GAUSS_BONNET:
+    case FREESASA_LCPO:
+        break; /* no resolution parameter */
     default:
         assert(0);
         break;
     }
-    json_object_object_add(obj, "resolution", res);
+    if (res) {
+        json_object_object_add(obj, "resolution", res);
+        if (p->target_atom_error > 0)
+            json_object_object_add(obj, "target-atom-error",
+                                   json_object_new_double(p->target_atom_error));
+        if (p->target_total_error > 0)
+            json_object_object_add(obj, "target-total-error",
+                                   json_object_new_double(p->target_total_error));
+    }
 
     return obj;
 }
@@ -12,22 +12,46 @@
 /** to control error messages (used for debugging and testing) */
 static freesasa_verbosity verbosity;
 
-int
-freesasa_set_verbosity(freesasa_verbosity s)
+static int
+valid_verbosity(freesasa_verbosity s)
 {
-    if (s == FREESASA_V_NORMAL ||
+    return s == FREESASA_V_NORMAL ||
         s == FREESASA_V_NOWARNINGS ||
         s == FREESASA_V_SILENT ||
-        s == FREESASA_V_DEBUG) {
+        s == FREESASA_V_DEBUG;
+}
+
+int
+freesasa_set_verbosity(freesasa_verbosity s)
+{
+    if (valid_verbosity(s)) {
         verbosity = s;
         return FREESASA_SUCCESS;
     }
     return FREESASA_WARN;
 }
 
+int
+freesasa_set_thread_verbosity(freesasa_verbosity s)
+{
+    struct freesasa_thread_state *state;
+
+    if (!valid_verbosity(s)) return FREESASA_WARN;
+
+    state = freesasa_thread_state(1);
+    if (state == NULL) return mem_fail();
+    state->has_verbosity = 1;
+    state->verbosity = s;
+
+    return FREESASA_SUCCESS;
+}
+
 freesasa_verbosity
 freesasa_get_verbosity(void)
 {
+    struct freesasa_thread_state *state = freesasa_thread_state(0);
+
+    if (state && state->has_verbosity) return state->verbosity;
     return verbosity;
 }
 
@@ -133,10 +157,19 @@ write_parameters(FILE *log,
     case FREESASA_LEE_RICHARDS:
         fprintf(log,"slices       : %d\n",p->lee_richards_n_slices);
         break;
+    case FREESASA_GAUSS_BONNET:
+    case FREESASA_LCPO:
+        break;
     default:
         assert(0);
         break;
     }
+    if (p->alg == FREESASA_SHRAKE_RUPLEY || p->alg == FREESASA_LEE_RICHARDS) {
+        if (p->target_atom_error > 0)
+            fprintf(log,"target error : %g (atom)\n",p->target_atom_error);
+        if (p->target_total_error > 0)
+            fprintf(log,"target error : %g (total)\n",p->target_total_error);
+    }
 
     fflush(log);
     if (ferror(log)) {
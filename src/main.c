@@ -9,6 +9,7 @@
 #include <string.h>
 #include <getopt.h>
 #include <stdarg.h>
+#include <ctype.h>
 
 #include "freesasa.h"
 
@@ -34,19 +35,31 @@ static char *program_name = "freesasa";
 
 #define FORMAT_STRING "log|res|seq|pdb|rsa" XML_STRING JSON_STRING
 
-enum {B_FILE, SELECT, UNKNOWN, RSA, RADII, DEPRECATED};
+enum {B_FILE, SELECT, UNKNOWN, RSA, RADII, DEPRECATED, LCPO,
+      TARGET_ERROR, TARGET_TOTAL_ERROR, SURFACE_DOTS, SURFACE_DOTS_FORMAT,
+      BIOMT, SYMMETRY_FILE, PERIODIC, NUMA, PIN_THREADS, STREAM,
+      XYZR};
+
+/* formats of coordinate input (option --xyzr) */
+enum {XYZR_NONE, XYZR_TEXT, XYZR_FLOAT, XYZR_DOUBLE};
 
 static int option_flag;
 
 static struct option long_options[] = {
     {"lee-richards",         no_argument,       0, 'L'},
     {"shrake-rupley",        no_argument,       0, 'S'},
+    {"gauss-bonnet",         no_argument,       0, 'G'},
+    {"lcpo",                 no_argument,       &option_flag, LCPO},
     {"probe-radius",         required_argument, 0, 'p'},
     {"resolution",           required_argument, 0, 'n'},
+    {"target-error",         required_argument, &option_flag, TARGET_ERROR},
+    {"target-total-error",   required_argument, &option_flag, TARGET_TOTAL_ERROR},
     {"help",                 no_argument,       0, 'h'},
     {"version",              no_argument,       0, 'v'},
     {"no-warnings",          no_argument,       0, 'w'},
     {"n-threads",            required_argument, 0, 't'},
+    {"numa",                 no_argument,       &option_flag, NUMA},
+    {"pin-threads",          no_argument,       &option_flag, PIN_THREADS},
     {"config-file",          required_argument, 0, 'c'},
     {"radius-from-occupancy",no_argument,       0, 'O'},
     {"hetatm",               no_argument,       0, 'H'},
@@ -54,11 +67,18 @@ static struct option long_options[] = {
     {"separate-chains",      no_argument,       0, 'C'},
     {"separate-models",      no_argument,       0, 'M'},
     {"join-models",          no_argument,       0, 'm'},
+    {"stream",               no_argument,       &option_flag, STREAM},
+    {"xyzr",                 required_argument, &option_flag, XYZR},
     {"chain-groups",         required_argument, 0, 'g'},
     {"error-file",           required_argument, 0, 'e'},
     {"output",               required_argument, 0, 'o'},
     {"format",               required_argument, 0, 'f'},
     {"depth",                required_argument, 0, 'd'},
+    {"surface-dots",         required_argument, &option_flag, SURFACE_DOTS},
+    {"surface-dots-format",  required_argument, &option_flag, SURFACE_DOTS_FORMAT},
+    {"biomt",                no_argument,       &option_flag, BIOMT},
+    {"symmetry-file",        required_argument, &option_flag, SYMMETRY_FILE},
+    {"periodic",             no_argument,       &option_flag, PERIODIC},
     {"select",               required_argument, &option_flag, SELECT},
     {"unknown",              required_argument, &option_flag, UNKNOWN},
     {"rsa",                  no_argument,       &option_flag, RSA},
@@ -72,7 +92,7 @@ static struct option long_options[] = {
     {0,0,0,0}
 };
 
-#define NOARG_OPTIONS "hvwLSHYOCMm"
+#define NOARG_OPTIONS "hvwLSGHYOCMm"
 #define NOARG_DEPRECATED "BrRl"
 #define ARG_OPTIONS "c:n:t:p:g:e:o:f:"
 const char* options_string = ":" NOARG_OPTIONS NOARG_DEPRECATED ARG_OPTIONS;
@@ -92,9 +112,19 @@ struct cli_state {
     int n_select;
     char** select_cmd;
     /* output settings */
-    int output_format, output_depth;
+    int output_format, output_depth, dots_format;
+    /* symmetry operators */
+    int read_biomt;
+    int n_operators;
+    double *operators;
+    /* periodic boundary conditions from CRYST1 */
+    int periodic;
+    /* read input as a stream of structures */
+    int stream;
+    /* read coordinates and radii instead of PDB */
+    int xyzr;
     /* Files */
-    FILE *input, *output, *errlog;
+    FILE *input, *output, *errlog, *dots;
 
 };
 
@@ -120,8 +150,16 @@ init_state(struct cli_state *state)
     state->select_cmd = 0;
     state->output_format = 0;
     state->output_depth = FREESASA_OUTPUT_CHAIN;
+    state->dots_format = FREESASA_DOTS_XYZ | FREESASA_DOTS_NORMALS;
     state->output = NULL;
     state->errlog = NULL;
+    state->dots = NULL;
+    state->read_biomt = 0;
+    state->n_operators = 0;
+    state->operators = NULL;
+    state->periodic = 0;
+    state->stream = 0;
+    state->xyzr = XYZR_NONE;
 }
 
 static void
@@ -143,6 +181,8 @@ release_state(struct cli_state *state)
     }
     if (state->errlog) fclose(state->errlog);
     if (state->output) fclose(state->output);
+    if (state->dots) fclose(state->dots);
+    free(state->operators);
 
 }
 
@@ -159,21 +199,26 @@ help(void)
 {
     printf("\nUsage: %s [options] pdb-file ...", program_name);
     printf("\n       %s [options] < pdb-file", program_name);
+    printf("\n       %s --xyzr=<text|float|double> [options] xyzr-file ...", program_name);
     printf("\n       %s (--help | --version | --deprecated)\n", program_name);
     printf("\n"
            "Options:\n"
-           "  --shrake-rupley | --lee-richards\n"
+           "  --shrake-rupley | --lee-richards | --gauss-bonnet | --lcpo\n"
            "  --probe-radius=<NUMBER>\n"
-           "  --resolution=<INTEGER> -n-threads=<INTEGER>\n"
+           "  --resolution=<INTEGER> -n-threads=<INTEGER> --numa --pin-threads\n"
+           "  --target-error=<NUMBER> | --target-total-error=<NUMBER>\n"
            "  --radius-from-occupancy | --config-file=<FILE> | --radii=<protor|naccess>\n"
            "  --hetatm --hydrogen\n"
            "  --unknown=<guess|skip|halt>\n"
-           "  --separate-models | --join-models\n"
+           "  --separate-models | --join-models --stream\n"
+           "  --xyzr=<text|float|double>\n"
            "  --separate-chains | --chain-groups=<LIST> ...\n"
+           "  --biomt | --symmetry-file=<FILE> | --periodic\n"
            "  --select=<STRING> ...\n"
            "  --output=<FILE> --error-file=<FILE> --no-warnings\n"
            "  --format=<" FORMAT_STRING "> ... \n"
-           "  --depth=<structure|chain|residue|atom>\n");
+           "  --depth=<structure|chain|residue|atom>\n"
+           "  --surface-dots=<FILE> --surface-dots-format=<xyz|binary>\n");
     printf("\nPlease refer to the man pages or online documentation for more information.\n");
     addresses(stdout);
     printf("\n");
@@ -243,14 +288,43 @@ exit_with_help(void) {
 #define error(...) err_msg("error", __VA_ARGS__)
 #define abort_msg(...) do {error(__VA_ARGS__); exit_with_help();} while(0)
 
+/* add views of the chain-groups (if requested) of each structure */
+static freesasa_structure **
+add_chain_groups(freesasa_structure **structures,
+                 int *n,
+                 const struct cli_state *state)
+{
+    int i, j, n2;
+    freesasa_structure *tmp;
+
+    if (state->n_chain_groups > 0) {
+        n2 = *n;
+        for (i = 0; i < state->n_chain_groups; ++i) {
+            for (j = 0; j < *n; ++j) {
+                tmp = freesasa_structure_view_chains(structures[j], state->chain_groups[i]);
+                if (tmp != NULL) {
+                    ++n2;
+                    structures = realloc(structures, sizeof(freesasa_structure*)*n2);
+                    if (structures == NULL) abort_msg("out of memory");
+                    structures[n2-1] = tmp;
+                } else {
+                    abort_msg("at least one of chain(s) '%s' not found", state->chain_groups[i]);
+                }
+            }
+        }
+        *n = n2;
+    }
+
+    return structures;
+}
+
 static freesasa_structure **
 get_structures(FILE *input,
                int *n,
                const struct cli_state *state)
 {
-    int i, j, n2;
+    int i;
     freesasa_structure **structures = NULL;
-    freesasa_structure *tmp;
 
     *n = 0;
     if ((state->structure_options & FREESASA_SEPARATE_CHAINS) ||
@@ -266,68 +340,83 @@ get_structures(FILE *input,
             abort_msg("out of memory");
         }
         *n = 1;
-        structures[0] = freesasa_structure_from_pdb(input, state->classifier, state->structure_options);
+        structures[0] = freesasa_structure_from_pdb_parallel(input, state->classifier,
+                                                             state->structure_options,
+                                                             state->parameters.n_threads);
         if (structures[0] == NULL) {
             abort_msg("invalid input");
         }
     }
 
-    /* get chain-groups (if requested) */
-    if (state->n_chain_groups > 0) {
-        n2 = *n;
-        for (i = 0; i < state->n_chain_groups; ++i) {
-            for (j = 0; j < *n; ++j) {
-                tmp = freesasa_structure_get_chains(structures[j], state->chain_groups[i],
-                                                    state->classifier, state->structure_options);
-                if (tmp != NULL) {
-                    ++n2;
-                    structures = realloc(structures, sizeof(freesasa_structure*)*n2);
-                    if (structures == NULL) abort_msg("out of memory");
-                    structures[n2-1] = tmp;
-                } else {
-                    abort_msg("at least one of chain(s) '%s' not found", state->chain_groups[i]);
-                }
-            }
-        }
-        *n = n2;
-    }
-
-    return structures;
+    return add_chain_groups(structures, n, state);
 }
 
-static freesasa_node *
-run_analysis(FILE *input,
-             const char *name,
-             const struct cli_state *state)
+/* Calculate the structures and add the results to the tree. The
+   structures are freed. */
+static void
+analyze_structures(freesasa_node *tree,
+                   freesasa_structure **structures,
+                   int n,
+                   const char *name,
+                   int model_names,
+                   const double *operators,
+                   int n_operators,
+                   const double *box,
+                   const struct cli_state *state)
 {
-    int name_len = strlen(name);
-    freesasa_structure **structures = NULL;
-    freesasa_node *tree = freesasa_tree_new(), *tmp_tree, *structure_node;
+    freesasa_node *tmp_tree, *structure_node;
     const freesasa_result *result;
+    freesasa_result *own_result, **results = NULL;
     freesasa_selection *sel;
-    int n = 0, i, c;
-    char *name_i = malloc(name_len+10);
+    int i, c;
+    char *name_i = malloc(strlen(name)+10);
 
-    if (tree == NULL) abort_msg("failed to initialize result-tree");
     if (name_i == NULL) abort_msg("memory failure");
 
-    /* read PDB file */
-    structures = get_structures(input, &n, state);
-    if (n == 0) abort_msg("invalid input");
+    /* several structures are calculated together, so that the
+       threads can be shared between them */
+    if (n > 1 && n_operators == 0 && !state->periodic) {
+        results = malloc(sizeof(freesasa_result *) * n);
+        if (results == NULL) abort_msg("memory failure");
+        if (freesasa_calc_structures((const freesasa_structure **) structures, n,
+                                     results, &state->parameters) == FREESASA_FAIL)
+            abort_msg("can't calculate SASA");
+    }
 
     /* perform calculation on each structure */
     for (i = 0; i < n; ++i) {
         strcpy(name_i,name);
-        if (n > 1 && (state->structure_options & FREESASA_SEPARATE_MODELS))
+        if (model_names)
             sprintf(name_i+strlen(name_i), ":%d", freesasa_structure_model(structures[i]));
 
-        tmp_tree = freesasa_calc_tree(structures[i], &state->parameters, name_i);
+        if (n_operators > 0) {
+            own_result = freesasa_calc_structure_symmetric(structures[i], operators,
+                                                           n_operators, &state->parameters);
+            if (own_result == NULL) abort_msg("can't calculate SASA");
+            tmp_tree = freesasa_tree_init(own_result, structures[i], name_i);
+            freesasa_result_free(own_result);
+        } else if (state->periodic) {
+            own_result = freesasa_calc_structure_periodic(structures[i], box,
+                                                          &state->parameters);
+            if (own_result == NULL) abort_msg("can't calculate SASA");
+            tmp_tree = freesasa_tree_init(own_result, structures[i], name_i);
+            freesasa_result_free(own_result);
+        } else if (results != NULL) {
+            tmp_tree = freesasa_tree_init(results[i], structures[i], name_i);
+            freesasa_result_free(results[i]);
+        } else {
+            tmp_tree = freesasa_calc_tree(structures[i], &state->parameters, name_i);
+        }
         if (tmp_tree == NULL) abort_msg("can't calculate SASA");
 
         structure_node =
             freesasa_node_children(freesasa_node_children(tmp_tree));
         result = freesasa_node_structure_result(structure_node);
 
+        if (state->dots &&
+            freesasa_write_surface_dots(state->dots, result, name_i, state->dots_format))
+            abort_msg("failed writing surface dots");
+
         /* Calculate selections for each structure */
         if (state->n_select > 0) {
             for (c = 0; c < state->n_select; ++c) {
@@ -348,7 +437,238 @@ run_analysis(FILE *input,
         freesasa_structure_free(structures[i]);
     }
 
-    free(structures);
+    free(results);
+    free(name_i);
+}
+
+/* Read the structures of a stream one by one, and calculate each
+   as soon as it has been read */
+static void
+analyze_stream(freesasa_node *tree,
+               FILE *input,
+               const char *name,
+               const double *operators,
+               int n_operators,
+               const double *box,
+               const struct cli_state *state)
+{
+    freesasa_structure_stream *stream;
+    freesasa_structure **structures;
+    freesasa_structure *structure;
+    int n, n_read = 0, ret;
+
+    stream = freesasa_structure_stream_new(input, state->classifier, state->structure_options,
+                                           state->parameters.n_threads);
+    if (stream == NULL) abort_msg("memory failure");
+
+    while ((ret = freesasa_structure_stream_next(stream, &structure)) == 1) {
+        structures = malloc(sizeof(freesasa_structure*));
+        if (structures == NULL) abort_msg("out of memory");
+        structures[0] = structure;
+        n = 1;
+        structures = add_chain_groups(structures, &n, state);
+        analyze_structures(tree, structures, n, name,
+                           state->structure_options & FREESASA_SEPARATE_MODELS,
+                           operators, n_operators, box, state);
+        free(structures);
+        ++n_read;
+    }
+    if (ret == FREESASA_FAIL) abort_msg("invalid input");
+    if (n_read == 0) abort_msg("input had no valid ATOM or HETATM lines");
+
+    freesasa_structure_stream_free(stream);
+}
+
+/* Add an atom to the arrays of read_xyzr() */
+static void
+add_xyzr(double **xyz,
+         double **radii,
+         int *n,
+         int *n_alloc,
+         const double *v)
+{
+    if (*n == *n_alloc) {
+        *n_alloc = *n_alloc ? 2 * *n_alloc : 1024;
+        *xyz = realloc(*xyz, sizeof(double) * 3 * *n_alloc);
+        *radii = realloc(*radii, sizeof(double) * *n_alloc);
+        if (*xyz == NULL || *radii == NULL) abort_msg("out of memory");
+    }
+    memcpy(*xyz + 3 * *n, v, sizeof(double) * 3);
+    (*radii)[*n] = v[3];
+    ++*n;
+}
+
+/* Read atoms in the format given by --xyzr. Text input has one atom
+   per line, as the four numbers x, y, z and radius. Empty lines and
+   lines starting with '#' are skipped. Binary input is a sequence of
+   records of four floats or doubles, in the byte order of the
+   machine. Returns the number of atoms. */
+static int
+read_xyzr(FILE *input,
+          const char *name,
+          int format,
+          double **xyz,
+          double **radii)
+{
+    char line[256], *p, *end;
+    unsigned char buf[4 * sizeof(double) * 1024];
+    double v[4];
+    float f[4];
+    size_t rec_size, n_bytes, offset;
+    int n = 0, n_alloc = 0, line_no = 0, k;
+
+    *xyz = *radii = NULL;
+
+    if (format == XYZR_TEXT) {
+        while (fgets(line, sizeof(line), input)) {
+            ++line_no;
+            if (strchr(line, '\n') == NULL && !feof(input))
+                abort_msg("line %d in '%s' is too long", line_no, name);
+            for (p = line; isspace((unsigned char) *p); ++p);
+            if (*p == '\0' || *p == '#') continue;
+            for (k = 0; k < 4; ++k) {
+                v[k] = strtod(p, &end);
+                if (end == p) break;
+                p = end;
+            }
+            while (isspace((unsigned char) *p)) ++p;
+            if (k < 4 || *p != '\0')
+                abort_msg("line %d in '%s' should have the four numbers x, y, z and radius",
+                          line_no, name);
+            if (v[3] < 0) abort_msg("negative radius on line %d in '%s'", line_no, name);
+            add_xyzr(xyz, radii, &n, &n_alloc, v);
+        }
+    } else {
+        rec_size = 4 * (format == XYZR_FLOAT ? sizeof(float) : sizeof(double));
+        /* the buffer holds a whole number of records of either size */
+        while ((n_bytes = fread(buf, 1, sizeof(buf), input)) > 0) {
+            if (n_bytes % rec_size != 0)
+                abort_msg("'%s' ends with an incomplete record", name);
+            for (offset = 0; offset < n_bytes; offset += rec_size) {
+                if (format == XYZR_FLOAT) {
+                    memcpy(f, buf + offset, rec_size);
+                    for (k = 0; k < 4; ++k) v[k] = f[k];
+                } else {
+                    memcpy(v, buf + offset, rec_size);
+                }
+                if (!(v[3] >= 0)) abort_msg("invalid radius in record %d in '%s'", n + 1, name);
+                add_xyzr(xyz, radii, &n, &n_alloc, v);
+            }
+        }
+    }
+    if (ferror(input)) abort_msg("error reading '%s'", name);
+    if (n == 0) abort_msg("no atoms in '%s'", name);
+
+    return n;
+}
+
+/* Calculate SASA of the coordinates and radii in the input, and
+   write the area of each atom on a separate line, in the order of
+   the input. Only text input can be compressed, binary input can
+   start with any bytes and is read as it is. */
+static void
+run_xyzr(FILE *raw,
+         const char *name,
+         const struct cli_state *state)
+{
+    FILE *input;
+    double *xyz, *radii;
+    freesasa_result *result;
+    int n, i;
+
+    if (state->xyzr == XYZR_TEXT) {
+        input = freesasa_decompress(raw, state->parameters.n_threads);
+        if (input == NULL) abort_msg("could not read '%s'", name);
+    } else {
+        input = raw;
+    }
+
+    n = read_xyzr(input, name, state->xyzr, &xyz, &radii);
+    if (input != raw) fclose(input);
+
+    if (state->n_operators > 0) {
+        result = freesasa_calc_coord_symmetric(xyz, radii, n, state->operators,
+                                               state->n_operators, &state->parameters);
+    } else {
+        result = freesasa_calc_coord(xyz, radii, n, &state->parameters);
+    }
+    if (result == NULL) abort_msg("can't calculate SASA");
+
+    if (state->dots &&
+        freesasa_write_surface_dots(state->dots, result, name, state->dots_format))
+        abort_msg("failed writing surface dots");
+
+    for (i = 0; i < n; ++i) {
+        fprintf(state->output, "%.3f\n", result->sasa[i]);
+    }
+    if (ferror(state->output)) abort_msg("failed writing output");
+
+    freesasa_result_free(result);
+    free(xyz);
+    free(radii);
+}
+
+static freesasa_node *
+run_analysis(FILE *raw,
+             const char *name,
+             const struct cli_state *state)
+{
+    FILE *input;
+    freesasa_structure **structures = NULL;
+    freesasa_node *tree = freesasa_tree_new();
+    const double *operators = state->operators;
+    double *biomt = NULL, box[9];
+    long pos;
+    int n = 0, c, n_operators = state->n_operators;
+
+    if (tree == NULL) abort_msg("failed to initialize result-tree");
+
+    /* compressed input is decompressed while it is read */
+    input = freesasa_decompress(raw, state->parameters.n_threads);
+    if (input == NULL) abort_msg("could not read '%s'", name);
+
+    /* read symmetry operators from the PDB header */
+    if (state->read_biomt) {
+        pos = ftell(input);
+        n_operators = freesasa_symmetry_from_pdb(input, &biomt);
+        if (n_operators == FREESASA_FAIL) abort_msg("invalid BIOMT records in '%s'", name);
+        if (pos < 0 || fseek(input, pos, SEEK_SET) != 0)
+            abort_msg("option --biomt requires input that can be rewound");
+        if (n_operators == 0)
+            warn("no BIOMT records found in '%s', calculating without symmetry", name);
+        operators = biomt;
+    }
+
+    /* read the periodic box from the PDB header */
+    if (state->periodic) {
+        pos = ftell(input);
+        c = freesasa_periodic_box_from_pdb(input, box);
+        if (c == FREESASA_FAIL) abort_msg("invalid CRYST1 record in '%s'", name);
+        if (c == 0) abort_msg("no CRYST1 record found in '%s'", name);
+        if (pos < 0 || fseek(input, pos, SEEK_SET) != 0)
+            abort_msg("option --periodic requires input that can be rewound");
+    }
+
+    /* input that can't be rewound, such as a pipe, is read as a
+       stream */
+    if (state->stream || ftell(input) < 0) {
+        analyze_stream(tree, input, name, operators, n_operators, box, state);
+    } else {
+        /* read PDB file */
+        structures = get_structures(input, &n, state);
+        if (n == 0) abort_msg("invalid input");
+
+        analyze_structures(tree, structures, n, name,
+                           n > 1 && (state->structure_options & FREESASA_SEPARATE_MODELS),
+                           operators, n_operators, box, state);
+        free(structures);
+    }
+
+    free(biomt);
+    /* a decompression error looks like the end of the input to
+       the parser */
+    if (ferror(input)) abort_msg("error reading '%s'", name);
+    if (input != raw) fclose(input);
 
     return tree;
 }
@@ -492,6 +812,37 @@ parse_output_depth(const char *optarg) {
     return FREESASA_FAIL; /* to avoid compiler warnings */
 }
 
+static int
+parse_xyzr_format(const char *optarg) {
+    if (strcmp("text", optarg) == 0) {
+        return XYZR_TEXT;
+    }
+    if (strcmp("float", optarg) == 0) {
+        return XYZR_FLOAT;
+    }
+    if (strcmp("double", optarg) == 0) {
+        return XYZR_DOUBLE;
+    }
+    abort_msg("coordinate format '%s' not allowed, "
+              "can only be 'text', 'float' or 'double'",
+              optarg);
+    return FREESASA_FAIL; /* to avoid compiler warnings */
+}
+
+static int
+parse_dots_format(const char *optarg) {
+    if (strcmp("xyz", optarg) == 0) {
+        return FREESASA_DOTS_XYZ | FREESASA_DOTS_NORMALS;
+    }
+    if (strcmp("binary", optarg) == 0) {
+        return FREESASA_DOTS_BINARY | FREESASA_DOTS_NORMALS;
+    }
+    abort_msg("surface dot format '%s' not allowed, "
+              "can only be 'xyz' or 'binary'",
+              optarg);
+    return FREESASA_FAIL; /* to avoid compiler warnings */
+}
+
 static void
 state_set_static_classifier(const char *optarg, struct cli_state *state)
 {
@@ -545,6 +896,58 @@ parse_arg(int argc, char **argv, struct cli_state *state)
             case RADII:
                 state_set_static_classifier(optarg, state);
                 break;
+            case LCPO:
+                state->parameters.alg = FREESASA_LCPO;
+                ++alg_set;
+                break;
+            case TARGET_ERROR:
+                state->parameters.target_atom_error = atof(optarg);
+                if (state->parameters.target_atom_error <= 0)
+                    abort_msg("target error must be larger than 0");
+                break;
+            case TARGET_TOTAL_ERROR:
+                state->parameters.target_total_error = atof(optarg);
+                if (state->parameters.target_total_error <= 0)
+                    abort_msg("target error must be larger than 0");
+                break;
+            case NUMA:
+                state->parameters.numa_aware = 1;
+                break;
+            case PIN_THREADS:
+                state->parameters.pin_threads = 1;
+                break;
+            case SURFACE_DOTS:
+                if (state->dots != NULL) {
+                    abort_msg("option --surface-dots can only be set once");
+                }
+                state->dots = fopen_werr(optarg, "wb");
+                state->parameters.calc_surface_dots = 1;
+                break;
+            case SURFACE_DOTS_FORMAT:
+                state->dots_format = parse_dots_format(optarg);
+                break;
+            case BIOMT:
+                state->read_biomt = 1;
+                break;
+            case PERIODIC:
+                state->periodic = 1;
+                break;
+            case STREAM:
+                state->stream = 1;
+                break;
+            case XYZR:
+                state->xyzr = parse_xyzr_format(optarg);
+                break;
+            case SYMMETRY_FILE:
+                if (state->operators != NULL) {
+                    abort_msg("option --symmetry-file can only be set once");
+                }
+                cf = fopen_werr(optarg, "r");
+                state->n_operators = freesasa_symmetry_from_file(cf, &state->operators);
+                fclose(cf);
+                if (state->n_operators == FREESASA_FAIL)
+                    abort_msg("invalid symmetry file '%s'", optarg);
+                break;
             case DEPRECATED:
                 deprecated();
                 exit(EXIT_SUCCESS);
@@ -598,6 +1001,10 @@ parse_arg(int argc, char **argv, struct cli_state *state)
             state->parameters.alg = FREESASA_LEE_RICHARDS;
             ++alg_set;
             break;
+        case 'G':
+            state->parameters.alg = FREESASA_GAUSS_BONNET;
+            ++alg_set;
+            break;
         case 'p':
             state->parameters.probe_radius = atof(optarg);
             if (state->parameters.probe_radius <= 0)
@@ -665,6 +1072,15 @@ parse_arg(int argc, char **argv, struct cli_state *state)
     }
     if (state->output == NULL) state->output = stdout;
     if (alg_set > 1) abort_msg("multiple algorithms specified");
+    if ((state->parameters.target_atom_error > 0 || state->parameters.target_total_error > 0) &&
+        (state->parameters.alg == FREESASA_GAUSS_BONNET || state->parameters.alg == FREESASA_LCPO))
+        abort_msg("target errors can only be used with L&R and S&R");
+    if (state->dots && state->parameters.alg != FREESASA_SHRAKE_RUPLEY)
+        abort_msg("surface dots can only be calculated with S&R");
+    if (state->read_biomt && state->operators)
+        abort_msg("the options --biomt and --symmetry-file can't be combined");
+    if (state->periodic && (state->read_biomt || state->operators))
+        abort_msg("the option --periodic can't be combined with --biomt or --symmetry-file");
     if (state->output_format == 0) state->output_format = FREESASA_LOG;
     if (opt_set['m'] && opt_set['M']) abort_msg("the options -m and -M can't be combined");
     if (opt_set['g'] && opt_set['C']) abort_msg("the options -g and -C can't be combined");
@@ -677,7 +1093,18 @@ parse_arg(int argc, char **argv, struct cli_state *state)
     if (state->output_format == FREESASA_RSA && (opt_set['C'] || opt_set['M']))
         abort_msg("the RSA format can not be used with the options -C or -M, "
                   "it does not support several results in one file");
-    if (state->output_format & FREESASA_LOG) {
+    /* coordinates and radii are read as they are, and the output is
+       only the area of each atom */
+    if (state->xyzr &&
+        (opt_set['c'] || opt_set['O'] || state->static_classifier ||
+         opt_set['H'] || opt_set['Y'] || opt_set['C'] || opt_set['M'] ||
+         opt_set['m'] || opt_set['g'] || opt_set['f'] || opt_set['d'] ||
+         state->n_select > 0 || state->structure_options ||
+         state->read_biomt || state->periodic || state->stream ||
+         state->output_format != FREESASA_LOG))
+        abort_msg("the option --xyzr can only be combined with options "
+                  "for the calculation, --symmetry-file, --surface-dots and --output");
+    if ((state->output_format & FREESASA_LOG) && !state->xyzr) {
         fprintf(state->output, "## %s ##\n", PACKAGE_STRING);
     }
 
@@ -702,19 +1129,28 @@ main(int argc,
     if (argc > optind) {
         for (i = optind; i < argc; ++i) {
             input = fopen_werr(argv[i], "r");
-            tmp = run_analysis(input, argv[i], &state);
-            freesasa_tree_join(tree, &tmp);
+            if (state.xyzr) {
+                run_xyzr(input, argv[i], &state);
+            } else {
+                tmp = run_analysis(input, argv[i], &state);
+                freesasa_tree_join(tree, &tmp);
+            }
             fclose(input);
         }
     } else {
         if (!isatty(STDIN_FILENO)) {
-            tmp = run_analysis(stdin, "stdin", &state);
-            freesasa_tree_join(tree, &tmp);
+            if (state.xyzr) {
+                run_xyzr(stdin, "stdin", &state);
+            } else {
+                tmp = run_analysis(stdin, "stdin", &state);
+                freesasa_tree_join(tree, &tmp);
+            }
         }
         else abort_msg("no input", program_name);
     }
 
-    freesasa_tree_export(state.output, tree, state.output_format | state.output_depth | (state.no_rel ? FREESASA_OUTPUT_SKIP_REL : 0));
+    if (!state.xyzr)
+        freesasa_tree_export(state.output, tree, state.output_format | state.output_depth | (state.no_rel ? FREESASA_OUTPUT_SKIP_REL : 0));
     freesasa_node_free(tree);
 
     release_state(&state);
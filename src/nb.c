@@ -14,14 +14,14 @@
 
 typedef struct cell cell;
 struct cell {
-    cell *nb[17]; /** includes self, only forward neighbors */
+    cell *nb[14]; /** includes self, only forward neighbors */
     int *atom;    /** indices of the atoms/coordinates in a cell */
     int n_nb;     /** number of neighbors to cell */
     int n_atoms;  /** number of atoms in cell */
 };
 
-static cell empty_cell = {{NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,
-                           NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL},
+static cell empty_cell = {{NULL,NULL,NULL,NULL,NULL,NULL,NULL,
+                           NULL,NULL,NULL,NULL,NULL,NULL,NULL},
                           NULL, 0, 0};
 
 /** cell lists, divide space into boxes */
@@ -98,10 +98,12 @@ fill_nb(cell_list *c,
     for (i = xmin; i <= xmax; ++i) {
         for (j = ymin; j <= ymax; ++j) {
             for (k = zmin; k <= zmax; ++k) {
-                /* Scalar product between (i-ix,j-iy,k-iz) and (1,1,1) should
-                   be non-negative. Using only forward neighbors means
-                   there's no double counting when comparing cells */
-                if (i-ix+j-iy+k-iz >= 0) {
+                /* Only forward neighbors, i.e. the offset (i-ix,j-iy,k-iz)
+                   is lexicographically non-negative, taking z first.
+                   Exactly one of each pair of opposite offsets is
+                   included, which means there's no double counting
+                   when comparing cells */
+                if (k > iz || (k == iz && (j > iy || (j == iy && i >= ix)))) {
                     cell->nb[n] = &c->cell[cell_index(c,i,j,k)];
                     ++n;
                 }
@@ -245,11 +247,11 @@ max_array(const double *a,
 }
 
 /**
-    Allocate memory for ::nb_list object. Tries to free everything
-    and returns NULL if malloc somewhere along the way.
+    Allocate an ::nb_list object without memory for the neighbors of
+    the elements (capacity 0, grown by chunk_up()).
  */
 static nb_list*
-freesasa_nb_alloc(int n)
+nb_alloc_index(int n)
 {
     int i;
     nb_list *nb;
@@ -265,19 +267,20 @@ freesasa_nb_alloc(int n)
     nb->nn = NULL;
     nb->nb = NULL;
     nb->capacity = NULL;
-    nb->xyd = nb->xd = nb->yd = NULL;
+    nb->xyd = nb->xd = nb->yd = nb->zd = NULL;
 
     nb->nn = malloc(sizeof(int)*n);
     nb->nb = malloc(sizeof(int *)*n);
     nb->xyd = malloc(sizeof(double *)*n);
     nb->xd = malloc(sizeof(double *)*n);
     nb->yd = malloc(sizeof(double *)*n);
+    nb->zd = malloc(sizeof(double *)*n);
     nb->capacity = malloc(sizeof(int)*n);
 
-    if (!nb->nn || !nb->nb || !nb->xyd ||
-        !nb->xd || !nb->yd || !nb->capacity) {
+    if (!nb->nn || !nb->nb || !nb->xyd || !nb->xd ||
+        !nb->yd || !nb->zd || !nb->capacity) {
         free(nb->nn); free(nb->nb); free(nb->xyd);
-        free(nb->xd); free(nb->yd); free(nb->capacity);
+        free(nb->xd); free(nb->yd); free(nb->zd); free(nb->capacity);
         free(nb);
         mem_fail();
         return NULL;
@@ -285,17 +288,35 @@ freesasa_nb_alloc(int n)
 
     for (i = 0; i < n; ++i) {
         nb->nn[i] = 0;
-        nb->capacity[i] = FREESASA_NB_CHUNK;
+        nb->capacity[i] = 0;
         /* again prepare for a potential cleanup */
         nb->nb[i] = NULL;
-        nb->xyd[i] = nb->xd[i] = nb->yd[i] = NULL;
+        nb->xyd[i] = nb->xd[i] = nb->yd[i] = nb->zd[i] = NULL;
     }
+
+    return nb;
+}
+
+/**
+    Allocate memory for ::nb_list object. Tries to free everything
+    and returns NULL if malloc somewhere along the way.
+ */
+nb_list*
+freesasa_nb_alloc(int n)
+{
+    int i;
+    nb_list *nb = nb_alloc_index(n);
+
+    if (nb == NULL) return NULL;
+
     for (i = 0; i < n; ++i) {
+        nb->capacity[i] = FREESASA_NB_CHUNK;
         nb->nb[i] = malloc(sizeof(int)*FREESASA_NB_CHUNK);
         nb->xyd[i] = malloc(sizeof(double)*FREESASA_NB_CHUNK);
         nb->xd[i] = malloc(sizeof(double)*FREESASA_NB_CHUNK);
         nb->yd[i] = malloc(sizeof(double)*FREESASA_NB_CHUNK);
-        if (!nb->nb[i] || !nb->xyd[i] || !nb->xd[i] || !nb->yd[i]) {
+        nb->zd[i] = malloc(sizeof(double)*FREESASA_NB_CHUNK);
+        if (!nb->nb[i] || !nb->xyd[i] || !nb->xd[i] || !nb->yd[i] || !nb->zd[i]) {
             freesasa_nb_free(nb);
             mem_fail();
             return NULL;
@@ -304,6 +325,12 @@ freesasa_nb_alloc(int n)
     return nb;
 }
 
+nb_list*
+freesasa_nb_alloc_empty(int n)
+{
+    return nb_alloc_index(n);
+}
+
 void
 freesasa_nb_free(nb_list *nb)
 {
@@ -315,12 +342,14 @@ freesasa_nb_free(nb_list *nb)
         if (nb->xyd) for (i = 0; i < n; ++i) free(nb->xyd[i]);
         if (nb->xd)  for (i = 0; i < n; ++i) free(nb->xd[i]);
         if (nb->yd)  for (i = 0; i < n; ++i) free(nb->yd[i]);
+        if (nb->zd)  for (i = 0; i < n; ++i) free(nb->zd[i]);
         free(nb->nb);
         free(nb->nn);
         free(nb->capacity);
         free(nb->xyd);
         free(nb->xd);
         free(nb->yd);
+        free(nb->zd);
         free(nb);
     }
 }
@@ -335,7 +364,7 @@ chunk_up(nb_list *nb_list,
 {
     int nni = nb_list->nn[i];
     int **nbi, *nbi_b, new_cap;
-    double **xydi, **xdi, **ydi, *xydi_b, *xdi_b, *ydi_b;
+    double **xydi, **xdi, **ydi, **zdi, *xydi_b, *xdi_b, *ydi_b, *zdi_b;
 
     if (nni > nb_list->capacity[i]) {
         nbi = &nb_list->nb[i];
@@ -343,7 +372,8 @@ chunk_up(nb_list *nb_list,
         xydi = &nb_list->xyd[i];
         xdi = &nb_list->xd[i];
         ydi = &nb_list->yd[i];
-        xydi_b = *xydi; xdi_b = *xdi; ydi_b = *ydi;
+        zdi = &nb_list->zd[i];
+        xydi_b = *xydi; xdi_b = *xdi; ydi_b = *ydi; zdi_b = *zdi;
         new_cap = (nb_list->capacity[i] += FREESASA_NB_CHUNK);
 
         *nbi = realloc(*nbi,sizeof(int)*new_cap);
@@ -357,6 +387,9 @@ chunk_up(nb_list *nb_list,
 
         *ydi = realloc(*ydi,sizeof(double)*new_cap);
         if (*ydi == NULL)  { nb_list->yd[i]  = ydi_b;  return mem_fail(); }
+
+        *zdi = realloc(*zdi,sizeof(double)*new_cap);
+        if (*zdi == NULL)  { nb_list->zd[i]  = zdi_b;  return mem_fail(); }
     }
     return FREESASA_SUCCESS;
 }
@@ -374,7 +407,8 @@ nb_add_pair(nb_list *nb_list,
             int i,
             int j,
             double dx,
-            double dy)
+            double dy,
+            double dz)
 {
     int ** nb;
     int * nn = nb_list->nn;
@@ -382,6 +416,7 @@ nb_add_pair(nb_list *nb_list,
     double ** xyd;
     double ** xd;
     double ** yd;
+    double ** zd;
     double d;
 
     assert(i != j);
@@ -396,6 +431,7 @@ nb_add_pair(nb_list *nb_list,
     xyd = nb_list->xyd;
     xd = nb_list->xd;
     yd = nb_list->yd;
+    zd = nb_list->zd;
 
     nb[i][nni] = j;
     nb[j][nnj] = i;
@@ -409,6 +445,8 @@ nb_add_pair(nb_list *nb_list,
     xd[j][nnj] = -dx;
     yd[i][nni] = dy;
     yd[j][nnj] = -dy;
+    zd[i][nni] = dz;
+    zd[j][nnj] = -dz;
 
     return FREESASA_SUCCESS;
 }
@@ -444,7 +482,7 @@ nb_calc_cell_pair(nb_list *nb_list,
             cut2 = (ri+rj)*(ri+rj);
             dx = xj-xi; dy = yj-yi; dz = zj-zi;
             if (dx*dx + dy*dy + dz*dz < cut2) {
-                if (nb_add_pair(nb_list,ia,ja,dx,dy))
+                if (nb_add_pair(nb_list,ia,ja,dx,dy,dz))
                     return mem_fail();
             }
         }
@@ -476,6 +514,212 @@ nb_fill_list(nb_list *nb_list,
     return FREESASA_SUCCESS;
 }
 
+/**
+    Cell lists for periodic coordinates. The box is divided into cells
+    along the box vectors, i.e. in fractional coordinates, the atoms
+    are sorted by cell and their coordinates wrapped into the box.
+ */
+typedef struct periodic_cells {
+    int n[3];    /** number of cells along each box vector */
+    int *first;  /** the atoms of cell c are atom[first[c]] to atom[first[c+1]-1] */
+    int *atom;   /** atom indices, sorted by cell */
+    double *xyz; /** coordinates wrapped into the box */
+} periodic_cells;
+
+static inline void
+cross(double *u,
+      const double *v,
+      const double *w)
+{
+    u[0] = v[1]*w[2] - v[2]*w[1];
+    u[1] = v[2]*w[0] - v[0]*w[2];
+    u[2] = v[0]*w[1] - v[1]*w[0];
+}
+
+static inline double
+dot(const double *v,
+    const double *w)
+{
+    return v[0]*w[0] + v[1]*w[1] + v[2]*w[2];
+}
+
+static void
+periodic_cells_free(periodic_cells *pc)
+{
+    free(pc->first);
+    free(pc->atom);
+    free(pc->xyz);
+}
+
+/**
+    Sorts the atoms into cells. The number of cells along each box
+    vector is chosen so that the distance between the cell faces is at
+    least cell_size. There have to be at least 3 cells in each
+    direction, for the neighbors of a cell to be distinct cells.
+ */
+static int
+periodic_cells_init(periodic_cells *pc,
+                    const coord_t *coord,
+                    const double *box,
+                    double cell_size)
+{
+    const int n = freesasa_coord_n(coord);
+    const double *v = freesasa_coord_all(coord);
+    double recip[9], volume, s, width;
+    int *cell_of = NULL, i, k, ic, idx[3], n_cells;
+
+    pc->first = pc->atom = NULL;
+    pc->xyz = NULL;
+
+    /* reciprocal vectors, fractional coordinate k of r is r . recip_k */
+    cross(recip, box + 3, box + 6);
+    cross(recip + 3, box + 6, box);
+    cross(recip + 6, box, box + 3);
+    volume = dot(box, recip);
+    for (k = 0; k < 9; ++k) recip[k] /= volume;
+
+    for (k = 0; k < 3; ++k) {
+        /* distance between the lattice planes not containing box vector k */
+        width = 1 / sqrt(dot(recip + 3*k, recip + 3*k));
+        pc->n[k] = (int) floor(width / cell_size);
+        if (pc->n[k] < 3) {
+            return fail_msg("periodic box is too small, it has to be at least "
+                            "%.2f Å wide in each direction", 3*cell_size);
+        }
+    }
+    n_cells = pc->n[0] * pc->n[1] * pc->n[2];
+
+    pc->first = calloc(n_cells + 1, sizeof(int));
+    pc->atom = malloc(sizeof(int) * n);
+    pc->xyz = malloc(sizeof(double) * 3 * n);
+    cell_of = malloc(sizeof(int) * n);
+    if (!pc->first || !pc->atom || !pc->xyz || !cell_of) {
+        free(cell_of);
+        periodic_cells_free(pc);
+        return mem_fail();
+    }
+
+    for (i = 0; i < n; ++i) {
+        for (k = 0; k < 3; ++k) pc->xyz[3*i+k] = v[3*i+k];
+        for (k = 0; k < 3; ++k) {
+            s = dot(v + 3*i, recip + 3*k);
+            if (s < 0 || s >= 1) {
+                s = floor(s);
+                pc->xyz[3*i]   -= s * box[3*k];
+                pc->xyz[3*i+1] -= s * box[3*k+1];
+                pc->xyz[3*i+2] -= s * box[3*k+2];
+            }
+        }
+        for (k = 0; k < 3; ++k) {
+            s = dot(pc->xyz + 3*i, recip + 3*k);
+            idx[k] = (int) (s * pc->n[k]);
+            /* rounding errors at the faces */
+            if (idx[k] < 0) idx[k] = 0;
+            if (idx[k] >= pc->n[k]) idx[k] = pc->n[k] - 1;
+        }
+        cell_of[i] = idx[0] + pc->n[0]*(idx[1] + pc->n[1]*idx[2]);
+        ++pc->first[cell_of[i] + 1];
+    }
+
+    /* counting sort */
+    for (ic = 0; ic < n_cells; ++ic) pc->first[ic+1] += pc->first[ic];
+    for (i = 0; i < n; ++i) pc->atom[pc->first[cell_of[i]]++] = i;
+    for (ic = n_cells; ic > 0; --ic) pc->first[ic] = pc->first[ic-1];
+    pc->first[0] = 0;
+
+    free(cell_of);
+
+    return FREESASA_SUCCESS;
+}
+
+/**
+    Fills the nb list for all contacts between atoms in the cells ci
+    and cj, where the atoms in cj are translated by shift.
+ */
+static int
+nb_calc_periodic_pair(nb_list *nb_list,
+                      const periodic_cells *pc,
+                      const double *radii,
+                      int ci,
+                      int cj,
+                      const double *shift)
+{
+    const double * restrict v = pc->xyz;
+    double ri, rj, xi, yi, zi, dx, dy, dz, cut2;
+    int i, j, ia, ja;
+
+    for (i = pc->first[ci]; i < pc->first[ci+1]; ++i) {
+        ia = pc->atom[i];
+        ri = radii[ia];
+        xi = v[ia*3] - shift[0]; yi = v[ia*3+1] - shift[1]; zi = v[ia*3+2] - shift[2];
+        j = ci == cj ? i + 1 : pc->first[cj];
+        for (; j < pc->first[cj+1]; ++j) {
+            ja = pc->atom[j];
+            rj = radii[ja];
+            cut2 = (ri+rj)*(ri+rj);
+            dx = v[ja*3]-xi; dy = v[ja*3+1]-yi; dz = v[ja*3+2]-zi;
+            if (dx*dx + dy*dy + dz*dz < cut2) {
+                if (nb_add_pair(nb_list,ia,ja,dx,dy,dz))
+                    return mem_fail();
+            }
+        }
+    }
+    return FREESASA_SUCCESS;
+}
+
+/**
+    Fills the nb list for periodic coordinates. As for open boundaries
+    only forward neighbors of each cell are compared, when the
+    neighbor is on the other side of the box its atoms are shifted by
+    a box vector.
+ */
+static int
+nb_fill_periodic(nb_list *nb_list,
+                 const coord_t *coord,
+                 const double *radii,
+                 double cell_size)
+{
+    const double *box = freesasa_coord_periodic(coord);
+    periodic_cells pc;
+    double shift[3];
+    int ix, iy, iz, ox, oy, oz, j[3], w[3], k, ci, cj, ret = FREESASA_SUCCESS;
+
+    if (periodic_cells_init(&pc, coord, box, cell_size)) return fail_msg("");
+
+    for (iz = 0; iz < pc.n[2]; ++iz) {
+        for (iy = 0; iy < pc.n[1]; ++iy) {
+            for (ix = 0; ix < pc.n[0]; ++ix) {
+                ci = ix + pc.n[0]*(iy + pc.n[1]*iz);
+                for (oz = 0; oz <= 1; ++oz) {
+                    for (oy = -1; oy <= 1; ++oy) {
+                        for (ox = -1; ox <= 1; ++ox) {
+                            /* same half-space as fill_nb() */
+                            if (oz == 0 && (oy < 0 || (oy == 0 && ox < 0))) continue;
+                            j[0] = ix + ox; j[1] = iy + oy; j[2] = iz + oz;
+                            for (k = 0; k < 3; ++k) {
+                                w[k] = j[k] < 0 ? -1 : (j[k] >= pc.n[k] ? 1 : 0);
+                                j[k] -= w[k] * pc.n[k];
+                            }
+                            for (k = 0; k < 3; ++k) {
+                                shift[k] = w[0]*box[k] + w[1]*box[3+k] + w[2]*box[6+k];
+                            }
+                            cj = j[0] + pc.n[0]*(j[1] + pc.n[1]*j[2]);
+                            if (nb_calc_periodic_pair(nb_list, &pc, radii, ci, cj, shift)) {
+                                ret = mem_fail();
+                                goto cleanup;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+ cleanup:
+    periodic_cells_free(&pc);
+    return ret;
+}
+
 nb_list*
 freesasa_nb_new(const coord_t *coord,
                 const double *radii)
@@ -497,6 +741,16 @@ freesasa_nb_new(const coord_t *coord,
 
     cell_size = 2*max_array(radii,n);
     assert(cell_size > 0);
+
+    if (freesasa_coord_periodic(coord)) {
+        if (nb_fill_periodic(nb, coord, radii, cell_size)) {
+            fail_msg("");
+            freesasa_nb_free(nb);
+            nb = NULL;
+        }
+        return nb;
+    }
+
     c = cell_list_new(cell_size,coord);
     if (c == NULL ||
         nb_fill_list(nb,c,coord,radii)) {
@@ -511,6 +765,153 @@ freesasa_nb_new(const coord_t *coord,
     return nb;
 }
 
+nb_cells *
+freesasa_nb_cells_new(const coord_t *coord,
+                      const double *radii)
+{
+    const int n = freesasa_coord_n(coord);
+    double cell_size;
+
+    assert(coord);
+    assert(radii);
+    assert(n > 0);
+    assert(freesasa_coord_periodic(coord) == NULL);
+
+    cell_size = 2*max_array(radii, n);
+    assert(cell_size > 0);
+
+    return cell_list_new(cell_size, coord);
+}
+
+void
+freesasa_nb_cells_free(nb_cells *cells)
+{
+    cell_list_free(cells);
+}
+
+static int
+compare_int(const void *a,
+            const void *b)
+{
+    return *(const int *) a - *(const int *) b;
+}
+
+void
+freesasa_nb_cells_order(const nb_cells *cells,
+                        int n,
+                        int n_blocks,
+                        int *order)
+{
+    const cell *ci;
+    int ic, ia, b, k = 0, block_size;
+
+    assert(cells);
+    assert(order);
+    assert(n_blocks > 0 && n_blocks <= n);
+
+    for (ic = 0; ic < cells->n; ++ic) {
+        ci = &cells->cell[ic];
+        for (ia = 0; ia < ci->n_atoms; ++ia) {
+            if (ci->atom[ia] < n) order[k++] = ci->atom[ia];
+        }
+    }
+    assert(k == n);
+
+    /* sorted blocks give monotonous access to per-atom arrays */
+    block_size = n / n_blocks;
+    for (b = 0; b < n_blocks; ++b) {
+        k = (b == n_blocks - 1) ? n - b*block_size : block_size;
+        qsort(order + b*block_size, k, sizeof(int), compare_int);
+    }
+}
+
+int
+freesasa_nb_fill_atom(nb_list *nb,
+                      const nb_cells *cells,
+                      const coord_t *coord,
+                      const double *radii,
+                      int i)
+{
+    const double * restrict v = freesasa_coord_all(coord);
+    const double xi = v[3*i], yi = v[3*i+1], zi = v[3*i+2], ri = radii[i];
+    const cell *cj;
+    double dx, dy, dz, cut2;
+    int ix, iy, iz, jx, jy, jz, j, ja, nni;
+
+    assert(nb);
+    assert(cells);
+    assert(i >= 0 && i < nb->n);
+
+    ix = (int)((xi - cells->x_min)/cells->d);
+    iy = (int)((yi - cells->y_min)/cells->d);
+    iz = (int)((zi - cells->z_min)/cells->d);
+
+    nb->nn[i] = 0;
+
+    /* all 27 cells around the atom, since only the list of atom i is
+       filled, the pairs are not added symmetrically */
+    for (jz = iz - 1; jz <= iz + 1; ++jz) {
+        if (jz < 0 || jz >= cells->nz) continue;
+        for (jy = iy - 1; jy <= iy + 1; ++jy) {
+            if (jy < 0 || jy >= cells->ny) continue;
+            for (jx = ix - 1; jx <= ix + 1; ++jx) {
+                if (jx < 0 || jx >= cells->nx) continue;
+                cj = &cells->cell[cell_index(cells, jx, jy, jz)];
+                for (j = 0; j < cj->n_atoms; ++j) {
+                    ja = cj->atom[j];
+                    if (ja == i) continue;
+                    dx = v[3*ja] - xi; dy = v[3*ja+1] - yi; dz = v[3*ja+2] - zi;
+                    cut2 = (ri + radii[ja])*(ri + radii[ja]);
+                    if (dx*dx + dy*dy + dz*dz < cut2) {
+                        nni = nb->nn[i]++;
+                        if (chunk_up(nb, i)) return mem_fail();
+                        nb->nb[i][nni] = ja;
+                        nb->xyd[i][nni] = sqrt(dx*dx + dy*dy);
+                        nb->xd[i][nni] = dx;
+                        nb->yd[i][nni] = dy;
+                        nb->zd[i][nni] = dz;
+                    }
+                }
+            }
+        }
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+int
+freesasa_nb_refill(nb_list *nb,
+                   const coord_t *coord,
+                   const double *radii)
+{
+    const int n = freesasa_coord_n(coord);
+    const double * restrict v = freesasa_coord_all(coord);
+    double ri, dx, dy, dz, cut;
+    int i, j;
+
+    assert(nb);
+    assert(radii);
+    assert(n <= nb->n);
+    assert(freesasa_coord_periodic(coord) == NULL);
+
+    for (i = 0; i < nb->n; ++i) nb->nn[i] = 0;
+
+    for (i = 0; i < n; ++i) {
+        ri = radii[i];
+        for (j = i+1; j < n; ++j) {
+            cut = ri + radii[j];
+            dx = v[3*j]   - v[3*i];
+            dy = v[3*j+1] - v[3*i+1];
+            dz = v[3*j+2] - v[3*i+2];
+            if (dx*dx + dy*dy + dz*dz < cut*cut) {
+                if (nb_add_pair(nb, i, j, dx, dy, dz))
+                    return mem_fail();
+            }
+        }
+    }
+    return FREESASA_SUCCESS;
+}
+
 int
 freesasa_nb_contact(const nb_list *nb,
                     int i,
@@ -576,7 +977,7 @@ START_TEST (test_cell) {
         ck_assert(ci.n_atoms >= 0);
         if (ci.n_atoms > 0) ck_assert(ci.atom != NULL);
         ck_assert_int_ge(ci.n_nb, 1);
-        ck_assert_int_le(ci.n_nb, 17);
+        ck_assert_int_le(ci.n_nb, 14);
         na += ci.n_atoms;
     }
     ck_assert_int_eq(na,n_atoms);
@@ -585,11 +986,43 @@ START_TEST (test_cell) {
 }
 END_TEST
 
+/* each contact should be listed exactly once, whatever the cells */
+START_TEST (test_no_duplicates)
+{
+    enum {N = 300};
+    double v[3*N], r[N], dx, dy, dz;
+    coord_t *coord;
+    nb_list *nb;
+    int i, j, n_contacts;
+
+    srand(1);
+    for (i = 0; i < 3*N; ++i) v[i] = 20.0 * rand() / RAND_MAX;
+    for (i = 0; i < N; ++i) r[i] = 1 + 1.0 * rand() / RAND_MAX;
+
+    coord = freesasa_coord_new_linked(v, N);
+    nb = freesasa_nb_new(coord, r);
+    ck_assert(nb != NULL);
+
+    for (i = 0; i < N; ++i) {
+        n_contacts = 0;
+        for (j = 0; j < N; ++j) {
+            dx = v[3*j] - v[3*i]; dy = v[3*j+1] - v[3*i+1]; dz = v[3*j+2] - v[3*i+2];
+            if (i != j && dx*dx + dy*dy + dz*dz < (r[i]+r[j])*(r[i]+r[j])) ++n_contacts;
+        }
+        ck_assert_int_eq(nb->nn[i], n_contacts);
+    }
+
+    freesasa_nb_free(nb);
+    freesasa_coord_free(coord);
+}
+END_TEST
+
 TCase *
 test_nb_static()
 {
     TCase *tc = tcase_create("nb.c static");
     tcase_add_test(tc, test_cell);
+    tcase_add_test(tc, test_no_duplicates);
 
     return tc;
 }
@@ -21,6 +21,7 @@ typedef struct {
     double **xyd;  /**< distance between neighbors in xy-plane */
     double **xd;   /**< signed distance between neighbors along x-axis */
     double **yd;   /**< signed distance between neighbors along y-axis */
+    double **zd;   /**< signed distance between neighbors along z-axis */
     int *capacity; /**< keeps track of memory chunks (don't change this) */
 } nb_list;
 
@@ -33,6 +34,14 @@ typedef struct {
     using this list the members of the returned struct should be used
     directly and not freesasa_nb_contact().
 
+    If the coordinates are periodic (see freesasa_coord_set_periodic())
+    the distances are between the closest periodic images, the
+    positions of the neighbors relative to each atom should therefore
+    be taken from the signed distances `xd`, `yd` and `zd` and not
+    from the coordinates. The box has to be at least three times as
+    wide as the largest contact distance in all directions, so that
+    each pair of atoms is in contact through at most one image.
+
     @param coord a set of coordinates
     @param radii radii for the coordinates
     @return a neigbor list. Returns NULL if either argument is null or
@@ -43,6 +52,124 @@ nb_list *
 freesasa_nb_new(const coord_t *coord,
                 const double *radii);
 
+/**
+    Allocates an empty neighbor list with space for n elements.
+
+    Can be filled with freesasa_nb_refill(). Should be freed with
+    freesasa_nb_free().
+
+    @param n Number of elements (> 0).
+    @return The list, NULL if memory allocation failed.
+ */
+nb_list *
+freesasa_nb_alloc(int n);
+
+/**
+    Allocates a neighbor list with space for n elements, but no
+    memory for the neighbors of each element.
+
+    To be filled element by element with freesasa_nb_fill_atom(),
+    which allocates the memory for the neighbors of each element in
+    the calling thread. Should be freed with freesasa_nb_free().
+
+    @param n Number of elements (> 0).
+    @return The list, NULL if memory allocation failed.
+ */
+nb_list *
+freesasa_nb_alloc_empty(int n);
+
+/** Cell lists used to find neighbors (opaque) */
+typedef struct cell_list nb_cells;
+
+/**
+    Sorts a set of coordinates into cells, for
+    freesasa_nb_fill_atom() and freesasa_nb_cells_order().
+
+    The cells are as in freesasa_nb_new(), periodic coordinates are
+    not supported.
+
+    @param coord a set of coordinates
+    @param radii radii for the coordinates
+    @return The cells, NULL if memory allocation failed. Should be
+      freed with freesasa_nb_cells_free().
+ */
+nb_cells *
+freesasa_nb_cells_new(const coord_t *coord,
+                      const double *radii);
+
+/**
+    Frees cells created by freesasa_nb_cells_new().
+
+    @param cells The cells, can be NULL.
+ */
+void
+freesasa_nb_cells_free(nb_cells *cells);
+
+/**
+    Partitions the first n coordinates into spatially compact blocks.
+
+    The coordinates are ordered by the cell they are in, along x, then
+    y, then z, and split into n_blocks blocks of n/n_blocks
+    coordinates (the last block gets the remainder). Each block is a
+    slab of cells, and is sorted by index.
+
+    @param cells The cells
+    @param n The number of coordinates to order, the coordinates
+      0..n-1 are included.
+    @param n_blocks The number of blocks, 0 < n_blocks <= n.
+    @param order Output, array of size n
+ */
+void
+freesasa_nb_cells_order(const nb_cells *cells,
+                        int n,
+                        int n_blocks,
+                        int *order);
+
+/**
+    Fills the neighbors of element i in a neighbor list.
+
+    Only the list of element i is changed, so different elements can
+    be filled concurrently from different threads. The neighbors are
+    the same as with freesasa_nb_new(), but can be in a different
+    order.
+
+    @param nb A neighbor list from freesasa_nb_alloc_empty().
+    @param cells Cells created for the same coordinates and radii.
+    @param coord The coordinates
+    @param radii The radii
+    @param i The element
+    @return ::FREESASA_SUCCESS, or ::FREESASA_FAIL if memory
+      allocation failed.
+ */
+int
+freesasa_nb_fill_atom(nb_list *nb,
+                      const nb_cells *cells,
+                      const coord_t *coord,
+                      const double *radii,
+                      int i);
+
+/**
+    Recalculates a neighbor list for a new set of coordinates,
+    reusing the memory of the list.
+
+    Compares all pairs of coordinates instead of using cell lists,
+    and is intended for small sets of coordinates, where this is
+    faster. Once the arrays of the list have grown large enough, no
+    memory is allocated.
+
+    @param nb A neighbor list created by freesasa_nb_alloc() or
+      freesasa_nb_new().
+    @param coord a set of coordinates, not more than the number of
+      elements the list was created for.
+    @param radii radii for the coordinates
+    @return ::FREESASA_SUCCESS, or ::FREESASA_FAIL if memory
+      allocation failed.
+ */
+int
+freesasa_nb_refill(nb_list *nb,
+                   const coord_t *coord,
+                   const double *radii);
+
 /**
     Frees a neigbor list created by freesasa_nb_new().
 
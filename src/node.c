@@ -9,6 +9,12 @@
 #include "freesasa_internal.h"
 #include "classifier.h"
 
+/* smallest number of atoms per thread when the residues of a
+   structure are generated in parallel */
+#ifndef NODE_MIN_BLOCK_ATOMS
+#define NODE_MIN_BLOCK_ATOMS 256
+#endif
+
 struct atom_properties {
     int is_polar;
     int is_bb;
@@ -300,21 +306,20 @@ node_residue(const freesasa_structure *structure,
     return NULL;
 }
 
+/** A chain node without children, first_residue and last_residue
+    are set to the residues of the chain */
 static freesasa_node *
-node_chain(const freesasa_structure *structure,
-                  const freesasa_result *result,
-                  int chain_index)
+node_chain_new(const freesasa_structure *structure,
+               int chain_index,
+               int *first_residue,
+               int *last_residue)
 {
     const char *chains = freesasa_structure_chain_labels(structure);
     char name[2] = {chains[chain_index], '\0'};
     freesasa_node *chain = NULL;
-    int first_atom, last_atom, first_residue, last_residue;
 
     assert(strlen(chains) > chain_index);
 
-    freesasa_structure_chain_atoms(structure, chains[chain_index],
-                                   &first_atom, &last_atom);
-
     chain = node_new(name);
     if (chain == NULL) {
         fail_msg("");
@@ -323,8 +328,25 @@ node_chain(const freesasa_structure *structure,
 
     chain->type = FREESASA_NODE_CHAIN;
     freesasa_structure_chain_residues(structure, name[0],
-                                      &first_residue, &last_residue);
-    chain->properties.chain.n_residues = last_residue - first_residue + 1;
+                                      first_residue, last_residue);
+    chain->properties.chain.n_residues = *last_residue - *first_residue + 1;
+
+    return chain;
+}
+
+static freesasa_node *
+node_chain(const freesasa_structure *structure,
+                  const freesasa_result *result,
+                  int chain_index)
+{
+    freesasa_node *chain = NULL;
+    int first_residue, last_residue;
+
+    chain = node_chain_new(structure, chain_index, &first_residue, &last_residue);
+    if (chain == NULL) {
+        fail_msg("");
+        return NULL;
+    }
 
     if (node_gen_children(chain, structure, result,
                           first_residue, last_residue,
@@ -337,12 +359,127 @@ node_chain(const freesasa_structure *structure,
     return chain;
 }
 
+/* a block of consecutive residues generated by one thread */
+struct residue_block {
+    const freesasa_structure *structure;
+    const freesasa_result *result;
+    freesasa_node **residue; /* array of all residues of the structure */
+    int first, last;
+    int status;
+};
+
+static void
+residue_block_gen(void *arg)
+{
+    struct residue_block *block = (struct residue_block *) arg;
+    int i;
+
+    block->status = FREESASA_SUCCESS;
+    for (i = block->first; i <= block->last; ++i) {
+        block->residue[i] = node_residue(block->structure, block->result, i);
+        if (block->residue[i] == NULL) {
+            block->status = fail_msg("");
+            break;
+        }
+    }
+}
+
+/** Generate the chains of a structure, with the residues (including
+    their atoms and areas) generated in parallel by n_blocks threads,
+    each with a block of consecutive residues with roughly the same
+    number of atoms. The chains are then assembled in order. */
+static int
+node_gen_chains_parallel(freesasa_node *node,
+                         const freesasa_structure *structure,
+                         const freesasa_result *result,
+                         int n_blocks)
+{
+    const int n_residues = freesasa_structure_n_residues(structure),
+        n_chains = freesasa_structure_n_chains(structure),
+        n_atoms = freesasa_structure_n(structure);
+    struct residue_block *block = malloc(sizeof(struct residue_block) * n_blocks);
+    freesasa_node **residue = malloc(sizeof(freesasa_node *) * n_residues);
+    freesasa_node *chain = NULL, *last_chain = NULL;
+    int return_value = FREESASA_SUCCESS, b, c, r, first_atom, last_atom,
+        first_residue, last_residue;
+
+    if (block == NULL || residue == NULL) {
+        free(block);
+        free(residue);
+        return mem_fail();
+    }
+
+    for (r = 0; r < n_residues; ++r) residue[r] = NULL;
+
+    /* split by atom count, on residue boundaries */
+    for (b = 0, r = 0; b < n_blocks; ++b) {
+        block[b].structure = structure;
+        block[b].result = result;
+        block[b].residue = residue;
+        block[b].first = r;
+        if (b == n_blocks - 1) {
+            r = n_residues;
+        } else {
+            while (r < n_residues) {
+                freesasa_structure_residue_atoms(structure, r, &first_atom, &last_atom);
+                ++r;
+                if (last_atom + 1 >= (long) n_atoms * (b + 1) / n_blocks) break;
+            }
+        }
+        block[b].last = r - 1;
+    }
+
+    if (freesasa_run_parallel(residue_block_gen, block, sizeof(struct residue_block),
+                              n_blocks)) {
+        return_value = FREESASA_FAIL;
+    }
+    for (b = 0; b < n_blocks; ++b) {
+        if (block[b].status == FREESASA_FAIL) return_value = FREESASA_FAIL;
+    }
+
+    for (c = 0; c < n_chains && return_value == FREESASA_SUCCESS; ++c) {
+        chain = node_chain_new(structure, c, &first_residue, &last_residue);
+        if (chain == NULL) {
+            return_value = fail_msg("");
+            break;
+        }
+        chain->parent = node;
+        if (last_chain) last_chain->next = chain;
+        else node->children = chain;
+        last_chain = chain;
+
+        chain->children = residue[first_residue];
+        for (r = first_residue; r <= last_residue; ++r) {
+            residue[r]->parent = chain;
+            residue[r]->next = r < last_residue ? residue[r+1] : NULL;
+            residue[r] = NULL; /* owned by the chain */
+        }
+        if (node_add_area(chain, structure, result)) {
+            return_value = fail_msg("");
+        }
+    }
+
+    if (return_value == FREESASA_SUCCESS &&
+        node_add_area(node, structure, result)) {
+        return_value = fail_msg("");
+    }
+
+    /* residues that didn't make it into a chain */
+    for (r = 0; r < n_residues; ++r) node_free(residue[r]);
+    free(residue);
+    free(block);
+
+    return return_value;
+}
+
 static freesasa_node *
 node_structure(const freesasa_structure *structure,
                const freesasa_result *result,
                int dummy_index)
 {
     freesasa_node *node = NULL;
+    int n_blocks;
+
     node = node_new(freesasa_structure_chain_labels(structure));
 
     if (node == NULL) {
@@ -370,9 +507,20 @@ node_structure(const freesasa_structure *structure,
         goto cleanup;
     }
 
-    if (node_gen_children(node, structure, result, 0,
-                          freesasa_structure_n_chains(structure)-1,
-                          node_chain) == NULL) {
+    n_blocks = result->parameters.n_threads;
+    if (n_blocks > freesasa_structure_n(structure) / NODE_MIN_BLOCK_ATOMS)
+        n_blocks = freesasa_structure_n(structure) / NODE_MIN_BLOCK_ATOMS;
+    if (n_blocks > freesasa_structure_n_residues(structure))
+        n_blocks = freesasa_structure_n_residues(structure);
+
+    if (n_blocks > 1) {
+        if (node_gen_chains_parallel(node, structure, result, n_blocks)) {
+            fail_msg("");
+            goto cleanup;
+        }
+    } else if (node_gen_children(node, structure, result, 0,
+                                 freesasa_structure_n_chains(structure)-1,
+                                 node_chain) == NULL) {
         fail_msg("");
         goto cleanup;
     }
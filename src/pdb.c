@@ -9,6 +9,12 @@
 #include "freesasa_internal.h"
 #include "pdb.h"
 
+/* smallest number of atoms per thread when ATOM records are
+   formatted in parallel */
+#ifndef PDB_MIN_BLOCK_ATOMS
+#define PDB_MIN_BLOCK_ATOMS 256
+#endif
+
 /* len >= 6 */
 static inline int
 pdb_line_check(const char *line, size_t len)
@@ -147,6 +153,86 @@ freesasa_pdb_get_chains(FILE *pdb,
     return n_chains;
 }
 
+int
+freesasa_pdb_get_biomt(FILE *pdb,
+                       double **operators)
+{
+    char line[PDB_MAX_LINE_STRL];
+    double *ops = NULL, *opsb, r[4];
+    int n = 0, n_biomolecules = 0, next_row = 1, row, serial;
+
+    assert(pdb);
+    assert(operators);
+
+    *operators = NULL;
+
+    while (fgets(line, PDB_MAX_LINE_STRL, pdb) != NULL) {
+        if (strncmp("ATOM", line, 4) == 0 || strncmp("HETATM", line, 6) == 0 ||
+            strncmp("MODEL", line, 5) == 0)
+            break;
+        if (strncmp("REMARK 350", line, 10) != 0) continue;
+
+        if (strncmp(" BIOMOLECULE:", line + 10, 13) == 0) {
+            if (++n_biomolecules > 1) break;
+            continue;
+        }
+
+        if (sscanf(line + 10, " BIOMT%d %d %lf %lf %lf %lf",
+                   &row, &serial, &r[0], &r[1], &r[2], &r[3]) != 6)
+            continue;
+
+        if (row != next_row) {
+            free(ops);
+            return fail_msg("BIOMT records out of order in PDB input");
+        }
+        if (row == 1) {
+            ++n;
+            opsb = ops;
+            ops = realloc(ops, sizeof(double) * 12 * n);
+            if (ops == NULL) {
+                free(opsb);
+                return mem_fail();
+            }
+        }
+        memcpy(ops + 12*(n-1) + 4*(row-1), r, sizeof(double) * 4);
+        next_row = row % 3 + 1;
+    }
+
+    if (next_row != 1) {
+        free(ops);
+        return fail_msg("incomplete BIOMT record in PDB input");
+    }
+
+    *operators = ops;
+    return n;
+}
+
+int
+freesasa_pdb_get_cryst1(FILE *pdb,
+                        double *cell)
+{
+    char line[PDB_MAX_LINE_STRL];
+
+    assert(pdb);
+    assert(cell);
+
+    while (fgets(line, PDB_MAX_LINE_STRL, pdb) != NULL) {
+        if (strncmp("ATOM", line, 4) == 0 || strncmp("HETATM", line, 6) == 0 ||
+            strncmp("MODEL", line, 5) == 0)
+            break;
+        if (strncmp("CRYST1", line, 6) != 0) continue;
+
+        if (sscanf(line + 6, "%lf %lf %lf %lf %lf %lf",
+                   &cell[0], &cell[1], &cell[2],
+                   &cell[3], &cell[4], &cell[5]) != 6) {
+            return fail_msg("malformed CRYST1 record in PDB input");
+        }
+        return 1;
+    }
+
+    return 0;
+}
+
 
 int
 freesasa_pdb_get_atom_name(char *name,
@@ -179,8 +265,8 @@ freesasa_pdb_get_res_name(char *name,
 }
 
 int
-freesasa_pdb_get_coord(double *xyz,
-                       const char *line)
+freesasa_pdb_get_coord_silent(double *xyz,
+                              const char *line)
 {
     int n_coord = 24; /* 54-30+1 */
     char coord_section[25];
@@ -196,6 +282,23 @@ freesasa_pdb_get_coord(double *xyz,
     coord_section[n_coord] = '\0';
 
     if (sscanf(coord_section, "%lf%lf%lf", &xyz[0], &xyz[1], &xyz[2]) != 3) {
+        return FREESASA_FAIL;
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+int
+freesasa_pdb_get_coord(double *xyz,
+                       const char *line)
+{
+    assert(xyz);
+    assert(line);
+
+    if (freesasa_pdb_get_coord_silent(xyz, line) == FREESASA_FAIL) {
+        if (pdb_line_check(line,54) == FREESASA_FAIL) {
+            return FREESASA_FAIL;
+        }
         return fail_msg("could not read coordinates from line '%s'",line);
     }
 
@@ -280,17 +383,94 @@ freesasa_pdb_ishydrogen(const char* line)
     return 0;
 }
 
+/* the ATOM records of a block of consecutive residues */
+struct pdb_block {
+    freesasa_node **residue; /* all residues of the structure */
+    int first, last;
+    freesasa_out out;
+    int status;
+};
+
+/** Write the ATOM records of the residues of a block */
+static void
+pdb_block_write(void *arg)
+{
+    struct pdb_block *block = (struct pdb_block *) arg;
+    char buf[PDB_LINE_STRL+1];
+    double radius;
+    const char *line = NULL;
+    freesasa_node *atom = NULL;
+    const freesasa_nodearea *area = NULL;
+    int r;
+
+    block->status = FREESASA_SUCCESS;
+    for (r = block->first; r <= block->last; ++r) {
+        atom = freesasa_node_children(block->residue[r]);
+        while (atom) {
+            line = freesasa_node_atom_pdb_line(atom);
+            area = freesasa_node_area(atom);
+            radius = freesasa_node_atom_radius(atom);
+
+            if (line == NULL) {
+                block->status = fail_msg("PDB input not valid or not present");
+                return;
+            }
+
+            strncpy(buf, line, PDB_LINE_STRL);
+            sprintf(&buf[54], "%6.2f%6.2f", radius, area->total);
+            if (freesasa_out_printf(&block->out, "%s\n", buf)) {
+                block->status = FREESASA_FAIL;
+                return;
+            }
+
+            atom = freesasa_node_next(atom);
+        }
+    }
+}
+
+/** The residues of a structure node in order, NULL if memory
+    allocation failed */
+static freesasa_node **
+pdb_residues(freesasa_node *structure,
+             int *n)
+{
+    freesasa_node *chain, *residue, **array;
+
+    *n = 0;
+    for (chain = freesasa_node_children(structure); chain; chain = freesasa_node_next(chain)) {
+        *n += freesasa_node_chain_n_residues(chain);
+    }
+
+    array = malloc(sizeof(freesasa_node *) * (*n > 0 ? *n : 1));
+    if (array == NULL) {
+        mem_fail();
+        return NULL;
+    }
+
+    *n = 0;
+    for (chain = freesasa_node_children(structure); chain; chain = freesasa_node_next(chain)) {
+        for (residue = freesasa_node_children(chain); residue; residue = freesasa_node_next(residue)) {
+            array[(*n)++] = residue;
+        }
+    }
+
+    return array;
+}
+
+/** The ATOM records of large structures are formatted in parallel,
+    in blocks of residues with roughly the same number of atoms. The
+    first block is written directly, the others are buffered and
+    written in order afterwards. */
 static int
 write_pdb_impl(FILE *output,
                freesasa_node *structure)
 {
-    char buf[PDB_LINE_STRL+1], buf2[6];
-    int model;
-    double radius;
+    char buf2[6];
+    int model, n_residues, n_atoms, n_blocks, b, r, count,
+        return_value = FREESASA_SUCCESS;
     const char *line = NULL;
-    freesasa_node *chain = NULL, *residue = NULL, *atom = NULL;
-    const freesasa_nodearea *area = NULL;
-    const char *last_res_name = NULL, *last_res_number = NULL, *last_chain = NULL;
+    freesasa_node **residue, *last_atom = NULL, *last_residue = NULL;
+    struct pdb_block *block;
 
     assert(freesasa_node_type(structure) == FREESASA_NODE_STRUCTURE);
 
@@ -298,41 +478,71 @@ write_pdb_impl(FILE *output,
     if (model > 0) fprintf(output, "MODEL     %4d\n", model);
     else fprintf(output,           "MODEL        1\n");
 
-    chain = freesasa_node_children(structure);
+    residue = pdb_residues(structure, &n_residues);
+    if (residue == NULL) return fail_msg("");
 
-    /* Write ATOM entries */
-    while (chain) {
-        residue = freesasa_node_children(chain);
-        while (residue) {
-            atom = freesasa_node_children(residue);
-            while (atom) {
-                line = freesasa_node_atom_pdb_line(atom);
-                area = freesasa_node_area(atom);
-                radius = freesasa_node_atom_radius(atom);
-
-                if (line == NULL) {
-                    return fail_msg("PDB input not valid or not present");
-                }
+    n_atoms = freesasa_node_structure_n_atoms(structure);
+    n_blocks = freesasa_node_result_parameters(freesasa_node_parent(structure))->n_threads;
+    if (n_blocks > n_atoms / PDB_MIN_BLOCK_ATOMS) n_blocks = n_atoms / PDB_MIN_BLOCK_ATOMS;
+    if (n_blocks > n_residues) n_blocks = n_residues;
+    if (n_blocks < 1) n_blocks = 1;
 
-                strncpy(buf, line, PDB_LINE_STRL);
-                sprintf(&buf[54], "%6.2f%6.2f", radius, area->total);
-                fprintf(output, "%s\n", buf);
+    block = malloc(sizeof(struct pdb_block) * n_blocks);
+    if (block == NULL) {
+        free(residue);
+        return mem_fail();
+    }
 
-                atom = freesasa_node_next(atom);
+    /* split by atom count, on residue boundaries */
+    for (b = 0, r = 0, count = 0; b < n_blocks; ++b) {
+        block[b].residue = residue;
+        block[b].first = r;
+        if (b == n_blocks - 1) {
+            r = n_residues;
+        } else {
+            while (r < n_residues) {
+                count += freesasa_node_residue_n_atoms(residue[r++]);
+                if (count >= (long) n_atoms * (b + 1) / n_blocks) break;
             }
-            last_res_name = freesasa_node_name(residue);
-            last_res_number = freesasa_node_residue_number(residue);
-            residue = freesasa_node_next(residue);
         }
-        last_chain = freesasa_node_name(chain);
-        chain = freesasa_node_next(chain);
+        block[b].last = r - 1;
+        block[b].out.file = b == 0 ? output : NULL;
+        block[b].out.buf = NULL;
+        block[b].out.len = block[b].out.size = 0;
+        block[b].out.fail = 0;
+    }
+
+    /* Write ATOM entries */
+    if (freesasa_run_parallel(pdb_block_write, block, sizeof(struct pdb_block), n_blocks)) {
+        return_value = FREESASA_FAIL;
     }
+    for (b = 0; b < n_blocks; ++b) {
+        if (block[b].status == FREESASA_FAIL) return_value = FREESASA_FAIL;
+    }
+    for (b = 1; b < n_blocks; ++b) {
+        if (return_value == FREESASA_SUCCESS) return_value = freesasa_out_write(&block[b].out, output);
+        else free(block[b].out.buf);
+    }
+
+    if (n_residues > 0) {
+        last_residue = residue[n_residues-1];
+        last_atom = freesasa_node_children(last_residue);
+        while (last_atom && freesasa_node_next(last_atom)) last_atom = freesasa_node_next(last_atom);
+    }
+    free(block);
+    free(residue);
+
+    if (return_value == FREESASA_FAIL) return fail_msg("");
 
     /* Write TER and ENDMDL lines */
-    strncpy(buf2, &buf[6], 5);
+    line = last_atom ? freesasa_node_atom_pdb_line(last_atom) : NULL;
+    if (line == NULL) return fail_msg("PDB input not valid or not present");
+    strncpy(buf2, &line[6], 5);
     buf2[5]='\0';
     fprintf(output,"TER   %5d     %4s %c%5s\nENDMDL\n",
-            atoi(buf2)+1, last_res_name, last_chain[0], last_res_number);
+            atoi(buf2)+1, freesasa_node_name(last_residue),
+            freesasa_node_name(freesasa_node_parent(last_residue))[0],
+            freesasa_node_residue_number(last_residue));
 
     fflush(output);
     if (ferror(output)) {
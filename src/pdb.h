@@ -54,6 +54,40 @@ freesasa_pdb_get_chains(FILE *pdb,
                         struct file_range model,
                         struct file_range **ranges,
                         int options);
+
+/**
+    Reads the BIOMT symmetry operators of the first biomolecule in
+    the REMARK 350 records of a PDB file.
+
+    Reads from the current position until the first coordinate
+    record. The chains the operators apply to are ignored.
+
+    @param pdb The pdb-file
+    @param operators The address to a dynamically allocated array
+      with 12 values per operator, the rows of the 3x4 matrix, will
+      be stored here (NULL if none found).
+    @return Number of operators found. ::FREESASA_FAIL if the records
+      are malformed or memory allocation fails.
+ */
+int
+freesasa_pdb_get_biomt(FILE *pdb,
+                       double **operators);
+
+/**
+    Reads the unit cell from the CRYST1 record of a PDB file.
+
+    Reads from the current position until the first coordinate
+    record.
+
+    @param pdb The pdb-file
+    @param cell The cell parameters a, b, c (Å), alpha, beta and gamma
+      (degrees) are stored here (6 values).
+    @return 1 if the record was found, 0 if not. ::FREESASA_FAIL if
+      the record is malformed.
+ */
+int
+freesasa_pdb_get_cryst1(FILE *pdb,
+                        double *cell);
 /**
     Get atom name from a PDB line.
 
@@ -102,6 +136,19 @@ int
 freesasa_pdb_get_coord(double *coord,
                        const char *line);
 
+/**
+    As freesasa_pdb_get_coord(), but without an error message if the
+    coordinates can not be read. For lines that are parsed
+    concurrently and reported afterwards.
+
+    @param coord The coordinates are written to this array as x,y,z.
+    @param line Line from a PDB file.
+    @return ::FREESASA_SUCCESS if input is readable, else ::FREESASA_FAIL.
+ */
+int
+freesasa_pdb_get_coord_silent(double *coord,
+                              const char *line);
+
 /**
     Get residue number from a PDB line.
 
@@ -0,0 +1,112 @@
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "freesasa_internal.h"
+#include "pdb.h"
+
+int
+freesasa_periodic_box_from_cell(const double *cell,
+                                double *box)
+{
+    const double deg = M_PI / 180;
+    double ca, cb, cg, sg, cy, cz2;
+    int k;
+
+    assert(cell);
+    assert(box);
+
+    for (k = 0; k < 3; ++k) {
+        if (!(cell[k] > 0)) return fail_msg("unit cell lengths have to be positive");
+        if (!(cell[3+k] > 0 && cell[3+k] < 180)) {
+            return fail_msg("unit cell angles have to be between 0 and 180 degrees");
+        }
+    }
+
+    ca = cos(cell[3]*deg);
+    cb = cos(cell[4]*deg);
+    cg = cos(cell[5]*deg);
+    sg = sin(cell[5]*deg);
+    cy = (ca - cb*cg) / sg;
+    cz2 = 1 - cb*cb - cy*cy;
+    if (!(cz2 > 0)) return fail_msg("unit cell angles don't form a valid cell");
+
+    /* a along x, b in the xy-plane, the PDB convention */
+    box[0] = cell[0];    box[1] = 0;          box[2] = 0;
+    box[3] = cell[1]*cg; box[4] = cell[1]*sg; box[5] = 0;
+    box[6] = cell[2]*cb; box[7] = cell[2]*cy; box[8] = cell[2]*sqrt(cz2);
+
+    return FREESASA_SUCCESS;
+}
+
+int
+freesasa_periodic_box_from_pdb(FILE *pdb,
+                               double *box)
+{
+    double cell[6];
+    int ret;
+
+    assert(pdb);
+    assert(box);
+
+    ret = freesasa_pdb_get_cryst1(pdb, cell);
+    if (ret == FREESASA_FAIL) return fail_msg("");
+    if (ret == 0) return 0;
+
+    if (freesasa_periodic_box_from_cell(cell, box)) return fail_msg("");
+
+    return 1;
+}
+
+freesasa_result *
+freesasa_calc_coord_periodic(const double *xyz,
+                             const double *radii,
+                             int n,
+                             const double *box,
+                             const freesasa_parameters *parameters)
+{
+    coord_t *coord = NULL;
+    freesasa_result *result = NULL;
+
+    assert(xyz);
+    assert(radii);
+    assert(box);
+    assert(n > 0);
+
+    coord = freesasa_coord_new_linked(xyz, n);
+    if (coord != NULL && freesasa_coord_set_periodic(coord, box) == FREESASA_SUCCESS) {
+        result = freesasa_calc_subset(coord, radii, n, parameters, NULL);
+    }
+    if (result == NULL) fail_msg("");
+
+    freesasa_coord_free(coord);
+
+    return result;
+}
+
+freesasa_result *
+freesasa_calc_structure_periodic(const freesasa_structure *structure,
+                                 const double *box,
+                                 const freesasa_parameters *parameters)
+{
+    const coord_t *xyz;
+    freesasa_result *result;
+
+    assert(structure);
+
+    xyz = freesasa_structure_xyz(structure);
+    if (freesasa_coord_n(xyz) == 0) {
+        fail_msg("empty structure");
+        return NULL;
+    }
+
+    result = freesasa_calc_coord_periodic(freesasa_coord_all(xyz),
+                                          freesasa_structure_radius(structure),
+                                          freesasa_coord_n(xyz), box, parameters);
+    if (result == NULL) fail_msg("");
+
+    return result;
+}
@@ -0,0 +1,440 @@
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freesasa_internal.h"
+
+/* upper limit for the number of cells in the receptor grid */
+#define RECEPTOR_MAX_CELLS 10000000
+
+struct freesasa_receptor {
+    double *xyz;
+    double *radii;
+    int n;
+    freesasa_parameters parameters;
+    freesasa_result *result; /* the free receptor */
+    double r_max;
+    /* grid of cells, the atoms of cell c are
+       cell_atoms[cell_start[c]] to cell_atoms[cell_start[c+1]-1] */
+    double lo[3], cell_size;
+    int dim[3];
+    int *cell_start;
+    int *cell_atoms;
+};
+
+/* growing list of atom indices */
+typedef struct {
+    int *atom;
+    int n, capacity;
+} index_list;
+
+static int
+index_list_push(index_list *list,
+                int i)
+{
+    int *ab;
+
+    if (list->n == list->capacity) {
+        list->capacity = list->capacity > 0 ? 2 * list->capacity : 64;
+        ab = realloc(list->atom, sizeof(int) * list->capacity);
+        if (ab == NULL) return mem_fail();
+        list->atom = ab;
+    }
+    list->atom[list->n++] = i;
+
+    return FREESASA_SUCCESS;
+}
+
+static int
+compare_int(const void *a,
+            const void *b)
+{
+    const int ia = *(const int *) a, ib = *(const int *) b;
+    return (ia > ib) - (ia < ib);
+}
+
+/** Sorts the list and removes duplicates */
+static void
+index_list_unique(index_list *list)
+{
+    int i, n = 0;
+
+    if (list->n == 0) return;
+    qsort(list->atom, list->n, sizeof(int), compare_int);
+    for (i = 1; i < list->n; ++i) {
+        if (list->atom[i] != list->atom[n]) list->atom[++n] = list->atom[i];
+    }
+    list->n = n + 1;
+}
+
+static inline int
+cell_coord(const freesasa_receptor *receptor,
+           double x,
+           int k)
+{
+    int c = (int) floor((x - receptor->lo[k]) / receptor->cell_size);
+    if (c < 0) return 0;
+    if (c >= receptor->dim[k]) return receptor->dim[k] - 1;
+    return c;
+}
+
+static inline int
+cell_index(const freesasa_receptor *receptor,
+           const double *v)
+{
+    return cell_coord(receptor, v[0], 0)
+        + receptor->dim[0] * (cell_coord(receptor, v[1], 1)
+                              + receptor->dim[1] * cell_coord(receptor, v[2], 2));
+}
+
+/** Sorts the receptor atoms into the cells of the grid */
+static int
+fill_grid(freesasa_receptor *receptor)
+{
+    const int n = receptor->n;
+    double hi[3], n_cells = 1;
+    int *count, i, k, c;
+
+    for (k = 0; k < 3; ++k) receptor->lo[k] = hi[k] = receptor->xyz[k];
+    for (i = 0; i < n; ++i) {
+        for (k = 0; k < 3; ++k) {
+            receptor->lo[k] = fmin(receptor->lo[k], receptor->xyz[3*i+k]);
+            hi[k] = fmax(hi[k], receptor->xyz[3*i+k]);
+        }
+    }
+
+    /* the cells are as wide as the longest possible contact between
+       two receptor atoms, larger for sparse systems */
+    receptor->cell_size = 2 * (receptor->r_max + receptor->parameters.probe_radius);
+    if (!(receptor->cell_size > 0)) receptor->cell_size = 1;
+    for (;;) {
+        n_cells = 1;
+        for (k = 0; k < 3; ++k) {
+            receptor->dim[k] = 1 + (int) floor((hi[k] - receptor->lo[k]) / receptor->cell_size);
+            n_cells *= receptor->dim[k];
+        }
+        if (n_cells <= RECEPTOR_MAX_CELLS) break;
+        receptor->cell_size *= 2;
+    }
+
+    receptor->cell_start = calloc((size_t) n_cells + 1, sizeof(int));
+    receptor->cell_atoms = malloc(sizeof(int) * n);
+    count = calloc((size_t) n_cells, sizeof(int));
+    if (!receptor->cell_start || !receptor->cell_atoms || !count) {
+        free(count);
+        return mem_fail();
+    }
+
+    for (i = 0; i < n; ++i) ++count[cell_index(receptor, receptor->xyz + 3*i)];
+    for (c = 0; c < (int) n_cells; ++c) {
+        receptor->cell_start[c+1] = receptor->cell_start[c] + count[c];
+        count[c] = receptor->cell_start[c];
+    }
+    for (i = 0; i < n; ++i) {
+        receptor->cell_atoms[count[cell_index(receptor, receptor->xyz + 3*i)]++] = i;
+    }
+
+    free(count);
+
+    return FREESASA_SUCCESS;
+}
+
+/**
+    Appends the receptor atoms whose probe-extended spheres overlap
+    that of a sphere at v with radius r.
+ */
+static int
+add_contacts(const freesasa_receptor *receptor,
+             const double *v,
+             double r,
+             index_list *list)
+{
+    const double probe = receptor->parameters.probe_radius;
+    const double reach = r + receptor->r_max + 2 * probe;
+    const double *vj;
+    double dx, dy, dz, cut;
+    int lo[3], hi[3], cx, cy, cz, c, m, j, k;
+
+    for (k = 0; k < 3; ++k) {
+        lo[k] = cell_coord(receptor, v[k] - reach, k);
+        hi[k] = cell_coord(receptor, v[k] + reach, k);
+    }
+
+    for (cz = lo[2]; cz <= hi[2]; ++cz) {
+        for (cy = lo[1]; cy <= hi[1]; ++cy) {
+            for (cx = lo[0]; cx <= hi[0]; ++cx) {
+                c = cx + receptor->dim[0] * (cy + receptor->dim[1] * cz);
+                for (m = receptor->cell_start[c]; m < receptor->cell_start[c+1]; ++m) {
+                    j = receptor->cell_atoms[m];
+                    vj = receptor->xyz + 3*j;
+                    dx = vj[0] - v[0];
+                    dy = vj[1] - v[1];
+                    dz = vj[2] - v[2];
+                    cut = r + receptor->radii[j] + 2 * probe;
+                    if (dx*dx + dy*dy + dz*dz < cut*cut && index_list_push(list, j))
+                        return FREESASA_FAIL;
+                }
+            }
+        }
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+void
+freesasa_receptor_free(freesasa_receptor *receptor)
+{
+    if (receptor) {
+        free(receptor->xyz);
+        free(receptor->radii);
+        freesasa_result_free(receptor->result);
+        free(receptor->cell_start);
+        free(receptor->cell_atoms);
+        free(receptor);
+    }
+}
+
+freesasa_receptor *
+freesasa_receptor_from_coord(const double *xyz,
+                             const double *radii,
+                             int n,
+                             const freesasa_parameters *parameters)
+{
+    freesasa_receptor *receptor;
+    int i;
+
+    assert(xyz);
+    assert(radii);
+
+    if (parameters == NULL) parameters = &freesasa_default_parameters;
+
+    if (n <= 0) {
+        fail_msg("empty receptor");
+        return NULL;
+    }
+    if (parameters->calc_gradient || parameters->calc_surface_dots) {
+        fail_msg("gradients and surface dots are not available for receptors");
+        return NULL;
+    }
+    if (parameters->target_total_error > 0) {
+        fail_msg("the target total error depends on the number of atoms, "
+                 "and can not be used for receptors");
+        return NULL;
+    }
+
+    receptor = calloc(1, sizeof(freesasa_receptor));
+    if (receptor == NULL) {
+        mem_fail();
+        return NULL;
+    }
+
+    receptor->n = n;
+    receptor->parameters = *parameters;
+    receptor->xyz = malloc(sizeof(double) * 3 * n);
+    receptor->radii = malloc(sizeof(double) * n);
+    if (!receptor->xyz || !receptor->radii) {
+        mem_fail();
+        goto fail;
+    }
+    memcpy(receptor->xyz, xyz, sizeof(double) * 3 * n);
+    memcpy(receptor->radii, radii, sizeof(double) * n);
+    for (i = 0; i < n; ++i) {
+        if (radii[i] < 0) {
+            fail_msg("atom %d has negative radius", i);
+            goto fail;
+        }
+        receptor->r_max = fmax(receptor->r_max, radii[i]);
+    }
+
+    receptor->result = freesasa_calc_coord(receptor->xyz, receptor->radii, n, parameters);
+    if (receptor->result == NULL) goto fail;
+
+    if (fill_grid(receptor)) goto fail;
+
+    return receptor;
+
+ fail:
+    fail_msg("");
+    freesasa_receptor_free(receptor);
+    return NULL;
+}
+
+freesasa_receptor *
+freesasa_receptor_from_structure(const freesasa_structure *structure,
+                                 const freesasa_parameters *parameters)
+{
+    freesasa_receptor *receptor;
+
+    assert(structure);
+
+    receptor = freesasa_receptor_from_coord(freesasa_structure_coord_array(structure),
+                                            freesasa_structure_radius(structure),
+                                            freesasa_structure_n(structure),
+                                            parameters);
+    if (receptor == NULL) fail_msg("");
+
+    return receptor;
+}
+
+const freesasa_result *
+freesasa_receptor_result(const freesasa_receptor *receptor)
+{
+    assert(receptor);
+
+    return receptor->result;
+}
+
+void
+freesasa_pose_result_free(freesasa_pose_result *result)
+{
+    if (result) {
+        free(result->ligand_sasa);
+        free(result->contact);
+        free(result->contact_delta);
+        free(result);
+    }
+}
+
+/** SASA of the first n_calc atoms of the n given */
+static freesasa_result *
+calc_local(const double *xyz,
+           const double *radii,
+           int n,
+           int n_calc,
+           const freesasa_parameters *parameters)
+{
+    coord_t *coord;
+    freesasa_result *result = NULL;
+
+    coord = freesasa_coord_new_linked(xyz, n);
+    if (coord != NULL) result = freesasa_calc_subset(coord, radii, n_calc, parameters, NULL);
+    freesasa_coord_free(coord);
+
+    return result;
+}
+
+freesasa_pose_result *
+freesasa_receptor_calc_pose(const freesasa_receptor *receptor,
+                            const double *xyz,
+                            const double *radii,
+                            int n)
+{
+    freesasa_parameters parameters;
+    freesasa_pose_result *pose = NULL;
+    freesasa_result *complex = NULL, *ligand = NULL;
+    index_list contact = {NULL, 0, 0}, shell = {NULL, 0, 0};
+    double *local_xyz = NULL, *local_r = NULL;
+    int i, j, k, m, n_local, ok = 0;
+
+    assert(receptor);
+    assert(xyz);
+    assert(radii);
+
+    if (n <= 0) {
+        fail_msg("empty ligand");
+        return NULL;
+    }
+    for (i = 0; i < n; ++i) {
+        if (radii[i] < 0) {
+            fail_msg("ligand atom %d has negative radius", i);
+            return NULL;
+        }
+    }
+
+    /* poses are small, and are calculated in parallel by the caller
+       if at all */
+    parameters = receptor->parameters;
+    parameters.n_threads = 1;
+
+    /* the receptor atoms that change are those in contact with the
+       ligand, their SASA depends on the receptor atoms in contact
+       with them */
+    for (i = 0; i < n; ++i) {
+        if (add_contacts(receptor, xyz + 3*i, radii[i], &contact)) goto cleanup;
+    }
+    index_list_unique(&contact);
+    for (k = 0; k < contact.n; ++k) {
+        j = contact.atom[k];
+        if (add_contacts(receptor, receptor->xyz + 3*j, receptor->radii[j], &shell))
+            goto cleanup;
+    }
+    index_list_unique(&shell);
+
+    /* the ligand, then the contact atoms, then the rest of the shell */
+    n_local = n + shell.n;
+    local_xyz = malloc(sizeof(double) * 3 * n_local);
+    local_r = malloc(sizeof(double) * n_local);
+    if (!local_xyz || !local_r) {
+        mem_fail();
+        goto cleanup;
+    }
+    memcpy(local_xyz, xyz, sizeof(double) * 3 * n);
+    memcpy(local_r, radii, sizeof(double) * n);
+    for (k = 0; k < contact.n; ++k) {
+        j = contact.atom[k];
+        memcpy(local_xyz + 3*(n+k), receptor->xyz + 3*j, sizeof(double) * 3);
+        local_r[n+k] = receptor->radii[j];
+    }
+    for (m = 0, k = 0, i = n + contact.n; m < shell.n; ++m) {
+        j = shell.atom[m];
+        while (k < contact.n && contact.atom[k] < j) ++k;
+        if (k < contact.n && contact.atom[k] == j) continue;
+        memcpy(local_xyz + 3*i, receptor->xyz + 3*j, sizeof(double) * 3);
+        local_r[i] = receptor->radii[j];
+        ++i;
+    }
+    assert(i == n_local);
+
+    complex = calc_local(local_xyz, local_r, n_local, n + contact.n, &parameters);
+    if (complex == NULL) goto cleanup;
+    ligand = calc_local(xyz, radii, n, n, &parameters);
+    if (ligand == NULL) goto cleanup;
+
+    pose = malloc(sizeof(freesasa_pose_result));
+    if (pose == NULL) {
+        mem_fail();
+        goto cleanup;
+    }
+    pose->n_ligand = n;
+    pose->n_contact = contact.n;
+    pose->ligand_sasa = malloc(sizeof(double) * n);
+    pose->contact = contact.atom;
+    pose->contact_delta = malloc(sizeof(double) * (contact.n > 0 ? contact.n : 1));
+    contact.atom = NULL;
+    if (!pose->ligand_sasa || !pose->contact_delta) {
+        mem_fail();
+        goto cleanup;
+    }
+
+    pose->ligand_total = 0;
+    for (i = 0; i < n; ++i) {
+        pose->ligand_sasa[i] = complex->sasa[i];
+        pose->ligand_total += complex->sasa[i];
+    }
+    pose->ligand_free = ligand->total;
+    pose->delta_total = pose->ligand_total - pose->ligand_free;
+    for (k = 0; k < pose->n_contact; ++k) {
+        pose->contact_delta[k] = complex->sasa[n+k] - receptor->result->sasa[pose->contact[k]];
+        pose->delta_total += pose->contact_delta[k];
+    }
+    ok = 1;
+
+ cleanup:
+    if (!ok) {
+        fail_msg("");
+        freesasa_pose_result_free(pose);
+        pose = NULL;
+    }
+    freesasa_result_free(complex);
+    freesasa_result_free(ligand);
+    free(contact.atom);
+    free(shell.atom);
+    free(local_xyz);
+    free(local_r);
+
+    return pose;
+}
@@ -0,0 +1,749 @@
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+# define _USE_MATH_DEFINES
+#endif
+#include <math.h>
+
+#if USE_THREADS
+# include <pthread.h>
+# define MAX_GB_THREADS 16
+#else
+# define MAX_GB_THREADS 1
+#endif
+
+#include "freesasa_internal.h"
+#include "nb.h"
+
+/**
+   Analytical SASA using the Gauss-Bonnet theorem.
+
+   Each neighbor j of atom i intersects the sphere of atom i in a
+   circle, which bounds a spherical cap (the part of sphere i buried
+   by j). The exposed surface of sphere i is the complement of the
+   union of these caps, and is bounded by arcs of the circles that
+   meet at vertices where two circles intersect. For a region S on a
+   sphere of radius R the Gauss-Bonnet theorem gives
+
+       A(S)/R^2 = 2 pi chi(S) - sum_arcs int kappa_g ds - sum_vertices eps,
+
+   where the geodesic curvature integral along an arc of angle phi on
+   a circle with angular radius theta is -phi cos(theta) (the region
+   lies outside the cap) and eps is the exterior angle at a vertex.
+
+   The Euler characteristic is chi = 2C - B, where C is the number of
+   connected exposed regions and B the number of boundary loops. C is
+   expensive to determine, but each loop l contributes L_l = 2 pi +
+   sum(phi cos theta) - sum(eps) and A/R^2 = sum_l L_l - 4 pi (B - C).
+   Since 0 < A/R^2 < 4 pi whenever there is at least one loop, the
+   area is simply sum_l L_l modulo 4 pi, which means that only the
+   number of loops needs to be counted, not the connectivity of the
+   exposed regions.
+
+   Variables are named according to this notation: a cap has axis n
+   (unit vector from atom i towards atom j), g = cos(theta) and s =
+   sin(theta).
+ */
+
+#define GB_EPS 1e-12
+/* Arc end points closer than this are considered the same vertex */
+#define GB_VERTEX_TOL 1e-7
+
+/* Flags for caps */
+#define CAP_IGNORE 0
+#define CAP_ACTIVE 1
+
+/** An exposed arc, traversed with the exposed surface to the left */
+typedef struct {
+    double start[3], end[3];   /* end points */
+    double t_start[3], t_end[3]; /* unit tangents at end points */
+    int next; /* the arc that continues the loop at the end point */
+} gb_arc;
+
+/* Scratch arrays used in the calculation of one atom */
+typedef struct {
+    double *n, *e1, *e2, *g, *s;
+    int *status;
+    int *n_point;
+    double *point; /* angles of intersection points on each circle */
+    gb_arc *arc;
+    int *visited;
+} gb_scratch;
+
+/* calculation parameters and data (results stored in *sasa) */
+typedef struct {
+    int n_atoms;
+    int n_calc; /* the first n_calc atoms are calculated, the rest only bury them */
+    int max_nni;
+    double *radii; /* including probe */
+    const coord_t *xyz;
+    nb_list *adj;
+    double *sasa; /* results */
+    gb_scratch scratch[MAX_GB_THREADS];
+    int n_threads;
+    freesasa_progress *progress; /* can be NULL */
+} gb_data;
+
+typedef struct {
+    int first_atom;
+    int last_atom;
+    int thread_id;
+    gb_data *gb;
+} gb_thread_interval;
+
+#if USE_THREADS
+static int gb_do_threads(int n_threads, gb_data *gb);
+static void *gb_thread(void *arg);
+#endif
+
+static double
+atom_area(gb_data *gb, int i, int thread_id);
+
+static void
+scratch_init(gb_scratch *sc)
+{
+    memset(sc, 0, sizeof(gb_scratch));
+}
+
+static void
+scratch_free(gb_scratch *sc)
+{
+    free(sc->n);
+    free(sc->e1);
+    free(sc->e2);
+    free(sc->g);
+    free(sc->s);
+    free(sc->status);
+    free(sc->n_point);
+    free(sc->point);
+    free(sc->arc);
+    free(sc->visited);
+    scratch_init(sc);
+}
+
+/* m is the maximum number of neighbors of any atom */
+static int
+scratch_alloc(gb_scratch *sc, int m)
+{
+    /* avoid zero-sized mallocs if an atom has no neighbors */
+    if (m < 1) m = 1;
+
+    sc->n = malloc(sizeof(double) * 3 * m);
+    sc->e1 = malloc(sizeof(double) * 3 * m);
+    sc->e2 = malloc(sizeof(double) * 3 * m);
+    sc->g = malloc(sizeof(double) * m);
+    sc->s = malloc(sizeof(double) * m);
+    sc->status = malloc(sizeof(int) * m);
+    sc->n_point = malloc(sizeof(int) * m);
+    /* each circle can intersect the others in at most 2(m-1) points,
+       and there can be no more exposed arcs than points */
+    sc->point = malloc(sizeof(double) * 2 * m * m);
+    sc->arc = malloc(sizeof(gb_arc) * 2 * m * m);
+    sc->visited = malloc(sizeof(int) * 2 * m * m);
+
+    if (!sc->n || !sc->e1 || !sc->e2 || !sc->g || !sc->s ||
+        !sc->status || !sc->n_point || !sc->point ||
+        !sc->arc || !sc->visited) {
+        return mem_fail();
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+/** Release contents of gb_data pointer */
+static void
+release_gb(gb_data *gb)
+{
+    int i;
+
+    free(gb->radii);
+    freesasa_nb_free(gb->adj);
+    gb->radii = NULL;
+    gb->adj = NULL;
+
+    for (i = 0; i < gb->n_threads; ++i) {
+        scratch_free(&gb->scratch[i]);
+    }
+}
+
+/** Initialize object to be used for Gauss-Bonnet calculation */
+static int
+init_gb(gb_data *gb,
+        double *sasa,
+        const coord_t *xyz,
+        const double *atom_radii,
+        double probe_radius,
+        int n_threads)
+{
+    const int n_atoms = freesasa_coord_n(xyz);
+    int i;
+
+    gb->n_atoms = n_atoms;
+    gb->n_calc = n_atoms;
+    gb->xyz = xyz;
+    gb->adj = NULL;
+    gb->sasa = sasa;
+    gb->n_threads = n_threads;
+    gb->max_nni = 0;
+    gb->progress = NULL;
+
+    for (i = 0; i < n_threads; ++i) {
+        scratch_init(&gb->scratch[i]);
+    }
+
+    gb->radii = malloc(sizeof(double)*n_atoms);
+    if (gb->radii == NULL) {
+        return mem_fail();
+    }
+
+    for (i = 0; i < n_atoms; ++i) {
+        gb->radii[i] = atom_radii[i] + probe_radius;
+        sasa[i] = 0.;
+    }
+
+    gb->adj = freesasa_nb_new(xyz, gb->radii);
+    if (gb->adj == NULL) {
+        release_gb(gb);
+        return fail_msg("");
+    }
+
+    for (i = 0; i < n_atoms; ++i) {
+        if (gb->adj->nn[i] > gb->max_nni) gb->max_nni = gb->adj->nn[i];
+    }
+
+    for (i = 0; i < n_threads; ++i) {
+        if (scratch_alloc(&gb->scratch[i], gb->max_nni)) {
+            release_gb(gb);
+            return fail_msg("");
+        }
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+int
+freesasa_gauss_bonnet(double *sasa,
+                      const coord_t *xyz,
+                      const double *atom_radii,
+                      int n_calc,
+                      const freesasa_parameters *param,
+                      freesasa_progress *progress)
+{
+    int return_value, n_atoms, n_threads, i, n_pending = 0;
+    gb_data gb;
+
+    assert(sasa);
+    assert(xyz);
+    assert(atom_radii);
+
+    if (param == NULL) param = &freesasa_default_parameters;
+
+    return_value = FREESASA_SUCCESS;
+    n_atoms = freesasa_coord_n(xyz);
+    n_threads = param->n_threads;
+
+    assert(n_calc <= n_atoms);
+
+    if (n_threads > MAX_GB_THREADS) {
+        return fail_msg("Gauss-Bonnet does not support more than %d threads", MAX_GB_THREADS);
+    }
+
+    if (n_calc == 0) {
+        return freesasa_warn("in %s(): empty coordinates", __func__);
+    }
+
+    if (n_threads > n_calc) {
+        n_threads = n_calc;
+        freesasa_warn("no sense in having more threads than atoms, only using %d threads",
+                      n_threads);
+    }
+
+    if (init_gb(&gb, sasa, xyz, atom_radii, param->probe_radius, n_threads))
+        return FREESASA_FAIL;
+    gb.progress = progress;
+    gb.n_calc = n_calc;
+
+    if (n_threads > 1) {
+#if USE_THREADS
+        return_value = gb_do_threads(n_threads, &gb);
+#else
+        return_value = freesasa_warn("in %s(): program compiled for single-threaded use, "
+                                     "but multiple threads were requested, will "
+                                     "proceed in single-threaded mode\n",
+                                     __func__);
+        n_threads = 1;
+#endif /* pthread */
+    }
+    if (n_threads == 1) {
+        for (i = 0; i < gb.n_calc; ++i) {
+            gb.sasa[i] = atom_area(&gb, i, 0);
+            if (freesasa_progress_tick(progress, &n_pending)) break;
+        }
+        freesasa_progress_flush(progress, &n_pending);
+    }
+    if (freesasa_progress_cancelled(progress)) return_value = FREESASA_FAIL;
+    release_gb(&gb);
+    return return_value;
+}
+
+#if USE_THREADS
+static int
+gb_do_threads(int n_threads,
+              gb_data *gb)
+{
+    pthread_t thread[MAX_GB_THREADS];
+    gb_thread_interval t_data[MAX_GB_THREADS];
+    int n_perthread = gb->n_calc/n_threads, res;
+    int threads_created = 0, return_value = FREESASA_SUCCESS;
+    int t;
+
+    for (t = 0; t < n_threads; ++t) {
+        t_data[t].first_atom = t*n_perthread;
+        if (t == n_threads-1) {
+            t_data[t].last_atom = gb->n_calc - 1;
+        } else {
+            t_data[t].last_atom = (t+1)*n_perthread - 1;
+        }
+        t_data[t].gb = gb;
+        t_data[t].thread_id = t;
+        res = freesasa_thread_create(&thread[t], gb_thread,
+                                     (void *) &t_data[t]);
+        if (res) {
+            return_value = fail_msg(freesasa_thread_error(res));
+            break;
+        }
+        ++threads_created;
+    }
+    for (t = 0; t < threads_created; ++t) {
+        res = pthread_join(thread[t], NULL);
+        if (res) {
+            return_value = fail_msg(freesasa_thread_error(res));
+        }
+    }
+    return return_value;
+}
+
+static void*
+gb_thread(void *arg)
+{
+    int i, n_pending = 0;
+    gb_thread_interval *ti = ((gb_thread_interval*) arg);
+
+    for (i = ti->first_atom; i <= ti->last_atom; ++i) {
+        /* the different threads write to different parts of the
+           array, so locking shouldn't be necessary */
+        ti->gb->sasa[i] = atom_area(ti->gb, i, ti->thread_id);
+        if (freesasa_progress_tick(ti->gb->progress, &n_pending)) break;
+    }
+    freesasa_progress_flush(ti->gb->progress, &n_pending);
+    pthread_exit(NULL);
+}
+#endif /* USE_THREADS */
+
+static inline double
+dot(const double *a, const double *b)
+{
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+static inline void
+cross(double *c, const double *a, const double *b)
+{
+    c[0] = a[1]*b[2] - a[2]*b[1];
+    c[1] = a[2]*b[0] - a[0]*b[2];
+    c[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+/** Orthonormal basis e1, e2 perpendicular to n, with e1 x e2 = n */
+static void
+circle_basis(double *e1, double *e2, const double *n)
+{
+    double a[3] = {0, 0, 0}, norm;
+
+    /* pick the coordinate axis least aligned with n */
+    if (fabs(n[0]) <= fabs(n[1]) && fabs(n[0]) <= fabs(n[2])) a[0] = 1;
+    else if (fabs(n[1]) <= fabs(n[2])) a[1] = 1;
+    else a[2] = 1;
+
+    cross(e1, n, a);
+    norm = sqrt(dot(e1, e1));
+    e1[0] /= norm; e1[1] /= norm; e1[2] /= norm;
+    cross(e2, n, e1);
+}
+
+/** Angle of point p around axis of circle j, in [0, 2 pi) */
+static inline double
+circle_angle(const gb_scratch *sc, int j, const double *p)
+{
+    double t = atan2(dot(p, sc->e2+3*j), dot(p, sc->e1+3*j));
+    return t < 0 ? t + 2*M_PI : t;
+}
+
+/** Point on circle j at angle t */
+static inline void
+circle_point(double *p, const gb_scratch *sc, int j, double t)
+{
+    const double *n = sc->n+3*j, *e1 = sc->e1+3*j, *e2 = sc->e2+3*j;
+    const double g = sc->g[j], s = sc->s[j], c = cos(t), d = sin(t);
+    p[0] = g*n[0] + s*(c*e1[0] + d*e2[0]);
+    p[1] = g*n[1] + s*(c*e1[1] + d*e2[1]);
+    p[2] = g*n[2] + s*(c*e1[2] + d*e2[2]);
+}
+
+/** Unit tangent of circle j at angle t, in the direction of decreasing t */
+static inline void
+circle_tangent(double *tangent, const gb_scratch *sc, int j, double t)
+{
+    const double *e1 = sc->e1+3*j, *e2 = sc->e2+3*j;
+    const double c = cos(t), d = sin(t);
+    tangent[0] = d*e1[0] - c*e2[0];
+    tangent[1] = d*e1[1] - c*e2[1];
+    tangent[2] = d*e1[2] - c*e2[2];
+}
+
+/** Is point p (on the unit sphere) strictly inside any cap but j */
+static int
+point_buried(const gb_scratch *sc, int m, int j, const double *p)
+{
+    int k;
+    for (k = 0; k < m; ++k) {
+        if (k == j || sc->status[k] != CAP_ACTIVE) continue;
+        if (dot(p, sc->n+3*k) > sc->g[k]) return 1;
+    }
+    return 0;
+}
+
+/**
+    Is the whole circle j inside (or touching from the inside) any
+    other cap. The point on circle j furthest from the axis of cap k
+    is at cos(theta_j + angle(n_j, n_k)).
+ */
+static int
+circle_buried(const gb_scratch *sc, int m, int j)
+{
+    double c;
+    int k;
+
+    for (k = 0; k < m; ++k) {
+        if (k == j || sc->status[k] != CAP_ACTIVE) continue;
+        c = dot(sc->n+3*j, sc->n+3*k);
+        if (c*sc->g[j] - sqrt(fmax(0, 1 - c*c))*sc->s[j] >= sc->g[k] - GB_EPS)
+            return 1;
+    }
+    return 0;
+}
+
+/* insertion sort (lists are short) */
+static void
+sort_points(double *t, int n)
+{
+    int i, j;
+    double tmp;
+
+    for (i = 1; i < n; ++i) {
+        tmp = t[i];
+        j = i;
+        while (j > 0 && t[j-1] > tmp) {
+            t[j] = t[j-1];
+            --j;
+        }
+        t[j] = tmp;
+    }
+}
+
+/**
+    Set up the caps on sphere i. Returns the number of caps, or -1 if
+    sphere i is completely buried inside one of its neighbors.
+ */
+static int
+setup_caps(gb_data *gb, gb_scratch *sc, int i)
+{
+    const int nni = gb->adj->nn[i];
+    const int *nbi = gb->adj->nb[i];
+    const double Ri = gb->radii[i];
+    double d, Rj, g, *n;
+    int j, k, m = 0;
+
+    for (j = 0; j < nni; ++j) {
+        Rj = gb->radii[nbi[j]];
+        n = sc->n + 3*m;
+        n[0] = gb->adj->xd[i][j];
+        n[1] = gb->adj->yd[i][j];
+        n[2] = gb->adj->zd[i][j];
+        d = sqrt(dot(n, n));
+
+        /* of two identical spheres, the one with the lowest index
+           is assumed to be the exposed one */
+        if (d == 0 && Ri == Rj) {
+            if (nbi[j] < i) return -1;
+            continue;
+        }
+        if (d + Ri <= Rj) return -1; /* sphere i inside j */
+        if (d + Rj <= Ri) continue;  /* sphere j inside i, no contact with surface */
+
+        g = (Ri*Ri + d*d - Rj*Rj) / (2*Ri*d);
+        if (g >= 1) continue;
+        if (g <= -1) return -1;
+
+        n[0] /= d; n[1] /= d; n[2] /= d;
+        sc->g[m] = g;
+        sc->s[m] = sqrt(1 - g*g);
+        sc->status[m] = CAP_ACTIVE;
+        ++m;
+    }
+
+    /* caps that are contained in other caps are redundant, the
+       check for status also removes only one of two identical caps */
+    for (k = 0; k < m; ++k) {
+        for (j = 0; j < m; ++j) {
+            if (j == k || sc->status[j] != CAP_ACTIVE) continue;
+            if (sc->g[j] <= sc->g[k] &&
+                dot(sc->n+3*j, sc->n+3*k) >= sc->g[j]*sc->g[k] + sc->s[j]*sc->s[k] - GB_EPS) {
+                sc->status[k] = CAP_IGNORE;
+                break;
+            }
+        }
+    }
+
+    for (j = 0; j < m; ++j) {
+        sc->n_point[j] = 0;
+        if (sc->status[j] == CAP_ACTIVE) {
+            circle_basis(sc->e1+3*j, sc->e2+3*j, sc->n+3*j);
+        }
+    }
+
+    return m;
+}
+
+/**
+    Find all intersections between circles and store the angles of
+    the intersection points on each circle.
+ */
+static void
+find_intersections(gb_scratch *sc, int m)
+{
+    double c, a, b, h2, h, nxn[3], p[3], q;
+    const double *nj, *nk;
+    int j, k, l;
+
+    for (j = 0; j < m; ++j) {
+        if (sc->status[j] != CAP_ACTIVE) continue;
+        nj = sc->n+3*j;
+        for (k = j+1; k < m; ++k) {
+            if (sc->status[k] != CAP_ACTIVE) continue;
+            nk = sc->n+3*k;
+            c = dot(nj, nk);
+
+            /* circles intersect if |theta_j - theta_k| < angle < theta_j + theta_k */
+            if (c >= sc->g[j]*sc->g[k] + sc->s[j]*sc->s[k] ||
+                c <= sc->g[j]*sc->g[k] - sc->s[j]*sc->s[k]) continue;
+
+            q = 1 - c*c;
+            if (q < GB_EPS) continue; /* (anti)parallel axes */
+            a = (sc->g[j] - c*sc->g[k]) / q;
+            b = (sc->g[k] - c*sc->g[j]) / q;
+            h2 = (1 - a*sc->g[j] - b*sc->g[k]) / q;
+            if (h2 < GB_EPS) continue; /* tangent circles */
+            h = sqrt(h2);
+
+            cross(nxn, nj, nk);
+            for (l = -1; l <= 1; l += 2) {
+                p[0] = a*nj[0] + b*nk[0] + l*h*nxn[0];
+                p[1] = a*nj[1] + b*nk[1] + l*h*nxn[1];
+                p[2] = a*nj[2] + b*nk[2] + l*h*nxn[2];
+                sc->point[2*m*j + sc->n_point[j]++] = circle_angle(sc, j, p);
+                sc->point[2*m*k + sc->n_point[k]++] = circle_angle(sc, k, p);
+            }
+        }
+    }
+}
+
+/**
+    Add the exposed arcs of circle j to the list of arcs, and their
+    contribution to the geodesic curvature integral to *sum. Returns
+    the new number of arcs.
+ */
+static int
+exposed_arcs(gb_scratch *sc, int m, int j, int n_arc, double *sum)
+{
+    const int n_point = sc->n_point[j];
+    double *t = sc->point + 2*m*j;
+    double t0, t1, p[3];
+    gb_arc *arc;
+    int l;
+
+    sort_points(t, n_point);
+
+    for (l = 0; l < n_point; ++l) {
+        t0 = t[l];
+        t1 = (l + 1 < n_point) ? t[l+1] : t[0] + 2*M_PI;
+
+        /* skip arcs too short to matter, typically when more than
+           two circles meet in the same point */
+        if (2*sc->s[j]*sin(0.5*(t1 - t0)) < GB_VERTEX_TOL) continue;
+
+        circle_point(p, sc, j, 0.5*(t0 + t1));
+        if (point_buried(sc, m, j, p)) continue;
+
+        /* The exposed surface is to the left when the circle is
+           traversed in the direction of decreasing angle */
+        *sum += (t1 - t0)*sc->g[j];
+        arc = &sc->arc[n_arc++];
+        circle_point(arc->start, sc, j, t1);
+        circle_point(arc->end, sc, j, t0);
+        circle_tangent(arc->t_start, sc, j, t1);
+        circle_tangent(arc->t_end, sc, j, t0);
+        arc->next = -1;
+    }
+
+    return n_arc;
+}
+
+/**
+    Connect the arcs into loops and subtract the exterior angles at
+    the vertices from *sum. If several arcs start at the same point,
+    the one making the sharpest left turn bounds the same exposed
+    region as the incoming arc. Returns the number of loops.
+ */
+static int
+connect_arcs(gb_scratch *sc, int n_arc, double *sum)
+{
+    double d[3], c[3], turn, best_turn;
+    gb_arc *a, *b;
+    int i, j, n_loop = 0;
+
+    for (i = 0; i < n_arc; ++i) {
+        a = &sc->arc[i];
+        best_turn = -2*M_PI;
+        for (j = 0; j < n_arc; ++j) {
+            b = &sc->arc[j];
+            d[0] = a->end[0] - b->start[0];
+            d[1] = a->end[1] - b->start[1];
+            d[2] = a->end[2] - b->start[2];
+            if (dot(d, d) > GB_VERTEX_TOL*GB_VERTEX_TOL) continue;
+            cross(c, a->t_end, b->t_start);
+            turn = atan2(dot(c, a->end), dot(a->t_end, b->t_start));
+            if (turn > best_turn) {
+                best_turn = turn;
+                a->next = j;
+            }
+        }
+        if (a->next >= 0) *sum -= best_turn;
+        sc->visited[i] = 0;
+    }
+
+    for (i = 0; i < n_arc; ++i) {
+        if (sc->visited[i]) continue;
+        ++n_loop;
+        for (j = i; j >= 0 && !sc->visited[j]; j = sc->arc[j].next) {
+            sc->visited[j] = 1;
+        }
+    }
+
+    return n_loop;
+}
+
+static double
+atom_area(gb_data *gb,
+          int i,
+          int thread_id)
+{
+    gb_scratch *sc = &gb->scratch[thread_id];
+    const double Ri = gb->radii[i];
+    const double four_pi = 4*M_PI;
+    int m, j, n_arc = 0, n_loop = 0, n_active = 0;
+    double sum = 0, cap_area = 0, r;
+
+    m = setup_caps(gb, sc, i);
+    if (m < 0) return 0;
+
+    find_intersections(sc, m);
+
+    for (j = 0; j < m; ++j) {
+        if (sc->status[j] != CAP_ACTIVE) continue;
+        ++n_active;
+        cap_area += 2*M_PI*(1 - sc->g[j]);
+
+        if (circle_buried(sc, m, j)) continue;
+
+        if (sc->n_point[j] == 0) {
+            /* a circle without intersections forms a loop on its own */
+            ++n_loop;
+            sum += 2*M_PI*sc->g[j];
+        } else {
+            n_arc = exposed_arcs(sc, m, j, n_arc, &sum);
+        }
+    }
+
+    if (n_active == 0) return four_pi*Ri*Ri;
+
+    n_loop += connect_arcs(sc, n_arc, &sum);
+
+    /* no exposed boundary, the caps cover the whole sphere */
+    if (n_loop == 0) return 0;
+
+    sum += 2*M_PI*n_loop;
+    r = fmod(sum, four_pi);
+    if (r < 0) r += four_pi;
+
+    /* Values close to 0 or 4 pi are ambiguous, decide based on how
+       much of the sphere the caps could possibly cover */
+    if (r < 1e-9 && cap_area < 2*M_PI) r += four_pi;
+    if (r > four_pi - 1e-9 && cap_area >= 2*M_PI) r -= four_pi;
+    if (r < 0) r = 0;
+
+    return r*Ri*Ri;
+}
+
+#if USE_CHECK
+#include <check.h>
+
+START_TEST (test_circle_basis)
+{
+    double n[][3] = {{1,0,0}, {0,1,0}, {0,0,1}, {0.6,0,0.8}, {-0.48,0.6,0.64}};
+    double e1[3], e2[3], c[3];
+    int i;
+
+    for (i = 0; i < 5; ++i) {
+        circle_basis(e1, e2, n[i]);
+        ck_assert(fabs(dot(e1, e1) - 1) < 1e-10);
+        ck_assert(fabs(dot(e2, e2) - 1) < 1e-10);
+        ck_assert(fabs(dot(e1, n[i])) < 1e-10);
+        ck_assert(fabs(dot(e2, n[i])) < 1e-10);
+        cross(c, e1, e2);
+        ck_assert(fabs(c[0] - n[i][0]) < 1e-10);
+        ck_assert(fabs(c[1] - n[i][1]) < 1e-10);
+        ck_assert(fabs(c[2] - n[i][2]) < 1e-10);
+    }
+}
+END_TEST
+
+START_TEST (test_sort_points)
+{
+    double t[5] = {3, 1, 4, 0.5, 2};
+    int i;
+
+    sort_points(t, 5);
+    for (i = 0; i < 4; ++i) ck_assert(t[i] <= t[i+1]);
+    ck_assert(t[0] == 0.5);
+    ck_assert(t[4] == 4);
+}
+END_TEST
+
+TCase *
+test_GB_static()
+{
+    TCase *tc = tcase_create("sasa_gb.c static");
+    tcase_add_test(tc, test_circle_basis);
+    tcase_add_test(tc, test_sort_points);
+
+    return tc;
+}
+
+#endif /* USE_CHECK */
@@ -0,0 +1,692 @@
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+# define _USE_MATH_DEFINES
+#endif
+#include <math.h>
+
+#if USE_THREADS
+# include <pthread.h>
+# define MAX_LCPO_THREADS 16
+#else
+# define MAX_LCPO_THREADS 1
+#endif
+
+#include "freesasa_internal.h"
+#include "nb.h"
+
+/**
+   Approximate SASA from pairwise and triplet overlaps (LCPO, Weiser,
+   Shenkin and Still, J Comput Chem 20:217, 1999).
+
+   The SASA of atom i is approximated as
+
+       A_i = P1 S_i + P2 sum_j A_ij + P3 sum_j sum_k A_jk
+           + P4 sum_j A_ij sum_k A_jk,
+
+   where S_i = 4 pi R_i^2 is the area of the isolated sphere, A_ij is
+   the area of sphere i buried inside sphere j, j runs over the
+   neighbors of i and k over the common neighbors of i and j.
+
+   The original method uses parameters for each atom type. Here atoms
+   are instead identified by their radius and the number of atoms
+   bonded to them (atoms closer than LCPO_BOND_CUTOFF). The parameters
+   in the table below have been fitted against exact SASA values for
+   the radii of the ProtOr, NACCESS and OONS classifiers with the
+   default probe radius, using 1ubq, 1a0q, 2jo4 and 3bzd from
+   tests/data/. Atoms with other radii, or not enough examples in the
+   data set, use the parameters fitted to all atoms with the same
+   number of bonds. Atoms without any neighbors are not covered by the
+   fit and get the area S_i.
+ */
+
+/** Atoms closer than this (in Ångström) are considered bonded */
+#define LCPO_BOND_CUTOFF 2.1
+
+/** Radius tolerance when looking up parameters */
+#define LCPO_RADIUS_TOL 0.005
+
+/** Probe radius used when fitting parameters */
+#define LCPO_PROBE_RADIUS 1.4
+
+struct lcpo_param {
+    double radius; /* 0 means any radius */
+    int n_bond;    /* -1 means any number of bonds */
+    double p[4];
+};
+
+/* Autogenerated by the program scripts/lcpo_fit.c */
+static const struct lcpo_param lcpo_params[] = {
+    {0.00, -1, {0.58192, -0.181175, 0.000180422, 0.000151324}},
+    {0.00, 1, {0.736851, -0.229154, -0.00186696, 0.000314489}},
+    {0.00, 2, {0.50409, -0.15723, -0.000158962, 0.000150809}},
+    {0.00, 3, {0.191775, -0.0597633, -0.000222068, 6.52327e-05}},
+    {1.40, -1, {0.663949, -0.187509, -0.00128599, 0.000231106}},
+    {1.40, 1, {0.66445, -0.1876, -0.00128602, 0.000231117}},
+    {1.42, -1, {0.681481, -0.191464, -0.00111054, 0.000228113}},
+    {1.42, 1, {0.682193, -0.191643, -0.0011079, 0.000228085}},
+    {1.46, -1, {0.751444, -0.247636, -0.000912527, 0.000295601}},
+    {1.46, 1, {0.751444, -0.247636, -0.000912527, 0.000295601}},
+    {1.50, -1, {0.810694, -0.356046, -0.00129487, 0.000541155}},
+    {1.50, 1, {0.810911, -0.356284, -0.00130625, 0.000542419}},
+    {1.55, -1, {0.627321, -0.2177, -0.000511318, 0.000237008}},
+    {1.55, 1, {0.71891, -0.268017, -0.000840723, 0.00035199}},
+    {1.55, 2, {0.382337, -0.113603, -0.000266642, 0.00010933}},
+    {1.55, 3, {0.0442546, -0.0138676, 2.313e-05, 1.13834e-05}},
+    {1.61, -1, {0.193979, -0.0661969, -0.000159778, 7.24428e-05}},
+    {1.61, 3, {0.0612276, -0.0191045, 7.96464e-06, 1.7331e-05}},
+    {1.64, -1, {0.715381, -0.229702, -0.000270327, 0.000226821}},
+    {1.64, 1, {0.790909, -0.304811, -0.00113644, 0.000426063}},
+    {1.64, 2, {0.302423, -0.088511, -8.45734e-05, 8.02468e-05}},
+    {1.65, -1, {0.65082, -0.196241, 4.76656e-05, 0.000165079}},
+    {1.65, 1, {0.831949, -0.303764, -0.00100018, 0.000388059}},
+    {1.65, 2, {0.258772, -0.0710164, 1.93911e-05, 5.49612e-05}},
+    {1.75, -1, {0.565478, -0.186293, -0.000382341, 0.000197923}},
+    {1.75, 2, {0.615849, -0.207508, -0.000544432, 0.000233429}},
+    {1.75, 3, {0.112908, -0.0340252, 2.3216e-05, 2.77312e-05}},
+    {1.76, -1, {0.294206, -0.0896529, 0.000295201, 6.34297e-05}},
+    {1.76, 2, {0.571563, -0.189654, -0.000513654, 0.000214476}},
+    {1.76, 3, {0.131866, -0.0412667, 4.35172e-05, 3.53658e-05}},
+    {1.87, -1, {0.618319, -0.208721, 0.000261183, 0.000184119}},
+    {1.87, 1, {0.846945, -0.294731, -0.00253932, 0.000438347}},
+    {1.87, 2, {0.551984, -0.196072, -0.000823783, 0.000246322}},
+    {1.87, 3, {0.233316, -0.0685113, -0.000432463, 7.96529e-05}},
+    {1.88, -1, {0.606153, -0.207322, 0.000339277, 0.000184247}},
+    {1.88, 1, {0.85188, -0.300557, -0.00252307, 0.000451741}},
+    {1.88, 2, {0.522309, -0.184605, -0.000791235, 0.000237011}},
+    {1.88, 3, {0.22987, -0.0678266, -0.000439243, 8.09214e-05}},
+    {2.00, -1, {0.590468, -0.188443, 0.000695264, 0.000130276}},
+    {2.00, 1, {0.844975, -0.257027, -0.00156825, 0.000298479}},
+    {2.00, 2, {0.509425, -0.154964, 0.000345964, 0.00011681}},
+    {2.00, 3, {0.242103, -0.0648605, -0.000154187, 5.55406e-05}},
+};
+
+static const int n_lcpo_params = sizeof(lcpo_params) / sizeof(struct lcpo_param);
+
+/* calculation parameters and data (results stored in *sasa) */
+typedef struct {
+    int n_atoms;
+    int n_calc; /* the first n_calc atoms are calculated, the rest only bury them */
+    const double *xyz;
+    double *radii; /* including probe */
+    const double **p; /* LCPO parameters for each atom */
+    nb_list *adj;
+    /* distance, overlap and its derivative for each pair in the
+       neighbor list, pair jj of atom i has index offset[i] + jj */
+    int *offset;
+    double *dist, *area, *darea;
+    double *sasa; /* results */
+    double *gradient; /* gradient of total SASA, can be NULL */
+    double *mark[MAX_LCPO_THREADS]; /* 1 for neighbors of current atom, else 0 */
+    double *grad[MAX_LCPO_THREADS]; /* gradient from each thread */
+    int n_threads;
+    freesasa_progress *progress; /* can be NULL */
+} lcpo_data;
+
+typedef struct {
+    int first_atom;
+    int last_atom;
+    int thread_id;
+    lcpo_data *lcpo;
+} lcpo_thread_interval;
+
+#if USE_THREADS
+static int lcpo_do_threads(int n_threads, lcpo_data *lcpo);
+static void *lcpo_thread(void *arg);
+#endif
+
+static double
+atom_area(lcpo_data *lcpo, int i, int thread_id);
+
+/** Area of sphere i buried inside sphere j, and its derivative with respect to d */
+static inline double
+overlap(double Ri, double Rj, double d, double *deriv)
+{
+    double q;
+    /* concentric spheres, either the smaller one is inside the other
+       one, or it doesn't bury any of it */
+    if (d == 0) {
+        if (deriv) *deriv = 0;
+        return 0;
+    }
+    q = (Ri*Ri - Rj*Rj) / d;
+    if (deriv) *deriv = M_PI * Ri * (q/d - 1);
+    return M_PI * Ri * (2*Ri - d - q);
+}
+
+/** Add f times the derivative of a distance-dependent term to the gradient */
+static inline void
+add_gradient(double *grad, const double *v, int a, int b, double d, double f)
+{
+    const double s = f / d;
+    double u;
+    int l;
+
+    for (l = 0; l < 3; ++l) {
+        u = s * (v[3*b+l] - v[3*a+l]);
+        grad[3*b+l] += u;
+        grad[3*a+l] -= u;
+    }
+}
+
+/**
+    Find parameters for an atom, first by radius and number of bonds,
+    then by radius alone, then by bonds alone.
+ */
+static const double *
+find_param(double radius, int n_bond)
+{
+    const struct lcpo_param *best = NULL;
+    int i, score, best_score = -1;
+
+    if (n_bond > 4) n_bond = 4;
+
+    for (i = 0; i < n_lcpo_params; ++i) {
+        const struct lcpo_param *lp = &lcpo_params[i];
+        score = 0;
+        if (lp->radius > 0) {
+            if (fabs(lp->radius - radius) > LCPO_RADIUS_TOL) continue;
+            score += 2;
+        }
+        if (lp->n_bond >= 0) {
+            if (lp->n_bond != n_bond) continue;
+            score += 1;
+        }
+        if (score > best_score) {
+            best_score = score;
+            best = lp;
+        }
+    }
+    assert(best);
+    return best->p;
+}
+
+static void
+release_lcpo(lcpo_data *lcpo)
+{
+    int i;
+
+    free(lcpo->radii);
+    free(lcpo->p);
+    free(lcpo->offset);
+    free(lcpo->dist);
+    free(lcpo->area);
+    free(lcpo->darea);
+    freesasa_nb_free(lcpo->adj);
+    for (i = 0; i < MAX_LCPO_THREADS; ++i) {
+        free(lcpo->mark[i]);
+        free(lcpo->grad[i]);
+        lcpo->mark[i] = NULL;
+        lcpo->grad[i] = NULL;
+    }
+    lcpo->radii = NULL;
+    lcpo->p = NULL;
+    lcpo->offset = NULL;
+    lcpo->dist = lcpo->area = lcpo->darea = NULL;
+    lcpo->adj = NULL;
+}
+
+static int
+init_lcpo(lcpo_data *lcpo,
+          double *sasa,
+          double *gradient,
+          const coord_t *xyz,
+          const double *atom_radii,
+          double probe_radius,
+          int n_threads)
+{
+    const int n_atoms = freesasa_coord_n(xyz);
+    const double *v = freesasa_coord_all(xyz);
+    double d;
+    int i, j, k, n_bond, n_pair;
+
+    memset(lcpo, 0, sizeof(lcpo_data));
+    lcpo->n_atoms = n_atoms;
+    lcpo->n_calc = n_atoms;
+    lcpo->xyz = v;
+    lcpo->sasa = sasa;
+    lcpo->gradient = gradient;
+    lcpo->n_threads = n_threads;
+
+    lcpo->radii = malloc(sizeof(double) * n_atoms);
+    lcpo->p = malloc(sizeof(double*) * n_atoms);
+    if (lcpo->radii == NULL || lcpo->p == NULL) goto memerr;
+
+    for (i = 0; i < n_atoms; ++i) {
+        lcpo->radii[i] = atom_radii[i] + probe_radius;
+    }
+
+    lcpo->adj = freesasa_nb_new(xyz, lcpo->radii);
+    if (lcpo->adj == NULL) {
+        release_lcpo(lcpo);
+        return fail_msg("");
+    }
+
+    lcpo->offset = malloc(sizeof(int) * (n_atoms + 1));
+    if (lcpo->offset == NULL) goto memerr;
+    lcpo->offset[0] = 0;
+    for (i = 0; i < n_atoms; ++i) {
+        lcpo->offset[i+1] = lcpo->offset[i] + lcpo->adj->nn[i];
+    }
+    n_pair = lcpo->offset[n_atoms];
+
+    /* avoid zero-sized mallocs if there are no contacts */
+    lcpo->dist = malloc(sizeof(double) * (n_pair + 1));
+    lcpo->area = malloc(sizeof(double) * (n_pair + 1));
+    lcpo->darea = malloc(sizeof(double) * (n_pair + 1));
+    if (!lcpo->dist || !lcpo->area || !lcpo->darea) goto memerr;
+
+    for (i = 0; i < n_atoms; ++i) {
+        n_bond = 0;
+        for (j = 0; j < lcpo->adj->nn[i]; ++j) {
+            k = lcpo->adj->nb[i][j];
+            /* from the neighbor list, to handle periodic coordinates */
+            d = sqrt(lcpo->adj->xyd[i][j]*lcpo->adj->xyd[i][j] +
+                     lcpo->adj->zd[i][j]*lcpo->adj->zd[i][j]);
+            lcpo->dist[lcpo->offset[i] + j] = d;
+            lcpo->area[lcpo->offset[i] + j] =
+                overlap(lcpo->radii[i], lcpo->radii[k], d, &lcpo->darea[lcpo->offset[i] + j]);
+            /* j inside i, i.e. no contact with surface */
+            if (lcpo->area[lcpo->offset[i] + j] < 0) {
+                lcpo->area[lcpo->offset[i] + j] = lcpo->darea[lcpo->offset[i] + j] = 0;
+            }
+            if (d < LCPO_BOND_CUTOFF) ++n_bond;
+        }
+        lcpo->p[i] = find_param(atom_radii[i], n_bond);
+    }
+
+    for (i = 0; i < n_threads; ++i) {
+        lcpo->mark[i] = calloc(n_atoms, sizeof(double));
+        if (lcpo->mark[i] == NULL) goto memerr;
+        if (gradient) {
+            lcpo->grad[i] = calloc(3 * n_atoms, sizeof(double));
+            if (lcpo->grad[i] == NULL) goto memerr;
+        }
+    }
+
+    return FREESASA_SUCCESS;
+
+ memerr:
+    release_lcpo(lcpo);
+    return mem_fail();
+}
+
+int
+freesasa_lcpo(double *sasa,
+              double *gradient,
+              const coord_t *xyz,
+              const double *atom_radii,
+              int n_calc,
+              const freesasa_parameters *param,
+              freesasa_progress *progress)
+{
+    int return_value, n_atoms, n_threads, i, t, n_pending = 0;
+    lcpo_data lcpo;
+
+    assert(sasa);
+    assert(xyz);
+    assert(atom_radii);
+
+    if (param == NULL) param = &freesasa_default_parameters;
+
+    return_value = FREESASA_SUCCESS;
+    n_atoms = freesasa_coord_n(xyz);
+    n_threads = param->n_threads;
+
+    assert(n_calc <= n_atoms);
+
+    if (n_threads > MAX_LCPO_THREADS) {
+        return fail_msg("LCPO does not support more than %d threads", MAX_LCPO_THREADS);
+    }
+
+    if (n_calc == 0) {
+        return freesasa_warn("in %s(): empty coordinates", __func__);
+    }
+
+    if (fabs(param->probe_radius - LCPO_PROBE_RADIUS) > 1e-10) {
+        return_value = freesasa_warn("LCPO parameters are fitted for a probe radius of %.2f Å, "
+                                     "results for other probe radii are less accurate",
+                                     LCPO_PROBE_RADIUS);
+    }
+
+    if (n_threads > n_calc) {
+        n_threads = n_calc;
+        freesasa_warn("no sense in having more threads than atoms, only using %d threads",
+                      n_threads);
+    }
+
+#if !USE_THREADS
+    if (n_threads > 1) {
+        return_value = freesasa_warn("in %s(): program compiled for single-threaded use, "
+                                     "but multiple threads were requested, will "
+                                     "proceed in single-threaded mode\n",
+                                     __func__);
+        n_threads = 1;
+    }
+#endif
+
+    if (init_lcpo(&lcpo, sasa, gradient, xyz, atom_radii,
+                  param->probe_radius, n_threads))
+        return FREESASA_FAIL;
+    lcpo.progress = progress;
+    lcpo.n_calc = n_calc;
+
+    if (n_threads > 1) {
+#if USE_THREADS
+        if (lcpo_do_threads(n_threads, &lcpo) == FREESASA_FAIL)
+            return_value = FREESASA_FAIL;
+#endif
+    } else {
+        for (i = 0; i < n_calc; ++i) {
+            sasa[i] = atom_area(&lcpo, i, 0);
+            if (freesasa_progress_tick(progress, &n_pending)) break;
+        }
+        freesasa_progress_flush(progress, &n_pending);
+    }
+    if (freesasa_progress_cancelled(progress)) return_value = FREESASA_FAIL;
+
+    if (gradient) {
+        memset(gradient, 0, sizeof(double) * 3 * n_atoms);
+        for (t = 0; t < n_threads; ++t) {
+            for (i = 0; i < 3*n_atoms; ++i) {
+                gradient[i] += lcpo.grad[t][i];
+            }
+        }
+    }
+
+    release_lcpo(&lcpo);
+    return return_value;
+}
+
+#if USE_THREADS
+static int
+lcpo_do_threads(int n_threads,
+                lcpo_data *lcpo)
+{
+    pthread_t thread[MAX_LCPO_THREADS];
+    lcpo_thread_interval t_data[MAX_LCPO_THREADS];
+    int n_perthread = lcpo->n_calc/n_threads, res;
+    int threads_created = 0, return_value = FREESASA_SUCCESS;
+    int t;
+
+    for (t = 0; t < n_threads; ++t) {
+        t_data[t].first_atom = t*n_perthread;
+        if (t == n_threads-1) {
+            t_data[t].last_atom = lcpo->n_calc - 1;
+        } else {
+            t_data[t].last_atom = (t+1)*n_perthread - 1;
+        }
+        t_data[t].lcpo = lcpo;
+        t_data[t].thread_id = t;
+        res = freesasa_thread_create(&thread[t], lcpo_thread,
+                                     (void *) &t_data[t]);
+        if (res) {
+            return_value = fail_msg(freesasa_thread_error(res));
+            break;
+        }
+        ++threads_created;
+    }
+    for (t = 0; t < threads_created; ++t) {
+        res = pthread_join(thread[t], NULL);
+        if (res) {
+            return_value = fail_msg(freesasa_thread_error(res));
+        }
+    }
+    return return_value;
+}
+
+static void*
+lcpo_thread(void *arg)
+{
+    int i, n_pending = 0;
+    lcpo_thread_interval *ti = ((lcpo_thread_interval*) arg);
+
+    for (i = ti->first_atom; i <= ti->last_atom; ++i) {
+        /* the different threads write to different parts of the
+           array, so locking shouldn't be necessary */
+        ti->lcpo->sasa[i] = atom_area(ti->lcpo, i, ti->thread_id);
+        if (freesasa_progress_tick(ti->lcpo->progress, &n_pending)) break;
+    }
+    freesasa_progress_flush(ti->lcpo->progress, &n_pending);
+    pthread_exit(NULL);
+}
+#endif /* USE_THREADS */
+
+/**
+    Terms of the LCPO sum for atom i. If grad is not NULL, the
+    derivatives of the terms, weighted by the parameters p, are added
+    to it.
+ */
+static void
+lcpo_terms(lcpo_data *lcpo,
+           int i,
+           int thread_id,
+           double *terms,
+           const double *p,
+           double *grad)
+{
+    const double *v = lcpo->xyz, *area = lcpo->area, *darea = lcpo->darea, *dist = lcpo->dist;
+    const int nni = lcpo->adj->nn[i], *nbi = lcpo->adj->nb[i];
+    const int oi = lcpo->offset[i];
+    const double Ri = lcpo->radii[i];
+    double *mark = lcpo->mark[thread_id];
+    double Aij, sum_jk;
+    int j, k, jj, kk, nnj, oj;
+    const int *nbj;
+
+    terms[0] = 4*M_PI*Ri*Ri;
+    terms[1] = terms[2] = terms[3] = 0;
+
+    for (jj = 0; jj < nni; ++jj) mark[nbi[jj]] = 1;
+
+    for (jj = 0; jj < nni; ++jj) {
+        Aij = area[oi + jj];
+        if (Aij <= 0) continue;
+        j = nbi[jj];
+        nbj = lcpo->adj->nb[j];
+        nnj = lcpo->adj->nn[j];
+        oj = lcpo->offset[j];
+        sum_jk = 0;
+        if (grad) {
+            for (kk = 0; kk < nnj; ++kk) {
+                k = nbj[kk];
+                if (mark[k] == 0) continue;
+                sum_jk += area[oj + kk];
+                add_gradient(grad, v, j, k, dist[oj + kk],
+                             darea[oj + kk]*(p[2] + p[3]*Aij));
+            }
+        } else {
+            /* branch-free, a test for membership would be hard to predict */
+            for (kk = 0; kk < nnj; ++kk) {
+                sum_jk += mark[nbj[kk]] * area[oj + kk];
+            }
+        }
+        terms[1] += Aij;
+        terms[2] += sum_jk;
+        terms[3] += Aij * sum_jk;
+        if (grad) add_gradient(grad, v, i, j, dist[oi + jj],
+                               darea[oi + jj]*(p[1] + p[3]*sum_jk));
+    }
+
+    for (jj = 0; jj < nni; ++jj) mark[nbi[jj]] = 0;
+}
+
+/** Is atom i completely inside one of its neighbors */
+static int
+inside_neighbor(const lcpo_data *lcpo,
+                int i)
+{
+    int l;
+
+    for (l = 0; l < lcpo->adj->nn[i]; ++l) {
+        if (lcpo->dist[lcpo->offset[i] + l] + lcpo->radii[i] <= lcpo->radii[lcpo->adj->nb[i][l]])
+            return 1;
+    }
+    return 0;
+}
+
+static double
+atom_area(lcpo_data *lcpo,
+          int i,
+          int thread_id)
+{
+    const double *p = lcpo->p[i];
+    double terms[4], area, *grad = lcpo->grad[thread_id];
+
+    /* the overlap terms are not meaningful in this case */
+    if (inside_neighbor(lcpo, i)) return 0;
+
+    /* the parameters are fitted to atoms with neighbors, an isolated
+       atom is fully exposed */
+    if (lcpo->adj->nn[i] == 0) return 4*M_PI*lcpo->radii[i]*lcpo->radii[i];
+
+    lcpo_terms(lcpo, i, thread_id, terms, p, NULL);
+    area = p[0]*terms[0] + p[1]*terms[1] + p[2]*terms[2] + p[3]*terms[3];
+
+    /* the approximation can give negative values for buried atoms */
+    if (area <= 0) return 0;
+
+    if (grad) lcpo_terms(lcpo, i, thread_id, terms, p, grad);
+
+    return area;
+}
+
+#if USE_CHECK
+#include <check.h>
+
+START_TEST (test_overlap)
+{
+    double d, deriv, h = 1e-6;
+    /* touching spheres don't overlap */
+    ck_assert(fabs(overlap(1, 2, 3, NULL)) < 1e-12);
+    /* equal spheres: the buried cap has height R - d/2 */
+    ck_assert(fabs(overlap(2, 2, 1.5, NULL) - 2*M_PI*2*(2 - 0.75)) < 1e-12);
+    for (d = 1.5; d < 3; d += 0.3) {
+        overlap(1.5, 1.8, d, &deriv);
+        ck_assert(fabs((overlap(1.5, 1.8, d+h, NULL) - overlap(1.5, 1.8, d-h, NULL))/(2*h)
+                       - deriv) < 1e-6);
+    }
+}
+END_TEST
+
+START_TEST (test_concentric)
+{
+    /* the small sphere is inside the large one, and doesn't bury any
+       of it */
+    double v[6] = {1, 2, 3, 1, 2, 3};
+    double r[2] = {2, 1.5};
+    double sasa[2], grad[6], deriv = 1;
+    freesasa_parameters param = freesasa_default_parameters;
+    coord_t *xyz = freesasa_coord_new_linked(v, 2);
+    int i;
+
+    ck_assert(overlap(2, 1, 0, &deriv) == 0);
+    ck_assert(deriv == 0);
+    param.n_threads = 1;
+    ck_assert_int_eq(freesasa_lcpo(sasa, grad, xyz, r, 2, &param, NULL), FREESASA_SUCCESS);
+    ck_assert(sasa[0] > 0 && sasa[0] <= 4*M_PI*3.4*3.4);
+    ck_assert(sasa[1] == 0);
+    for (i = 0; i < 6; ++i) ck_assert(isfinite(grad[i]));
+    freesasa_coord_free(xyz);
+}
+END_TEST
+
+START_TEST (test_find_param)
+{
+    int i;
+    /* generic parameters for any number of bonds */
+    const double *generic = NULL, *p;
+    for (i = 0; i < n_lcpo_params; ++i) {
+        if (lcpo_params[i].radius == 0 && lcpo_params[i].n_bond == -1)
+            generic = lcpo_params[i].p;
+    }
+    ck_assert_ptr_ne(generic, NULL);
+    /* unknown radius with unusual number of bonds falls back to generic */
+    p = find_param(3.33, 0);
+    ck_assert_ptr_ne(p, NULL);
+    /* all entries can be found */
+    for (i = 0; i < n_lcpo_params; ++i) {
+        if (lcpo_params[i].radius > 0 && lcpo_params[i].n_bond >= 0) {
+            ck_assert_ptr_eq(find_param(lcpo_params[i].radius, lcpo_params[i].n_bond),
+                             lcpo_params[i].p);
+        }
+    }
+}
+END_TEST
+
+START_TEST (test_isolated)
+{
+    /* isolated atoms get the area of the sphere, the parameters
+       would give about 0.6 of it */
+    double v[6] = {0, 0, 0, 10, 0, 0};
+    double r[2] = {2, 1.5};
+    double sasa[2], grad[6];
+    const double R0 = 2 + 1.4, R1 = 1.5 + 1.4;
+    freesasa_parameters param = freesasa_default_parameters;
+    coord_t *xyz = freesasa_coord_new_linked(v, 1);
+    int i;
+
+    param.n_threads = 1;
+    ck_assert_int_eq(freesasa_lcpo(sasa, NULL, xyz, r, 1, &param, NULL), FREESASA_SUCCESS);
+    ck_assert(fabs(sasa[0] - 4*M_PI*R0*R0) < 1e-10);
+    freesasa_coord_free(xyz);
+
+    /* two atoms too far apart to touch */
+    xyz = freesasa_coord_new_linked(v, 2);
+    ck_assert_int_eq(freesasa_lcpo(sasa, grad, xyz, r, 2, &param, NULL), FREESASA_SUCCESS);
+    ck_assert(fabs(sasa[0] - 4*M_PI*R0*R0) < 1e-10);
+    ck_assert(fabs(sasa[1] - 4*M_PI*R1*R1) < 1e-10);
+    for (i = 0; i < 6; ++i) ck_assert(grad[i] == 0);
+    freesasa_coord_free(xyz);
+}
+END_TEST
+
+START_TEST (test_gradient)
+{
+    /* small cluster without bonds, so that the parameters don't
+       change when the atoms are displaced */
+    double v[15] = {0, 0, 0,  2.6, 0, 0,  1.2, 2.4, 0,  1, 0.8, 2.7,  -2.2, 1.5, -0.7};
+    double r[5] = {1.8, 1.7, 1.9, 1.6, 1.8};
+    double sasa[5], sasa_p[5], sasa_m[5], grad[15], total_p, total_m, h = 1e-6;
+    freesasa_parameters param = freesasa_default_parameters;
+    coord_t *xyz = freesasa_coord_new_linked(v, 5);
+    int i, j;
+
+    param.n_threads = 1;
+    ck_assert_int_eq(freesasa_lcpo(sasa, grad, xyz, r, freesasa_coord_n(xyz), &param, NULL), FREESASA_SUCCESS);
+    for (i = 0; i < 15; ++i) {
+        v[i] += h;
+        freesasa_lcpo(sasa_p, NULL, xyz, r, freesasa_coord_n(xyz), &param, NULL);
+        v[i] -= 2*h;
+        freesasa_lcpo(sasa_m, NULL, xyz, r, freesasa_coord_n(xyz), &param, NULL);
+        v[i] += h;
+        total_p = total_m = 0;
+        for (j = 0; j < 5; ++j) {
+            total_p += sasa_p[j];
+            total_m += sasa_m[j];
+        }
+        ck_assert(fabs((total_p - total_m)/(2*h) - grad[i]) < 1e-4);
+    }
+    freesasa_coord_free(xyz);
+}
+END_TEST
+
+TCase *
+test_LCPO_static()
+{
+    TCase *tc = tcase_create("sasa_lcpo.c static");
+    tcase_add_test(tc, test_overlap);
+    tcase_add_test(tc, test_concentric);
+    tcase_add_test(tc, test_find_param);
+    tcase_add_test(tc, test_isolated);
+    tcase_add_test(tc, test_gradient);
+
+    return tc;
+}
+
+#endif /* USE_CHECK */
@@ -21,25 +21,70 @@
 
 #include "freesasa_internal.h"
 #include "nb.h"
+#include "buried.h"
+
+/* upper limit for the number of slices per atom in adaptive mode */
+#define LR_MAX_ADAPTIVE_SLICES 2000
+
+/* below this number of slices buried atoms are cheaper to calculate
+   than to detect with freesasa_atom_buried() */
+#ifndef LR_MIN_SLICES_BURIED_SCREEN
+#define LR_MIN_SLICES_BURIED_SCREEN 20
+#endif
 
 const double TWOPI = 2*M_PI;
 
 /* calculation parameters and data (results stored in *sasa) */
 typedef struct {
     int n_atoms;
-    double *radii; /* including probe */
+    int n_calc; /* the first n_calc atoms are calculated, the rest only bury them */
+    double *radii; /* including largest probe */
     const coord_t *xyz;
     nb_list *adj;
     int n_slices_per_atom;
-    double *sasa; /* results */
+    double target_error; /* per atom, 0 if resolution is fixed */
+    int screen_buried; /* skip atoms found by freesasa_atom_buried() */
+    int n_probes;
+    int *probe_order; /* probe indices in order of increasing radius */
+    double *probe_shifts; /* largest probe minus each probe, in the same order */
+    double *sasa; /* results, n_probes values per atom */
     double *arc[MAX_LR_THREADS], *z_nb[MAX_LR_THREADS], *R_nb[MAX_LR_THREADS];
+    /* the neighbors in contact with the current atom and probe */
+    double *xyd_nb[MAX_LR_THREADS], *beta_nb[MAX_LR_THREADS];
+    int nn[MAX_LR_THREADS];
+    /* only used in adaptive mode: the positions of the neighbors
+       relative to the current atom, and the heights where its exposed
+       length can change non-smoothly */
+    double *xyz_nb[MAX_LR_THREADS], *z_break[MAX_LR_THREADS];
+    double *buried_work[MAX_LR_THREADS];
+    double probe_shift[MAX_LR_THREADS]; /* subtracted from radii for the current probe */
+    double *gradient; /* gradient of total SASA, can be NULL */
+    double *grad[MAX_LR_THREADS]; /* gradient from each thread */
+    /* only used for gradients: index of each neighbor in contact, the
+       derivatives of the end-points of its arc with respect to its
+       position, which neighbor each stored arc end-point belongs to
+       (-1 for 0 and 2*PI), and the gradient of the area of the
+       current atom with respect to the position of each neighbor */
+    int *idx_nb[MAX_LR_THREADS], *arc_owner[MAX_LR_THREADS];
+    double *darc[MAX_LR_THREADS], *dA_nb[MAX_LR_THREADS];
+    int nb_capacity[MAX_LR_THREADS]; /* size of the work arrays of each thread */
+    int n_unconverged[MAX_LR_THREADS]; /* atoms that didn't reach target_error */
+    int n_skipped[MAX_LR_THREADS]; /* buried atoms */
     int n_threads;
+    /* NUMA-aware mode: cells used by the threads to fill the neighbor
+       lists of their own atoms, and the atoms of each thread (NULL
+       otherwise) */
+    nb_cells *cells;
+    int *order;
+    int pin_threads;
+    freesasa_progress *progress; /* can be NULL */
 } lr_data;
 
 typedef struct {
     int first_atom;
     int last_atom;
     int thread_id;
+    int status;
     lr_data *lr;
 } lr_thread_interval;
 
@@ -48,15 +93,61 @@ static int lr_do_threads(int n_threads, lr_data*);
 static void *lr_thread(void *arg);
 #endif
 
-/** Returns the are of atom i */
+/** Stores the area of atom i for each probe radius in lr->sasa */
+static void
+atom_areas(lr_data *lr, int i, int thread_id);
+
+/** Returns the are of atom i, for the current probe radius */
 static double
 atom_area(lr_data *lr, int i, int thread_id);
 
+/** Returns the area of atom i, refining the slices locally until the
+    estimated error is below lr->target_error, see
+    atom_area_adaptive() for details */
+static double
+atom_area_adaptive(lr_data *lr, int i, int thread_id);
+
 /** Sum of exposed arcs based on buried arc intervals arc, assumes no
     intervals cross zero */
 static double
 exposed_arc_length(double *restrict arc, int n);
 
+/** As exposed_arc_length(), but also adds the derivative of the
+    exposed length with respect to the position of each neighbor,
+    times f, to dA. Also sorts owner together with arc. */
+static double
+exposed_arc_length_gradient(double *restrict arc,
+                            int *restrict owner,
+                            int n,
+                            const double *restrict darc,
+                            double f,
+                            double *restrict dA);
+
+/** Free the work arrays of thread i that depend on the number of
+    neighbors */
+static void
+free_lr_thread_arrays(lr_data *lr, int i)
+{
+    free(lr->arc[i]);
+    free(lr->z_nb[i]);
+    free(lr->R_nb[i]);
+    free(lr->xyd_nb[i]);
+    free(lr->beta_nb[i]);
+    free(lr->buried_work[i]);
+    free(lr->idx_nb[i]);
+    free(lr->arc_owner[i]);
+    free(lr->darc[i]);
+    free(lr->dA_nb[i]);
+    free(lr->xyz_nb[i]);
+    free(lr->z_break[i]);
+    lr->arc[i] = lr->z_nb[i] = lr->R_nb[i] = NULL;
+    lr->xyd_nb[i] = lr->beta_nb[i] = lr->buried_work[i] = NULL;
+    lr->darc[i] = lr->dA_nb[i] = NULL;
+    lr->xyz_nb[i] = lr->z_break[i] = NULL;
+    lr->idx_nb[i] = lr->arc_owner[i] = NULL;
+    lr->nb_capacity[i] = 0;
+}
+
 /** Release contenst of lr_data pointer*/
 static void
 release_lr(lr_data *lr)
@@ -64,34 +155,64 @@ release_lr(lr_data *lr)
     int i;
 
     free(lr->radii);
+    free(lr->probe_order);
+    free(lr->probe_shifts);
     freesasa_nb_free(lr->adj);
+    freesasa_nb_cells_free(lr->cells);
+    free(lr->order);
     lr->radii = NULL;
+    lr->probe_order = NULL;
+    lr->probe_shifts = NULL;
     lr->adj = NULL;
+    lr->cells = NULL;
+    lr->order = NULL;
 
     for (i = 0; i < lr->n_threads; ++i) {
-        free(lr->arc[i]);
-        free(lr->z_nb[i]);
-        free(lr->R_nb[i]);
+        free_lr_thread_arrays(lr, i);
+        free(lr->grad[i]);
+        lr->grad[i] = NULL;
     }
 }
 
-/* Allocate some helper arrays in area calculation that need to be pre-allocated */
+/* Allocate the helper arrays of thread i for the area calculation,
+   for atoms with at most max_nni neighbors. Arrays allocated earlier
+   are replaced. */
 static int
-alloc_lr_calc_arrays(lr_data *lr, int n_threads) {
-    int max_nni = 0, i, nni;
+alloc_lr_thread_arrays(lr_data *lr, int i, int max_nni) {
     const int n_atoms = lr->n_atoms;
 
-    for (i = 0; i < n_atoms; ++i) {
-        nni = lr->adj->nn[i];
-        max_nni = max_nni < nni ? nni : max_nni;
+    free_lr_thread_arrays(lr, i);
+    lr->nb_capacity[i] = max_nni;
+    lr->arc[i] = malloc(sizeof(double) * 4 * max_nni);
+    lr->z_nb[i] = malloc(sizeof(double) * max_nni);
+    lr->R_nb[i] = malloc(sizeof(double) * max_nni);
+    lr->xyd_nb[i] = malloc(sizeof(double) * max_nni);
+    lr->beta_nb[i] = malloc(sizeof(double) * max_nni);
+    lr->buried_work[i] = malloc(sizeof(double) * FREESASA_BURIED_WORK_SIZE(max_nni));
+
+    if (!lr->arc[i] || !lr->z_nb[i] || !lr->R_nb[i] || !lr->xyd_nb[i] ||
+        !lr->beta_nb[i] || !lr->buried_work[i]) {
+        return mem_fail();
     }
 
-    for (i = 0; i < n_threads; ++i) {
-        lr->arc[i] = malloc(sizeof(double) * 4 * max_nni);
-        lr->z_nb[i] = malloc(sizeof(double) * max_nni);
-        lr->R_nb[i] = malloc(sizeof(double) * max_nni);
+    if (lr->target_error > 0) {
+        /* the ends of the atom, two extremes for each neighbor, and
+           two crossings for each pair of neighbors */
+        lr->xyz_nb[i] = malloc(sizeof(double) * 3 * max_nni);
+        lr->z_break[i] = malloc(sizeof(double) * (2 + max_nni * (max_nni + 1)));
+        if (!lr->xyz_nb[i] || !lr->z_break[i]) {
+            return mem_fail();
+        }
+    }
 
-        if (!lr->arc[i] || !lr->z_nb[i] || !lr->R_nb[i]) {
+    if (lr->gradient) {
+        if (lr->grad[i] == NULL) lr->grad[i] = calloc(3 * n_atoms, sizeof(double));
+        lr->idx_nb[i] = malloc(sizeof(int) * max_nni);
+        lr->arc_owner[i] = malloc(sizeof(int) * 4 * max_nni);
+        lr->darc[i] = malloc(sizeof(double) * 6 * max_nni);
+        lr->dA_nb[i] = malloc(sizeof(double) * 3 * max_nni);
+        if (!lr->grad[i] || !lr->idx_nb[i] || !lr->arc_owner[i] ||
+            !lr->darc[i] || !lr->dA_nb[i]) {
             return mem_fail();
         }
     }
@@ -99,44 +220,131 @@ alloc_lr_calc_arrays(lr_data *lr, int n_threads) {
     return FREESASA_SUCCESS;
 }
 
-/** Initialize object to be used for L&R calculation */
+/* Allocate some helper arrays in area calculation that need to be
+   pre-allocated, for atoms with at most max_nni neighbors */
 static int
-init_lr(lr_data *lr,
-        double *sasa,
-        const coord_t *xyz,
-        const double *atom_radii,
-        double probe_radius,
-        int n_slices_per_atom,
-        int n_threads)
+alloc_lr_calc_arrays(lr_data *lr, int n_threads, int max_nni) {
+    int i;
+
+    for (i = 0; i < n_threads; ++i) {
+        if (alloc_lr_thread_arrays(lr, i, max_nni)) return FREESASA_FAIL;
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+/** Set parameters and allocate the arrays that only depend on the
+    number of atoms and probes, for init_lr() and
+    freesasa_lr_workspace_new() */
+static int
+prepare_lr(lr_data *lr,
+           double *gradient,
+           const coord_t *xyz,
+           int n_atoms,
+           int n_probes,
+           int n_slices_per_atom,
+           double target_error,
+           int n_threads)
 {
-    const int n_atoms = freesasa_coord_n(xyz);
     int i;
 
     lr->n_atoms = n_atoms;
+    lr->n_calc = n_atoms;
     lr->xyz = xyz;
     lr->adj = NULL;
+    lr->radii = NULL;
+    lr->n_probes = n_probes;
+    lr->probe_order = NULL;
+    lr->probe_shifts = NULL;
+    lr->gradient = gradient;
     lr->n_slices_per_atom = n_slices_per_atom;
-    lr->sasa = sasa;
+    lr->target_error = target_error;
+    lr->screen_buried = target_error > 0 ||
+        n_slices_per_atom >= LR_MIN_SLICES_BURIED_SCREEN;
+    lr->sasa = NULL;
     lr->n_threads = n_threads;
+    lr->cells = NULL;
+    lr->order = NULL;
+    lr->pin_threads = 0;
+    lr->progress = NULL;
 
     for (i = 0; i < n_threads; ++i) {
         lr->arc[i] = NULL;
         lr->z_nb[i] = NULL;
         lr->R_nb[i] = NULL;
+        lr->xyd_nb[i] = lr->beta_nb[i] = NULL;
+        lr->buried_work[i] = NULL;
+        lr->grad[i] = lr->darc[i] = lr->dA_nb[i] = NULL;
+        lr->xyz_nb[i] = lr->z_break[i] = NULL;
+        lr->idx_nb[i] = lr->arc_owner[i] = NULL;
+        lr->nb_capacity[i] = 0;
+        lr->probe_shift[i] = 0;
+        lr->n_unconverged[i] = 0;
+        lr->n_skipped[i] = 0;
     }
 
     lr->radii = malloc(sizeof(double)*n_atoms);
-    if (lr->radii == NULL) {
+    lr->probe_order = malloc(sizeof(int)*n_probes);
+    lr->probe_shifts = malloc(sizeof(double)*n_probes);
+    if (lr->radii == NULL || lr->probe_order == NULL || lr->probe_shifts == NULL) {
+        release_lr(lr);
         return mem_fail();
     }
 
+    return FREESASA_SUCCESS;
+}
+
+/** Initialize object to be used for L&R calculation. In NUMA-aware
+    mode the neighbor lists and work arrays are left to the threads */
+static int
+init_lr(lr_data *lr,
+        double *sasa,
+        double *gradient,
+        const coord_t *xyz,
+        const double *atom_radii,
+        int n_calc,
+        const double *probe_radii,
+        int n_probes,
+        int n_slices_per_atom,
+        double target_error,
+        int n_threads,
+        int numa_aware)
+{
+    const int n_atoms = freesasa_coord_n(xyz);
+    double probe_max;
+    int i, max_nni = 0;
+
+    if (prepare_lr(lr, gradient, xyz, n_atoms, n_probes, n_slices_per_atom,
+                   target_error, n_threads))
+        return FREESASA_FAIL;
+    lr->sasa = sasa;
+    lr->n_calc = n_calc;
+
+    probe_max = freesasa_sort_probes(lr->probe_order, lr->probe_shifts,
+                                     probe_radii, n_probes);
+
     /* init some arrays */
     for (i = 0; i < n_atoms; ++i) {
-        lr->radii[i] = atom_radii[i] + probe_radius;
+        lr->radii[i] = atom_radii[i] + probe_max;
+    }
+    for (i = 0; i < n_atoms*n_probes; ++i) {
         sasa[i] = 0.;
     }
 
-    /* determine which atoms are neighbours */
+    if (numa_aware) {
+        lr->cells = freesasa_nb_cells_new(xyz, lr->radii);
+        lr->adj = freesasa_nb_alloc_empty(n_atoms);
+        lr->order = malloc(sizeof(int) * n_calc);
+        if (lr->cells == NULL || lr->adj == NULL || lr->order == NULL) {
+            release_lr(lr);
+            return mem_fail();
+        }
+        freesasa_nb_cells_order(lr->cells, n_calc, n_threads, lr->order);
+        return FREESASA_SUCCESS;
+    }
+
+    /* determine which atoms are neighbours, the neighbors for
+       smaller probes are a subset of these */
     lr->adj = freesasa_nb_new(xyz, lr->radii);
 
     if (lr->adj == NULL) {
@@ -144,7 +352,11 @@ init_lr(lr_data *lr,
         return fail_msg("");
     }
 
-    if (alloc_lr_calc_arrays(lr, n_threads)) {
+    for (i = 0; i < n_atoms; ++i) {
+        if (lr->adj->nn[i] > max_nni) max_nni = lr->adj->nn[i];
+    }
+
+    if (alloc_lr_calc_arrays(lr, n_threads, max_nni)) {
         release_lr(lr);
         return fail_msg("");
     }
@@ -153,19 +365,71 @@ init_lr(lr_data *lr,
 
 }
 
+/** Common implementation of freesasa_lee_richards() and
+    freesasa_lee_richards_probes(), gradient only with one probe */
+static int
+lee_richards(double *sasa,
+             double *gradient,
+             int *n_skipped,
+             const coord_t *xyz,
+             const double *atom_radii,
+             int n_calc,
+             const double *probe_radii,
+             int n_probes,
+             const freesasa_parameters *param,
+             freesasa_progress *progress);
+
 int
 freesasa_lee_richards(double *sasa,
+                      double *gradient,
+                      int *n_skipped,
                       const coord_t *xyz,
                       const double *atom_radii,
-                      const freesasa_parameters *param)
+                      int n_calc,
+                      const freesasa_parameters *param,
+                      freesasa_progress *progress)
 {
-    int return_value, n_atoms, n_threads, resolution, i;
-    double probe_radius;
+    if (param == NULL) param = &freesasa_default_parameters;
+
+    return lee_richards(sasa, gradient, n_skipped, xyz, atom_radii, n_calc,
+                        &param->probe_radius, 1, param, progress);
+}
+
+int
+freesasa_lee_richards_probes(double *sasa,
+                             int *n_skipped,
+                             const coord_t *xyz,
+                             const double *atom_radii,
+                             const double *probe_radii,
+                             int n_probes,
+                             const freesasa_parameters *param)
+{
+    return lee_richards(sasa, NULL, n_skipped, xyz, atom_radii, freesasa_coord_n(xyz),
+                        probe_radii, n_probes, param, NULL);
+}
+
+static int
+lee_richards(double *sasa,
+             double *gradient,
+             int *n_skipped,
+             const coord_t *xyz,
+             const double *atom_radii,
+             int n_calc,
+             const double *probe_radii,
+             int n_probes,
+             const freesasa_parameters *param,
+             freesasa_progress *progress)
+{
+    int return_value, n_atoms, n_threads, resolution, i, t, n_unconverged,
+        n_pending = 0, numa_aware;
+    double target_error;
     lr_data lr;
 
     assert(sasa);
     assert(xyz);
     assert(atom_radii);
+    assert(probe_radii);
+    assert(n_probes > 0);
 
     if (param == NULL) param = &freesasa_default_parameters;
 
@@ -173,7 +437,9 @@ freesasa_lee_richards(double *sasa,
     n_atoms = freesasa_coord_n(xyz);
     n_threads = param->n_threads;
     resolution = param->lee_richards_n_slices;
-    probe_radius = param->probe_radius;
+    target_error = freesasa_target_atom_error(param, n_calc);
+
+    assert(n_calc <= n_atoms);
 
     if (n_threads > MAX_LR_THREADS) {
         return fail_msg("L&R does not support more than %d threads", MAX_LR_THREADS);
@@ -183,18 +449,28 @@ freesasa_lee_richards(double *sasa,
         return fail_msg("%f slices per atom invalid resolution in L&R, must be > 0\n", resolution);
     }
 
-    if (n_atoms == 0) {
+    if (gradient && target_error > 0) {
+        return fail_msg("gradients can not be calculated with adaptive resolution");
+    }
+
+    if (n_calc == 0) {
         return freesasa_warn("in %s(): empty coordinates", __func__);
     }
 
-    if (n_threads > n_atoms) {
-        n_threads = n_atoms;
+    if (n_threads > n_calc) {
+        n_threads = n_calc;
         freesasa_warn("no sense in having more threads than atoms, only using %d threads",
                       n_threads);
     }
 
-    if(init_lr(&lr, sasa, xyz, atom_radii, probe_radius, resolution, n_threads))
+    numa_aware = USE_THREADS && param->numa_aware && n_threads > 1 &&
+        freesasa_coord_periodic(xyz) == NULL;
+
+    if (init_lr(&lr, sasa, gradient, xyz, atom_radii, n_calc, probe_radii, n_probes,
+                resolution, target_error, n_threads, numa_aware))
         return FREESASA_FAIL;
+    lr.progress = progress;
+    lr.pin_threads = param->pin_threads;
 
     if (n_threads > 1) {
 #if USE_THREADS
@@ -208,14 +484,289 @@ freesasa_lee_richards(double *sasa,
 #endif /* pthread */
     }
     if (n_threads == 1) {
-        for (i = 0; i < lr.n_atoms; ++i) {
-            lr.sasa[i] = atom_area(&lr, i, 0);
+        for (i = 0; i < lr.n_calc; ++i) {
+            atom_areas(&lr, i, 0);
+            if (freesasa_progress_tick(progress, &n_pending)) break;
+        }
+        freesasa_progress_flush(progress, &n_pending);
+    }
+    if (freesasa_progress_cancelled(progress)) {
+        release_lr(&lr);
+        return FREESASA_FAIL;
+    }
+    n_unconverged = 0;
+    if (n_skipped) *n_skipped = 0;
+    for (i = 0; i < lr.n_threads; ++i) {
+        n_unconverged += lr.n_unconverged[i];
+        if (n_skipped) *n_skipped += lr.n_skipped[i];
+    }
+    if (gradient) {
+        memset(gradient, 0, sizeof(double) * 3 * n_atoms);
+        for (t = 0; t < lr.n_threads; ++t) {
+            for (i = 0; i < 3*n_atoms; ++i) {
+                gradient[i] += lr.grad[t][i];
+            }
         }
     }
+    if (n_unconverged > 0) {
+        return_value = freesasa_warn("%d atoms did not reach the target error in L&R, "
+                                     "using at most %d slices per atom",
+                                     n_unconverged, LR_MAX_ADAPTIVE_SLICES);
+    }
     release_lr(&lr);
     return return_value;
 }
 
+/** Fill the neighbor lists of the atoms order[first..last] (atoms
+    first..last if order is NULL) from the cells, and make sure the
+    work arrays of the thread are large enough for them */
+static int
+lr_fill_atoms(lr_data *lr,
+              const int *order,
+              int first,
+              int last,
+              int thread_id)
+{
+    int k, i, max_nni = 0;
+
+    for (k = first; k <= last; ++k) {
+        i = order ? order[k] : k;
+        if (freesasa_nb_fill_atom(lr->adj, lr->cells, lr->xyz, lr->radii, i))
+            return fail_msg("");
+        if (lr->adj->nn[i] > max_nni) max_nni = lr->adj->nn[i];
+    }
+
+    if (lr->arc[thread_id] == NULL || max_nni > lr->nb_capacity[thread_id]) {
+        if (alloc_lr_thread_arrays(lr, thread_id, max_nni > 0 ? max_nni : 1))
+            return fail_msg("");
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+struct freesasa_lr_job {
+    lr_data lr;
+};
+
+freesasa_lr_job *
+freesasa_lr_job_new(double *sasa,
+                    const coord_t *xyz,
+                    const double *atom_radii,
+                    const freesasa_parameters *param,
+                    int n_workers)
+{
+    const int n_atoms = freesasa_coord_n(xyz);
+    freesasa_lr_job *job;
+    int i;
+
+    assert(sasa);
+    assert(atom_radii);
+    assert(n_atoms > 0);
+
+    if (param == NULL) param = &freesasa_default_parameters;
+
+    if (n_workers < 1 || n_workers > MAX_LR_THREADS) {
+        fail_msg("L&R does not support more than %d threads", MAX_LR_THREADS);
+        return NULL;
+    }
+    if (param->lee_richards_n_slices <= 0) {
+        fail_msg("%d slices per atom invalid resolution in L&R, must be > 0",
+                 param->lee_richards_n_slices);
+        return NULL;
+    }
+
+    job = malloc(sizeof(freesasa_lr_job));
+    if (job == NULL) {
+        mem_fail();
+        return NULL;
+    }
+
+    if (prepare_lr(&job->lr, NULL, xyz, n_atoms, 1, param->lee_richards_n_slices,
+                   freesasa_target_atom_error(param, n_atoms), n_workers)) {
+        free(job);
+        fail_msg("");
+        return NULL;
+    }
+    job->lr.sasa = sasa;
+    job->lr.probe_order[0] = 0;
+    job->lr.probe_shifts[0] = 0;
+
+    for (i = 0; i < n_atoms; ++i) {
+        job->lr.radii[i] = atom_radii[i] + param->probe_radius;
+        sasa[i] = 0;
+    }
+
+    /* the neighbor lists are filled by the workers, chunk by chunk */
+    job->lr.cells = freesasa_nb_cells_new(xyz, job->lr.radii);
+    job->lr.adj = freesasa_nb_alloc_empty(n_atoms);
+    if (job->lr.cells == NULL || job->lr.adj == NULL) {
+        freesasa_lr_job_free(job);
+        mem_fail();
+        return NULL;
+    }
+
+    return job;
+}
+
+int
+freesasa_lr_job_calc(freesasa_lr_job *job,
+                     int first,
+                     int n,
+                     int worker)
+{
+    lr_data *lr = &job->lr;
+    int i;
+
+    assert(first >= 0 && n > 0 && first + n <= lr->n_atoms);
+    assert(worker >= 0 && worker < lr->n_threads);
+
+    if (lr_fill_atoms(lr, NULL, first, first + n - 1, worker))
+        return fail_msg("");
+
+    for (i = first; i < first + n; ++i) {
+        atom_areas(lr, i, worker);
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+int
+freesasa_lr_job_report(const freesasa_lr_job *job,
+                       int *n_skipped)
+{
+    int t, n_unconverged = 0;
+
+    for (t = 0; t < job->lr.n_threads; ++t) {
+        n_unconverged += job->lr.n_unconverged[t];
+        if (n_skipped) *n_skipped += job->lr.n_skipped[t];
+    }
+    if (n_unconverged > 0) {
+        return freesasa_warn("%d atoms did not reach the target error in L&R, "
+                             "using at most %d slices per atom",
+                             n_unconverged, LR_MAX_ADAPTIVE_SLICES);
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+void
+freesasa_lr_job_free(freesasa_lr_job *job)
+{
+    if (job) {
+        release_lr(&job->lr);
+        free(job);
+    }
+}
+
+struct freesasa_lr_workspace {
+    lr_data lr;
+    coord_t *xyz;
+    int n_max;
+    double probe_radius;
+    freesasa_parameters param;
+};
+
+freesasa_lr_workspace *
+freesasa_lr_workspace_new(int n_max,
+                          const freesasa_parameters *param)
+{
+    freesasa_lr_workspace *w;
+
+    assert(n_max > 0);
+
+    if (param == NULL) param = &freesasa_default_parameters;
+
+    if (param->lee_richards_n_slices <= 0) {
+        fail_msg("%d slices per atom invalid resolution in L&R, must be > 0",
+                 param->lee_richards_n_slices);
+        return NULL;
+    }
+
+    w = malloc(sizeof(freesasa_lr_workspace));
+    if (w == NULL) {
+        mem_fail();
+        return NULL;
+    }
+    w->n_max = n_max;
+    w->probe_radius = param->probe_radius;
+    w->param = *param;
+    w->xyz = freesasa_coord_new();
+    if (w->xyz == NULL) {
+        free(w);
+        mem_fail();
+        return NULL;
+    }
+
+    if (prepare_lr(&w->lr, NULL, w->xyz, n_max, 1, param->lee_richards_n_slices,
+                   freesasa_target_atom_error(param, n_max), 1)) {
+        freesasa_coord_free(w->xyz);
+        free(w);
+        fail_msg("");
+        return NULL;
+    }
+
+    /* one probe, the neighbor list is filled for each molecule, no
+       atom can have more neighbors than there are atoms */
+    w->lr.probe_order[0] = 0;
+    w->lr.probe_shifts[0] = 0;
+    w->lr.adj = freesasa_nb_alloc(n_max);
+    if (w->lr.adj == NULL || alloc_lr_calc_arrays(&w->lr, 1, n_max)) {
+        freesasa_lr_workspace_free(w);
+        fail_msg("");
+        return NULL;
+    }
+
+    return w;
+}
+
+void
+freesasa_lr_workspace_free(freesasa_lr_workspace *w)
+{
+    if (w) {
+        release_lr(&w->lr);
+        freesasa_coord_free(w->xyz);
+        free(w);
+    }
+}
+
+int
+freesasa_lr_workspace_calc(freesasa_lr_workspace *w,
+                           double *sasa,
+                           const double *xyz,
+                           const double *atom_radii,
+                           int n,
+                           int *n_skipped,
+                           int *n_unconverged)
+{
+    lr_data *lr = &w->lr;
+    int i;
+
+    assert(n > 0 && n <= w->n_max);
+
+    freesasa_coord_relink(w->xyz, xyz, n);
+    lr->n_atoms = lr->n_calc = n;
+    lr->sasa = sasa;
+    lr->target_error = freesasa_target_atom_error(&w->param, n);
+    lr->n_skipped[0] = lr->n_unconverged[0] = 0;
+
+    for (i = 0; i < n; ++i) {
+        lr->radii[i] = atom_radii[i] + w->probe_radius;
+        sasa[i] = 0;
+    }
+
+    if (freesasa_nb_refill(lr->adj, w->xyz, lr->radii))
+        return fail_msg("");
+
+    for (i = 0; i < n; ++i) {
+        atom_areas(lr, i, 0);
+    }
+
+    if (n_skipped) *n_skipped += lr->n_skipped[0];
+    if (n_unconverged) *n_unconverged += lr->n_unconverged[0];
+
+    return FREESASA_SUCCESS;
+}
+
 #if USE_THREADS
 static int
 lr_do_threads(int n_threads,
@@ -223,21 +774,22 @@ lr_do_threads(int n_threads,
 {
     pthread_t thread[MAX_LR_THREADS];
     lr_thread_interval t_data[MAX_LR_THREADS];
-    int n_perthread = lr->n_atoms/n_threads, res;
+    int n_perthread = lr->n_calc/n_threads, res;
     int threads_created = 0, return_value = FREESASA_SUCCESS;
     int t;
 
     for (t = 0; t < n_threads; ++t) {
         t_data[t].first_atom = t*n_perthread;
         if (t == n_threads-1) {
-            t_data[t].last_atom = lr->n_atoms - 1;
+            t_data[t].last_atom = lr->n_calc - 1;
         } else {
             t_data[t].last_atom = (t+1)*n_perthread - 1;
         }
         t_data[t].lr = lr;
         t_data[t].thread_id = t;
-        res = pthread_create(&thread[t], NULL, lr_thread,
-                             (void *) &t_data[t]);
+        t_data[t].status = FREESASA_SUCCESS;
+        res = freesasa_thread_create(&thread[t], lr_thread,
+                                     (void *) &t_data[t]);
         if (res) {
             return_value = fail_msg(freesasa_thread_error(res));
             break;
@@ -249,29 +801,105 @@ lr_do_threads(int n_threads,
         if (res) {
             return_value = fail_msg(freesasa_thread_error(res));
         }
+        if (t_data[t].status == FREESASA_FAIL) return_value = FREESASA_FAIL;
     }
     return return_value;
 }
 
+/* NUMA-aware mode: fill the neighbor lists of the thread's atoms and
+   allocate its work arrays in the thread, so that the memory is
+   first touched on the node where it is used */
+static int
+lr_thread_init(lr_thread_interval *ti)
+{
+    return lr_fill_atoms(ti->lr, ti->lr->order, ti->first_atom, ti->last_atom,
+                         ti->thread_id);
+}
+
 static void*
 lr_thread(void *arg)
 {
-    int i;
+    int k, i, n_pending = 0;
     lr_thread_interval *ti = ((lr_thread_interval*) arg);
+    const int *order = ti->lr->order;
+
+    if (ti->lr->pin_threads) freesasa_pin_thread(ti->thread_id);
 
-    for (i = ti->first_atom; i <= ti->last_atom; ++i) {
+    if (order != NULL) {
+        ti->status = lr_thread_init(ti);
+        if (ti->status == FREESASA_FAIL) pthread_exit(NULL);
+    }
+
+    for (k = ti->first_atom; k <= ti->last_atom; ++k) {
+        i = order ? order[k] : k;
         /* the different threads write to different parts of the
            array, so locking shouldn't be necessary */
-        ti->lr->sasa[i] = atom_area(ti->lr, i, ti->thread_id);
+        atom_areas(ti->lr, i, ti->thread_id);
+        if (freesasa_progress_tick(ti->lr->progress, &n_pending)) break;
     }
+    freesasa_progress_flush(ti->lr->progress, &n_pending);
     pthread_exit(NULL);
 }
 #endif /* USE_THREADS */
 
-static double
-atom_area(lr_data *lr,
-          int i,
-          int thread_id)
+/** Radius of atom i, including the current probe radius */
+static inline double
+atom_radius(const lr_data *lr,
+            int i,
+            int thread_id)
+{
+    return lr->radii[i] - lr->probe_shift[thread_id];
+}
+
+/** Copy the neighbors of atom i that are in contact with it, with
+    the current probe radius, to the thread's work arrays, for more
+    efficient access */
+static void
+load_neighbors(lr_data *lr,
+               int i,
+               int thread_id)
+{
+    const int nni = lr->adj->nn[i];
+    const int * restrict const nbi = lr->adj->nb[i];
+    const double * restrict const xydi = lr->adj->xyd[i];
+    const double * restrict const zdi = lr->adj->zd[i];
+    const double zi = freesasa_coord_all(lr->xyz)[3*i+2], Ri = atom_radius(lr, i, thread_id);
+    double *z_nb = lr->z_nb[thread_id], *R_nb = lr->R_nb[thread_id];
+    double *xyd_nb = lr->xyd_nb[thread_id], *beta_nb = lr->beta_nb[thread_id];
+    double Rj;
+    int j, n = 0;
+
+    /* relative positions from the neighbor list, which are correct
+       also for periodic coordinates */
+    for (j = 0; j < nni; ++j) {
+        Rj = atom_radius(lr, nbi[j], thread_id);
+        if (xydi[j]*xydi[j] + zdi[j]*zdi[j] >= (Ri+Rj)*(Ri+Rj)) continue;
+        z_nb[n] = zi + zdi[j];
+        R_nb[n] = Rj;
+        xyd_nb[n] = xydi[j];
+        /* position of mid-point of intersection along circle i, the
+           same in all slices */
+        beta_nb[n] = atan2(lr->adj->yd[i][j], lr->adj->xd[i][j]) + M_PI;
+        if (lr->gradient) lr->idx_nb[thread_id][n] = nbi[j];
+        if (lr->xyz_nb[thread_id]) {
+            lr->xyz_nb[thread_id][3*n] = lr->adj->xd[i][j];
+            lr->xyz_nb[thread_id][3*n+1] = lr->adj->yd[i][j];
+            lr->xyz_nb[thread_id][3*n+2] = zdi[j];
+        }
+        ++n;
+    }
+    lr->nn[thread_id] = n;
+}
+
+/** Exposed arc length of atom i in the slice at height z, times the
+    radius of atom i. Multiplied by the slice thickness this gives the
+    contribution of the slice to the SASA. Assumes load_neighbors()
+    has been called for atom i. */
+static inline double
+slice_exposed_length(lr_data *lr,
+                     int i,
+                     int thread_id,
+                     double z)
 {
     /* This function is large because a large number of pre-calculated
        arrays need to be accessed efficiently. Partially dereferenced
@@ -280,89 +908,513 @@ atom_area(lr_data *lr,
        Variables are named according to the documentation (see page
        "Geometry of Lee & Richards' algorithm") */
 
-    const int nni = lr->adj->nn[i];
+    const int nni = lr->nn[thread_id];
+    const double * restrict const xydi = lr->xyd_nb[thread_id];
+    const double * restrict const beta_nb = lr->beta_nb[thread_id];
+    const double zi = freesasa_coord_all(lr->xyz)[3*i+2], Ri = atom_radius(lr, i, thread_id);
+    const double * restrict const z_nb = lr->z_nb[thread_id];
+    const double * restrict const R_nb = lr->R_nb[thread_id];
+    double * restrict const arc = lr->arc[thread_id];
+
+    int j, n_arcs, narc2;
+    double alpha, beta, inf, sup;
+    double zj, di, dj, dij, Rj, Ri_prime2, Ri_prime, Rj_prime2, Rj_prime;
+
+    di = fabs(zi - z);
+    Ri_prime2 = Ri*Ri-di*di;
+    if (Ri_prime2 < 0 ) return 0; /* handle round-off errors */
+    Ri_prime = sqrt(Ri_prime2);
+    if (Ri_prime <= 0) return 0; /* more round-off errors */
+    n_arcs = 0;
+    for (j = 0; j < nni; ++j) {
+        zj = z_nb[j];
+        dj = fabs(zj - z);
+        Rj = R_nb[j];
+
+        if (dj < Rj) {
+            Rj_prime2 = Rj*Rj-dj*dj;
+            Rj_prime = sqrt(Rj_prime2);
+            dij = xydi[j];
+            if (dij >= Ri_prime + Rj_prime) { /* atoms aren't in contact */
+                continue;
+            }
+            if (dij + Ri_prime < Rj_prime) { /* circle i is completely inside j */
+                return 0;
+            }
+            if (dij + Rj_prime < Ri_prime) { /* circle j is completely inside i */
+                continue;
+            }
+            /* arc of circle i intersected by circle j */
+            alpha = acos ((Ri_prime2 + dij*dij - Rj_prime2)/(2.0*Ri_prime*dij));
+            beta = beta_nb[j];
+            inf = beta - alpha;
+            sup = beta + alpha;
+            if (inf < 0) inf += TWOPI;
+            if (sup > 2*M_PI) sup -= TWOPI;
+            narc2 = 2*n_arcs;
+            /* store the arc, if arc passes 2*PI split into two */
+            if (sup < inf) {
+                /* store arcs as contiguous pairs of angles */
+                arc[narc2]   = 0;
+                arc[narc2+1] = sup;
+                /* second arc */
+                arc[narc2+2] = inf;
+                arc[narc2+3] = TWOPI;
+                n_arcs += 2;
+            } else {
+                arc[narc2]   = inf;
+                arc[narc2+1] = sup;
+                ++n_arcs;
+            }
+        }
+    }
+    return Ri*exposed_arc_length(arc,n_arcs);
+}
+
+/**
+    As slice_exposed_length(), but also adds the derivative of the
+    slice's contribution to the area, with respect to the position of
+    each neighbor, to lr->dA_nb[thread_id]. delta is the thickness of
+    the slice.
+
+    The arc of neighbor j has center beta and half-width alpha, that
+    depend on the distance dij in the xy-plane and on the radius Rj'
+    of the circle of j in the slice (and thus on the z-coordinate of
+    j). Only end-points that bound an exposed part of the circle
+    contribute.
+ */
+static double
+slice_exposed_length_gradient(lr_data *lr,
+                              int i,
+                              int thread_id,
+                              double z,
+                              double delta)
+{
+    const int nni = lr->nn[thread_id];
+    const int * restrict const idx_nb = lr->idx_nb[thread_id];
     const double * restrict const v = freesasa_coord_all(lr->xyz);
-    const double * restrict const R = lr->radii;
-    const int * restrict const nbi = lr->adj->nb[i];
-    const double * restrict const xydi = lr->adj->xyd[i];
-    const double * restrict const xdi = lr->adj->xd[i];
-    const double * restrict const ydi = lr->adj->yd[i];
-    const double zi = v[3*i+2], Ri = R[i];
+    const double * restrict const xydi = lr->xyd_nb[thread_id];
+    const double * restrict const beta_nb = lr->beta_nb[thread_id];
+    const double zi = v[3*i+2], Ri = atom_radius(lr, i, thread_id);
+    const double * restrict const z_nb = lr->z_nb[thread_id];
+    const double * restrict const R_nb = lr->R_nb[thread_id];
+    double * restrict const arc = lr->arc[thread_id];
+    int * restrict const owner = lr->arc_owner[thread_id];
+    double * restrict const darc = lr->darc[thread_id];
+
+    int j, n_arcs, narc2;
+    double alpha, beta, inf, sup, cos_a, sin_a, xij, yij, da_dd, da_dz;
+    double zj, di, dj, dij, Rj, Ri_prime2, Ri_prime, Rj_prime2, Rj_prime;
+    double *dj_arc;
+
+    di = fabs(zi - z);
+    Ri_prime2 = Ri*Ri-di*di;
+    if (Ri_prime2 < 0 ) return 0;
+    Ri_prime = sqrt(Ri_prime2);
+    if (Ri_prime <= 0) return 0;
+    n_arcs = 0;
+    for (j = 0; j < nni; ++j) {
+        zj = z_nb[j];
+        dj = zj - z;
+        Rj = R_nb[j];
+
+        if (fabs(dj) < Rj) {
+            Rj_prime2 = Rj*Rj-dj*dj;
+            Rj_prime = sqrt(Rj_prime2);
+            dij = xydi[j];
+            if (dij >= Ri_prime + Rj_prime) continue;
+            if (dij + Ri_prime < Rj_prime) return 0;
+            if (dij + Rj_prime < Ri_prime) continue;
+
+            cos_a = (Ri_prime2 + dij*dij - Rj_prime2)/(2.0*Ri_prime*dij);
+            alpha = acos(cos_a);
+            beta = beta_nb[j];
+
+            /* derivatives of alpha and beta with respect to (xj, yj, zj) */
+            sin_a = sin(alpha);
+            xij = v[3*idx_nb[j]] - v[3*i];
+            yij = v[3*idx_nb[j]+1] - v[3*i+1];
+            dj_arc = darc + 6*j;
+            if (sin_a > 0) {
+                da_dd = -(1/(2*Ri_prime) - (Ri_prime2 - Rj_prime2)/(2*Ri_prime*dij*dij))/sin_a;
+                da_dz = -dj/(Ri_prime*dij*sin_a);
+            } else {
+                da_dd = da_dz = 0;
+            }
+            /* inf = beta - alpha */
+            dj_arc[0] = -yij/(dij*dij) - da_dd*xij/dij;
+            dj_arc[1] =  xij/(dij*dij) - da_dd*yij/dij;
+            dj_arc[2] = -da_dz;
+            /* sup = beta + alpha */
+            dj_arc[3] = -yij/(dij*dij) + da_dd*xij/dij;
+            dj_arc[4] =  xij/(dij*dij) + da_dd*yij/dij;
+            dj_arc[5] =  da_dz;
+
+            inf = beta - alpha;
+            sup = beta + alpha;
+            if (inf < 0) inf += TWOPI;
+            if (sup > 2*M_PI) sup -= TWOPI;
+            narc2 = 2*n_arcs;
+            /* owners are encoded as 2*j for inf and 2*j+1 for sup */
+            if (sup < inf) {
+                arc[narc2]   = 0;
+                arc[narc2+1] = sup;
+                owner[narc2] = -1;
+                owner[narc2+1] = 2*j+1;
+                arc[narc2+2] = inf;
+                arc[narc2+3] = TWOPI;
+                owner[narc2+2] = 2*j;
+                owner[narc2+3] = -1;
+                n_arcs += 2;
+            } else {
+                arc[narc2]   = inf;
+                arc[narc2+1] = sup;
+                owner[narc2] = 2*j;
+                owner[narc2+1] = 2*j+1;
+                ++n_arcs;
+            }
+        }
+    }
+    return Ri*exposed_arc_length_gradient(arc, owner, n_arcs, darc, delta*Ri,
+                                          lr->dA_nb[thread_id]);
+}
+
+/** Area of atom i, and its gradient, added to lr->grad[thread_id] */
+static double
+atom_area_gradient(lr_data *lr,
+                   int i,
+                   int thread_id)
+{
+    const double zi = freesasa_coord_all(lr->xyz)[3*i+2], Ri = atom_radius(lr, i, thread_id);
     const int ns = lr->n_slices_per_atom;
+    const double delta = 2*Ri/ns;
+    double * restrict const dA = lr->dA_nb[thread_id];
+    double * restrict const grad = lr->grad[thread_id];
+    double z, sasa = 0;
+    int islice, j, l, nni;
 
-    int j, islice, n_arcs, is_buried, narc2;
-    double *arc = lr->arc[thread_id],
-        *z_nb = lr->z_nb[thread_id],
-        *R_nb = lr->R_nb[thread_id];
-    double z, delta, sasa = 0, alpha, beta, inf, sup;
-    double zj, di, dj, dij, Rj, Ri_prime2, Ri_prime, Rj_prime2, Rj_prime;
+    load_neighbors(lr, i, thread_id);
+    nni = lr->nn[thread_id];
+    for (j = 0; j < 3*nni; ++j) dA[j] = 0;
+
+    z = zi-Ri-0.5*delta;
+    for (islice = 0; islice < ns; ++islice) {
+        z += delta;
+        sasa += delta*slice_exposed_length_gradient(lr, i, thread_id, z, delta);
+    }
 
+    /* the area only depends on the positions relative to atom i */
     for (j = 0; j < nni; ++j) {
-        z_nb[j] = v[3*nbi[j]+2];
-        R_nb[j] = R[nbi[j]];
+        for (l = 0; l < 3; ++l) {
+            grad[3*lr->idx_nb[thread_id][j]+l] += dA[3*j+l];
+            grad[3*i+l] -= dA[3*j+l];
+        }
     }
 
-    delta = 2*Ri/ns;
+    return sasa;
+}
+
+static void
+atom_areas(lr_data *lr,
+           int i,
+           int thread_id)
+{
+    double *sasa = lr->sasa + i*lr->n_probes;
+    int k, n_exposed = lr->n_probes;
+
+    if (lr->screen_buried) {
+        n_exposed = freesasa_atom_buried_probes(i, lr->radii, lr->probe_shifts,
+                                                lr->n_probes, lr->adj,
+                                                lr->buried_work[thread_id]);
+        lr->n_skipped[thread_id] += lr->n_probes - n_exposed;
+    }
+
+    for (k = 0; k < lr->n_probes; ++k) {
+        if (k < n_exposed) {
+            lr->probe_shift[thread_id] = lr->probe_shifts[k];
+            sasa[lr->probe_order[k]] = atom_area(lr, i, thread_id);
+        } else {
+            sasa[lr->probe_order[k]] = 0;
+        }
+    }
+}
+
+static double
+atom_area(lr_data *lr,
+          int i,
+          int thread_id)
+{
+    const double zi = freesasa_coord_all(lr->xyz)[3*i+2], Ri = atom_radius(lr, i, thread_id);
+    const int ns = lr->n_slices_per_atom;
+    const double delta = 2*Ri/ns;
+    double z, sasa = 0;
+    int islice;
+
+    if (Ri <= 0) return 0;
+
+    if (lr->gradient) return atom_area_gradient(lr, i, thread_id);
+
+    if (lr->target_error > 0) return atom_area_adaptive(lr, i, thread_id);
+
+    load_neighbors(lr, i, thread_id);
+
     z = zi-Ri-0.5*delta;
     for (islice = 0; islice < ns; ++islice) {
         z += delta;
-        di = fabs(zi - z);
-        Ri_prime2 = Ri*Ri-di*di;
-        if (Ri_prime2 < 0 ) continue; /* handle round-off errors */
-        Ri_prime = sqrt(Ri_prime2);
-        if (Ri_prime <= 0) continue; /* more round-off errors */
-        n_arcs = 0; is_buried = 0;
-        for (j = 0; j < nni; ++j) {
-            zj = z_nb[j];
-            dj = fabs(zj - z);
-            Rj = R_nb[j];
-
-            if (dj < Rj) {
-                Rj_prime2 = Rj*Rj-dj*dj;
-                Rj_prime = sqrt(Rj_prime2);
-                dij = xydi[j];
-                if (dij >= Ri_prime + Rj_prime) { /* atoms aren't in contact */
-                    continue;
-                }
-                if (dij + Ri_prime < Rj_prime) { /* circle i is completely inside j */
-                    is_buried = 1;
-                    break;
-                }
-                if (dij + Rj_prime < Ri_prime) { /* circle j is completely inside i */
-                    continue;
-                }
-                /* arc of circle i intersected by circle j */
-                alpha = acos ((Ri_prime2 + dij*dij - Rj_prime2)/(2.0*Ri_prime*dij));
-                /* position of mid-point of intersection along circle i */
-                beta = atan2 (ydi[j],xdi[j]) + M_PI;
-                inf = beta - alpha;
-                sup = beta + alpha;
-                if (inf < 0) inf += TWOPI;
-                if (sup > 2*M_PI) sup -= TWOPI;
-                narc2 = 2*n_arcs;
-                /* store the arc, if arc passes 2*PI split into two */
-                if (sup < inf) {
-                    /* store arcs as contiguous pairs of angles */
-                    arc[narc2]   = 0;
-                    arc[narc2+1] = sup;
-                    /* second arc */
-                    arc[narc2+2] = inf;
-                    arc[narc2+3] = TWOPI;
-                    n_arcs += 2;
-                } else {
-                    arc[narc2]   = inf;
-                    arc[narc2+1] = sup;
-                    ++n_arcs;
-                }
+        sasa += delta*slice_exposed_length(lr, i, thread_id, z);
+    }
+    return sasa;
+}
+
+/** Is the point p (relative to the current atom) inside one of its
+    neighbors, other than skip1 and skip2. Points on the surface of a
+    neighbor count as exposed. */
+static int
+point_buried(const lr_data *lr,
+             int thread_id,
+             const double *p,
+             int skip1,
+             int skip2)
+{
+    const double *xyz_nb = lr->xyz_nb[thread_id], *R_nb = lr->R_nb[thread_id];
+    double dx, dy, dz;
+    int k;
+
+    for (k = 0; k < lr->nn[thread_id]; ++k) {
+        if (k == skip1 || k == skip2) continue;
+        dx = p[0] - xyz_nb[3*k];
+        dy = p[1] - xyz_nb[3*k+1];
+        dz = p[2] - xyz_nb[3*k+2];
+        if (dx*dx + dy*dy + dz*dz < R_nb[k]*R_nb[k]*(1 - 1e-10)) return 1;
+    }
+    return 0;
+}
+
+/** insertion sort, there are usually only a few exposed break points */
+static void
+sort_doubles(double *a,
+             int n)
+{
+    double tmp;
+    int k, l;
+
+    for (k = 1; k < n; ++k) {
+        tmp = a[k];
+        for (l = k; l > 0 && a[l-1] > tmp; --l) a[l] = a[l-1];
+        a[l] = tmp;
+    }
+}
+
+/**
+    Heights, relative to the center of atom i, between which the
+    exposed length of atom i is a smooth function of z. The exposed
+    surface is bounded by arcs of the circles where the neighbors
+    intersect atom i. The exposed length changes non-smoothly where a
+    slice is tangent to such a circle, i.e. at its highest and lowest
+    points, and where two circles cross. Only the points that are
+    exposed, i.e. on the boundary of the exposed surface, matter. The
+    points are stored in lr->z_break[thread_id], sorted, starting
+    with -Ri and ending with Ri. Returns the number of points.
+    Assumes load_neighbors() has been called for atom i.
+ */
+static int
+exposed_breakpoints(lr_data *lr,
+                    int i,
+                    int thread_id)
+{
+    const int nn = lr->nn[thread_id];
+    const double Ri = atom_radius(lr, i, thread_id), Ri2 = Ri*Ri;
+    const double *xyz_nb = lr->xyz_nb[thread_id], *R_nb = lr->R_nb[thread_id];
+    double *zb = lr->z_break[thread_id];
+    const double *cj, *ck;
+    double d2, d, a, rho2, rho, uz, s, p[3], w[3];
+    double hj, hk, jj, kk, jk, det, alpha, beta, b[3], n[3], gamma2, gamma;
+    int j, k, l, m, n_break = 0;
+
+    zb[n_break++] = -Ri;
+    zb[n_break++] = Ri;
+
+    for (j = 0; j < nn; ++j) {
+        cj = xyz_nb + 3*j;
+        d2 = cj[0]*cj[0] + cj[1]*cj[1] + cj[2]*cj[2];
+        if (d2 == 0) continue;
+        d = sqrt(d2);
+        /* the circle is centered at a*u, where u is the direction to
+           j, and has radius rho */
+        a = (d2 + Ri2 - R_nb[j]*R_nb[j])/(2*d);
+        rho2 = Ri2 - a*a;
+        if (rho2 <= 0) continue;
+        rho = sqrt(rho2);
+        uz = cj[2]/d;
+        s = 1 - uz*uz;
+        if (s <= 1e-12) {
+            /* horizontal circle, all points at the same height */
+            zb[n_break++] = a*uz;
+            continue;
+        }
+        s = sqrt(s);
+        /* w is the direction in the plane of the circle with the
+           largest z-component */
+        w[0] = -uz*cj[0]/(d*s);
+        w[1] = -uz*cj[1]/(d*s);
+        w[2] = s;
+        for (m = -1; m <= 1; m += 2) {
+            for (l = 0; l < 3; ++l) p[l] = a*cj[l]/d + m*rho*w[l];
+            if (!point_buried(lr, thread_id, p, j, -1)) zb[n_break++] = p[2];
+        }
+    }
+
+    /* the crossings of the circles of j and k are the points p on the
+       sphere with p.cj = hj and p.ck = hk */
+    for (j = 0; j < nn; ++j) {
+        cj = xyz_nb + 3*j;
+        jj = cj[0]*cj[0] + cj[1]*cj[1] + cj[2]*cj[2];
+        hj = (Ri2 + jj - R_nb[j]*R_nb[j])/2;
+        for (k = j + 1; k < nn; ++k) {
+            ck = xyz_nb + 3*k;
+            for (l = 0; l < 3; ++l) b[l] = ck[l] - cj[l];
+            /* the circles can only cross if j and k intersect */
+            if (b[0]*b[0] + b[1]*b[1] + b[2]*b[2] >= (R_nb[j] + R_nb[k])*(R_nb[j] + R_nb[k]))
+                continue;
+            kk = ck[0]*ck[0] + ck[1]*ck[1] + ck[2]*ck[2];
+            jk = cj[0]*ck[0] + cj[1]*ck[1] + cj[2]*ck[2];
+            det = jj*kk - jk*jk;
+            if (det <= 1e-12*jj*kk) continue; /* i, j and k on a line */
+            hk = (Ri2 + kk - R_nb[k]*R_nb[k])/2;
+            alpha = (hj*kk - hk*jk)/det;
+            beta = (hk*jj - hj*jk)/det;
+            for (l = 0; l < 3; ++l) b[l] = alpha*cj[l] + beta*ck[l];
+            gamma2 = (Ri2 - b[0]*b[0] - b[1]*b[1] - b[2]*b[2])/det;
+            if (gamma2 < 0) continue; /* the circles don't cross */
+            gamma = sqrt(gamma2);
+            n[0] = cj[1]*ck[2] - cj[2]*ck[1];
+            n[1] = cj[2]*ck[0] - cj[0]*ck[2];
+            n[2] = cj[0]*ck[1] - cj[1]*ck[0];
+            for (m = -1; m <= 1; m += 2) {
+                for (l = 0; l < 3; ++l) p[l] = b[l] + m*gamma*n[l];
+                if (!point_buried(lr, thread_id, p, j, k)) zb[n_break++] = p[2];
             }
         }
-        if (is_buried == 0) {
-            sasa += delta*Ri*exposed_arc_length(arc,n_arcs);
+    }
+
+    sort_doubles(zb, n_break);
+
+    return n_break;
+}
+
+/**
+    Contribution to the area of atom i of a panel of the interval
+    [za,zb] between two break points. The interval is parametrized as
+    z = zc - hw cos(t), t in [0,pi], where zc and hw are the center and
+    half-width of the interval. The exposed length can have
+    square-root singularities at the ends of the interval, this
+    substitution makes the integrand f(t) = L(z) hw sin(t) smooth.
+
+    The panel is centered at t with width h, and f is the integrand
+    at t. It is split in three and the outer two evaluated. The
+    midpoint rule has an error proportional to h^2, so the error of
+    the finer level is an eighth of the difference between the two
+    levels, and adding that eighth (Richardson extrapolation) removes
+    the leading part of the error, which would otherwise always have
+    the same sign for the whole molecule. If the estimate exceeds
+    tol, each of the three is refined further with a third of the
+    tolerance, down to a minimal thickness. The sum of the estimates
+    of the accepted panels is stored in err.
+ */
+static double
+refine_panel(lr_data *lr,
+             int i,
+             int thread_id,
+             double zc,
+             double hw,
+             double t,
+             double h,
+             double f,
+             double tol,
+             double *err)
+{
+    const double h3 = h/3;
+    const double f_lo = hw*sin(t - h3)*slice_exposed_length(lr, i, thread_id, zc - hw*cos(t - h3));
+    const double f_hi = hw*sin(t + h3)*slice_exposed_length(lr, i, thread_id, zc - hw*cos(t + h3));
+    const double fine = h3*(f_lo + f + f_hi);
+    double sasa, e;
+
+    *err = fabs(fine - h*f)/8;
+    if (*err <= tol || hw*h3 < 2*atom_radius(lr, i, thread_id)/LR_MAX_ADAPTIVE_SLICES) {
+        return fine + (fine - h*f)/8;
+    }
+
+    sasa = refine_panel(lr, i, thread_id, zc, hw, t - h3, h3, f_lo, tol/3, err);
+    sasa += refine_panel(lr, i, thread_id, zc, hw, t, h3, f, tol/3, &e);
+    *err += e;
+    sasa += refine_panel(lr, i, thread_id, zc, hw, t + h3, h3, f_hi, tol/3, &e);
+    *err += e;
+
+    return sasa;
+}
+
+/**
+    Area of atom i, with an estimated error below lr->target_error.
+
+    Slicing with a fixed thickness has two problems: the exposed
+    length has square-root singularities where a slice is tangent to
+    the circle of a neighbor, and small exposed patches can fall
+    between two slices. Comparing with finer slices doesn't detect
+    either, since the finer slices share the problem. Instead the atom
+    is split at the heights where the exposed surface starts, ends or
+    changes shape (see exposed_breakpoints()), and each interval is
+    integrated separately, with a substitution that removes the
+    singularities at its ends (see refine_panel()). Each interval
+    starts with as many panels as it would have slices at the starting
+    resolution, at least one, and gets a share of the target error
+    proportional to its length.
+
+    The atom is counted as unconverged if the sum of the estimates
+    exceeds the target, which only happens if panels reach the
+    minimal thickness.
+ */
+static double
+atom_area_adaptive(lr_data *lr,
+                   int i,
+                   int thread_id)
+{
+    const double zi = freesasa_coord_all(lr->xyz)[3*i+2], Ri = atom_radius(lr, i, thread_id);
+    const int ns = lr->n_slices_per_atom;
+    const double *zb = lr->z_break[thread_id];
+    double zc, hw, h, t, tol, err, total_err = 0, sasa = 0;
+    int k, l, n_break, n_panel;
+
+    load_neighbors(lr, i, thread_id);
+    n_break = exposed_breakpoints(lr, i, thread_id);
+
+    for (k = 0; k + 1 < n_break; ++k) {
+        hw = (zb[k+1] - zb[k])/2;
+        if (hw <= 1e-10*Ri) continue;
+        zc = zi + (zb[k+1] + zb[k])/2;
+        n_panel = (int)ceil(ns*hw/Ri);
+        h = M_PI/n_panel;
+        tol = lr->target_error*hw/(Ri*n_panel);
+        for (l = 0; l < n_panel; ++l) {
+            t = (l + 0.5)*h;
+            sasa += refine_panel(lr, i, thread_id, zc, hw, t, h,
+                                 hw*sin(t)*slice_exposed_length(lr, i, thread_id, zc - hw*cos(t)),
+                                 tol, &err);
+            total_err += err;
         }
     }
+
+    if (total_err > lr->target_error) ++lr->n_unconverged[thread_id];
+
     return sasa;
 }
 
+double
+freesasa_exposed_arc_length(double *arc,
+                            int n)
+{
+    return exposed_arc_length(arc, n);
+}
+
 /* insertion sort (faster than qsort for these short lists) */
 inline static void
 sort_arcs(double * restrict arc,
@@ -407,6 +1459,83 @@ exposed_arc_length(double * restrict arc,
     return sum + TWOPI - sup;
 }
 
+/* as sort_arcs(), also sorting the owners of the end-points */
+inline static void
+sort_arcs_owner(double * restrict arc,
+                int * restrict owner,
+                int n)
+{
+    double tmp[2];
+    int tmp_owner[2], i, j;
+    for (i = 1; i < n; ++i) {
+        tmp[0] = arc[2*i]; tmp[1] = arc[2*i+1];
+        tmp_owner[0] = owner[2*i]; tmp_owner[1] = owner[2*i+1];
+        for (j = i; j > 0 && arc[2*j-2] > tmp[0]; --j) {
+            arc[2*j] = arc[2*j-2];
+            arc[2*j+1] = arc[2*j-1];
+            owner[2*j] = owner[2*j-2];
+            owner[2*j+1] = owner[2*j-1];
+        }
+        arc[2*j] = tmp[0]; arc[2*j+1] = tmp[1];
+        owner[2*j] = tmp_owner[0]; owner[2*j+1] = tmp_owner[1];
+    }
+}
+
+/* adds f times the derivative of end-point o (see
+   slice_exposed_length_gradient()) to dA */
+inline static void
+add_endpoint_derivative(double * restrict dA,
+                        const double * restrict darc,
+                        int o,
+                        double f)
+{
+    const double *d;
+    double *dAj;
+
+    if (o < 0) return;
+    d = darc + 6*(o/2) + 3*(o%2);
+    dAj = dA + 3*(o/2);
+    dAj[0] += f*d[0];
+    dAj[1] += f*d[1];
+    dAj[2] += f*d[2];
+}
+
+static double
+exposed_arc_length_gradient(double * restrict arc,
+                            int * restrict owner,
+                            int n,
+                            const double * restrict darc,
+                            double f,
+                            double * restrict dA)
+{
+    int i2, sup_owner;
+    double sum, sup, tmp;
+
+    if (n == 0) return TWOPI;
+
+    sort_arcs_owner(arc, owner, n);
+    /* exposed parts start where an arc ends, and end where the next
+       begins, moving the end increases the exposed length */
+    sum = arc[0];
+    add_endpoint_derivative(dA, darc, owner[0], f);
+    sup = arc[1];
+    sup_owner = owner[1];
+    for (i2 = 2; i2 < 2*n; i2 += 2) {
+        if (sup < arc[i2]) {
+            sum += arc[i2] - sup;
+            add_endpoint_derivative(dA, darc, owner[i2], f);
+            add_endpoint_derivative(dA, darc, sup_owner, -f);
+        }
+        tmp = arc[i2+1];
+        if (tmp > sup) {
+            sup = tmp;
+            sup_owner = owner[i2+1];
+        }
+    }
+    add_endpoint_derivative(dA, darc, sup_owner, -f);
+    return sum + TWOPI - sup;
+}
+
 #if USE_CHECK
 #include <check.h>
 
@@ -471,12 +1600,48 @@ START_TEST (test_exposed_arc_length)
 }
 END_TEST
 
+START_TEST (test_gradient)
+{
+    double v[15] = {0, 0, 0,  2.6, 0, 0,  1.2, 2.4, 0,  1, 0.8, 2.7,  -2.2, 1.5, -0.7};
+    double r[5] = {1.8, 1.7, 1.9, 1.6, 1.8};
+    double sasa[5], grad[15], total_p, total_m, h = 1e-6, sum[3] = {0, 0, 0};
+    freesasa_parameters param = freesasa_default_parameters;
+    coord_t *xyz = freesasa_coord_new_linked(v, 5);
+    int i, j;
+
+    param.n_threads = 1;
+    ck_assert_int_eq(freesasa_lee_richards(sasa, grad, NULL, xyz, r, freesasa_coord_n(xyz), &param, NULL), FREESASA_SUCCESS);
+    for (i = 0; i < 15; ++i) {
+        v[i] += h;
+        freesasa_lee_richards(sasa, NULL, NULL, xyz, r, freesasa_coord_n(xyz), &param, NULL);
+        for (j = 0, total_p = 0; j < 5; ++j) total_p += sasa[j];
+        v[i] -= 2*h;
+        freesasa_lee_richards(sasa, NULL, NULL, xyz, r, freesasa_coord_n(xyz), &param, NULL);
+        for (j = 0, total_m = 0; j < 5; ++j) total_m += sasa[j];
+        v[i] += h;
+        ck_assert(fabs((total_p - total_m)/(2*h) - grad[i]) < 1e-4);
+        sum[i%3] += grad[i];
+    }
+    /* translation invariance */
+    for (i = 0; i < 3; ++i) ck_assert(fabs(sum[i]) < 1e-8);
+
+    /* not with adaptive resolution */
+    param.target_atom_error = 1;
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    ck_assert_int_eq(freesasa_lee_richards(sasa, grad, NULL, xyz, r, freesasa_coord_n(xyz), &param, NULL), FREESASA_FAIL);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+
+    freesasa_coord_free(xyz);
+}
+END_TEST
+
 TCase *
 test_LR_static()
 {
     TCase *tc = tcase_create("sasa_lr.c static");
     tcase_add_test(tc, test_sort_arcs);
     tcase_add_test(tc, test_exposed_arc_length);
+    tcase_add_test(tc, test_gradient);
 
     return tc;
 }
@@ -20,6 +20,20 @@
 
 #include "freesasa_internal.h"
 #include "nb.h"
+#include "buried.h"
+
+/* upper limit for the number of test points per atom in adaptive mode */
+#define SR_MAX_ADAPTIVE_POINTS 60000
+/* the number of points is doubled for each level */
+#define SR_MAX_LEVELS 16
+/* ratio between the errors of two consecutive levels, 2^(-3/4) */
+#define SR_LEVEL_ERROR_RATIO 0.5946
+
+/* below this number of test points buried atoms are cheaper to
+   calculate than to detect with freesasa_atom_buried() */
+#ifndef SR_MIN_POINTS_BURIED_SCREEN
+#define SR_MIN_POINTS_BURIED_SCREEN 1000
+#endif
 
 #ifdef __GNUC__
 #define __attrib_pure__ __attribute__((pure))
@@ -32,17 +46,45 @@ typedef struct {
     int i1, i2; /* for multithreading, range of atoms */
     int thread_index;
     int n_atoms;
-    int n_points;
+    int n_calc; /* the first n_calc atoms are calculated, the rest only bury them */
+    int n_points[SR_MAX_LEVELS]; /* test points per level */
+    int n_levels; /* 1 if resolution is fixed */
     int n_threads;
-    double probe_radius;
+    int n_probes;
+    int *probe_order; /* probe indices in order of increasing radius */
+    double *probe_shifts; /* largest probe minus each probe, in the same order */
+    double probe_max; /* largest probe radius */
+    double probe_shift; /* subtracted from r for the current probe */
+    double target_error; /* per atom, 0 if resolution is fixed */
+    int screen_buried; /* skip atoms found by freesasa_atom_buried() */
+    int n_unconverged; /* atoms that didn't reach target_error */
+    int n_skipped; /* buried atoms */
     const coord_t *xyz;
-    coord_t *srp; /* test-points */
-    coord_t *tp_local[MAX_SR_THREADS]; /* coord object for storing intermediates */
+    coord_t *srp[SR_MAX_LEVELS]; /* test-points */
+    coord_t *tp_local[MAX_SR_THREADS][SR_MAX_LEVELS]; /* coord object for storing intermediates */
     int *spcount[MAX_SR_THREADS];
-    double *r;
-    double *r2;
+    double *buried_work[MAX_SR_THREADS];
+    /* coordinates and squared radii of the neighbors in contact with
+       the current atom and probe */
+    double *nb_xyz[MAX_SR_THREADS];
+    double *nb_r2[MAX_SR_THREADS];
+    int nb_capacity[MAX_SR_THREADS]; /* size of the work arrays of each thread */
+    int nn;
+    /* exposed test points, per thread, NULL if not requested */
+    freesasa_surface_dots *dots[MAX_SR_THREADS];
+    int dots_capacity[MAX_SR_THREADS];
+    int dots_fail;
+    double *r; /* including largest probe */
     nb_list *nb;
-    double *sasa;
+    /* NUMA-aware mode: cells used by the threads to fill the neighbor
+       lists of their own atoms, and the atoms of each thread (NULL
+       otherwise) */
+    nb_cells *cells;
+    int *order;
+    int pin_threads;
+    int status; /* of a thread */
+    double *sasa; /* results, n_probes values per atom */
+    freesasa_progress *progress; /* can be NULL */
 } sr_data;
 
 #if USE_THREADS
@@ -50,8 +92,17 @@ static int sr_do_threads(int n_threads, sr_data *sr);
 static void *sr_thread(void *arg);
 #endif
 
+static void
+sr_atom_areas(int i, sr_data *sr, int thread_index);
+
 static double
-sr_atom_area(int i, const sr_data *sr, int thread_index) __attrib_pure__;
+sr_atom_area(int i, sr_data *sr, int thread_index);
+
+static double
+sr_level_area(int i, const sr_data *sr, int thread_index, int level) __attrib_pure__;
+
+static void
+sr_store_dots(int i, sr_data *sr, int thread_index, int level);
 
 static coord_t *
 test_points(int N)
@@ -93,73 +144,133 @@ test_points(int N)
 void
 release_sr(sr_data *sr)
 {
-    int i;
+    int i, l;
 
-    freesasa_coord_free(sr->srp);
+    for (l = 0; l < sr->n_levels; ++l) {
+        freesasa_coord_free(sr->srp[l]);
+    }
     freesasa_nb_free(sr->nb);
+    freesasa_nb_cells_free(sr->cells);
+    free(sr->order);
     free(sr->r);
-    free(sr->r2);
+    free(sr->probe_order);
+    free(sr->probe_shifts);
 
     for (i = 0; i < sr->n_threads; ++i) {
-        freesasa_coord_free(sr->tp_local[i]);
+        for (l = 0; l < sr->n_levels; ++l) {
+            freesasa_coord_free(sr->tp_local[i][l]);
+        }
         free(sr->spcount[i]);
+        free(sr->buried_work[i]);
+        free(sr->nb_xyz[i]);
+        free(sr->nb_r2[i]);
+        /* the first one belongs to the caller */
+        if (i > 0) freesasa_surface_dots_free(sr->dots[i]);
     }
 }
 
 
-int
-init_sr(sr_data *sr,
-        double *sasa,
-        const coord_t *xyz,
-        const double *r,
-        double probe_radius,
-        int n_points,
-        int n_threads)
+/** Set parameters and allocate everything that doesn't depend on
+    the coordinates, for init_sr() and freesasa_sr_workspace_new() */
+static int
+prepare_sr(sr_data *sr,
+           double *sasa,
+           const coord_t *xyz,
+           int n_atoms,
+           const double *probe_radii,
+           int n_probes,
+           freesasa_surface_dots *dots,
+           int n_points,
+           double target_error,
+           int n_threads)
 {
-    int n_atoms = freesasa_coord_n(xyz), i;
-    coord_t *srp = test_points(n_points);
-    double ri;
+    int i, l, n_levels = 1;
 
-    if (srp == NULL) return fail_msg("failed to initialize test points");
+    /* in adaptive mode, double the number of points for each level */
+    if (target_error > 0) {
+        while (n_levels < SR_MAX_LEVELS &&
+               (n_points << n_levels) <= SR_MAX_ADAPTIVE_POINTS) {
+            ++n_levels;
+        }
+    }
 
     /* store parameters and reference arrays */
     sr->n_atoms = n_atoms;
-    sr->n_points = n_points;
+    sr->n_calc = n_atoms;
+    sr->n_levels = n_levels;
     sr->n_threads = n_threads;
-    sr->probe_radius = probe_radius;
+    sr->n_probes = n_probes;
+    sr->probe_shift = 0;
+    sr->target_error = target_error;
+    sr->screen_buried = target_error > 0 || n_points >= SR_MIN_POINTS_BURIED_SCREEN;
+    sr->n_unconverged = 0;
+    sr->n_skipped = 0;
     sr->xyz = xyz;
-    sr->srp = srp;
     sr->sasa = sasa;
     sr->nb = NULL;
+    sr->cells = NULL;
+    sr->order = NULL;
+    sr->pin_threads = 0;
+    sr->status = FREESASA_SUCCESS;
+    sr->r = NULL;
+    sr->probe_order = NULL;
+    sr->probe_shifts = NULL;
+    sr->progress = NULL;
 
     /* should be done before any mallocs (to avoid problems in potential cleanup) */
+    for (l = 0; l < n_levels; ++l) {
+        sr->srp[l] = NULL;
+        for (i = 0; i < n_threads; ++i) sr->tp_local[i][l] = NULL;
+    }
     for (i = 0; i < n_threads; ++i) {
-        sr->tp_local[i] = NULL;
         sr->spcount[i] = NULL;
+        sr->buried_work[i] = NULL;
+        sr->nb_xyz[i] = NULL;
+        sr->nb_r2[i] = NULL;
+        sr->nb_capacity[i] = 0;
+        sr->dots[i] = NULL;
+        sr->dots_capacity[i] = 0;
+    }
+    sr->dots_fail = 0;
+
+    for (l = 0; l < n_levels; ++l) {
+        sr->n_points[l] = n_points << l;
+        sr->srp[l] = test_points(sr->n_points[l]);
+        if (sr->srp[l] == NULL) {
+            release_sr(sr);
+            return fail_msg("failed to initialize test points");
+        }
     }
 
     sr->r =  malloc(sizeof(double)*n_atoms);
-    sr->r2 = malloc(sizeof(double)*n_atoms);
+    sr->probe_order = malloc(sizeof(int)*n_probes);
+    sr->probe_shifts = malloc(sizeof(double)*n_probes);
 
-    if (sr->r == NULL || sr->r2 == NULL) goto cleanup;
+    if (sr->r == NULL || sr->probe_order == NULL || sr->probe_shifts == NULL)
+        goto cleanup;
 
-    for (i = 0; i < n_atoms; ++i) {
-        ri = r[i] + probe_radius;
-        sr->r[i] = ri;
-        sr->r2[i] = ri * ri;
-    }
+    sr->probe_max = freesasa_sort_probes(sr->probe_order, sr->probe_shifts,
+                                         probe_radii, n_probes);
 
     for (i = 0; i < n_threads; ++i) {
-        sr->tp_local[i] = freesasa_coord_clone(sr->srp);
-        sr->spcount[i] = malloc(sizeof(int) * n_points);
-        if (sr->tp_local[i] == NULL || sr->spcount[i] == NULL) {
-            goto cleanup;
+        for (l = 0; l < n_levels; ++l) {
+            sr->tp_local[i][l] = freesasa_coord_clone(sr->srp[l]);
+            if (sr->tp_local[i][l] == NULL) goto cleanup;
         }
+        sr->spcount[i] = malloc(sizeof(int) * sr->n_points[n_levels-1]);
+        if (sr->spcount[i] == NULL) goto cleanup;
     }
 
-    /* calculate distances */
-    sr->nb = freesasa_nb_new(xyz, sr->r);
-    if (sr->nb == NULL) goto cleanup;
+    /* the first thread appends directly to the caller's object, the
+       others to their own, which are joined at the end */
+    if (dots) {
+        sr->dots[0] = dots;
+        sr->dots_capacity[0] = dots->n;
+        for (i = 1; i < n_threads; ++i) {
+            sr->dots[i] = freesasa_surface_dots_new();
+            if (sr->dots[i] == NULL) goto cleanup;
+        }
+    }
 
     return FREESASA_SUCCESS;
 
@@ -168,42 +279,151 @@ init_sr(sr_data *sr,
     return mem_fail();
 }
 
+/** Allocate the work arrays of thread i for atoms with at most
+    max_nni neighbors. Arrays allocated earlier are replaced. */
+static int
+alloc_sr_thread_arrays(sr_data *sr,
+                       int i,
+                       int max_nni)
+{
+    free(sr->buried_work[i]);
+    free(sr->nb_xyz[i]);
+    free(sr->nb_r2[i]);
+    sr->nb_capacity[i] = max_nni;
+    sr->buried_work[i] = malloc(sizeof(double) * FREESASA_BURIED_WORK_SIZE(max_nni));
+    sr->nb_xyz[i] = malloc(sizeof(double) * 3 * max_nni);
+    sr->nb_r2[i] = malloc(sizeof(double) * max_nni);
+    if (sr->buried_work[i] == NULL || sr->nb_xyz[i] == NULL || sr->nb_r2[i] == NULL)
+        return mem_fail();
+
+    return FREESASA_SUCCESS;
+}
+
+/** Allocate the work arrays for atoms with at most max_nni neighbors */
+static int
+alloc_sr_nb_arrays(sr_data *sr,
+                   int max_nni)
+{
+    int i;
+
+    for (i = 0; i < sr->n_threads; ++i) {
+        if (alloc_sr_thread_arrays(sr, i, max_nni)) return FREESASA_FAIL;
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+/** Initialize object for S&R calculation. In NUMA-aware mode the
+    neighbor lists and work arrays are left to the threads */
 int
-freesasa_shrake_rupley(double *sasa,
-                       const coord_t *xyz,
-                       const double *r,
-                       const freesasa_parameters *param)
+init_sr(sr_data *sr,
+        double *sasa,
+        const coord_t *xyz,
+        const double *r,
+        int n_calc,
+        const double *probe_radii,
+        int n_probes,
+        freesasa_surface_dots *dots,
+        int n_points,
+        double target_error,
+        int n_threads,
+        int numa_aware)
 {
-    int i, n_atoms, n_threads = param->n_threads, resolution, return_value;
-    double probe_radius = param->probe_radius;
+    int n_atoms = freesasa_coord_n(xyz), i, max_nni = 0;
+
+    if (prepare_sr(sr, sasa, xyz, n_atoms, probe_radii, n_probes, dots,
+                   n_points, target_error, n_threads))
+        return FREESASA_FAIL;
+    sr->n_calc = n_calc;
+
+    for (i = 0; i < n_atoms; ++i) {
+        sr->r[i] = r[i] + sr->probe_max;
+    }
+
+    if (numa_aware) {
+        sr->cells = freesasa_nb_cells_new(xyz, sr->r);
+        sr->nb = freesasa_nb_alloc_empty(n_atoms);
+        sr->order = malloc(sizeof(int) * n_calc);
+        if (sr->cells == NULL || sr->nb == NULL || sr->order == NULL) {
+            release_sr(sr);
+            return mem_fail();
+        }
+        freesasa_nb_cells_order(sr->cells, n_calc, n_threads, sr->order);
+        return FREESASA_SUCCESS;
+    }
+
+    /* calculate distances, the neighbors for smaller probes are a
+       subset of these */
+    sr->nb = freesasa_nb_new(xyz, sr->r);
+    if (sr->nb == NULL) {
+        release_sr(sr);
+        return fail_msg("");
+    }
+
+    for (i = 0; i < n_atoms; ++i) {
+        if (sr->nb->nn[i] > max_nni) max_nni = sr->nb->nn[i];
+    }
+    if (alloc_sr_nb_arrays(sr, max_nni)) {
+        release_sr(sr);
+        return fail_msg("");
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+static int
+shrake_rupley(double *sasa,
+              int *n_skipped,
+              freesasa_surface_dots *dots,
+              const coord_t *xyz,
+              const double *r,
+              int n_calc,
+              const double *probe_radii,
+              int n_probes,
+              const freesasa_parameters *param,
+              freesasa_progress *progress)
+{
+    int i, n_atoms, n_threads, resolution, return_value, n_pending = 0, numa_aware;
+    double target_error;
     sr_data sr;
 
     assert(sasa);
     assert(xyz);
     assert(r);
-
-    if (param == NULL) param = &freesasa_default_parameters;
+    assert(probe_radii);
+    assert(n_probes > 0);
+    assert(dots == NULL || n_probes == 1);
 
     n_atoms = freesasa_coord_n(xyz);
     n_threads = param->n_threads;
     resolution = param->shrake_rupley_n_points;
+    target_error = freesasa_target_atom_error(param, n_calc);
     return_value = FREESASA_SUCCESS;
 
+    assert(n_calc <= n_atoms);
+
     if (n_threads > MAX_SR_THREADS) {
         return fail_msg("S&R does not support more than %d threads", MAX_SR_THREADS);
     }
     if (resolution <= 0) {
         return fail_msg("%f test points invalid resolution in S&R, must be > 0\n", resolution);
     }
-    if (n_atoms == 0) return freesasa_warn("in %s(): empty coordinates", __func__);
-    if (n_threads > n_atoms) {
-        n_threads = n_atoms;
+    if (n_calc == 0) return freesasa_warn("in %s(): empty coordinates", __func__);
+    if (n_threads > n_calc) {
+        n_threads = n_calc;
         freesasa_warn("no sense in having more threads than atoms, only using %d threads",
                       n_threads);
     }
 
-    if (init_sr(&sr, sasa, xyz, r, probe_radius, resolution, n_threads))
+    /* the surface dots are stored in order of atom index */
+    numa_aware = USE_THREADS && param->numa_aware && n_threads > 1 &&
+        dots == NULL && freesasa_coord_periodic(xyz) == NULL;
+
+    if (init_sr(&sr, sasa, xyz, r, n_calc, probe_radii, n_probes, dots,
+                resolution, target_error, n_threads, numa_aware))
         return FREESASA_FAIL;
+    sr.progress = progress;
+    sr.pin_threads = param->pin_threads;
 
     /* calculate SASA */
     if (n_threads > 1) {
@@ -219,14 +439,326 @@ freesasa_shrake_rupley(double *sasa,
     }
     if (n_threads == 1) {
         /* don't want the overhead of generating threads if only one is used */
-        for (i = 0; i < n_atoms; ++i) {
-            sasa[i] = sr_atom_area(i, &sr, 0);
+        for (i = 0; i < n_calc; ++i) {
+            sr_atom_areas(i, &sr, 0);
+            if (freesasa_progress_tick(progress, &n_pending)) break;
+        }
+        freesasa_progress_flush(progress, &n_pending);
+    }
+    if (freesasa_progress_cancelled(progress)) {
+        release_sr(&sr);
+        return FREESASA_FAIL;
+    }
+    if (sr.n_unconverged > 0) {
+        return_value = freesasa_warn("%d atoms did not reach the target error in S&R, "
+                                     "using at most %d test points per atom",
+                                     sr.n_unconverged, sr.n_points[sr.n_levels-1]);
+    }
+    if (dots) {
+        for (i = 1; i < sr.n_threads; ++i) {
+            if (sr.dots_fail) break;
+            if (freesasa_surface_dots_append(dots, &sr.dots_capacity[0], sr.dots[i]))
+                sr.dots_fail = 1;
         }
+        if (sr.dots_fail) return_value = fail_msg("failed to store surface dots");
     }
+    if (n_skipped) *n_skipped = sr.n_skipped;
     release_sr(&sr);
     return return_value;
 }
 
+int
+freesasa_shrake_rupley(double *sasa,
+                       int *n_skipped,
+                       freesasa_surface_dots *dots,
+                       const coord_t *xyz,
+                       const double *r,
+                       int n_calc,
+                       const freesasa_parameters *param,
+                       freesasa_progress *progress)
+{
+    if (param == NULL) param = &freesasa_default_parameters;
+
+    return shrake_rupley(sasa, n_skipped, dots, xyz, r, n_calc,
+                         &param->probe_radius, 1, param, progress);
+}
+
+int
+freesasa_shrake_rupley_probes(double *sasa,
+                              int *n_skipped,
+                              const coord_t *xyz,
+                              const double *r,
+                              const double *probe_radii,
+                              int n_probes,
+                              const freesasa_parameters *param)
+{
+    if (param == NULL) param = &freesasa_default_parameters;
+
+    return shrake_rupley(sasa, n_skipped, NULL, xyz, r, freesasa_coord_n(xyz),
+                         probe_radii, n_probes, param, NULL);
+}
+
+struct freesasa_sr_workspace {
+    sr_data sr;
+    coord_t *xyz;
+    int n_max;
+    freesasa_parameters param;
+};
+
+freesasa_sr_workspace *
+freesasa_sr_workspace_new(int n_max,
+                          const freesasa_parameters *param)
+{
+    freesasa_sr_workspace *w;
+
+    assert(n_max > 0);
+
+    if (param == NULL) param = &freesasa_default_parameters;
+
+    if (param->shrake_rupley_n_points <= 0) {
+        fail_msg("%d test points invalid resolution in S&R, must be > 0",
+                 param->shrake_rupley_n_points);
+        return NULL;
+    }
+
+    w = malloc(sizeof(freesasa_sr_workspace));
+    if (w == NULL) {
+        mem_fail();
+        return NULL;
+    }
+    w->n_max = n_max;
+    w->param = *param;
+    w->xyz = freesasa_coord_new();
+    if (w->xyz == NULL) {
+        free(w);
+        mem_fail();
+        return NULL;
+    }
+
+    if (prepare_sr(&w->sr, NULL, w->xyz, n_max, &w->param.probe_radius, 1, NULL,
+                   param->shrake_rupley_n_points,
+                   freesasa_target_atom_error(param, n_max), 1)) {
+        freesasa_coord_free(w->xyz);
+        free(w);
+        fail_msg("");
+        return NULL;
+    }
+
+    /* the neighbor list is filled for each molecule, no atom can have
+       more neighbors than there are atoms */
+    w->sr.nb = freesasa_nb_alloc(n_max);
+    if (w->sr.nb == NULL || alloc_sr_nb_arrays(&w->sr, n_max)) {
+        freesasa_sr_workspace_free(w);
+        fail_msg("");
+        return NULL;
+    }
+
+    return w;
+}
+
+void
+freesasa_sr_workspace_free(freesasa_sr_workspace *w)
+{
+    if (w) {
+        release_sr(&w->sr);
+        freesasa_coord_free(w->xyz);
+        free(w);
+    }
+}
+
+int
+freesasa_sr_workspace_calc(freesasa_sr_workspace *w,
+                           double *sasa,
+                           const double *xyz,
+                           const double *r,
+                           int n,
+                           int *n_skipped,
+                           int *n_unconverged)
+{
+    sr_data *sr = &w->sr;
+    int i;
+
+    assert(n > 0 && n <= w->n_max);
+
+    freesasa_coord_relink(w->xyz, xyz, n);
+    sr->n_atoms = sr->n_calc = n;
+    sr->sasa = sasa;
+    sr->target_error = freesasa_target_atom_error(&w->param, n);
+    sr->n_skipped = sr->n_unconverged = 0;
+
+    for (i = 0; i < n; ++i) {
+        sr->r[i] = r[i] + sr->probe_max;
+    }
+
+    if (freesasa_nb_refill(sr->nb, w->xyz, sr->r))
+        return fail_msg("");
+
+    for (i = 0; i < n; ++i) {
+        sr_atom_areas(i, sr, 0);
+    }
+
+    if (n_skipped) *n_skipped += sr->n_skipped;
+    if (n_unconverged) *n_unconverged += sr->n_unconverged;
+
+    return FREESASA_SUCCESS;
+}
+
+/** Fill the neighbor lists of the atoms order[i1..i2-1] (atoms
+    i1..i2-1 if order is NULL) from the cells, and make sure the work
+    arrays of the thread are large enough for them */
+static int
+sr_fill_atoms(sr_data *sr,
+              const int *order,
+              int i1,
+              int i2)
+{
+    const int t = sr->thread_index;
+    int k, i, max_nni = 0;
+
+    for (k = i1; k < i2; ++k) {
+        i = order ? order[k] : k;
+        if (freesasa_nb_fill_atom(sr->nb, sr->cells, sr->xyz, sr->r, i))
+            return fail_msg("");
+        if (sr->nb->nn[i] > max_nni) max_nni = sr->nb->nn[i];
+    }
+
+    if (sr->nb_xyz[t] == NULL || max_nni > sr->nb_capacity[t]) {
+        if (alloc_sr_thread_arrays(sr, t, max_nni > 0 ? max_nni : 1))
+            return fail_msg("");
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+/* the shared data owns the arrays, each worker has a copy with its
+   own counters and work arrays, as in sr_do_threads() */
+struct freesasa_sr_job {
+    sr_data sr;
+    sr_data worker[MAX_SR_THREADS];
+};
+
+freesasa_sr_job *
+freesasa_sr_job_new(double *sasa,
+                    const coord_t *xyz,
+                    const double *r,
+                    const freesasa_parameters *param,
+                    int n_workers)
+{
+    const int n_atoms = freesasa_coord_n(xyz);
+    freesasa_sr_job *job;
+    int i;
+
+    assert(sasa);
+    assert(r);
+    assert(n_atoms > 0);
+
+    if (param == NULL) param = &freesasa_default_parameters;
+
+    if (n_workers < 1 || n_workers > MAX_SR_THREADS) {
+        fail_msg("S&R does not support more than %d threads", MAX_SR_THREADS);
+        return NULL;
+    }
+    if (param->shrake_rupley_n_points <= 0) {
+        fail_msg("%d test points invalid resolution in S&R, must be > 0",
+                 param->shrake_rupley_n_points);
+        return NULL;
+    }
+
+    job = malloc(sizeof(freesasa_sr_job));
+    if (job == NULL) {
+        mem_fail();
+        return NULL;
+    }
+
+    if (prepare_sr(&job->sr, sasa, xyz, n_atoms, &param->probe_radius, 1, NULL,
+                   param->shrake_rupley_n_points,
+                   freesasa_target_atom_error(param, n_atoms), n_workers)) {
+        free(job);
+        fail_msg("");
+        return NULL;
+    }
+
+    for (i = 0; i < n_atoms; ++i) {
+        job->sr.r[i] = r[i] + job->sr.probe_max;
+        sasa[i] = 0;
+    }
+
+    /* the neighbor lists are filled by the workers, chunk by chunk */
+    job->sr.cells = freesasa_nb_cells_new(xyz, job->sr.r);
+    job->sr.nb = freesasa_nb_alloc_empty(n_atoms);
+    if (job->sr.cells == NULL || job->sr.nb == NULL) {
+        release_sr(&job->sr);
+        free(job);
+        mem_fail();
+        return NULL;
+    }
+
+    for (i = 0; i < n_workers; ++i) {
+        job->worker[i] = job->sr;
+        job->worker[i].thread_index = i;
+    }
+
+    return job;
+}
+
+int
+freesasa_sr_job_calc(freesasa_sr_job *job,
+                     int first,
+                     int n,
+                     int worker)
+{
+    sr_data *sr = &job->worker[worker];
+    int i;
+
+    assert(first >= 0 && n > 0 && first + n <= sr->n_atoms);
+    assert(worker >= 0 && worker < job->sr.n_threads);
+
+    if (sr_fill_atoms(sr, NULL, first, first + n))
+        return fail_msg("");
+
+    for (i = first; i < first + n; ++i) {
+        sr_atom_areas(i, sr, worker);
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+int
+freesasa_sr_job_report(const freesasa_sr_job *job,
+                       int *n_skipped)
+{
+    int t, n_unconverged = 0;
+
+    for (t = 0; t < job->sr.n_threads; ++t) {
+        n_unconverged += job->worker[t].n_unconverged;
+        if (n_skipped) *n_skipped += job->worker[t].n_skipped;
+    }
+    if (n_unconverged > 0) {
+        return freesasa_warn("%d atoms did not reach the target error in S&R, "
+                             "using at most %d test points per atom",
+                             n_unconverged, job->sr.n_points[job->sr.n_levels-1]);
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+void
+freesasa_sr_job_free(freesasa_sr_job *job)
+{
+    int t;
+
+    if (job) {
+        /* allocated by the workers */
+        for (t = 0; t < job->sr.n_threads; ++t) {
+            job->sr.buried_work[t] = job->worker[t].buried_work[t];
+            job->sr.nb_xyz[t] = job->worker[t].nb_xyz[t];
+            job->sr.nb_r2[t] = job->worker[t].nb_r2[t];
+        }
+        release_sr(&job->sr);
+        free(job);
+    }
+}
+
 #if USE_THREADS
 static int
 sr_do_threads(int n_threads,
@@ -234,7 +766,7 @@ sr_do_threads(int n_threads,
 {
     pthread_t thread[MAX_SR_THREADS];
     sr_data srt[MAX_SR_THREADS];
-    int thread_block_size = sr->n_atoms/n_threads;
+    int thread_block_size = sr->n_calc/n_threads;
     int res, return_value = FREESASA_SUCCESS;
     int threads_created = 0, t;
 
@@ -242,10 +774,10 @@ sr_do_threads(int n_threads,
     for (t = 0; t < n_threads; ++t) {
         srt[t] = *sr;
         srt[t].i1 = t*thread_block_size;
-        if (t == n_threads-1) srt[t].i2 = sr->n_atoms;
+        if (t == n_threads-1) srt[t].i2 = sr->n_calc;
         else srt[t].i2 = (t+1)*thread_block_size;
         srt[t].thread_index = t;
-        res = pthread_create(&thread[t], NULL, sr_thread, (void *) &srt[t]);
+        res = freesasa_thread_create(&thread[t], sr_thread, (void *) &srt[t]);
         if (res) {
             return_value = fail_msg(freesasa_thread_error(res));
             break;
@@ -257,50 +789,186 @@ sr_do_threads(int n_threads,
         if (res) {
             return_value = fail_msg(freesasa_thread_error(res));
         }
+        sr->n_unconverged += srt[t].n_unconverged;
+        sr->n_skipped += srt[t].n_skipped;
+        /* allocated by the thread in NUMA-aware mode */
+        sr->buried_work[t] = srt[t].buried_work[t];
+        sr->nb_xyz[t] = srt[t].nb_xyz[t];
+        sr->nb_r2[t] = srt[t].nb_r2[t];
+        if (srt[t].status == FREESASA_FAIL) return_value = FREESASA_FAIL;
+        sr->dots_capacity[t] = srt[t].dots_capacity[t];
+        sr->dots_fail |= srt[t].dots_fail;
     }
     return return_value;
 }
 
+/* NUMA-aware mode: fill the neighbor lists of the thread's atoms and
+   allocate its work arrays in the thread, so that the memory is
+   first touched on the node where it is used */
+static int
+sr_thread_init(sr_data *sr)
+{
+    return sr_fill_atoms(sr, sr->order, sr->i1, sr->i2);
+}
+
 static void *
 sr_thread(void *arg)
 {
-    int i;
+    int k, i, n_pending = 0;
     sr_data *sr = ((sr_data*) arg);
 
-    for (i = sr->i1; i < sr->i2; ++i) {
+    if (sr->pin_threads) freesasa_pin_thread(sr->thread_index);
+
+    if (sr->order != NULL) {
+        sr->status = sr_thread_init(sr);
+        if (sr->status == FREESASA_FAIL) pthread_exit(NULL);
+    }
+
+    for (k = sr->i1; k < sr->i2; ++k) {
+        i = sr->order ? sr->order[k] : k;
         /* mutex should not be necessary, writes to non-overlapping regions */
-        sr->sasa[i] = sr_atom_area(i, sr, sr->thread_index);
+        sr_atom_areas(i, sr, sr->thread_index);
+        if (freesasa_progress_tick(sr->progress, &n_pending)) break;
     }
+    freesasa_progress_flush(sr->progress, &n_pending);
     pthread_exit(NULL);
 }
 #endif
 
+/** Stores the area of atom i for each probe radius in sr->sasa */
+static void
+sr_atom_areas(int i,
+              sr_data *sr,
+              int thread_index)
+{
+    const int nni = sr->nb->nn[i];
+    const int * restrict nbi = sr->nb->nb[i];
+    const double * restrict vi = freesasa_coord_all(sr->xyz) + 3*i;
+    const double * restrict xdi = sr->nb->xd[i], * restrict ydi = sr->nb->yd[i],
+        * restrict zdi = sr->nb->zd[i];
+    double * restrict nb_xyz = sr->nb_xyz[thread_index];
+    double * restrict nb_r2 = sr->nb_r2[thread_index];
+    double *sasa = sr->sasa + i*sr->n_probes, ri, rj, dx, dy, dz;
+    int j, k, n, n_exposed = sr->n_probes;
+
+    if (sr->screen_buried) {
+        n_exposed = freesasa_atom_buried_probes(i, sr->r, sr->probe_shifts,
+                                                sr->n_probes, sr->nb,
+                                                sr->buried_work[thread_index]);
+        sr->n_skipped += sr->n_probes - n_exposed;
+    }
+
+    for (k = 0; k < sr->n_probes; ++k) {
+        if (k >= n_exposed) {
+            sasa[sr->probe_order[k]] = 0;
+            continue;
+        }
+        sr->probe_shift = sr->probe_shifts[k];
+        ri = sr->r[i] - sr->probe_shift;
+
+        /* copy the neighbors in contact for more efficient access,
+           positions relative to atom i are taken from the neighbor
+           list, to handle periodic coordinates */
+        for (j = 0, n = 0; j < nni; ++j) {
+            rj = sr->r[nbi[j]] - sr->probe_shift;
+            dx = xdi[j];
+            dy = ydi[j];
+            dz = zdi[j];
+            if (dx*dx + dy*dy + dz*dz >= (ri+rj)*(ri+rj)) continue;
+            nb_xyz[3*n]   = vi[0] + dx;
+            nb_xyz[3*n+1] = vi[1] + dy;
+            nb_xyz[3*n+2] = vi[2] + dz;
+            nb_r2[n] = rj*rj;
+            ++n;
+        }
+        sr->nn = n;
+
+        sasa[sr->probe_order[k]] = sr_atom_area(i, sr, thread_index);
+    }
+}
+
+/**
+    Area of atom i, for the current probe. In adaptive mode the number of test points is
+    doubled until the area changes by less than the target error
+    between two levels. Levels where each test point covers more than
+    the target error are skipped, since they can miss the same small
+    patch of surface and agree by chance.
+ */
 static double
 sr_atom_area(int i,
-             const sr_data *sr,
+             sr_data *sr,
              int thread_index)
 {
-    const int n_points = sr->n_points;
+    const double ri = sr->r[i] - sr->probe_shift;
+    double area, prev, diff = -1, prev_diff;
+    int l = 0, converged = 1;
+
+    if (sr->n_levels > 1) {
+        while (l < sr->n_levels - 3 &&
+               4*M_PI*ri*ri/sr->n_points[l] > sr->target_error) {
+            ++l;
+        }
+    }
+
+    area = sr_level_area(i, sr, thread_index, l);
+
+    if (sr->n_levels > 1) {
+        for (++l; l < sr->n_levels; ++l) {
+            prev_diff = diff;
+            prev = area;
+            area = sr_level_area(i, sr, thread_index, l);
+            diff = fabs(area - prev);
+            if (diff <= sr->target_error && prev_diff >= 0 &&
+                prev_diff <= sr->target_error) break;
+            /* the error of S&R decreases as n_points^(-3/4), give up
+               if the remaining levels can't reach the target */
+            if (diff*pow(SR_LEVEL_ERROR_RATIO, sr->n_levels - 1 - l) > sr->target_error) {
+                l = sr->n_levels;
+                area = sr_level_area(i, sr, thread_index, l - 1);
+                break;
+            }
+        }
+        if (l == sr->n_levels) {
+            converged = 0;
+            --l;
+        }
+    }
+
+    if (!converged) ++sr->n_unconverged;
+    if (sr->dots[thread_index]) sr_store_dots(i, sr, thread_index, l);
+
+    return area;
+}
+
+/** Area of atom i using the test points of a given level */
+static double
+sr_level_area(int i,
+              const sr_data *sr,
+              int thread_index,
+              int level)
+{
+    const int n_points = sr->n_points[level];
     /* this array keeps track of which testpoints belonging to
        a certain atom do not overlap with any other atoms */
     int *spcount = sr->spcount[thread_index];
-    const int nni = sr->nb->nn[i];
-    const int * restrict nbi = sr->nb->nb[i];
-    const double ri = sr->r[i];
-    const double * restrict r2 = sr->r2;
-    const double * restrict v = freesasa_coord_all(sr->xyz);
-    const double * restrict vi = v+3*i;
+    const int nni = sr->nn;
+    const double * restrict nb_xyz = sr->nb_xyz[thread_index];
+    const double * restrict nb_r2 = sr->nb_r2[thread_index];
+    const double ri = sr->r[i] - sr->probe_shift;
+    const double * restrict vi = freesasa_coord_all(sr->xyz) + 3*i;
     const double * restrict tp;
     int n_surface = 0, current_nb, a, j, k;
     double dx, dy, dz;
     /* testpoints for this atom */
-    coord_t * restrict tp_coord_ri = sr->tp_local[thread_index];
+    coord_t * restrict tp_coord_ri = sr->tp_local[thread_index][level];
 
-    freesasa_coord_copy(tp_coord_ri, sr->srp);
+    freesasa_coord_copy(tp_coord_ri, sr->srp[level]);
     freesasa_coord_scale(tp_coord_ri, ri);
     freesasa_coord_translate(tp_coord_ri, vi);
     tp = freesasa_coord_all(tp_coord_ri);
 
+    if (nni == 0) return 4.0*M_PI*ri*ri;
+
     /* initialize with all surface points hidden */
     memset(spcount, 0, n_points*sizeof(int));
 
@@ -311,19 +979,18 @@ sr_atom_area(int i,
        organized in patches and not spirals. */
     current_nb = 0;
     for (j = 0; j < n_points; ++j) {
-        /* a is the index of the atom under consideration */
-        a = nbi[current_nb];
-        dx = tp[j*3]   - v[a*3];
-        dy = tp[j*3+1] - v[a*3+1];
-        dz = tp[j*3+2] - v[a*3+2];
-        if (dx*dx + dy*dy + dz*dz > r2[a]) {
+        /* a is the index of the neighbor under consideration */
+        a = current_nb;
+        dx = tp[j*3]   - nb_xyz[a*3];
+        dy = tp[j*3+1] - nb_xyz[a*3+1];
+        dz = tp[j*3+2] - nb_xyz[a*3+2];
+        if (dx*dx + dy*dy + dz*dz > nb_r2[a]) {
             k = 0;
             for (; k < nni; ++k) {
-                a = nbi[k];
-                dx = tp[j*3]   - v[a*3];
-                dy = tp[j*3+1] - v[a*3+1];
-                dz = tp[j*3+2] - v[a*3+2];
-                if (dx*dx + dy*dy + dz*dz <= r2[a]) {
+                dx = tp[j*3]   - nb_xyz[k*3];
+                dy = tp[j*3+1] - nb_xyz[k*3+1];
+                dz = tp[j*3+2] - nb_xyz[k*3+2];
+                if (dx*dx + dy*dy + dz*dz <= nb_r2[k]) {
                     current_nb = k;
                     break;
                 }
@@ -338,3 +1005,38 @@ sr_atom_area(int i,
 
     return (4.0*M_PI*ri*ri*n_surface)/n_points;
 }
+
+/**
+    Append the test points of atom i that were found to be exposed in
+    the last call to sr_level_area() to the dots of the thread.
+ */
+static void
+sr_store_dots(int i,
+              sr_data *sr,
+              int thread_index,
+              int level)
+{
+    freesasa_surface_dots *dots = sr->dots[thread_index];
+    const int n_points = sr->n_points[level];
+    const int *spcount = sr->spcount[thread_index];
+    const double *tp = freesasa_coord_all(sr->tp_local[thread_index][level]);
+    const double *normal = freesasa_coord_all(sr->srp[level]);
+    int j, n;
+
+    if (sr->dots_fail) return;
+    if (freesasa_surface_dots_reserve(dots, &sr->dots_capacity[thread_index], n_points)) {
+        sr->dots_fail = 1;
+        return;
+    }
+
+    n = dots->n;
+    for (j = 0; j < n_points; ++j) {
+        /* spcount is not used if there are no neighbors */
+        if (sr->nn > 0 && !spcount[j]) continue;
+        memcpy(dots->xyz + 3*n, tp + 3*j, sizeof(double) * 3);
+        memcpy(dots->normal + 3*n, normal + 3*j, sizeof(double) * 3);
+        dots->atom[n] = i;
+        ++n;
+    }
+    dots->n = n;
+}
@@ -0,0 +1,417 @@
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <assert.h>
+#include <stdlib.h>
+
+#if USE_THREADS
+# include <pthread.h>
+# define MAX_SCHEDULE_THREADS 16
+#else
+# define MAX_SCHEDULE_THREADS 1
+#endif
+
+#include "freesasa_internal.h"
+
+/* number of atoms per task when structures are divided into chunks */
+#ifndef SCHEDULE_CHUNK_SIZE
+#define SCHEDULE_CHUNK_SIZE 256
+#endif
+
+/* the calculation of a structure goes through these states, whole
+   structures and chunked ones that are finished stay in the setup and
+   ready states respectively, since they have nothing more to hand
+   out */
+enum {SCHEDULE_NEW, SCHEDULE_SETUP, SCHEDULE_READY, SCHEDULE_DONE};
+
+/* a structure and the state of its calculation */
+typedef struct {
+    const freesasa_structure *structure;
+    freesasa_result *result;
+    freesasa_sr_job *sr;
+    freesasa_lr_job *lr;
+    int n_chunks; /* 0 if the structure is calculated as one task */
+    int next_chunk; /* the next chunk to hand out */
+    int n_done; /* chunks finished */
+    int state;
+    int status;
+} schedule_item;
+
+typedef struct {
+    schedule_item *item;
+    int n_items;
+    int first_open; /* all tasks of the items before this are handed out */
+    int n_setup; /* items being set up that will have chunks to hand out */
+    int n_workers;
+    const freesasa_parameters *param;
+    freesasa_parameters single; /* one thread, for whole structures */
+#if USE_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+#endif
+} schedule;
+
+typedef struct {
+    schedule *sched;
+    int worker;
+} schedule_worker;
+
+static void
+schedule_lock(schedule *sched)
+{
+#if USE_THREADS
+    pthread_mutex_lock(&sched->lock);
+#endif
+}
+
+static void
+schedule_unlock(schedule *sched)
+{
+#if USE_THREADS
+    pthread_mutex_unlock(&sched->lock);
+#endif
+}
+
+/** Can the structure be divided into chunks of atoms? */
+static int
+schedule_chunked(const freesasa_structure *structure,
+                 const freesasa_parameters *param)
+{
+    if (freesasa_structure_n(structure) == 0 || param->calc_gradient) return 0;
+
+    switch (param->alg) {
+    case FREESASA_SHRAKE_RUPLEY:
+        return !param->calc_surface_dots;
+    case FREESASA_LEE_RICHARDS:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/** Have all tasks of the item been handed out? */
+static int
+schedule_exhausted(const schedule_item *item)
+{
+    switch (item->state) {
+    case SCHEDULE_NEW:
+        return 0;
+    case SCHEDULE_SETUP:
+        return item->n_chunks == 0;
+    case SCHEDULE_READY:
+        return item->next_chunk == item->n_chunks;
+    default:
+        return 1;
+    }
+}
+
+/** Hand out the next task, the lock should be held. Chunks of
+    structures that have been set up are preferred, in the order of
+    the structures, so that few structures are in memory at the same
+    time. Otherwise the next structure is started. Sets chunk to -1
+    for setup or whole structures. Returns NULL if there is nothing to
+    do at the moment. */
+static schedule_item *
+schedule_next(schedule *sched,
+              int *chunk)
+{
+    schedule_item *item;
+    int k;
+
+    while (sched->first_open < sched->n_items &&
+           schedule_exhausted(&sched->item[sched->first_open])) {
+        ++sched->first_open;
+    }
+
+    for (k = sched->first_open; k < sched->n_items; ++k) {
+        item = &sched->item[k];
+        if (item->state == SCHEDULE_READY && item->next_chunk < item->n_chunks) {
+            *chunk = item->next_chunk++;
+            return item;
+        }
+    }
+    for (k = sched->first_open; k < sched->n_items; ++k) {
+        item = &sched->item[k];
+        if (item->state == SCHEDULE_NEW) {
+            item->state = SCHEDULE_SETUP;
+            if (item->n_chunks > 0) ++sched->n_setup;
+            *chunk = -1;
+            return item;
+        }
+    }
+
+    return NULL;
+}
+
+/** Calculate a structure that isn't divided into chunks */
+static void
+schedule_whole(schedule *sched,
+               schedule_item *item)
+{
+    /* structures without atoms have no coordinates to calculate from */
+    if (freesasa_structure_n(item->structure) == 0) {
+        item->result = freesasa_result_new(0);
+        if (item->result != NULL) item->result->total = 0;
+    } else {
+        item->result = freesasa_calc_structure(item->structure, &sched->single);
+    }
+    if (item->result == NULL) {
+        item->status = fail_msg("");
+    } else {
+        item->result->parameters = *sched->param;
+    }
+}
+
+/** Allocate the result and the job of a chunked structure */
+static void
+schedule_setup(schedule *sched,
+               schedule_item *item)
+{
+    const freesasa_structure *s = item->structure;
+    const coord_t *xyz = freesasa_structure_xyz(s);
+    const double *radii = freesasa_structure_radius(s);
+    int status = FREESASA_SUCCESS;
+
+    item->result = freesasa_result_new(freesasa_structure_n(s));
+    if (item->result == NULL) {
+        status = fail_msg("");
+    } else if (sched->param->alg == FREESASA_SHRAKE_RUPLEY) {
+        item->sr = freesasa_sr_job_new(item->result->sasa, xyz, radii,
+                                       sched->param, sched->n_workers);
+        if (item->sr == NULL) status = fail_msg("");
+    } else {
+        item->lr = freesasa_lr_job_new(item->result->sasa, xyz, radii,
+                                       sched->param, sched->n_workers);
+        if (item->lr == NULL) status = fail_msg("");
+    }
+
+    schedule_lock(sched);
+    --sched->n_setup;
+    if (status == FREESASA_FAIL) {
+        freesasa_result_free(item->result);
+        item->result = NULL;
+        item->status = FREESASA_FAIL;
+        item->state = SCHEDULE_DONE;
+    } else {
+        item->state = SCHEDULE_READY;
+    }
+#if USE_THREADS
+    pthread_cond_broadcast(&sched->ready);
+#endif
+    schedule_unlock(sched);
+}
+
+/** Summarize the result of a chunked structure, when all chunks are
+    done, and free the job */
+static void
+schedule_finish(schedule *sched,
+                schedule_item *item)
+{
+    freesasa_result *result = item->result;
+    int i, ret;
+
+    if (item->status != FREESASA_FAIL) {
+        result->n_skipped = 0;
+        if (item->sr) ret = freesasa_sr_job_report(item->sr, &result->n_skipped);
+        else ret = freesasa_lr_job_report(item->lr, &result->n_skipped);
+        if (ret == FREESASA_WARN) item->status = FREESASA_WARN;
+
+        result->total = 0;
+        for (i = 0; i < result->n_atoms; ++i) {
+            result->total += result->sasa[i];
+        }
+        result->parameters = *sched->param;
+    } else {
+        freesasa_result_free(result);
+        item->result = NULL;
+    }
+
+    freesasa_sr_job_free(item->sr);
+    freesasa_lr_job_free(item->lr);
+    item->sr = NULL;
+    item->lr = NULL;
+}
+
+/** Calculate one chunk of a structure, the worker that finishes the
+    last chunk summarizes the result */
+static void
+schedule_chunk(schedule *sched,
+               schedule_item *item,
+               int chunk,
+               int worker)
+{
+    const int n_atoms = freesasa_structure_n(item->structure);
+    int first = chunk * SCHEDULE_CHUNK_SIZE, n, ret, last_chunk;
+
+    n = n_atoms - first < SCHEDULE_CHUNK_SIZE ? n_atoms - first : SCHEDULE_CHUNK_SIZE;
+
+    if (item->sr) ret = freesasa_sr_job_calc(item->sr, first, n, worker);
+    else ret = freesasa_lr_job_calc(item->lr, first, n, worker);
+
+    schedule_lock(sched);
+    if (ret == FREESASA_FAIL) item->status = fail_msg("");
+    last_chunk = (++item->n_done == item->n_chunks);
+    schedule_unlock(sched);
+
+    if (last_chunk) schedule_finish(sched, item);
+}
+
+/** The loop of each worker, runs until all tasks are handed out */
+static void
+schedule_run(schedule *sched,
+             int worker)
+{
+    schedule_item *item;
+    int chunk;
+
+    for (;;) {
+        schedule_lock(sched);
+        item = schedule_next(sched, &chunk);
+#if USE_THREADS
+        /* more chunks will come when the structures being set up are ready */
+        while (item == NULL && sched->n_setup > 0) {
+            pthread_cond_wait(&sched->ready, &sched->lock);
+            item = schedule_next(sched, &chunk);
+        }
+#endif
+        schedule_unlock(sched);
+
+        if (item == NULL) break;
+
+        if (chunk >= 0) schedule_chunk(sched, item, chunk, worker);
+        else if (item->n_chunks == 0) schedule_whole(sched, item);
+        else schedule_setup(sched, item);
+    }
+}
+
+#if USE_THREADS
+static void *
+schedule_thread(void *arg)
+{
+    schedule_worker *w = (schedule_worker *) arg;
+
+    if (w->sched->param->pin_threads) freesasa_pin_thread(w->worker);
+    schedule_run(w->sched, w->worker);
+    pthread_exit(NULL);
+}
+
+/** The calling thread is worker 0, the others are started here */
+static int
+schedule_do_threads(schedule *sched)
+{
+    pthread_t thread[MAX_SCHEDULE_THREADS];
+    schedule_worker worker[MAX_SCHEDULE_THREADS];
+    int res, t, threads_created = 0, return_value = FREESASA_SUCCESS;
+
+    for (t = 1; t < sched->n_workers; ++t) {
+        worker[t].sched = sched;
+        worker[t].worker = t;
+        res = freesasa_thread_create(&thread[t], schedule_thread, (void *) &worker[t]);
+        if (res) {
+            return_value = fail_msg(freesasa_thread_error(res));
+            break;
+        }
+        ++threads_created;
+    }
+
+    /* the tasks are handed out on demand, so the work gets done also
+       if not all threads could be started */
+    schedule_run(sched, 0);
+
+    for (t = 1; t <= threads_created; ++t) {
+        res = pthread_join(thread[t], NULL);
+        if (res) {
+            return_value = fail_msg(freesasa_thread_error(res));
+        }
+    }
+
+    return return_value;
+}
+#endif /* USE_THREADS */
+
+int
+freesasa_calc_structures(const freesasa_structure **structures,
+                         int n,
+                         freesasa_result **results,
+                         const freesasa_parameters *parameters)
+{
+    schedule sched;
+    int return_value = FREESASA_SUCCESS, n_atoms, i;
+
+    assert(structures);
+    assert(results);
+
+    if (parameters == NULL) parameters = &freesasa_default_parameters;
+
+    if (n < 0) return fail_msg("negative number of structures");
+    if (n == 0) return FREESASA_SUCCESS;
+    if (parameters->n_threads < 1) return fail_msg("number of threads must be 1 or larger");
+    if (parameters->n_threads > MAX_SCHEDULE_THREADS) {
+        return fail_msg("can not use more than %d threads", MAX_SCHEDULE_THREADS);
+    }
+
+    sched.item = malloc(sizeof(schedule_item) * n);
+    if (sched.item == NULL) return mem_fail();
+
+    sched.n_items = n;
+    sched.first_open = 0;
+    sched.n_setup = 0;
+    sched.n_workers = parameters->n_threads;
+    sched.param = parameters;
+    sched.single = *parameters;
+    sched.single.n_threads = 1;
+
+    for (i = 0; i < n; ++i) {
+        assert(structures[i]);
+        n_atoms = freesasa_structure_n(structures[i]);
+        sched.item[i].structure = structures[i];
+        sched.item[i].result = NULL;
+        sched.item[i].sr = NULL;
+        sched.item[i].lr = NULL;
+        sched.item[i].n_chunks = schedule_chunked(structures[i], parameters) ?
+            (n_atoms + SCHEDULE_CHUNK_SIZE - 1) / SCHEDULE_CHUNK_SIZE : 0;
+        sched.item[i].next_chunk = 0;
+        sched.item[i].n_done = 0;
+        sched.item[i].state = SCHEDULE_NEW;
+        sched.item[i].status = FREESASA_SUCCESS;
+    }
+
+#if USE_THREADS
+    pthread_mutex_init(&sched.lock, NULL);
+    pthread_cond_init(&sched.ready, NULL);
+#endif
+
+    if (sched.n_workers > 1) {
+#if USE_THREADS
+        return_value = schedule_do_threads(&sched);
+#else
+        return_value = freesasa_warn("in %s(): program compiled for single-threaded use, "
+                                     "but multiple threads were requested, will "
+                                     "proceed in single-threaded mode\n",
+                                     __func__);
+        sched.n_workers = 1;
+#endif
+    }
+    if (sched.n_workers == 1) {
+        schedule_run(&sched, 0);
+    }
+
+#if USE_THREADS
+    pthread_cond_destroy(&sched.ready);
+    pthread_mutex_destroy(&sched.lock);
+#endif
+
+    for (i = 0; i < n; ++i) {
+        results[i] = sched.item[i].result;
+        if (sched.item[i].status == FREESASA_FAIL) {
+            return_value = FREESASA_FAIL;
+        } else if (sched.item[i].status == FREESASA_WARN && return_value == FREESASA_SUCCESS) {
+            return_value = FREESASA_WARN;
+        }
+    }
+    free(sched.item);
+
+    if (return_value == FREESASA_FAIL) return fail_msg("");
+
+    return return_value;
+}
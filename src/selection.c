@@ -844,8 +844,10 @@ int freesasa_selection_parse_error(expression *e,
                                    yyscan_t scanner,
                                    const char *msg)
 {
-    if (freesasa_get_verbosity() == FREESASA_V_DEBUG)  print_expr(stderr, e, 0);
-    if (freesasa_get_verbosity() == FREESASA_V_NORMAL) fprintf(stderr, "\n");
+    FILE *err = freesasa_err_stream();
+
+    if (freesasa_get_verbosity() == FREESASA_V_DEBUG)  print_expr(err, e, 0);
+    if (freesasa_get_verbosity() == FREESASA_V_NORMAL) fprintf(err, "\n");
     return freesasa_fail(msg);
 }
 
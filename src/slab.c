@@ -0,0 +1,283 @@
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "freesasa_internal.h"
+
+/* maximum number of slab files open at the same time */
+#define SLAB_MAX_OPEN 128
+
+/* upper limit for the number of slabs */
+#define SLAB_MAX_N 1000000
+
+/* an atom as stored in the temporary files */
+typedef struct {
+    int index;
+    double xyz[3];
+    double r;
+} slab_atom;
+
+typedef struct {
+    double lo[3], hi[3];
+    double r_max;
+    int n;
+    int axis; /* the axis the atoms are divided along */
+    double width, halo;
+    int n_slabs;
+} slab_layout;
+
+/** The slab that the coordinate t along the axis belongs to */
+static int
+slab_of(const slab_layout *layout,
+        double t)
+{
+    int s = (int) floor((t - layout->lo[layout->axis]) / layout->width);
+    if (s < 0) return 0;
+    if (s >= layout->n_slabs) return layout->n_slabs - 1;
+    return s;
+}
+
+/**
+    Reads all atoms from the input, stores them in the spool file and
+    determines the extent of the system.
+ */
+static int
+spool_atoms(FILE *spool,
+            freesasa_atom_reader input,
+            void *input_data,
+            slab_layout *layout)
+{
+    slab_atom atom;
+    int ret, k;
+
+    layout->n = 0;
+    layout->r_max = 0;
+
+    while ((ret = input(atom.xyz, &atom.r, input_data)) == 1) {
+        if (atom.r < 0) {
+            return fail_msg("atom %d has negative radius", layout->n);
+        }
+        for (k = 0; k < 3; ++k) {
+            if (layout->n == 0 || atom.xyz[k] < layout->lo[k]) layout->lo[k] = atom.xyz[k];
+            if (layout->n == 0 || atom.xyz[k] > layout->hi[k]) layout->hi[k] = atom.xyz[k];
+        }
+        layout->r_max = fmax(layout->r_max, atom.r);
+        atom.index = layout->n++;
+        if (fwrite(&atom, sizeof(slab_atom), 1, spool) != 1) {
+            return fail_msg("failed writing temporary file");
+        }
+    }
+    if (ret == FREESASA_FAIL) return fail_msg("failed reading atoms");
+
+    return FREESASA_SUCCESS;
+}
+
+/**
+    Distributes the atoms in the spool file to the slab files of the
+    slabs first to first + n_files - 1, each atom is written to its
+    own slab and to the slabs whose halo it is in.
+ */
+static int
+distribute_atoms(FILE *spool,
+                 FILE **slab_file,
+                 int first,
+                 int n_files,
+                 const slab_layout *layout)
+{
+    slab_atom atom;
+    double t;
+    int s, s_lo, s_hi;
+
+    rewind(spool);
+    while (fread(&atom, sizeof(slab_atom), 1, spool) == 1) {
+        t = atom.xyz[layout->axis];
+        s_lo = slab_of(layout, t - layout->halo);
+        s_hi = slab_of(layout, t + layout->halo);
+        if (s_lo < first) s_lo = first;
+        if (s_hi >= first + n_files) s_hi = first + n_files - 1;
+        for (s = s_lo; s <= s_hi; ++s) {
+            if (fwrite(&atom, sizeof(slab_atom), 1, slab_file[s - first]) != 1) {
+                return fail_msg("failed writing temporary file");
+            }
+        }
+    }
+    if (ferror(spool)) return fail_msg("failed reading temporary file");
+
+    return FREESASA_SUCCESS;
+}
+
+/**
+    Calculates the atoms of one slab, with the atoms of the halo
+    only burying them, and passes the results to the output.
+ */
+static int
+calc_slab(FILE *slab_file,
+          int slab,
+          const slab_layout *layout,
+          freesasa_sasa_writer output,
+          void *output_data,
+          double *total,
+          const freesasa_parameters *parameters)
+{
+    slab_atom atom;
+    freesasa_parameters param = *parameters;
+    double *xyz = NULL, *r = NULL;
+    int *index = NULL;
+    coord_t *coord = NULL;
+    freesasa_result *result = NULL;
+    long size;
+    int n, n_core, n_halo, i, k, ret = FREESASA_SUCCESS;
+
+    if (fseek(slab_file, 0, SEEK_END) != 0 || (size = ftell(slab_file)) < 0) {
+        return fail_msg("failed reading temporary file");
+    }
+    n = (int) (size / sizeof(slab_atom));
+    if (n == 0) return FREESASA_SUCCESS;
+    rewind(slab_file);
+
+    xyz = malloc(sizeof(double) * 3 * n);
+    r = malloc(sizeof(double) * n);
+    index = malloc(sizeof(int) * n);
+    if (!xyz || !r || !index) {
+        ret = mem_fail();
+        goto cleanup;
+    }
+
+    /* the atoms of the slab first, the halo from the end */
+    n_core = n_halo = 0;
+    for (i = 0; i < n; ++i) {
+        if (fread(&atom, sizeof(slab_atom), 1, slab_file) != 1) {
+            ret = fail_msg("failed reading temporary file");
+            goto cleanup;
+        }
+        if (slab_of(layout, atom.xyz[layout->axis]) == slab) {
+            k = n_core++;
+            index[k] = atom.index;
+        } else {
+            k = n - 1 - n_halo++;
+        }
+        xyz[3*k] = atom.xyz[0];
+        xyz[3*k+1] = atom.xyz[1];
+        xyz[3*k+2] = atom.xyz[2];
+        r[k] = atom.r;
+    }
+    if (n_core == 0) goto cleanup;
+
+    coord = freesasa_coord_new_linked(xyz, n);
+    if (coord == NULL) {
+        ret = fail_msg("");
+        goto cleanup;
+    }
+    /* thin slabs can have fewer atoms than threads, which would
+       otherwise give a warning for each slab */
+    if (param.n_threads > n_core) param.n_threads = n_core;
+    result = freesasa_calc_subset(coord, r, n_core, &param, NULL);
+    if (result == NULL) {
+        ret = fail_msg("");
+        goto cleanup;
+    }
+
+    for (i = 0; i < n_core; ++i) {
+        if (output(index[i], result->sasa[i], output_data) == FREESASA_FAIL) {
+            ret = fail_msg("failed writing results");
+            goto cleanup;
+        }
+    }
+    *total += result->total;
+
+ cleanup:
+    freesasa_result_free(result);
+    freesasa_coord_free(coord);
+    free(xyz);
+    free(r);
+    free(index);
+
+    return ret;
+}
+
+int
+freesasa_calc_slabs(freesasa_atom_reader input,
+                    void *input_data,
+                    freesasa_sasa_writer output,
+                    void *output_data,
+                    double slab_width,
+                    double *total,
+                    const freesasa_parameters *parameters)
+{
+    FILE *spool = NULL, *slab_file[SLAB_MAX_OPEN];
+    slab_layout layout;
+    double sum = 0;
+    int first, n_files, s, k, ret = FREESASA_SUCCESS;
+
+    assert(input);
+    assert(output);
+
+    if (parameters == NULL) parameters = &freesasa_default_parameters;
+
+    if (!(slab_width > 0)) return fail_msg("slab width must be positive");
+    if (parameters->calc_gradient || parameters->calc_surface_dots) {
+        return fail_msg("gradients and surface dots can not be calculated in slab mode");
+    }
+
+    spool = tmpfile();
+    if (spool == NULL) return fail_msg("failed opening temporary file");
+
+    if (spool_atoms(spool, input, input_data, &layout)) {
+        fclose(spool);
+        return fail_msg("");
+    }
+
+    if (layout.n > 0) {
+        /* divide along the longest axis */
+        layout.axis = 0;
+        for (k = 1; k < 3; ++k) {
+            if (layout.hi[k] - layout.lo[k] > layout.hi[layout.axis] - layout.lo[layout.axis])
+                layout.axis = k;
+        }
+        layout.width = slab_width;
+        layout.halo = 2 * (layout.r_max + parameters->probe_radius);
+        if ((layout.hi[layout.axis] - layout.lo[layout.axis]) / slab_width > SLAB_MAX_N) {
+            fclose(spool);
+            return fail_msg("slab width %f too small, gives more than %d slabs",
+                            slab_width, SLAB_MAX_N);
+        }
+        layout.n_slabs = 1 + (int) ((layout.hi[layout.axis] - layout.lo[layout.axis]) / slab_width);
+
+        for (first = 0; first < layout.n_slabs && ret == FREESASA_SUCCESS; first += n_files) {
+            n_files = layout.n_slabs - first;
+            if (n_files > SLAB_MAX_OPEN) n_files = SLAB_MAX_OPEN;
+
+            for (s = 0; s < n_files; ++s) slab_file[s] = NULL;
+            for (s = 0; s < n_files; ++s) {
+                slab_file[s] = tmpfile();
+                if (slab_file[s] == NULL) {
+                    ret = fail_msg("failed opening temporary file");
+                    break;
+                }
+            }
+
+            if (ret == FREESASA_SUCCESS) {
+                ret = distribute_atoms(spool, slab_file, first, n_files, &layout);
+            }
+
+            for (s = 0; s < n_files; ++s) {
+                if (ret == FREESASA_SUCCESS) {
+                    ret = calc_slab(slab_file[s], first + s, &layout,
+                                    output, output_data, &sum, parameters);
+                }
+                if (slab_file[s]) fclose(slab_file[s]);
+            }
+        }
+    }
+
+    fclose(spool);
+
+    if (ret == FREESASA_FAIL) return fail_msg("");
+    if (total) *total = sum;
+
+    return FREESASA_SUCCESS;
+}
@@ -4,6 +4,9 @@
 
 #include <stdlib.h>
 #include <assert.h>
+#if USE_THREADS
+# include <pthread.h>
+#endif
 
 #include "pdb.h"
 #include "classifier.h"
@@ -28,13 +31,24 @@
 #define RESIDUES_CHUNK 64
 #define CHAINS_CHUNK 64
 
+/* smallest number of atom lines per thread when a PDB file is parsed
+   in parallel */
+#ifndef PARSE_MIN_BLOCK_ATOMS
+#define PARSE_MIN_BLOCK_ATOMS 256
+#endif
+
+#if USE_THREADS
+/* Views of a shared structure may be created and freed from several
+   threads, the reference counts are protected by this lock. */
+static pthread_mutex_t refs_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
 struct atom {
     char *res_name;
     char *res_number;
     char *atom_name;
     char *symbol;
     char *line;
-    int res_index;
     char chain_label;
     freesasa_atom_class the_class;
 };
@@ -45,7 +59,6 @@ static const struct atom empty_atom = {
     NULL, /* atom_name */
     NULL, /* symbol */
     NULL, /* line */
-    -1, /* res_index */
     '\0', /* chain_label */
     FREESASA_ATOM_UNKNOWN /* the_class */
 };
@@ -55,6 +68,11 @@ struct atoms {
     int n_alloc;
     struct atom **atom;
     double *radius;
+    /* atoms created by freesasa_structure_from_arrays() are allocated
+       in one block, with their strings in another */
+    struct atom *pool;
+    int n_pool;
+    char *strings;
 };
 
 struct residues {
@@ -78,12 +96,23 @@ struct freesasa_structure {
     char *classifier_name;
     coord_t *xyz;
     int model; /* model number */
+    /* Views share the atoms of their parent. The arrays of atoms and
+       radii are owned by the view only if the atoms are not
+       contiguous in the parent, the residue reference areas are never
+       owned. */
+    freesasa_structure *parent;
+    int owns_atoms;
+    int n_refs; /* the structure itself and its views */
 };
 
 static int
 guess_symbol(char *symbol,
              const char *name);
 
+static int
+guess_symbol_silent(char *symbol,
+                    const char *name);
+
 static void
 atom_free(struct atom *a)
 {
@@ -105,6 +134,9 @@ atoms_init()
     atoms.n_alloc = 0;
     atoms.atom = NULL;
     atoms.radius = NULL;
+    atoms.pool = NULL;
+    atoms.n_pool = 0;
+    atoms.strings = NULL;
     return atoms;
 }
 
@@ -154,11 +186,16 @@ atoms_dealloc(struct atoms *atoms)
     if (atoms) {
         atom = atoms->atom;
         if (atom) {
-            for (i = 0; i < atoms->n; ++i)
-                if (atom[i]) atom_free(atom[i]);
+            for (i = 0; i < atoms->n; ++i) {
+                if (atom[i] && !(atom[i] >= atoms->pool &&
+                                 atom[i] < atoms->pool + atoms->n_pool))
+                    atom_free(atom[i]);
+            }
             free(atom);
         }
         free(atoms->radius);
+        free(atoms->pool);
+        free(atoms->strings);
         *atoms = atoms_init();
     }
 }
@@ -177,7 +214,6 @@ atom_new(const char *residue_name,
 
     a->line = NULL;
     a->chain_label = chain_label;
-    a->res_index = -1;
 
     a->res_name = strdup(residue_name);
     a->res_number = strdup(residue_number);
@@ -198,9 +234,16 @@ atom_new(const char *residue_name,
     return NULL;
 }
 
+/**
+    Creates an atom from an ATOM or HETATM line. If the line has no
+    element symbol, it is guessed from the atom name, and *guessed is
+    set to ::FREESASA_WARN if that guess is uncertain (no warning is
+    printed here, so that lines can be parsed concurrently).
+ */
 static struct atom *
 atom_new_from_line(const char *line,
-                   char *alt_label)
+                   char *alt_label,
+                   int *guessed)
 {
     char aname[PDB_ATOM_NAME_STRL+1], rname[PDB_ATOM_RES_NAME_STRL+1],
         rnumber[PDB_ATOM_RES_NUMBER_STRL+1], symbol[PDB_ATOM_SYMBOL_STRL+1];
@@ -215,9 +258,10 @@ atom_new_from_line(const char *line,
     freesasa_pdb_get_res_name(rname, line);
     freesasa_pdb_get_res_number(rnumber, line);
 
+    *guessed = FREESASA_SUCCESS;
     flag = freesasa_pdb_get_symbol(symbol, line);
     if (flag == FREESASA_FAIL || (symbol[0] == ' ' && symbol[1] == ' ')) {
-        guess_symbol(symbol, aname);
+        *guessed = guess_symbol_silent(symbol, aname);
     }
 
     a = atom_new(rname, rnumber, aname, symbol, freesasa_pdb_get_chain_label(line));
@@ -368,6 +412,9 @@ freesasa_structure_new(void)
     s->xyz = freesasa_coord_new();
     s->model = 1;
     s->classifier_name = NULL;
+    s->parent = NULL;
+    s->owns_atoms = 1;
+    s->n_refs = 1;
 
     if (s->xyz == NULL) goto memerr;
 
@@ -378,16 +425,51 @@ freesasa_structure_new(void)
     return NULL;
 }
 
+/** Change the reference count of a structure, returns the new count */
+static int
+structure_refs_add(freesasa_structure *s,
+                   int delta)
+{
+    int n;
+
+#if USE_THREADS
+    pthread_mutex_lock(&refs_lock);
+#endif
+    n = (s->n_refs += delta);
+#if USE_THREADS
+    pthread_mutex_unlock(&refs_lock);
+#endif
+
+    return n;
+}
+
 void
 freesasa_structure_free(freesasa_structure *s)
 {
+    freesasa_structure *parent;
+
     if (s != NULL) {
-        atoms_dealloc(&s->atoms);
-        residues_dealloc(&s->residues);
+        /* the structure stays alive as long as it has views */
+        if (structure_refs_add(s, -1) > 0) return;
+
+        parent = s->parent;
+        if (parent == NULL) {
+            atoms_dealloc(&s->atoms);
+            residues_dealloc(&s->residues);
+        } else {
+            if (s->owns_atoms) {
+                free(s->atoms.atom);
+                free(s->atoms.radius);
+            }
+            free(s->residues.first_atom);
+            free(s->residues.reference_area);
+        }
         chains_dealloc(&s->chains);
         if (s->xyz != NULL) freesasa_coord_free(s->xyz);
         free(s->classifier_name);
         free(s);
+
+        freesasa_structure_free(parent);
     }
 }
 
@@ -399,8 +481,8 @@ freesasa_structure_free(freesasa_structure *s)
     used if the atom cannot be recognized by the classifier.
 */
 static int
-guess_symbol(char *symbol,
-             const char *name)
+guess_symbol_silent(char *symbol,
+                    const char *name)
 {
     /* if the first position is empty, or a number, assume that it is
        a one letter element e.g. " C ", or "1H " */
@@ -412,7 +494,7 @@ guess_symbol(char *symbol,
         /* if the string has padding to the right, it's a
            two-letter element, e.g. "FE  " */
         if (name[3] == ' ') {
-            strncpy(symbol,name,2);
+            memcpy(symbol, name, 2);
             symbol[2] = '\0';
         } else {
             /* If it's a four-letter string, it's hard to say,
@@ -420,12 +502,24 @@ guess_symbol(char *symbol,
             symbol[0] = ' ';
             symbol[1] = name[0];
             symbol[2] = '\0';
-            return freesasa_warn("guessing that atom '%s' is symbol '%s'",
-                                 name,symbol);
+            return FREESASA_WARN;
         }
     }
     return FREESASA_SUCCESS;
 }
+
+/** As guess_symbol_silent(), but warns if the guess is uncertain */
+static int
+guess_symbol(char *symbol,
+             const char *name)
+{
+    if (guess_symbol_silent(symbol, name) == FREESASA_WARN) {
+        return freesasa_warn("guessing that atom '%s' is symbol '%s'",
+                             name,symbol);
+    }
+    return FREESASA_SUCCESS;
+}
+
 static int
 structure_add_chain(freesasa_structure *s,
                     char chain_label,
@@ -485,16 +579,14 @@ structure_add_residue(freesasa_structure *s,
 }
 
 /**
-    Get the radius of an atom, and fail, warn and/or guess depending
-    on the options.
+    Check the radius the classifier gave an atom (negative if
+    unknown), and fail, warn and/or guess depending on the options.
  */
 static int
 structure_check_atom_radius(double *radius,
                             struct atom *a,
-                            const freesasa_classifier* classifier,
                             int options)
 {
-    *radius = freesasa_classifier_radius(classifier, a->res_name, a->atom_name);
     if (*radius < 0) {
         if (options & FREESASA_HALT_AT_UNKNOWN) {
             return fail_msg("atom '%s %s' unknown",
@@ -546,20 +638,28 @@ structure_register_classifier(freesasa_structure *structure,
    assigned and the caller is expected to replace it with a correct
    radius later.
 
+   The class of the atom and its radius (negative if unknown) have
+   already been looked up in the classifier.
+
    The atom a should be a pointer to a heap address, this will not be cloned.
  */
 static int
-structure_add_atom(freesasa_structure *structure,
-                   struct atom *atom,
-                   double *xyz,
-                   const freesasa_classifier* classifier,
-                   int options)
+structure_add_classified_atom(freesasa_structure *structure,
+                              struct atom *atom,
+                              double *xyz,
+                              double radius,
+                              const freesasa_classifier* classifier,
+                              int options)
 {
     int na, ret;
-    double r;
+    double r = radius;
 
     assert(structure); assert(atom); assert(xyz);
 
+    if (structure->parent != NULL || structure->n_refs > 1) {
+        return fail_msg("atoms can not be added to views, or structures that have views");
+    }
+
     /* let the stricter option override if both are specified */
     if (options & FREESASA_SKIP_UNKNOWN && options & FREESASA_HALT_AT_UNKNOWN)
         options &= ~FREESASA_SKIP_UNKNOWN;
@@ -573,7 +673,7 @@ structure_add_atom(freesasa_structure *structure,
     if (options & FREESASA_RADIUS_FROM_OCCUPANCY) {
         r = 1; /* fix it later */
     } else {
-        ret = structure_check_atom_radius(&r, atom, classifier, options);
+        ret = structure_check_atom_radius(&r, atom, options);
         if (ret == FREESASA_FAIL) return fail_msg("halting at unknown atom");
         if (ret == FREESASA_WARN) return FREESASA_WARN;
     }
@@ -596,35 +696,115 @@ structure_add_atom(freesasa_structure *structure,
     if (structure_add_residue(structure, classifier, atom, na-1) == FREESASA_FAIL)
         return mem_fail();
 
-    atom->the_class = freesasa_classifier_class(classifier, atom->res_name, atom->atom_name);
-    atom->res_index = structure->residues.n - 1;
     structure->atoms.radius[na-1] = r;
     structure->atoms.atom[na-1] = atom;
 
     return FREESASA_SUCCESS;
 }
 
+/** As structure_add_classified_atom(), but classifies the atom */
+static int
+structure_add_atom(freesasa_structure *structure,
+                   struct atom *atom,
+                   double *xyz,
+                   const freesasa_classifier* classifier,
+                   int options)
+{
+    if (classifier == NULL) {
+        classifier = &freesasa_default_classifier;
+    }
+    atom->the_class = freesasa_classifier_class(classifier, atom->res_name, atom->atom_name);
+
+    return structure_add_classified_atom(structure, atom, xyz,
+                                         freesasa_classifier_radius(classifier, atom->res_name,
+                                                                    atom->atom_name),
+                                         classifier, options);
+}
+
+/* An ATOM or HETATM line, and what is parsed from it */
+struct atom_line {
+    size_t offset; /* in the buffer of lines */
+    struct atom *atom;
+    double xyz[3];
+    double radius; /* from the classifier, negative if unknown */
+    double occupancy;
+    char alt;
+    int guessed; /* ::FREESASA_WARN if the symbol guess is uncertain */
+    int coord_status;
+    int occupancy_status;
+};
+
+/* The atom lines of a file range, each terminated by '\0' */
+struct atom_lines {
+    char *buf;
+    size_t len, size;
+    struct atom_line *line;
+    int n, n_alloc;
+    int model;
+};
+
+/* A block of consecutive atom lines, parsed in one thread */
+struct parse_block {
+    struct atom_lines *lines;
+    const freesasa_classifier *classifier;
+    int options;
+    int first, last; /* last not included */
+};
+
+static void
+atom_lines_free(struct atom_lines *lines)
+{
+    int i;
+    for (i = 0; i < lines->n; ++i) {
+        atom_free(lines->line[i].atom);
+    }
+    free(lines->line);
+    free(lines->buf);
+}
+
+static int
+atom_lines_add(struct atom_lines *lines,
+               const char *line)
+{
+    size_t len = strlen(line) + 1;
+    void *tmp;
+
+    if (lines->len + len > lines->size) {
+        size_t new_size = 2 * lines->size + len + 4096;
+        tmp = realloc(lines->buf, new_size);
+        if (tmp == NULL) return mem_fail();
+        lines->buf = tmp;
+        lines->size = new_size;
+    }
+    if (lines->n == lines->n_alloc) {
+        int new_n = 2 * lines->n_alloc + ATOMS_CHUNK;
+        tmp = realloc(lines->line, sizeof(struct atom_line) * new_n);
+        if (tmp == NULL) return mem_fail();
+        lines->line = tmp;
+        lines->n_alloc = new_n;
+    }
+
+    memcpy(lines->buf + lines->len, line, len);
+    lines->line[lines->n].offset = lines->len;
+    lines->line[lines->n].atom = NULL;
+    lines->len += len;
+    ++lines->n;
+
+    return FREESASA_SUCCESS;
+}
+
 /**
-    Handles the reading of PDB-files, returns NULL if problems reading
-    or input or malloc failure. Error-messages should explain what
-    went wrong.
+    Reads the lines of a file range that contain atoms to be included
+    (given the options), and the model number. Stops at the first
+    ENDMDL, unless models are joined.
  */
-static freesasa_structure*
-from_pdb_impl(FILE *pdb_file,
-              struct file_range it,
-              const freesasa_classifier *classifier,
-              int options)
+static int
+atom_lines_read(struct atom_lines *lines,
+                FILE *pdb_file,
+                struct file_range it,
+                int options)
 {
     char line[PDB_MAX_LINE_STRL];
-    char alt, the_alt = ' ';
-    double v[3], r;
-    int ret;
-    struct atom *a = NULL;
-    freesasa_structure *s = freesasa_structure_new();
-
-    assert(pdb_file);
-
-    if (s == NULL) return NULL;
 
     fseek(pdb_file,it.begin,SEEK_SET);
 
@@ -636,59 +816,202 @@ from_pdb_impl(FILE *pdb_file,
                 !(options & FREESASA_INCLUDE_HYDROGEN))
                 continue;
 
-            a = atom_new_from_line(line, &alt);
-            if (a == NULL)
-                goto cleanup;
+            if (atom_lines_add(lines, line) == FREESASA_FAIL)
+                return FREESASA_FAIL;
+        }
 
-            if ((alt != ' ' && the_alt == ' ') || (alt == ' '))
-                the_alt = alt;
-            else if (alt != ' ' && alt != the_alt) {
-                atom_free(a);
-                a = NULL;
-                continue;
-            }
+        if (! (options & FREESASA_JOIN_MODELS)) {
+            if (strncmp("MODEL",line,5)==0)  sscanf(line+10, "%d", &lines->model);
+            if (strncmp("ENDMDL",line,6)==0) break;
+        }
+    }
 
-            ret = freesasa_pdb_get_coord(v, line);
-            if (ret == FREESASA_FAIL)
-                goto cleanup;
+    return FREESASA_SUCCESS;
+}
 
-            ret = structure_add_atom(s, a, v, classifier, options);
-            if (ret == FREESASA_FAIL) {
-                goto cleanup;
-            } else if (ret == FREESASA_WARN) {
-                atom_free(a);
-                a = NULL;
-                continue;
-            }
+/**
+    Parses and classifies the lines of a block. Nothing is printed,
+    except for memory errors, problems are stored with each line and
+    reported when the atoms are added to the structure.
+ */
+static void
+parse_block(void *arg)
+{
+    struct parse_block *block = (struct parse_block *) arg;
+    const freesasa_classifier *classifier = block->classifier;
+    struct atom_line *l;
+    const char *line;
+    struct atom *a;
+    int i;
 
-            if (options & FREESASA_RADIUS_FROM_OCCUPANCY) {
-                ret = freesasa_pdb_get_occupancy(&r, line);
-                if (ret == FREESASA_FAIL)
-                    goto cleanup;
-                s->atoms.radius[s->atoms.n-1] = r;
-            }
-        }
+    for (i = block->first; i < block->last; ++i) {
+        l = &block->lines->line[i];
+        line = block->lines->buf + l->offset;
 
-        if (! (options & FREESASA_JOIN_MODELS)) {
-            if (strncmp("MODEL",line,5)==0)  sscanf(line+10, "%d", &s->model);
-            if (strncmp("ENDMDL",line,6)==0) break;
+        a = l->atom = atom_new_from_line(line, &l->alt, &l->guessed);
+        if (a == NULL) break;
+
+        l->coord_status = freesasa_pdb_get_coord_silent(l->xyz, line);
+        a->the_class = freesasa_classifier_class(classifier, a->res_name, a->atom_name);
+        l->radius = freesasa_classifier_radius(classifier, a->res_name, a->atom_name);
+        if (block->options & FREESASA_RADIUS_FROM_OCCUPANCY) {
+            l->occupancy_status = freesasa_pdb_get_occupancy(&l->occupancy, line);
         }
     }
+}
 
-    if (s->atoms.n == 0) {
-        fail_msg("input had no valid ATOM or HETATM lines");
+/**
+    Creates a structure from atom lines. The lines are parsed and
+    classified in blocks of about equal size, one per thread, and the
+    atoms are then added to the structure in order. Only the last step
+    needs to know about residues, chains and alternate coordinates,
+    and all messages are printed there, in the order of the file.
+
+    The atoms that are added to the structure are removed from the
+    lines, which should be freed by the caller. Returns NULL if
+    problems reading input or malloc failure. The structure can be
+    empty.
+ */
+static freesasa_structure*
+from_atom_lines(struct atom_lines *lines,
+                const freesasa_classifier *classifier,
+                int options,
+                int n_threads)
+{
+    char the_alt = ' ';
+    int i, ret, n_blocks;
+    struct parse_block *block = NULL;
+    struct atom_line *l;
+    freesasa_structure *s = freesasa_structure_new();
+
+    if (s == NULL) return NULL;
+    if (classifier == NULL) classifier = &freesasa_default_classifier;
+
+    s->model = lines->model;
+
+    n_blocks = lines->n / PARSE_MIN_BLOCK_ATOMS;
+    if (n_blocks > n_threads) n_blocks = n_threads;
+    if (n_blocks < 1) n_blocks = 1;
+
+    block = malloc(sizeof(struct parse_block) * n_blocks);
+    if (block == NULL) {
+        mem_fail();
+        goto cleanup;
+    }
+
+    for (i = 0; i < n_blocks; ++i) {
+        block[i].lines = lines;
+        block[i].classifier = classifier;
+        block[i].options = options;
+        block[i].first = (int)((long)lines->n * i / n_blocks);
+        block[i].last = (int)((long)lines->n * (i + 1) / n_blocks);
+    }
+    if (freesasa_run_parallel(parse_block, block, sizeof(struct parse_block),
+                              n_blocks) == FREESASA_FAIL)
         goto cleanup;
+    free(block);
+    block = NULL;
+
+    for (i = 0; i < lines->n; ++i) {
+        l = &lines->line[i];
+
+        if (l->atom == NULL)
+            goto cleanup;
+
+        if (l->guessed == FREESASA_WARN) {
+            freesasa_warn("guessing that atom '%s' is symbol '%s'",
+                          l->atom->atom_name, l->atom->symbol);
+        }
+
+        if ((l->alt != ' ' && the_alt == ' ') || (l->alt == ' '))
+            the_alt = l->alt;
+        else if (l->alt != ' ' && l->alt != the_alt) {
+            atom_free(l->atom);
+            l->atom = NULL;
+            continue;
+        }
+
+        if (l->coord_status == FREESASA_FAIL) {
+            /* parse again for the error message */
+            freesasa_pdb_get_coord(l->xyz, lines->buf + l->offset);
+            goto cleanup;
+        }
+
+        ret = structure_add_classified_atom(s, l->atom, l->xyz, l->radius,
+                                            classifier, options);
+        if (ret == FREESASA_FAIL) {
+            goto cleanup;
+        } else if (ret == FREESASA_WARN) {
+            atom_free(l->atom);
+            l->atom = NULL;
+            continue;
+        }
+        l->atom = NULL; /* owned by the structure */
+
+        if (options & FREESASA_RADIUS_FROM_OCCUPANCY) {
+            if (l->occupancy_status == FREESASA_FAIL)
+                goto cleanup;
+            s->atoms.radius[s->atoms.n-1] = l->occupancy;
+        }
     }
 
     return s;
 
  cleanup:
     fail_msg("");
-    atom_free(a);
+    free(block);
     freesasa_structure_free(s);
     return NULL;
 }
 
+/**
+    Handles the reading of PDB-files, returns NULL if problems reading
+    or input or malloc failure. Error-messages should explain what
+    went wrong. The structure can be empty.
+ */
+static freesasa_structure*
+from_pdb_range(FILE *pdb_file,
+               struct file_range it,
+               const freesasa_classifier *classifier,
+               int options,
+               int n_threads)
+{
+    struct atom_lines lines = {NULL, 0, 0, NULL, 0, 0, 1};
+    freesasa_structure *s = NULL;
+
+    assert(pdb_file);
+
+    if (atom_lines_read(&lines, pdb_file, it, options) == FREESASA_FAIL)
+        fail_msg("");
+    else
+        s = from_atom_lines(&lines, classifier, options, n_threads);
+
+    atom_lines_free(&lines);
+
+    return s;
+}
+
+/** As from_pdb_range(), but fails for empty structures */
+static freesasa_structure*
+from_pdb_impl(FILE *pdb_file,
+              struct file_range it,
+              const freesasa_classifier *classifier,
+              int options,
+              int n_threads)
+{
+    freesasa_structure *s = from_pdb_range(pdb_file, it, classifier, options, n_threads);
+
+    if (s == NULL) return NULL;
+
+    if (s->atoms.n == 0) {
+        fail_msg("input had no valid ATOM or HETATM lines");
+        freesasa_structure_free(s);
+        return NULL;
+    }
+
+    return s;
+}
+
 
 int
 freesasa_structure_add_atom_wopt(freesasa_structure *structure,
@@ -748,7 +1071,19 @@ freesasa_structure_from_pdb(FILE *pdb_file,
 {
     assert(pdb_file);
     return from_pdb_impl(pdb_file, freesasa_whole_file(pdb_file),
-                         classifier, options);
+                         classifier, options, 1);
+}
+
+freesasa_structure *
+freesasa_structure_from_pdb_parallel(FILE *pdb_file,
+                                     const freesasa_classifier* classifier,
+                                     int options,
+                                     int n_threads)
+{
+    assert(pdb_file);
+    assert(n_threads > 0);
+    return from_pdb_impl(pdb_file, freesasa_whole_file(pdb_file),
+                         classifier, options, n_threads);
 }
 
 freesasa_structure **
@@ -757,10 +1092,10 @@ freesasa_structure_array(FILE *pdb,
                          const freesasa_classifier *classifier,
                          int options)
 {
-    struct file_range *models = NULL, *chains = NULL;
+    struct file_range *models = NULL;
     struct file_range whole_file;
     int n_models = 0, n_chains = 0, j0, n_new_chains, i, j;
-    freesasa_structure **ss = NULL, **ssb;
+    freesasa_structure **ss = NULL, **ssb, *model = NULL;
 
     assert(pdb);
     assert(n);
@@ -787,15 +1122,20 @@ freesasa_structure_array(FILE *pdb,
     /* only keep first model if option not provided */
     if (! (options & FREESASA_SEPARATE_MODELS) ) n_models = 1;
 
-    /* for each model read chains if requested */
+    *n = 0;
+
+    /* for each model read chains if requested, the model is only
+       parsed once and the chains are views of it */
     if (options & FREESASA_SEPARATE_CHAINS) {
         for (i = 0; i < n_models; ++i) {
-            chains = NULL;
-            n_new_chains = freesasa_pdb_get_chains(pdb, models[i], &chains, options);
+            model = from_pdb_range(pdb, models[i], classifier, options, 1);
+            if (model == NULL) goto cleanup;
 
-            if (n_new_chains == FREESASA_FAIL) goto cleanup;
+            n_new_chains = model->chains.n;
             if (n_new_chains == 0) {
                 freesasa_warn("in %s(): no chains found (in model %d)", __func__, i+1);
+                freesasa_structure_free(model);
+                model = NULL;
                 continue;
             }
 
@@ -812,16 +1152,20 @@ freesasa_structure_array(FILE *pdb,
             n_chains += n_new_chains;
 
             for (j = 0; j < n_new_chains; ++j) ss[j0+j] = NULL;
+            *n = n_chains;
 
             for (j = 0; j < n_new_chains; ++j) {
-                ss[j0+j] = from_pdb_impl(pdb, chains[j], classifier, options);
+                ss[j0+j] = freesasa_structure_view_atoms(model, model->chains.first_atom[j],
+                                                         j == n_new_chains - 1 ?
+                                                         model->atoms.n - 1 :
+                                                         model->chains.first_atom[j+1] - 1);
                 if (ss[j0+j] == NULL) goto cleanup;
                 ss[j0+j]->model = i + 1;
             }
 
-            free(chains);
+            freesasa_structure_free(model);
+            model = NULL;
         }
-        *n = n_chains;
     } else {
         ss = malloc(sizeof(freesasa_structure*)*n_models);
         if (!ss) {
@@ -833,7 +1177,7 @@ freesasa_structure_array(FILE *pdb,
         *n = n_models;
 
         for (i = 0; i < n_models; ++i) {
-            ss[i] = from_pdb_impl(pdb, models[i], classifier, options);
+            ss[i] = from_pdb_impl(pdb, models[i], classifier, options, 1);
             if (ss[i] == NULL) goto cleanup;
             ss[i]->model = i + 1;
         }
@@ -848,12 +1192,534 @@ freesasa_structure_array(FILE *pdb,
  cleanup:
     if (ss) for (i = 0; i < *n; ++i) freesasa_structure_free(ss[i]);
     if (models != &whole_file) free(models);
-    free(chains);
+    freesasa_structure_free(model);
     *n = 0;
     free(ss);
     return NULL;
 }
 
+struct freesasa_structure_stream {
+    FILE *input;
+    const freesasa_classifier *classifier;
+    int options;
+    int n_threads;
+    int n_models; /* models read in the current entry */
+    int skip; /* skip the rest of the current entry */
+    int eof;
+    freesasa_structure *current; /* structure whose chains are returned */
+    int next_chain;
+};
+
+freesasa_structure_stream *
+freesasa_structure_stream_new(FILE *input,
+                              const freesasa_classifier *classifier,
+                              int options,
+                              int n_threads)
+{
+    freesasa_structure_stream *stream;
+
+    assert(input);
+    assert(n_threads > 0);
+
+    stream = malloc(sizeof(freesasa_structure_stream));
+    if (stream == NULL) {
+        mem_fail();
+        return NULL;
+    }
+
+    stream->input = input;
+    stream->classifier = classifier;
+    stream->options = options;
+    stream->n_threads = n_threads;
+    stream->n_models = 0;
+    stream->skip = 0;
+    stream->eof = 0;
+    stream->current = NULL;
+    stream->next_chain = 0;
+
+    return stream;
+}
+
+void
+freesasa_structure_stream_free(freesasa_structure_stream *stream)
+{
+    if (stream != NULL) {
+        freesasa_structure_free(stream->current);
+        free(stream);
+    }
+}
+
+/* END record, which ends an entry in a stream */
+static int
+is_end_record(const char *line)
+{
+    return strncmp("END", line, 3) == 0 &&
+        (line[3] == '\0' || line[3] == ' ' || line[3] == '\n' || line[3] == '\r');
+}
+
+/**
+    Reads the atom lines of the next structure in a stream: a model
+    if models are separated, else an entry (up to the next END
+    record), of which only the first model is used unless models are
+    joined. Only reads forward, one line at a time.
+ */
+static int
+stream_read_lines(freesasa_structure_stream *stream,
+                  struct atom_lines *lines)
+{
+    char line[PDB_MAX_LINE_STRL];
+    const int options = stream->options;
+
+    while (fgets(line, PDB_MAX_LINE_STRL, stream->input) != NULL) {
+
+        if (is_end_record(line)) {
+            stream->n_models = 0;
+            stream->skip = 0;
+            return FREESASA_SUCCESS;
+        }
+
+        if (stream->skip) continue;
+
+        if (strncmp("ATOM",line,4)==0 || ( (options & FREESASA_INCLUDE_HETATM) &&
+                                           (strncmp("HETATM", line, 6) == 0) )) {
+            if (freesasa_pdb_ishydrogen(line) &&
+                !(options & FREESASA_INCLUDE_HYDROGEN))
+                continue;
+
+            if (atom_lines_add(lines, line) == FREESASA_FAIL)
+                return FREESASA_FAIL;
+        }
+
+        if (! (options & FREESASA_JOIN_MODELS)) {
+            if (strncmp("MODEL",line,5)==0)  sscanf(line+10, "%d", &lines->model);
+            if (strncmp("ENDMDL",line,6)==0) {
+                ++stream->n_models;
+                if (! (options & FREESASA_SEPARATE_MODELS)) stream->skip = 1;
+                return FREESASA_SUCCESS;
+            }
+        }
+    }
+
+    if (ferror(stream->input)) return fail_msg("error reading input");
+    stream->eof = 1;
+
+    return FREESASA_SUCCESS;
+}
+
+int
+freesasa_structure_stream_next(freesasa_structure_stream *stream,
+                               freesasa_structure **structure)
+{
+    struct atom_lines lines;
+    freesasa_structure *s;
+    int model, c, last;
+
+    assert(stream);
+    assert(structure);
+
+    *structure = NULL;
+
+    for (;;) {
+        /* chains of the latest structure, as views */
+        s = stream->current;
+        if (s != NULL) {
+            c = stream->next_chain;
+            if (c < s->chains.n) {
+                last = c == s->chains.n - 1 ? s->atoms.n - 1 : s->chains.first_atom[c+1] - 1;
+                *structure = freesasa_structure_view_atoms(s, s->chains.first_atom[c], last);
+                if (*structure == NULL) return fail_msg("");
+                ++stream->next_chain;
+                return 1;
+            }
+            freesasa_structure_free(s);
+            stream->current = NULL;
+        }
+
+        if (stream->eof) return 0;
+
+        lines.buf = NULL;
+        lines.len = lines.size = 0;
+        lines.line = NULL;
+        lines.n = lines.n_alloc = 0;
+        lines.model = 1;
+        model = stream->n_models + 1;
+
+        s = NULL;
+        if (stream_read_lines(stream, &lines) == FREESASA_SUCCESS)
+            s = from_atom_lines(&lines, stream->classifier, stream->options,
+                                stream->n_threads);
+        atom_lines_free(&lines);
+        if (s == NULL) return fail_msg("problems reading PDB input");
+
+        if (stream->options & FREESASA_SEPARATE_MODELS) s->model = model;
+
+        /* entries and models without atoms are skipped */
+        if (s->atoms.n == 0) {
+            freesasa_structure_free(s);
+            continue;
+        }
+
+        if (stream->options & FREESASA_SEPARATE_CHAINS) {
+            stream->current = s;
+            stream->next_chain = 0;
+            continue;
+        }
+
+        *structure = s;
+        return 1;
+    }
+}
+
+/* a residue name, or a pair of residue and atom names, with their
+   classification, used by freesasa_structure_from_arrays() */
+struct name_entry {
+    const char *res_name;
+    const char *atom_name;
+    double radius;
+    freesasa_atom_class the_class;
+    char symbol[PDB_ATOM_SYMBOL_STRL+1];
+    int keep;
+    const freesasa_nodearea *reference;
+};
+
+/* hash table of names, with linear probing */
+struct name_table {
+    int *slot; /* entry of each slot, -1 if empty */
+    int n_slots; /* a power of 2, at least twice the number of entries */
+    int n;
+    int n_alloc;
+    struct name_entry *entry;
+};
+
+static int
+name_table_init(struct name_table *table)
+{
+    int i;
+
+    table->n_slots = 64;
+    table->n = table->n_alloc = 0;
+    table->entry = NULL;
+    table->slot = malloc(sizeof(int) * table->n_slots);
+    if (table->slot == NULL) return mem_fail();
+    for (i = 0; i < table->n_slots; ++i) table->slot[i] = -1;
+
+    return FREESASA_SUCCESS;
+}
+
+static void
+name_table_free(struct name_table *table)
+{
+    free(table->slot);
+    free(table->entry);
+}
+
+static unsigned int
+hash_names(const char *res_name,
+           const char *atom_name)
+{
+    unsigned int h = 5381;
+
+    while (*res_name) h = 33*h + (unsigned char) *res_name++;
+    h = 33*h;
+    while (*atom_name) h = 33*h + (unsigned char) *atom_name++;
+
+    return h;
+}
+
+/**
+    Returns the index of the entry with the given names, or -1 if
+    there is none, in which case slot is set to where it should go.
+ */
+static int
+name_table_find(const struct name_table *table,
+                const char *res_name,
+                const char *atom_name,
+                int *slot)
+{
+    const unsigned int mask = table->n_slots - 1;
+    unsigned int s = hash_names(res_name, atom_name) & mask;
+    int e;
+
+    while ((e = table->slot[s]) >= 0) {
+        if (strcmp(table->entry[e].res_name, res_name) == 0 &&
+            strcmp(table->entry[e].atom_name, atom_name) == 0)
+            return e;
+        s = (s + 1) & mask;
+    }
+    *slot = s;
+
+    return -1;
+}
+
+/** Adds an entry with the given names, returns its index */
+static int
+name_table_add(struct name_table *table,
+               const char *res_name,
+               const char *atom_name)
+{
+    struct name_entry *eb;
+    int *sb, i, s, e;
+
+    if (table->n == table->n_alloc) {
+        table->n_alloc = table->n_alloc > 0 ? 2 * table->n_alloc : 32;
+        eb = realloc(table->entry, sizeof(struct name_entry) * table->n_alloc);
+        if (eb == NULL) return mem_fail();
+        table->entry = eb;
+    }
+    if (2 * (table->n + 1) > table->n_slots) {
+        sb = malloc(sizeof(int) * 2 * table->n_slots);
+        if (sb == NULL) return mem_fail();
+        free(table->slot);
+        table->slot = sb;
+        table->n_slots *= 2;
+        for (i = 0; i < table->n_slots; ++i) table->slot[i] = -1;
+        for (e = 0; e < table->n; ++e) {
+            name_table_find(table, table->entry[e].res_name, table->entry[e].atom_name, &s);
+            table->slot[s] = e;
+        }
+    }
+
+    e = table->n++;
+    name_table_find(table, res_name, atom_name, &s);
+    table->slot[s] = e;
+    table->entry[e].res_name = res_name;
+    table->entry[e].atom_name = atom_name;
+
+    return e;
+}
+
+/**
+    Classifies a pair of residue and atom name the first time it is
+    encountered, and returns the index of its entry.
+ */
+static int
+atom_type(struct name_table *types,
+          const char *res_name,
+          const char *atom_name,
+          const freesasa_classifier *classifier,
+          int options,
+          int need_radius)
+{
+    struct name_entry *e;
+    struct atom a = empty_atom;
+    char name[PDB_ATOM_NAME_STRL+1];
+    int i, slot, ret;
+
+    i = name_table_find(types, res_name, atom_name, &slot);
+    if (i >= 0) return i;
+
+    i = name_table_add(types, res_name, atom_name);
+    if (i < 0) return fail_msg("");
+    e = &types->entry[i];
+
+    /* names shorter than in PDB files are assumed to start with a
+       one-letter element */
+    if (strlen(atom_name) >= PDB_ATOM_NAME_STRL) strncpy(name, atom_name, PDB_ATOM_NAME_STRL);
+    else sprintf(name, " %-3s", atom_name);
+    name[PDB_ATOM_NAME_STRL] = '\0';
+    guess_symbol(e->symbol, name);
+
+    e->the_class = freesasa_classifier_class(classifier, res_name, atom_name);
+    e->radius = 0;
+    e->keep = 1;
+    if (need_radius) {
+        a.res_name = (char *) res_name;
+        a.atom_name = (char *) atom_name;
+        a.symbol = e->symbol;
+        e->radius = freesasa_classifier_radius(classifier, res_name, atom_name);
+        ret = structure_check_atom_radius(&e->radius, &a, options);
+        if (ret == FREESASA_FAIL) return fail_msg("halting at unknown atom");
+        if (ret == FREESASA_WARN) e->keep = 0;
+    }
+
+    return i;
+}
+
+/** The reference area of a residue type, looked up once per type */
+static int
+residue_type(struct name_table *residue_types,
+             const char *res_name,
+             const freesasa_classifier *classifier)
+{
+    int i, slot;
+
+    i = name_table_find(residue_types, res_name, "", &slot);
+    if (i >= 0) return i;
+
+    i = name_table_add(residue_types, res_name, "");
+    if (i < 0) return fail_msg("");
+    residue_types->entry[i].reference = freesasa_classifier_residue_reference(classifier, res_name);
+
+    return i;
+}
+
+static char *
+pool_string(char **pool,
+            const char *str)
+{
+    char *s = *pool;
+    size_t n = strlen(str) + 1;
+
+    memcpy(s, str, n);
+    *pool += n;
+
+    return s;
+}
+
+freesasa_structure *
+freesasa_structure_from_arrays(int n,
+                               const char **atom_names,
+                               const char **residue_names,
+                               const char **residue_numbers,
+                               const char *chain_labels,
+                               const double *xyz,
+                               const double *radii,
+                               const freesasa_atom_class *classes,
+                               const freesasa_classifier *classifier,
+                               int options)
+{
+    freesasa_structure *s = NULL;
+    struct name_table types, residue_types;
+    const struct name_entry *e;
+    const freesasa_nodearea *reference;
+    struct atom *a;
+    double *v = NULL;
+    char *str;
+    size_t n_chars = 0;
+    int *type = NULL, i, k, r, n_keep = 0, n_res = 0, prev = -1, ok = 0, t;
+
+    assert(atom_names); assert(residue_names); assert(residue_numbers);
+    assert(chain_labels); assert(xyz);
+
+    types.slot = residue_types.slot = NULL;
+    types.entry = residue_types.entry = NULL;
+
+    if (n <= 0) {
+        fail_msg("no atoms");
+        return NULL;
+    }
+    if (classifier == NULL) classifier = &freesasa_default_classifier;
+    if (options & FREESASA_SKIP_UNKNOWN && options & FREESASA_HALT_AT_UNKNOWN)
+        options &= ~FREESASA_SKIP_UNKNOWN;
+
+    s = freesasa_structure_new();
+    if (s == NULL) return NULL;
+
+    if (name_table_init(&types) || name_table_init(&residue_types)) goto cleanup;
+    if (structure_register_classifier(s, classifier) == FREESASA_FAIL) goto cleanup;
+    type = malloc(sizeof(int) * n);
+    if (type == NULL) {
+        mem_fail();
+        goto cleanup;
+    }
+
+    /* classify each combination of residue and atom name once, and
+       count the atoms, residues and characters to store */
+    for (i = 0; i < n; ++i) {
+        if (radii != NULL && radii[i] < 0) {
+            fail_msg("atom %d has negative radius", i);
+            goto cleanup;
+        }
+        type[i] = atom_type(&types, residue_names[i], atom_names[i],
+                            classifier, options, radii == NULL);
+        if (type[i] == FREESASA_FAIL) goto cleanup;
+        if (!types.entry[type[i]].keep) continue;
+
+        ++n_keep;
+        n_chars += strlen(atom_names[i]) + PDB_ATOM_SYMBOL_STRL + 2;
+        if (prev < 0 || strcmp(residue_numbers[i], residue_numbers[prev]) ||
+            chain_labels[i] != chain_labels[prev]) {
+            ++n_res;
+            n_chars += strlen(residue_names[i]) + strlen(residue_numbers[i]) + 2;
+        }
+        prev = i;
+    }
+    if (n_keep == 0) {
+        fail_msg("all atoms were skipped");
+        goto cleanup;
+    }
+
+    s->atoms.atom = malloc(sizeof(struct atom*) * n_keep);
+    s->atoms.radius = malloc(sizeof(double) * n_keep);
+    s->atoms.pool = malloc(sizeof(struct atom) * n_keep);
+    s->atoms.strings = malloc(n_chars);
+    s->residues.first_atom = malloc(sizeof(int) * n_res);
+    s->residues.reference_area = malloc(sizeof(freesasa_nodearea*) * n_res);
+    v = malloc(sizeof(double) * 3 * n_keep);
+    if (!s->atoms.atom || !s->atoms.radius || !s->atoms.pool || !s->atoms.strings ||
+        !s->residues.first_atom || !s->residues.reference_area || !v) {
+        mem_fail();
+        goto cleanup;
+    }
+    s->atoms.n_alloc = s->atoms.n_pool = n_keep;
+    s->residues.n_alloc = n_res;
+
+    str = s->atoms.strings;
+    prev = -1;
+    for (i = 0, k = 0, r = -1; i < n; ++i) {
+        e = &types.entry[type[i]];
+        if (!e->keep) continue;
+
+        a = &s->atoms.pool[k];
+        *a = empty_atom;
+        if (prev < 0 || strcmp(residue_numbers[i], residue_numbers[prev]) ||
+            chain_labels[i] != chain_labels[prev]) {
+            ++r;
+            a->res_name = pool_string(&str, residue_names[i]);
+            a->res_number = pool_string(&str, residue_numbers[i]);
+            s->residues.first_atom[r] = k;
+            s->residues.reference_area[r] = NULL;
+            s->residues.n = r + 1;
+            t = residue_type(&residue_types, residue_names[i], classifier);
+            if (t == FREESASA_FAIL) goto cleanup;
+            reference = residue_types.entry[t].reference;
+            if (reference != NULL) {
+                s->residues.reference_area[r] = malloc(sizeof(freesasa_nodearea));
+                if (s->residues.reference_area[r] == NULL) {
+                    mem_fail();
+                    goto cleanup;
+                }
+                *s->residues.reference_area[r] = *reference;
+            }
+        } else {
+            /* the atoms of a residue share its strings */
+            a->res_name = s->atoms.pool[k-1].res_name;
+            a->res_number = s->atoms.pool[k-1].res_number;
+        }
+        if (prev < 0 || chain_labels[i] != chain_labels[prev]) {
+            if (structure_add_chain(s, chain_labels[i], k)) goto cleanup;
+        }
+        a->atom_name = pool_string(&str, atom_names[i]);
+        a->symbol = pool_string(&str, e->symbol);
+        a->chain_label = chain_labels[i];
+        a->the_class = classes != NULL ? classes[i] : e->the_class;
+
+        s->atoms.atom[k] = a;
+        s->atoms.radius[k] = radii != NULL ? radii[i] : e->radius;
+        memcpy(v + 3*k, xyz + 3*i, sizeof(double) * 3);
+        ++k;
+        prev = i;
+    }
+    assert(k == n_keep && r == n_res - 1);
+
+    if (freesasa_coord_set_all(s->xyz, v, n_keep)) goto cleanup;
+    s->atoms.n = n_keep;
+    ok = 1;
+
+ cleanup:
+    if (!ok) {
+        fail_msg("");
+        freesasa_structure_free(s);
+        s = NULL;
+    }
+    name_table_free(&types);
+    name_table_free(&residue_types);
+    free(type);
+    free(v);
+
+    return s;
+}
+
 freesasa_structure*
 freesasa_structure_get_chains(const freesasa_structure *structure,
                               const char* chains,
@@ -911,6 +1777,206 @@ freesasa_structure_get_chains(const freesasa_structure *structure,
     return NULL;
 }
 
+/** The residue that atom i belongs to */
+static int
+residue_of_atom(const freesasa_structure *structure,
+                int i)
+{
+    int lo = 0, hi = structure->residues.n - 1, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        if (structure->residues.first_atom[mid] <= i) lo = mid;
+        else hi = mid - 1;
+    }
+
+    return lo;
+}
+
+/** The last atom of chain c_i */
+static int
+chain_last_atom(const freesasa_structure *structure,
+                int c_i)
+{
+    if (c_i == structure->chains.n - 1) return structure->atoms.n - 1;
+    return structure->chains.first_atom[c_i+1] - 1;
+}
+
+/**
+    Creates a view of the atoms first[k] to last[k] of the structure,
+    for k = 0, ..., n_ranges - 1. The ranges should be in increasing
+    order and not overlap. Only the residue and chain tables are
+    built, and if there is only one range the atoms, radii and
+    coordinates are shared with the parent.
+ */
+static freesasa_structure *
+structure_view(const freesasa_structure *structure,
+               const int *first,
+               const int *last,
+               int n_ranges)
+{
+    /* only the reference count of the parent is changed */
+    freesasa_structure *parent = (freesasa_structure *) structure, *view;
+    int n = 0, n_res = 0, offset, a, c, i, k, r, r_last;
+
+    for (k = 0; k < n_ranges; ++k) {
+        assert(first[k] >= 0 && first[k] <= last[k] && last[k] < parent->atoms.n);
+        assert(k == 0 || first[k] > last[k-1]);
+        n += last[k] - first[k] + 1;
+        n_res += residue_of_atom(parent, last[k]) - residue_of_atom(parent, first[k]) + 1;
+    }
+
+    view = malloc(sizeof(freesasa_structure));
+    if (view == NULL) {
+        mem_fail();
+        return NULL;
+    }
+    view->atoms = atoms_init();
+    view->residues = residues_init();
+    view->chains = chains_init();
+    view->classifier_name = NULL;
+    view->xyz = NULL;
+    view->model = parent->model;
+    view->parent = parent;
+    view->owns_atoms = n_ranges > 1;
+    view->n_refs = 1;
+    structure_refs_add(parent, 1);
+
+    if (n_ranges == 1) {
+        view->atoms.atom = parent->atoms.atom + first[0];
+        view->atoms.radius = parent->atoms.radius + first[0];
+        view->xyz = freesasa_coord_new_linked(freesasa_coord_i(parent->xyz, first[0]), n);
+        if (view->xyz == NULL) goto cleanup;
+    } else {
+        view->atoms.atom = malloc(sizeof(struct atom*) * n);
+        view->atoms.radius = malloc(sizeof(double) * n);
+        view->xyz = freesasa_coord_new();
+        if (!view->atoms.atom || !view->atoms.radius || !view->xyz) {
+            mem_fail();
+            goto cleanup;
+        }
+        for (k = 0, offset = 0; k < n_ranges; ++k) {
+            a = last[k] - first[k] + 1;
+            memcpy(view->atoms.atom + offset, parent->atoms.atom + first[k],
+                   sizeof(struct atom*) * a);
+            memcpy(view->atoms.radius + offset, parent->atoms.radius + first[k],
+                   sizeof(double) * a);
+            if (freesasa_coord_append(view->xyz, freesasa_coord_i(parent->xyz, first[k]), a))
+                goto cleanup;
+            offset += a;
+        }
+    }
+    view->atoms.n = view->atoms.n_alloc = n;
+
+    view->residues.first_atom = malloc(sizeof(int) * n_res);
+    view->residues.reference_area = malloc(sizeof(freesasa_nodearea*) * n_res);
+    if (!view->residues.first_atom || !view->residues.reference_area) {
+        mem_fail();
+        goto cleanup;
+    }
+    view->residues.n = view->residues.n_alloc = n_res;
+
+    for (k = 0, offset = 0, i = 0; k < n_ranges; ++k) {
+        r_last = residue_of_atom(parent, last[k]);
+        for (r = residue_of_atom(parent, first[k]); r <= r_last; ++r, ++i) {
+            a = parent->residues.first_atom[r];
+            view->residues.first_atom[i] = offset + (a > first[k] ? a - first[k] : 0);
+            view->residues.reference_area[i] = parent->residues.reference_area[r];
+        }
+        for (c = 0; c < parent->chains.n; ++c) {
+            a = parent->chains.first_atom[c];
+            if (chain_last_atom(parent, c) < first[k] || a > last[k]) continue;
+            if (structure_add_chain(view, parent->chains.labels[c],
+                                    offset + (a > first[k] ? a - first[k] : 0)))
+                goto cleanup;
+        }
+        offset += last[k] - first[k] + 1;
+    }
+
+    if (parent->classifier_name != NULL) {
+        view->classifier_name = strdup(parent->classifier_name);
+        if (view->classifier_name == NULL) {
+            mem_fail();
+            goto cleanup;
+        }
+    }
+
+    return view;
+
+ cleanup:
+    fail_msg("");
+    freesasa_structure_free(view);
+    return NULL;
+}
+
+freesasa_structure *
+freesasa_structure_view_atoms(const freesasa_structure *structure,
+                              int first,
+                              int last)
+{
+    assert(structure);
+
+    if (first < 0 || last >= structure->atoms.n || first > last) {
+        fail_msg("atoms %d to %d requested, structure has %d atoms",
+                 first, last, structure->atoms.n);
+        return NULL;
+    }
+
+    return structure_view(structure, &first, &last, 1);
+}
+
+freesasa_structure *
+freesasa_structure_view_chains(const freesasa_structure *structure,
+                               const char *chains)
+{
+    freesasa_structure *view = NULL;
+    int *first, *last, n_ranges = 0, c, i;
+
+    assert(structure);
+    assert(chains);
+
+    if (strlen(chains) == 0) {
+        fail_msg("no chains requested");
+        return NULL;
+    }
+    for (i = 0; chains[i] != '\0'; ++i) {
+        if (structure->chains.n == 0 || strchr(structure->chains.labels, chains[i]) == NULL) {
+            fail_msg("structure has chains '%s', but '%s' requested",
+                     structure->chains.n > 0 ? structure->chains.labels : "", chains);
+            return NULL;
+        }
+    }
+
+    first = malloc(sizeof(int) * structure->chains.n);
+    last = malloc(sizeof(int) * structure->chains.n);
+    if (first == NULL || last == NULL) {
+        mem_fail();
+        goto cleanup;
+    }
+
+    /* the chains in the order of the structure, with neighboring
+       chains joined so that they can share memory */
+    for (c = 0; c < structure->chains.n; ++c) {
+        if (strchr(chains, structure->chains.labels[c]) == NULL) continue;
+        if (n_ranges > 0 && last[n_ranges-1] == structure->chains.first_atom[c] - 1) {
+            last[n_ranges-1] = chain_last_atom(structure, c);
+        } else {
+            first[n_ranges] = structure->chains.first_atom[c];
+            last[n_ranges] = chain_last_atom(structure, c);
+            ++n_ranges;
+        }
+    }
+
+    view = structure_view(structure, first, last, n_ranges);
+    if (view == NULL) fail_msg("");
+
+ cleanup:
+    free(first);
+    free(last);
+
+    return view;
+}
+
 const char *
 freesasa_structure_chain_labels(const freesasa_structure *structure)
 {
@@ -1134,8 +2200,8 @@ freesasa_structure_chain_residues(const freesasa_structure *structure,
    if (freesasa_structure_chain_atoms(structure, chain, &first_atom, &last_atom))
        return fail_msg("");
 
-   *first = structure->atoms.atom[first_atom]->res_index;
-   *last = structure->atoms.atom[last_atom]->res_index;
+   *first = residue_of_atom(structure, first_atom);
+   *last = residue_of_atom(structure, last_atom);
 
    return FREESASA_SUCCESS;
 }
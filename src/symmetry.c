@@ -0,0 +1,326 @@
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "freesasa_internal.h"
+#include "pdb.h"
+
+/* tolerance when checking that operators are rotations, and when
+   identifying the identity operator (BIOMT records have 6 decimals) */
+#define SYMMETRY_TOL 1e-4
+
+/** x' = R x + t, op is the 3x4 matrix (R|t) by rows */
+static inline void
+apply_operator(double *out,
+               const double *op,
+               const double *v)
+{
+    int k;
+    for (k = 0; k < 3; ++k) {
+        out[k] = op[4*k]*v[0] + op[4*k+1]*v[1] + op[4*k+2]*v[2] + op[4*k+3];
+    }
+}
+
+static int
+is_identity(const double *op)
+{
+    int k, l;
+    for (k = 0; k < 3; ++k) {
+        for (l = 0; l < 4; ++l) {
+            if (fabs(op[4*k+l] - (k == l ? 1 : 0)) > SYMMETRY_TOL) return 0;
+        }
+    }
+    return 1;
+}
+
+/** Checks that the rotation part of each operator is orthonormal */
+static int
+check_operators(const double *operators,
+                int n_ops)
+{
+    const double *op;
+    double d;
+    int i, k, l;
+
+    for (i = 0; i < n_ops; ++i) {
+        op = operators + 12*i;
+        for (k = 0; k < 3; ++k) {
+            for (l = 0; l < 3; ++l) {
+                d = op[4*k]*op[4*l] + op[4*k+1]*op[4*l+1] + op[4*k+2]*op[4*l+2];
+                if (fabs(d - (k == l ? 1 : 0)) > SYMMETRY_TOL) {
+                    return fail_msg("symmetry operator %d is not a rotation", i + 1);
+                }
+            }
+        }
+    }
+
+    return FREESASA_SUCCESS;
+}
+
+int
+freesasa_symmetry_from_pdb(FILE *pdb,
+                           double **operators)
+{
+    int n;
+
+    assert(pdb);
+    assert(operators);
+
+    n = freesasa_pdb_get_biomt(pdb, operators);
+    if (n == FREESASA_FAIL) return fail_msg("");
+
+    if (n > 0 && check_operators(*operators, n)) {
+        free(*operators);
+        *operators = NULL;
+        return fail_msg("");
+    }
+
+    return n;
+}
+
+int
+freesasa_symmetry_from_file(FILE *file,
+                            double **operators)
+{
+    char line[256], *p, *end;
+    double *ops = NULL, *opsb, val;
+    int n_val = 0, capacity = 0, line_no = 0;
+
+    assert(file);
+    assert(operators);
+
+    *operators = NULL;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        ++line_no;
+        p = line;
+        while (*p == ' ' || *p == '\t') ++p;
+        if (*p == '#') continue;
+
+        for (;;) {
+            errno = 0;
+            val = strtod(p, &end);
+            if (end == p) break;
+            if (errno) {
+                free(ops);
+                return fail_msg("invalid number on line %d of symmetry file", line_no);
+            }
+            if (n_val == capacity) {
+                capacity = capacity > 0 ? 2*capacity : 120;
+                opsb = ops;
+                ops = realloc(ops, sizeof(double) * capacity);
+                if (ops == NULL) {
+                    free(opsb);
+                    return mem_fail();
+                }
+            }
+            ops[n_val++] = val;
+            p = end;
+        }
+        while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') ++p;
+        if (*p != '\0') {
+            free(ops);
+            return fail_msg("unexpected character '%c' on line %d of symmetry file",
+                            *p, line_no);
+        }
+    }
+
+    if (n_val == 0 || n_val % 12 != 0) {
+        free(ops);
+        return fail_msg("symmetry file should contain 12 numbers per operator, found %d",
+                        n_val);
+    }
+
+    if (check_operators(ops, n_val / 12)) {
+        free(ops);
+        return fail_msg("");
+    }
+
+    *operators = ops;
+    return n_val / 12;
+}
+
+/** Appends an atom to the arrays, growing them if necessary */
+static int
+add_atom(double **xyz,
+         double **radii,
+         int *n,
+         int *capacity,
+         const double *v,
+         double r)
+{
+    double *xb, *rb;
+
+    if (*n == *capacity) {
+        *capacity *= 2;
+        xb = realloc(*xyz, sizeof(double) * 3 * (*capacity));
+        if (xb == NULL) return mem_fail();
+        *xyz = xb;
+        rb = realloc(*radii, sizeof(double) * (*capacity));
+        if (rb == NULL) return mem_fail();
+        *radii = rb;
+    }
+
+    (*xyz)[3*(*n)] = v[0];
+    (*xyz)[3*(*n)+1] = v[1];
+    (*xyz)[3*(*n)+2] = v[2];
+    (*radii)[*n] = r;
+    ++*n;
+
+    return FREESASA_SUCCESS;
+}
+
+/**
+    The atoms of the asymmetric unit are followed by the atoms of the
+    symmetry images that are close enough to touch them, only the
+    first are calculated.
+ */
+static freesasa_result *
+calc_symmetric(const coord_t *asu,
+               const double *radii,
+               const double *operators,
+               int n_ops,
+               const freesasa_parameters *parameters)
+{
+    const int n = freesasa_coord_n(asu);
+    const double *v = freesasa_coord_all(asu);
+    double *xyz = NULL, *r = NULL;
+    double center[3] = {0, 0, 0}, lo[3], hi[3], w[3], d[3];
+    double r_max = 0, extent = 0, cutoff, dist2;
+    coord_t *coord = NULL;
+    freesasa_result *result = NULL;
+    int i, k, op, n_all = 0, capacity = 2*n, n_identity = 0, outside;
+
+    assert(operators);
+
+    if (parameters == NULL) parameters = &freesasa_default_parameters;
+
+    if (n == 0) {
+        fail_msg("empty coordinates");
+        return NULL;
+    }
+    if (n_ops < 1) {
+        fail_msg("at least one symmetry operator needed");
+        return NULL;
+    }
+    if (parameters->calc_gradient) {
+        fail_msg("gradients can not be calculated for symmetric assemblies");
+        return NULL;
+    }
+    if (check_operators(operators, n_ops)) {
+        fail_msg("");
+        return NULL;
+    }
+
+    xyz = malloc(sizeof(double) * 3 * capacity);
+    r = malloc(sizeof(double) * capacity);
+    if (xyz == NULL || r == NULL) {
+        mem_fail();
+        goto cleanup;
+    }
+
+    for (k = 0; k < 3; ++k) lo[k] = hi[k] = v[k];
+    for (i = 0; i < n; ++i) {
+        for (k = 0; k < 3; ++k) {
+            center[k] += v[3*i+k] / n;
+            lo[k] = fmin(lo[k], v[3*i+k]);
+            hi[k] = fmax(hi[k], v[3*i+k]);
+        }
+        r_max = fmax(r_max, radii[i]);
+        if (add_atom(&xyz, &r, &n_all, &capacity, v + 3*i, radii[i])) goto cleanup;
+    }
+    for (i = 0; i < n; ++i) {
+        for (k = 0; k < 3; ++k) d[k] = v[3*i+k] - center[k];
+        extent = fmax(extent, sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]));
+    }
+
+    /* image atoms further away from the box around the asymmetric unit
+       than this can't touch it */
+    cutoff = 2 * (r_max + parameters->probe_radius);
+    for (k = 0; k < 3; ++k) {
+        lo[k] -= cutoff;
+        hi[k] += cutoff;
+    }
+
+    for (op = 0; op < n_ops; ++op) {
+        if (is_identity(operators + 12*op)) {
+            ++n_identity;
+            continue;
+        }
+
+        /* skip images that are too far away to touch at all */
+        apply_operator(w, operators + 12*op, center);
+        for (k = 0; k < 3; ++k) d[k] = w[k] - center[k];
+        dist2 = d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+        if (dist2 > (2*extent + cutoff) * (2*extent + cutoff)) continue;
+
+        for (i = 0; i < n; ++i) {
+            apply_operator(w, operators + 12*op, v + 3*i);
+            outside = 0;
+            for (k = 0; k < 3; ++k) {
+                if (w[k] < lo[k] || w[k] > hi[k]) outside = 1;
+            }
+            if (outside) continue;
+            if (add_atom(&xyz, &r, &n_all, &capacity, w, radii[i])) goto cleanup;
+        }
+    }
+
+    if (n_identity == 0) {
+        freesasa_warn("the symmetry operators don't include the identity, "
+                      "the asymmetric unit is added to the assembly");
+    }
+
+    coord = freesasa_coord_new_linked(xyz, n_all);
+    if (coord == NULL) goto cleanup;
+
+    result = freesasa_calc_subset(coord, r, n, parameters, NULL);
+
+ cleanup:
+    if (result == NULL) fail_msg("");
+    freesasa_coord_free(coord);
+    free(xyz);
+    free(r);
+
+    return result;
+}
+
+freesasa_result *
+freesasa_calc_structure_symmetric(const freesasa_structure *structure,
+                                  const double *operators,
+                                  int n_ops,
+                                  const freesasa_parameters *parameters)
+{
+    assert(structure);
+
+    return calc_symmetric(freesasa_structure_xyz(structure),
+                          freesasa_structure_radius(structure),
+                          operators, n_ops, parameters);
+}
+
+freesasa_result *
+freesasa_calc_coord_symmetric(const double *xyz,
+                              const double *radii,
+                              int n,
+                              const double *operators,
+                              int n_ops,
+                              const freesasa_parameters *parameters)
+{
+    coord_t *coord = NULL;
+    freesasa_result *result = NULL;
+
+    assert(xyz);
+    assert(radii);
+    assert(n > 0);
+
+    coord = freesasa_coord_new_linked(xyz, n);
+    if (coord != NULL) result = calc_symmetric(coord, radii, operators, n_ops, parameters);
+    if (result == NULL) fail_msg("");
+
+    freesasa_coord_free(coord);
+
+    return result;
+}
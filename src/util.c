@@ -4,8 +4,12 @@
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <errno.h>
+#if USE_THREADS
+# include <pthread.h>
+#endif
 
 #include "freesasa_internal.h"
 
@@ -17,6 +21,134 @@ const char *freesasa_name = "freesasa";
 
 static FILE *errlog = NULL;
 
+#if USE_THREADS
+static pthread_key_t thread_state_key;
+static pthread_once_t thread_state_once = PTHREAD_ONCE_INIT;
+static int thread_state_key_ok = 0;
+
+static void
+thread_state_init(void)
+{
+    thread_state_key_ok = (pthread_key_create(&thread_state_key, free) == 0);
+}
+#else
+static struct freesasa_thread_state the_thread_state;
+static int has_thread_state = 0;
+#endif
+
+struct freesasa_thread_state *
+freesasa_thread_state(int create)
+{
+#if USE_THREADS
+    struct freesasa_thread_state *state;
+
+    pthread_once(&thread_state_once, thread_state_init);
+    if (!thread_state_key_ok) return NULL;
+
+    state = pthread_getspecific(thread_state_key);
+    if (state == NULL && create) {
+        state = malloc(sizeof(struct freesasa_thread_state));
+        if (state == NULL) return NULL;
+        state->has_verbosity = 0;
+        state->verbosity = FREESASA_V_NORMAL;
+        state->err_out = NULL;
+        if (pthread_setspecific(thread_state_key, state)) {
+            free(state);
+            return NULL;
+        }
+    }
+    return state;
+#else
+    if (!has_thread_state && create) {
+        the_thread_state.has_verbosity = 0;
+        the_thread_state.verbosity = FREESASA_V_NORMAL;
+        the_thread_state.err_out = NULL;
+        has_thread_state = 1;
+    }
+    return has_thread_state ? &the_thread_state : NULL;
+#endif
+}
+
+void
+freesasa_thread_state_get(struct freesasa_thread_state *state)
+{
+    struct freesasa_thread_state *ts = freesasa_thread_state(0);
+
+    assert(state);
+
+    if (ts) {
+        *state = *ts;
+    } else {
+        state->has_verbosity = 0;
+        state->verbosity = FREESASA_V_NORMAL;
+        state->err_out = NULL;
+    }
+}
+
+int
+freesasa_thread_state_set(const struct freesasa_thread_state *state)
+{
+    struct freesasa_thread_state *ts;
+
+    assert(state);
+
+    if (!state->has_verbosity && state->err_out == NULL) {
+        freesasa_clear_thread_state();
+        return FREESASA_SUCCESS;
+    }
+
+    ts = freesasa_thread_state(1);
+    if (ts == NULL) return mem_fail();
+    *ts = *state;
+
+    return FREESASA_SUCCESS;
+}
+
+void
+freesasa_clear_thread_state(void)
+{
+#if USE_THREADS
+    struct freesasa_thread_state *state = freesasa_thread_state(0);
+
+    if (state) {
+        pthread_setspecific(thread_state_key, NULL);
+        free(state);
+    }
+#else
+    has_thread_state = 0;
+#endif
+}
+
+FILE *
+freesasa_err_stream(void)
+{
+    FILE *fp = freesasa_get_err_out();
+
+    return fp ? fp : stderr;
+}
+
+/* Messages are written with several calls, lock the stream so that
+   messages from concurrent threads don't interleave. */
+static void
+lock_stream(FILE *fp)
+{
+#if USE_THREADS
+    flockfile(fp);
+#else
+    (void) fp;
+#endif
+}
+
+static void
+unlock_stream(FILE *fp)
+{
+#if USE_THREADS
+    funlockfile(fp);
+#else
+    (void) fp;
+#endif
+}
+
 struct file_range
 freesasa_whole_file(FILE* file)
 {
@@ -38,10 +170,9 @@ freesasa_err_impl(int err,
                   const char *format,
                   va_list arg)
 {
-    FILE *fp = stderr;
-
-    if (errlog != NULL) fp = errlog;
+    FILE *fp = freesasa_err_stream();
 
+    lock_stream(fp);
     fprintf(fp, "%s: ", freesasa_name);
     switch (err) {
     case FREESASA_FAIL: fputs("error: ", fp); break;
@@ -52,6 +183,7 @@ freesasa_err_impl(int err,
     va_end(arg);
     fputc('\n', fp);
     fflush(fp);
+    unlock_stream(fp);
 }
 
 int
@@ -88,18 +220,20 @@ freesasa_fail_wloc(const char* file,
                    const char *format,
                    ...)
 {
-    FILE *fp = stderr;
+    FILE *fp;
     va_list arg;
 
     if (freesasa_get_verbosity() == FREESASA_V_SILENT) return FREESASA_FAIL;
-    if (errlog != NULL) fp = errlog;
+    fp = freesasa_err_stream();
 
+    lock_stream(fp);
     fprintf(fp, "%s:%s:%d: error: ", freesasa_name, file, line);
     va_start(arg, format);
     vfprintf(fp, format, arg);
     va_end(arg);
     fputc('\n', fp);
     fflush(fp);
+    unlock_stream(fp);
 
     return FREESASA_FAIL;
 }
@@ -122,6 +256,178 @@ freesasa_thread_error(int error_code)
     return "Unknown thread error";
 }
 
+#if USE_THREADS
+struct thread_start {
+    void *(*fn)(void *);
+    void *arg;
+    struct freesasa_thread_state diagnostics; /* of the calling thread */
+};
+
+static void *
+thread_start(void *arg)
+{
+    struct thread_start start = *(struct thread_start *) arg;
+    void *ret;
+
+    free(arg);
+    /* report errors the way the caller would */
+    freesasa_thread_state_set(&start.diagnostics);
+    ret = start.fn(start.arg);
+    freesasa_clear_thread_state();
+
+    return ret;
+}
+
+int
+freesasa_thread_create(pthread_t *thread,
+                       void *(*fn)(void *),
+                       void *arg)
+{
+    struct thread_start *start = malloc(sizeof(struct thread_start));
+    int res;
+
+    if (start == NULL) return EAGAIN;
+
+    start->fn = fn;
+    start->arg = arg;
+    freesasa_thread_state_get(&start->diagnostics);
+
+    res = pthread_create(thread, NULL, thread_start, start);
+    if (res) free(start);
+
+    return res;
+}
+
+struct parallel_call {
+    void (*fn)(void *);
+    void *arg;
+};
+
+static void *
+parallel_thread(void *arg)
+{
+    struct parallel_call *call = (struct parallel_call *) arg;
+
+    call->fn(call->arg);
+    return NULL;
+}
+#endif /* USE_THREADS */
+
+int
+freesasa_run_parallel(void (*fn)(void *),
+                      void *args,
+                      size_t size,
+                      int n)
+{
+    int i, return_value = FREESASA_SUCCESS;
+#if USE_THREADS
+    struct parallel_call *call = NULL;
+    pthread_t *thread = NULL;
+    int *created = NULL, res;
+
+    if (n > 1) {
+        call = malloc(sizeof(struct parallel_call) * n);
+        thread = malloc(sizeof(pthread_t) * n);
+        created = malloc(sizeof(int) * n);
+    }
+    if (call != NULL && thread != NULL && created != NULL) {
+        for (i = 1; i < n; ++i) {
+            call[i].fn = fn;
+            call[i].arg = (char *) args + i*size;
+            created[i] = freesasa_thread_create(&thread[i], parallel_thread, &call[i]) == 0;
+        }
+        fn(args);
+        /* the calls whose threads couldn't be started are made here */
+        for (i = 1; i < n; ++i) {
+            if (!created[i]) fn((char *) args + i*size);
+        }
+        for (i = 1; i < n; ++i) {
+            if (!created[i]) continue;
+            res = pthread_join(thread[i], NULL);
+            if (res) return_value = fail_msg(freesasa_thread_error(res));
+        }
+        free(call);
+        free(thread);
+        free(created);
+        return return_value;
+    }
+    free(call);
+    free(thread);
+    free(created);
+#endif /* USE_THREADS */
+
+    for (i = 0; i < n; ++i) {
+        fn((char *) args + i*size);
+    }
+
+    return return_value;
+}
+
+int
+freesasa_out_printf(freesasa_out *out,
+                    const char *format,
+                    ...)
+{
+    va_list arg;
+    size_t size;
+    char *buf;
+    int n;
+
+    if (out->file) {
+        va_start(arg, format);
+        n = vfprintf(out->file, format, arg);
+        va_end(arg);
+        return n < 0 ? FREESASA_FAIL : FREESASA_SUCCESS;
+    }
+
+    if (out->fail) return FREESASA_FAIL;
+
+    va_start(arg, format);
+    n = vsnprintf(out->buf ? out->buf + out->len : NULL,
+                  out->buf ? out->size - out->len : 0, format, arg);
+    va_end(arg);
+    if (n < 0) {
+        out->fail = 1;
+        return FREESASA_FAIL;
+    }
+
+    if (out->buf == NULL || out->len + n >= out->size) {
+        size = out->size > 0 ? 2*out->size : 4096;
+        while (size <= out->len + n) size *= 2;
+        buf = realloc(out->buf, size);
+        if (buf == NULL) {
+            out->fail = 1;
+            return mem_fail();
+        }
+        out->buf = buf;
+        out->size = size;
+        va_start(arg, format);
+        vsnprintf(out->buf + out->len, out->size - out->len, format, arg);
+        va_end(arg);
+    }
+    out->len += n;
+
+    return FREESASA_SUCCESS;
+}
+
+int
+freesasa_out_write(freesasa_out *out,
+                   FILE *file)
+{
+    int return_value = FREESASA_SUCCESS;
+
+    if (out->fail) {
+        return_value = FREESASA_FAIL;
+    } else if (out->len > 0 && fwrite(out->buf, 1, out->len, file) != out->len) {
+        return_value = fail_msg(strerror(errno));
+    }
+    free(out->buf);
+    out->buf = NULL;
+    out->len = out->size = 0;
+
+    return return_value;
+}
+
 void
 freesasa_set_err_out(FILE *fp)
 {
@@ -129,8 +435,31 @@ freesasa_set_err_out(FILE *fp)
     errlog = fp;
 }
 
+int
+freesasa_set_thread_err_out(FILE *fp)
+{
+    struct freesasa_thread_state *state;
+
+    if (fp == NULL) {
+        state = freesasa_thread_state(0);
+        if (state == NULL) return FREESASA_SUCCESS;
+        state->err_out = NULL;
+        if (!state->has_verbosity) freesasa_clear_thread_state();
+        return FREESASA_SUCCESS;
+    }
+
+    state = freesasa_thread_state(1);
+    if (state == NULL) return mem_fail();
+    state->err_out = fp;
+
+    return FREESASA_SUCCESS;
+}
+
 FILE *
 freesasa_get_err_out()
 {
+    struct freesasa_thread_state *state = freesasa_thread_state(0);
+
+    if (state && state->err_out) return state->err_out;
     return errlog;
 }
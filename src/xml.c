@@ -430,15 +430,36 @@ parameters2xml(const freesasa_parameters *p)
     case FREESASA_LEE_RICHARDS:
         sprintf(buf, "%d", p->lee_richards_n_slices);
         break;
+    case FREESASA_GAUSS_BONNET:
+    case FREESASA_LCPO:
+        buf[0] = '\0'; /* no resolution parameter */
+        break;
     default:
         assert(0);
         break;
     }
-    if (xmlNewProp(xml_node, BAD_CAST "resolution", BAD_CAST buf) == NULL) {
+    if (buf[0] != '\0' &&
+        xmlNewProp(xml_node, BAD_CAST "resolution", BAD_CAST buf) == NULL) {
         fail_msg("");
         goto cleanup;
     }
 
+    if (buf[0] != '\0' && p->target_atom_error > 0) {
+        sprintf(buf, "%f", p->target_atom_error);
+        if (xmlNewProp(xml_node, BAD_CAST "targetAtomError", BAD_CAST buf) == NULL) {
+            fail_msg("");
+            goto cleanup;
+        }
+    }
+
+    if (buf[0] != '\0' && p->target_total_error > 0) {
+        sprintf(buf, "%f", p->target_total_error);
+        if (xmlNewProp(xml_node, BAD_CAST "targetTotalError", BAD_CAST buf) == NULL) {
+            fail_msg("");
+            goto cleanup;
+        }
+    }
+
     return xml_node;
 
  cleanup:
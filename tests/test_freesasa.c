@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <check.h>
 #if HAVE_CONFIG_H
@@ -78,6 +79,16 @@ void setup_sr_precision(void)
 void teardown_sr_precision(void)
 {
 
+}
+void setup_gb_precision(void)
+{
+    parameters = freesasa_default_parameters;
+    parameters.alg = FREESASA_GAUSS_BONNET;
+    tolerance = 1e-10;
+}
+void teardown_gb_precision(void)
+{
+
 }
 
 START_TEST (test_sasa_alg_basic)
@@ -184,6 +195,78 @@ void teardown_lr(void)
 
 }
 
+void setup_gb (void)
+{
+    // agrees with L&R using 20000 slices to within 6e-4 Å^2
+    parameters = freesasa_default_parameters;
+    parameters.alg = FREESASA_GAUSS_BONNET;
+    parameters.n_threads = 1;
+    total_ref = 4804.633997;
+    polar_ref = 2502.677016;
+    apolar_ref = 2301.956981;
+}
+void teardown_gb(void)
+{
+
+}
+
+void setup_lcpo (void)
+{
+    // approximation, 2.7 % below the exact value
+    parameters = freesasa_default_parameters;
+    parameters.alg = FREESASA_LCPO;
+    parameters.n_threads = 1;
+    total_ref = 4674.867809;
+    polar_ref = 2396.566486;
+    apolar_ref = 2278.301323;
+}
+void teardown_lcpo(void)
+{
+
+}
+
+START_TEST (test_lcpo_accuracy)
+{
+    // 1ubq was used to fit the parameters, 1d3z was not
+    const char *files[] = {DATADIR "1ubq.pdb", DATADIR "1d3z.pdb"};
+    freesasa_parameters p = freesasa_default_parameters;
+    freesasa_structure *st;
+    freesasa_result *exact, *approx;
+    FILE *pdb;
+    double rms, diff;
+    int i, j, n;
+
+    p.n_threads = 1;
+    for (j = 0; j < 2; ++j) {
+        pdb = fopen(files[j], "r");
+        ck_assert(pdb != NULL);
+        st = freesasa_structure_from_pdb(pdb, NULL, 0);
+        fclose(pdb);
+        ck_assert(st != NULL);
+
+        p.alg = FREESASA_GAUSS_BONNET;
+        ck_assert((exact = freesasa_calc_structure(st, &p)) != NULL);
+        p.alg = FREESASA_LCPO;
+        ck_assert((approx = freesasa_calc_structure(st, &p)) != NULL);
+
+        // the documented accuracy of the fitted parameters
+        n = exact->n_atoms;
+        rms = 0;
+        for (i = 0; i < n; ++i) {
+            diff = approx->sasa[i] - exact->sasa[i];
+            rms += diff * diff;
+        }
+        rms = sqrt(rms / n);
+        ck_assert(rms < 5);
+        ck_assert(fabs(approx->total - exact->total) < 0.05 * exact->total);
+
+        freesasa_result_free(exact);
+        freesasa_result_free(approx);
+        freesasa_structure_free(st);
+    }
+}
+END_TEST
+
 START_TEST (test_sasa_1ubq)
 {
     FILE *pdb = fopen(DATADIR "1ubq.pdb","r");
@@ -256,6 +339,7 @@ START_TEST (test_write_pdb) {
     freesasa_node *root;
     fclose(pdb);
 
+    memset(&res, 0, sizeof(res));
     res.sasa = malloc(sizeof(double)*n);
     for (int i = 0; i < n; ++i) res.sasa[i] = 1.23;
     res.parameters = freesasa_default_parameters;
@@ -425,6 +509,16 @@ START_TEST (test_multi_calc)
     p.lee_richards_n_slices = 20;
     ck_assert((res = freesasa_calc_structure(st,&p)) != NULL);
     ck_assert(fabs(res->total - 4804.055641) < 1e-5);
+    freesasa_result_free(res);
+    // Gauss-Bonnet
+    p.alg = FREESASA_GAUSS_BONNET;
+    ck_assert((res = freesasa_calc_structure(st,&p)) != NULL);
+    ck_assert(fabs(res->total - 4804.633997) < 1e-5);
+    freesasa_result_free(res);
+    // LCPO
+    p.alg = FREESASA_LCPO;
+    ck_assert((res = freesasa_calc_structure(st,&p)) != NULL);
+    ck_assert(fabs(res->total - 4674.867809) < 1e-5);
 
     freesasa_structure_free(st);
     freesasa_result_free(res);
@@ -432,6 +526,1198 @@ START_TEST (test_multi_calc)
 }
 END_TEST
 
+START_TEST (test_numa)
+{
+#if USE_THREADS
+    FILE *pdb = fopen(DATADIR "1ubq.pdb","r");
+    freesasa_structure *st = freesasa_structure_from_pdb(pdb, NULL, 0);
+    freesasa_result *ref, *res;
+    freesasa_parameters p = freesasa_default_parameters, pn;
+    freesasa_algorithm alg[] = {FREESASA_LEE_RICHARDS, FREESASA_SHRAKE_RUPLEY};
+    int a, k, i, n = freesasa_structure_n(st);
+
+    fclose(pdb);
+
+    /* the same results as without, for several settings and thread
+       counts that don't divide the number of atoms */
+    for (a = 0; a < 2; ++a) {
+        for (k = 0; k < 3; ++k) {
+            p = freesasa_default_parameters;
+            p.alg = alg[a];
+            p.n_threads = 3 + 2*k;
+            if (k == 1) p.target_atom_error = 0.5;
+            if (k == 2 && alg[a] == FREESASA_LEE_RICHARDS) p.calc_gradient = 1;
+            pn = p;
+            pn.numa_aware = 1;
+            pn.pin_threads = 1;
+            ref = freesasa_calc_structure(st, &p);
+            res = freesasa_calc_structure(st, &pn);
+            ck_assert_ptr_ne(ref, NULL);
+            ck_assert_ptr_ne(res, NULL);
+            ck_assert_int_eq(res->n_skipped, ref->n_skipped);
+            for (i = 0; i < n; ++i) {
+                ck_assert(fabs(res->sasa[i] - ref->sasa[i]) < 1e-10);
+            }
+            if (p.calc_gradient) {
+                for (i = 0; i < 3*n; ++i) {
+                    ck_assert(fabs(res->gradient[i] - ref->gradient[i]) < 1e-8);
+                }
+            }
+            freesasa_result_free(ref);
+            freesasa_result_free(res);
+        }
+    }
+
+    /* surface dots keep their order, NUMA mode is not used */
+    p = freesasa_default_parameters;
+    p.alg = FREESASA_SHRAKE_RUPLEY;
+    p.calc_surface_dots = 1;
+    p.n_threads = 4;
+    pn = p;
+    pn.numa_aware = 1;
+    ref = freesasa_calc_structure(st, &p);
+    res = freesasa_calc_structure(st, &pn);
+    ck_assert_int_eq(res->dots->n, ref->dots->n);
+    for (i = 0; i < ref->dots->n; ++i) ck_assert_int_eq(res->dots->atom[i], ref->dots->atom[i]);
+    freesasa_result_free(ref);
+    freesasa_result_free(res);
+
+    freesasa_structure_free(st);
+#endif
+}
+END_TEST
+
+START_TEST (test_adaptive)
+{
+    FILE *pdb = fopen(DATADIR "1ubq.pdb","r");
+    freesasa_structure *st = freesasa_structure_from_pdb(pdb, NULL, 0);
+    freesasa_parameters p = freesasa_default_parameters;
+    freesasa_result *exact, *res;
+    FILE *err = tmpfile();
+    double rms = 0;
+    long pos;
+    int i;
+
+    fclose(pdb);
+    p.n_threads = 1;
+
+    // the total target is divided by sqrt(n_atoms)
+    p.target_atom_error = 1;
+    ck_assert(float_eq(freesasa_target_atom_error(&p, 100), 1, 1e-10));
+    p.target_total_error = 5;
+    ck_assert(float_eq(freesasa_target_atom_error(&p, 100), 0.5, 1e-10));
+    ck_assert(float_eq(freesasa_target_atom_error(&p, 4), 1, 1e-10));
+    p.target_atom_error = 0;
+    ck_assert(float_eq(freesasa_target_atom_error(&p, 4), 2.5, 1e-10));
+    p.target_total_error = 0;
+    ck_assert(freesasa_target_atom_error(&p, 5) == 0);
+
+    p.alg = FREESASA_GAUSS_BONNET;
+    ck_assert((exact = freesasa_calc_structure(st, &p)) != NULL);
+
+    // fixed resolution with 20 slices gives RMS error 0.17 Å^2 per
+    // atom, and up to 1.2 Å^2
+    p.alg = FREESASA_LEE_RICHARDS;
+    // a few atoms reach the minimal slice thickness, but still meet
+    // the target
+    p.target_atom_error = 0.01;
+    freesasa_set_err_out(err);
+    ck_assert((res = freesasa_calc_structure(st, &p)) != NULL);
+    freesasa_set_err_out(stderr);
+    for (i = 0; i < res->n_atoms; ++i) {
+        ck_assert(fabs(res->sasa[i] - exact->sasa[i]) < 0.01);
+        rms += (res->sasa[i] - exact->sasa[i])*(res->sasa[i] - exact->sasa[i]);
+    }
+    ck_assert(sqrt(rms/res->n_atoms) < 0.002);
+    ck_assert(fabs(res->total - exact->total) < 0.1);
+    freesasa_result_free(res);
+
+    p.target_atom_error = 0;
+    p.target_total_error = 2;
+    p.n_threads = 2;
+    ck_assert((res = freesasa_calc_structure(st, &p)) != NULL);
+    ck_assert(fabs(res->total - exact->total) < 2);
+    freesasa_result_free(res);
+
+    p.alg = FREESASA_SHRAKE_RUPLEY;
+    p.target_total_error = 0;
+    p.target_atom_error = 1;
+    ck_assert((res = freesasa_calc_structure(st, &p)) != NULL);
+    ck_assert(fabs(res->total - exact->total) < 0.01*exact->total);
+    freesasa_result_free(res);
+
+    // S&R can't reach 0.01 Å^2 for all atoms with the maximal number
+    // of test points, which gives a warning
+    p.target_atom_error = 0.01;
+    pos = ftell(err);
+    freesasa_set_err_out(err);
+    ck_assert((res = freesasa_calc_structure(st, &p)) != NULL);
+    ck_assert_int_gt(ftell(err), pos);
+    freesasa_set_err_out(stderr);
+    for (i = 0; i < res->n_atoms; ++i) {
+        ck_assert(fabs(res->sasa[i] - exact->sasa[i]) < 0.1);
+    }
+    freesasa_result_free(res);
+    fclose(err);
+
+    freesasa_result_free(exact);
+    freesasa_structure_free(st);
+}
+END_TEST
+
+START_TEST (test_adaptive_converge)
+{
+    const char *file[] = {DATADIR "1ubq.pdb", DATADIR "1a0q.pdb"};
+    const struct {
+        freesasa_algorithm alg;
+        double atom, total;
+    } target[] = {
+        {FREESASA_LEE_RICHARDS, 0.1, 0},
+        {FREESASA_LEE_RICHARDS, 1, 0},
+        {FREESASA_LEE_RICHARDS, 0, 5},
+        {FREESASA_SHRAKE_RUPLEY, 1, 0},
+        {FREESASA_SHRAKE_RUPLEY, 0, 10},
+    };
+    freesasa_parameters p = freesasa_default_parameters;
+    freesasa_structure *st;
+    freesasa_result *exact, *res;
+    FILE *pdb, *err = tmpfile();
+    double max_err;
+    int f, t, i;
+
+    // typical targets should be reached without warnings, the
+    // estimates of L&R are upper bounds, those of S&R are statistical
+    freesasa_set_err_out(err);
+    for (f = 0; f < 2; ++f) {
+        pdb = fopen(file[f], "r");
+        st = freesasa_structure_from_pdb(pdb, NULL, 0);
+        fclose(pdb);
+        p = freesasa_default_parameters;
+        p.alg = FREESASA_GAUSS_BONNET;
+        ck_assert((exact = freesasa_calc_structure(st, &p)) != NULL);
+        for (t = 0; t < sizeof(target)/sizeof(target[0]); ++t) {
+            p.alg = target[t].alg;
+            p.target_atom_error = target[t].atom;
+            p.target_total_error = target[t].total;
+            ck_assert((res = freesasa_calc_structure(st, &p)) != NULL);
+            ck_assert_int_eq(ftell(err), 0);
+            max_err = freesasa_target_atom_error(&p, res->n_atoms);
+            if (p.alg == FREESASA_SHRAKE_RUPLEY) max_err *= 2;
+            for (i = 0; i < res->n_atoms; ++i) {
+                ck_assert(fabs(res->sasa[i] - exact->sasa[i]) < max_err);
+            }
+            if (target[t].total > 0) {
+                ck_assert(fabs(res->total - exact->total) < target[t].total);
+            }
+            freesasa_result_free(res);
+        }
+        freesasa_result_free(exact);
+        freesasa_structure_free(st);
+    }
+    freesasa_set_err_out(stderr);
+    fclose(err);
+}
+END_TEST
+
+START_TEST (test_gradient)
+{
+    FILE *pdb = fopen(DATADIR "1ubq.pdb","r");
+    freesasa_structure *st = freesasa_structure_from_pdb(pdb, NULL, 0);
+    freesasa_parameters p = freesasa_default_parameters;
+    freesasa_algorithm alg[] = {FREESASA_LEE_RICHARDS, FREESASA_LCPO};
+    freesasa_result *res, *clone;
+    double sum[3];
+    int a, i;
+
+    fclose(pdb);
+
+    ck_assert((res = freesasa_calc_structure(st, &p)) != NULL);
+    ck_assert_ptr_eq(res->gradient, NULL);
+    freesasa_result_free(res);
+
+    p.calc_gradient = 1;
+    for (a = 0; a < 2; ++a) {
+        p.alg = alg[a];
+        ck_assert((res = freesasa_calc_structure(st, &p)) != NULL);
+        ck_assert_ptr_ne(res->gradient, NULL);
+        // the total only depends on relative positions
+        sum[0] = sum[1] = sum[2] = 0;
+        for (i = 0; i < 3*res->n_atoms; ++i) sum[i%3] += res->gradient[i];
+        for (i = 0; i < 3; ++i) ck_assert(fabs(sum[i]) < 1e-6);
+        clone = freesasa_result_clone(res);
+        ck_assert(clone->gradient[3*res->n_atoms-1] == res->gradient[3*res->n_atoms-1]);
+        freesasa_result_free(clone);
+        freesasa_result_free(res);
+    }
+
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    p.alg = FREESASA_SHRAKE_RUPLEY;
+    ck_assert_ptr_eq(freesasa_calc_structure(st, &p), NULL);
+    p.alg = FREESASA_GAUSS_BONNET;
+    ck_assert_ptr_eq(freesasa_calc_structure(st, &p), NULL);
+    p.alg = FREESASA_LEE_RICHARDS;
+    p.target_atom_error = 1;
+    ck_assert_ptr_eq(freesasa_calc_structure(st, &p), NULL);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+
+    freesasa_structure_free(st);
+}
+END_TEST
+
+START_TEST (test_surface_dots)
+{
+    FILE *pdb = fopen(DATADIR "1ubq.pdb","r"), *tf;
+    freesasa_structure *st = freesasa_structure_from_pdb(pdb, NULL, 0);
+    freesasa_parameters p = freesasa_default_parameters;
+    const double *radii = freesasa_structure_radius(st);
+    const double *v = freesasa_structure_coord_array(st);
+    freesasa_result *res, *clone;
+    double r, d[3], *sasa;
+    char buf[50];
+    int i, k, t, a, n;
+
+    fclose(pdb);
+
+    p.alg = FREESASA_SHRAKE_RUPLEY;
+    ck_assert((res = freesasa_calc_structure(st, &p)) != NULL);
+    ck_assert_ptr_eq(res->dots, NULL);
+    freesasa_result_free(res);
+
+    p.calc_surface_dots = 1;
+    for (t = 1; t <= 2; ++t) {
+        p.n_threads = t;
+        ck_assert((res = freesasa_calc_structure(st, &p)) != NULL);
+        ck_assert_ptr_ne(res->dots, NULL);
+        ck_assert(res->dots->n > 0);
+        // each point represents an equal share of the sphere
+        sasa = calloc(res->n_atoms, sizeof(double));
+        for (k = 0; k < res->dots->n; ++k) {
+            a = res->dots->atom[k];
+            ck_assert(k == 0 || a >= res->dots->atom[k-1]);
+            r = radii[a] + p.probe_radius;
+            sasa[a] += 4*M_PI*r*r/p.shrake_rupley_n_points;
+            for (i = 0; i < 3; ++i) {
+                d[i] = res->dots->xyz[3*k+i] - v[3*a+i] - r*res->dots->normal[3*k+i];
+                ck_assert(fabs(d[i]) < 1e-10);
+            }
+        }
+        for (i = 0; i < res->n_atoms; ++i) {
+            ck_assert(fabs(sasa[i] - res->sasa[i]) < 1e-10);
+        }
+        free(sasa);
+
+        clone = freesasa_result_clone(res);
+        ck_assert_int_eq(clone->dots->n, res->dots->n);
+        n = res->dots->n - 1;
+        ck_assert(clone->dots->xyz[3*n+2] == res->dots->xyz[3*n+2]);
+        ck_assert_int_eq(clone->dots->atom[n], res->dots->atom[n]);
+        freesasa_result_free(clone);
+        freesasa_result_free(res);
+    }
+
+    // adaptive resolution, the points of the final level are stored
+    p.target_atom_error = 0.5;
+    ck_assert((res = freesasa_calc_structure(st, &p)) != NULL);
+    for (k = 0, n = 0; k < res->dots->n; ++k) n += res->sasa[res->dots->atom[k]] > 0;
+    ck_assert_int_eq(n, res->dots->n);
+    p.target_atom_error = 0;
+
+    tf = tmpfile();
+    ck_assert_int_eq(freesasa_write_surface_dots(tf, res, "test", FREESASA_DOTS_XYZ),
+                     FREESASA_SUCCESS);
+    rewind(tf);
+    ck_assert(fscanf(tf, "%d", &n) == 1);
+    ck_assert_int_eq(n, res->dots->n);
+    fclose(tf);
+
+    tf = tmpfile();
+    ck_assert_int_eq(freesasa_write_surface_dots(tf, res, NULL,
+                                                 FREESASA_DOTS_BINARY | FREESASA_DOTS_NORMALS),
+                     FREESASA_SUCCESS);
+    rewind(tf);
+    ck_assert(fread(buf, 1, 8, tf) == 8);
+    ck_assert(strncmp(buf, "FSASADOT", 8) == 0);
+    ck_assert(fseek(tf, 0, SEEK_END) == 0);
+    ck_assert_int_eq(ftell(tf), 8 + 3*4 + res->dots->n*7*4);
+    fclose(tf);
+    freesasa_result_free(res);
+
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    p.alg = FREESASA_LEE_RICHARDS;
+    ck_assert_ptr_eq(freesasa_calc_structure(st, &p), NULL);
+    p.alg = FREESASA_SHRAKE_RUPLEY;
+    p.calc_surface_dots = 0;
+    ck_assert((res = freesasa_calc_structure(st, &p)) != NULL);
+    tf = tmpfile();
+    ck_assert_int_eq(freesasa_write_surface_dots(tf, res, NULL, FREESASA_DOTS_XYZ),
+                     FREESASA_FAIL);
+    fclose(tf);
+    freesasa_result_free(res);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+
+    freesasa_structure_free(st);
+}
+END_TEST
+
+START_TEST (test_batch)
+{
+    FILE *pdb = fopen(DATADIR "1ubq.pdb","r");
+    freesasa_structure *st = freesasa_structure_from_pdb(pdb, NULL, 0);
+    freesasa_parameters p = freesasa_default_parameters;
+    freesasa_algorithm alg[] = {FREESASA_LEE_RICHARDS, FREESASA_SHRAKE_RUPLEY,
+                                FREESASA_GAUSS_BONNET, FREESASA_LCPO};
+    const double *xyz = freesasa_structure_coord_array(st);
+    const double *radii = freesasa_structure_radius(st);
+    // molecules of varying size, one empty, the first atoms not used
+    int offsets[] = {3, 40, 40, 41, 100, 130, 200};
+    const int n_mol = 6;
+    double sasa[200], total[6];
+    freesasa_result *res;
+    int a, t, m, i, bad[] = {0, 10, 5};
+
+    fclose(pdb);
+
+    for (a = 0; a < 4; ++a) {
+        p.alg = alg[a];
+        p.target_atom_error = 0;
+        for (t = 1; t <= 4; t += 3) {
+            p.n_threads = t;
+            ck_assert_int_eq(freesasa_calc_coord_batch(xyz, radii, offsets, n_mol,
+                                                       sasa, total, &p),
+                             FREESASA_SUCCESS);
+            p.n_threads = 1;
+            for (m = 0; m < n_mol; ++m) {
+                if (offsets[m+1] == offsets[m]) {
+                    ck_assert(total[m] == 0);
+                    continue;
+                }
+                res = freesasa_calc_coord(xyz + 3*offsets[m], radii + offsets[m],
+                                          offsets[m+1] - offsets[m], &p);
+                ck_assert(res != NULL);
+                ck_assert(fabs(res->total - total[m]) < 1e-10);
+                for (i = 0; i < res->n_atoms; ++i) {
+                    ck_assert(fabs(res->sasa[i] - sasa[offsets[m] + i]) < 1e-10);
+                }
+                freesasa_result_free(res);
+            }
+        }
+    }
+
+    // adaptive resolution (some atoms at the ends of the fragments
+    // don't converge)
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    p.alg = FREESASA_LEE_RICHARDS;
+    p.target_atom_error = 0.1;
+    ck_assert_int_ne(freesasa_calc_coord_batch(xyz, radii, offsets, n_mol, sasa, NULL, &p),
+                     FREESASA_FAIL);
+    res = freesasa_calc_coord(xyz + 3*offsets[3], radii + offsets[3], offsets[4] - offsets[3], &p);
+    for (i = 0; i < res->n_atoms; ++i) {
+        ck_assert(fabs(res->sasa[i] - sasa[offsets[3] + i]) < 1e-10);
+    }
+    freesasa_result_free(res);
+    p.target_atom_error = 0;
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+
+    ck_assert_int_eq(freesasa_calc_coord_batch(xyz, radii, offsets, 0, sasa, NULL, &p),
+                     FREESASA_SUCCESS);
+
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    ck_assert_int_eq(freesasa_calc_coord_batch(xyz, radii, bad, 2, sasa, NULL, &p),
+                     FREESASA_FAIL);
+    ck_assert_int_eq(freesasa_calc_coord_batch(xyz, radii, offsets, -1, sasa, NULL, &p),
+                     FREESASA_FAIL);
+    p.calc_gradient = 1;
+    ck_assert_int_eq(freesasa_calc_coord_batch(xyz, radii, offsets, n_mol, sasa, NULL, &p),
+                     FREESASA_FAIL);
+    p.calc_gradient = 0;
+    p.lee_richards_n_slices = 0;
+    ck_assert_int_eq(freesasa_calc_coord_batch(xyz, radii, offsets, n_mol, sasa, NULL, &p),
+                     FREESASA_FAIL);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+
+    freesasa_structure_free(st);
+}
+END_TEST
+
+START_TEST (test_calc_structures)
+{
+    FILE *pdb = fopen(DATADIR "1d3z.pdb", "r");
+    freesasa_structure **models, *st[13];
+    freesasa_result *res[13], *ref;
+    freesasa_parameters p;
+    int n_models = 0, n, k, t, i, j;
+
+    ck_assert_ptr_ne(pdb, NULL);
+    models = freesasa_structure_array(pdb, &n_models, NULL, FREESASA_SEPARATE_MODELS);
+    fclose(pdb);
+    ck_assert_int_eq(n_models, 10);
+
+    /* large and small structures, and one without atoms */
+    pdb = fopen(DATADIR "1ubq.pdb", "r");
+    st[0] = freesasa_structure_from_pdb(pdb, NULL, 0);
+    fclose(pdb);
+    for (i = 0; i < n_models; ++i) {
+        st[i+1] = freesasa_structure_view_atoms(models[i], 0, 40*i);
+    }
+    st[11] = freesasa_structure_new();
+    st[12] = models[0];
+    n = 13;
+
+    /* chunked (S&R and L&R) and whole structures (LCPO, surface dots) */
+    for (k = 0; k < 4; ++k) {
+        for (t = 1; t <= 5; t += 4) {
+            p = freesasa_default_parameters;
+            p.n_threads = t;
+            if (k == 1) {
+                p.alg = FREESASA_SHRAKE_RUPLEY;
+                p.target_atom_error = 0.5;
+            }
+            if (k == 2) p.alg = FREESASA_LCPO;
+            if (k == 3) {
+                p.alg = FREESASA_SHRAKE_RUPLEY;
+                p.calc_surface_dots = 1;
+            }
+            ck_assert_int_ne(freesasa_calc_structures((const freesasa_structure **) st, n, res, &p),
+                             FREESASA_FAIL);
+            for (i = 0; i < n; ++i) {
+                ck_assert_ptr_ne(res[i], NULL);
+                ck_assert_int_eq(res[i]->n_atoms, freesasa_structure_n(st[i]));
+                ck_assert_int_eq(res[i]->parameters.n_threads, t);
+                if (i == 11) {
+                    ck_assert(res[i]->total == 0);
+                    freesasa_result_free(res[i]);
+                    continue;
+                }
+                ref = freesasa_calc_structure(st[i], &p);
+                ck_assert_ptr_ne(ref, NULL);
+                ck_assert_int_eq(res[i]->n_skipped, ref->n_skipped);
+                ck_assert(fabs(res[i]->total - ref->total) < 1e-8);
+                for (j = 0; j < ref->n_atoms; ++j) {
+                    ck_assert(fabs(res[i]->sasa[j] - ref->sasa[j]) < 1e-10);
+                }
+                if (p.calc_surface_dots) {
+                    ck_assert_int_eq(res[i]->dots->n, ref->dots->n);
+                }
+                freesasa_result_free(ref);
+                freesasa_result_free(res[i]);
+            }
+        }
+    }
+
+    /* invalid parameters */
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    p = freesasa_default_parameters;
+    p.n_threads = 0;
+    ck_assert_int_eq(freesasa_calc_structures((const freesasa_structure **) st, n, res, &p),
+                     FREESASA_FAIL);
+    p.n_threads = 2;
+    p.lee_richards_n_slices = 0;
+    ck_assert_int_eq(freesasa_calc_structures((const freesasa_structure **) st, n, res, &p),
+                     FREESASA_FAIL);
+    for (i = 0; i < n; ++i) {
+        if (i == 11) freesasa_result_free(res[i]);
+        else ck_assert_ptr_eq(res[i], NULL);
+    }
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+    ck_assert_int_eq(freesasa_calc_structures((const freesasa_structure **) st, 0, res, NULL),
+                     FREESASA_SUCCESS);
+
+    for (i = 0; i < 12; ++i) freesasa_structure_free(st[i]);
+    for (i = 1; i < n_models; ++i) freesasa_structure_free(models[i]);
+    freesasa_structure_free(models[0]);
+    free(models);
+}
+END_TEST
+
+START_TEST (test_strided)
+{
+    FILE *pdb = fopen(DATADIR "1ubq.pdb","r");
+    freesasa_structure *st = freesasa_structure_from_pdb(pdb, NULL, 0);
+    freesasa_parameters p = freesasa_default_parameters;
+    freesasa_algorithm alg[] = {FREESASA_LEE_RICHARDS, FREESASA_SHRAKE_RUPLEY,
+                                FREESASA_GAUSS_BONNET, FREESASA_LCPO};
+    const double *xyz = freesasa_structure_coord_array(st);
+    const double *radii = freesasa_structure_radius(st);
+    const int n = freesasa_structure_n(st);
+    double *soa = malloc(sizeof(double) * 3 * n);
+    double *aos = malloc(sizeof(double) * 4 * n);
+    float *fxyz = malloc(sizeof(float) * 3 * n);
+    double *sasa = malloc(sizeof(double) * n);
+    double total;
+    freesasa_result *res;
+    int a, i;
+
+    fclose(pdb);
+
+    // separate arrays, 4-component structs, and floats
+    for (i = 0; i < n; ++i) {
+        soa[i]       = aos[4*i]   = xyz[3*i];
+        soa[n + i]   = aos[4*i+1] = xyz[3*i+1];
+        soa[2*n + i] = aos[4*i+2] = xyz[3*i+2];
+        aos[4*i+3] = radii[i];
+        fxyz[3*i] = xyz[3*i]; fxyz[3*i+1] = xyz[3*i+1]; fxyz[3*i+2] = xyz[3*i+2];
+    }
+
+    for (a = 0; a < 4; ++a) {
+        p.alg = alg[a];
+        res = freesasa_calc_coord(xyz, radii, n, &p);
+        ck_assert(res != NULL);
+
+        ck_assert_int_eq(freesasa_calc_coord_strided(xyz, xyz+1, xyz+2, 3, radii, n,
+                                                     sasa, &total, &p),
+                         FREESASA_SUCCESS);
+        ck_assert(fabs(total - res->total) < 1e-10);
+        for (i = 0; i < n; ++i) ck_assert(fabs(sasa[i] - res->sasa[i]) < 1e-10);
+
+        ck_assert_int_eq(freesasa_calc_coord_strided(soa, soa+n, soa+2*n, 1, radii, n,
+                                                     sasa, &total, &p),
+                         FREESASA_SUCCESS);
+        ck_assert(fabs(total - res->total) < 1e-10);
+        for (i = 0; i < n; ++i) ck_assert(fabs(sasa[i] - res->sasa[i]) < 1e-10);
+
+        ck_assert_int_eq(freesasa_calc_coord_strided(aos, aos+1, aos+2, 4, radii, n,
+                                                     sasa, NULL, &p),
+                         FREESASA_SUCCESS);
+        for (i = 0; i < n; ++i) ck_assert(fabs(sasa[i] - res->sasa[i]) < 1e-10);
+
+        // PDB coordinates have three decimals, float precision is
+        // not exact, but close
+        ck_assert_int_eq(freesasa_calc_coord_strided_float(fxyz, fxyz+1, fxyz+2, 3, radii, n,
+                                                           sasa, &total, &p),
+                         FREESASA_SUCCESS);
+        ck_assert(fabs(total - res->total) < 1e-3);
+
+        freesasa_result_free(res);
+    }
+
+    ck_assert_int_eq(freesasa_calc_coord_strided(xyz, xyz+1, xyz+2, 3, radii, 0,
+                                                 sasa, &total, NULL),
+                     FREESASA_SUCCESS);
+    ck_assert(total == 0);
+
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    ck_assert_int_eq(freesasa_calc_coord_strided(xyz, xyz+1, xyz+2, 0, radii, n,
+                                                 sasa, &total, NULL),
+                     FREESASA_FAIL);
+    ck_assert_int_eq(freesasa_calc_coord_strided_float(fxyz, fxyz+1, fxyz+2, 3, radii, -1,
+                                                       sasa, &total, NULL),
+                     FREESASA_FAIL);
+    p.calc_gradient = 1;
+    ck_assert_int_eq(freesasa_calc_coord_strided(xyz, xyz+1, xyz+2, 3, radii, n,
+                                                 sasa, &total, &p),
+                     FREESASA_FAIL);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+
+    free(soa);
+    free(aos);
+    free(fxyz);
+    free(sasa);
+    freesasa_structure_free(st);
+}
+END_TEST
+
+START_TEST (test_async)
+{
+    FILE *pdb = fopen(DATADIR "1ubq.pdb","r");
+    freesasa_structure *st = freesasa_structure_from_pdb(pdb, NULL, 0);
+    freesasa_parameters p = freesasa_default_parameters;
+    freesasa_result *res, *ref;
+    freesasa_async *async;
+    const int n = freesasa_structure_n(st);
+    int i, t, n_done, n_total;
+
+    fclose(pdb);
+
+    for (t = 1; t <= 2; ++t) {
+        p.n_threads = t;
+        ref = freesasa_calc_structure(st, &p);
+        async = freesasa_calc_structure_async(st, &p);
+        ck_assert(async != NULL);
+        res = freesasa_async_wait(async);
+        ck_assert(res != NULL);
+        ck_assert(freesasa_async_wait(async) == NULL);
+        ck_assert_int_eq(freesasa_async_status(async, &n_done, &n_total),
+                         FREESASA_ASYNC_DONE);
+        ck_assert_int_eq(n_done, n);
+        ck_assert_int_eq(n_total, n);
+        ck_assert(fabs(res->total - ref->total) < 1e-10);
+        for (i = 0; i < n; ++i) ck_assert(fabs(res->sasa[i] - ref->sasa[i]) < 1e-10);
+        freesasa_async_cancel(async); /* no effect */
+        ck_assert_int_eq(freesasa_async_status(async, NULL, NULL), FREESASA_ASYNC_DONE);
+        freesasa_async_free(async);
+        freesasa_result_free(res);
+        freesasa_result_free(ref);
+    }
+
+    async = freesasa_calc_coord_async(freesasa_structure_coord_array(st),
+                                      freesasa_structure_radius(st), n, NULL);
+    res = freesasa_async_wait(async);
+    ck_assert(res != NULL);
+    ck_assert_int_eq(res->n_atoms, n);
+    freesasa_result_free(res);
+    freesasa_async_free(async);
+
+    /* cancel a slow calculation */
+    for (t = 1; t <= 2; ++t) {
+        p.n_threads = t;
+        p.lee_richards_n_slices = 5000;
+        async = freesasa_calc_structure_async(st, &p);
+        ck_assert(async != NULL);
+        freesasa_async_cancel(async);
+        ck_assert(freesasa_async_wait(async) == NULL);
+        ck_assert_int_eq(freesasa_async_status(async, &n_done, &n_total),
+                         FREESASA_ASYNC_CANCELLED);
+        ck_assert_int_lt(n_done, n_total);
+        freesasa_async_free(async);
+    }
+
+    /* free without waiting */
+    async = freesasa_calc_structure_async(st, &p);
+    freesasa_async_free(async);
+
+    /* invalid parameters */
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    p.lee_richards_n_slices = 0;
+    async = freesasa_calc_structure_async(st, &p);
+    ck_assert(freesasa_async_wait(async) == NULL);
+    ck_assert_int_eq(freesasa_async_status(async, NULL, NULL), FREESASA_ASYNC_FAILED);
+    freesasa_async_free(async);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+
+    freesasa_structure_free(st);
+}
+END_TEST
+
+START_TEST (test_symmetry)
+{
+    FILE *pdb = fopen(DATADIR "1ubq.pdb","r"), *tf;
+    freesasa_structure *st = freesasa_structure_from_pdb(pdb, NULL, 0);
+    freesasa_parameters p = freesasa_default_parameters;
+    freesasa_algorithm alg[] = {FREESASA_LEE_RICHARDS, FREESASA_SHRAKE_RUPLEY,
+                                FREESASA_GAUSS_BONNET, FREESASA_LCPO};
+    freesasa_result *res, *ref;
+    const int n = freesasa_structure_n(st);
+    const double *xyz = freesasa_structure_coord_array(st),
+        *r = freesasa_structure_radius(st);
+    const double cos_k[] = {1, 0, -1, 0}, sin_k[] = {0, 1, 0, -1};
+    double ops[4*12], *all_xyz, *all_r, *read_ops, axis[2], x_max,
+        c, sn, bad[12];
+    int i, j, k, a, n_ops;
+
+    fclose(pdb);
+
+    /* four copies related by 90 degree rotations around an axis
+       parallel to z, just outside the protein */
+    x_max = xyz[0];
+    axis[1] = 0;
+    for (i = 0; i < n; ++i) {
+        if (xyz[3*i] > x_max) x_max = xyz[3*i];
+        axis[1] += xyz[3*i+1] / n;
+    }
+    axis[0] = x_max + 1;
+    memset(ops, 0, sizeof(ops));
+    for (k = 0; k < 4; ++k) {
+        c = cos_k[k];
+        sn = sin_k[k];
+        ops[12*k] = c; ops[12*k+1] = -sn;
+        ops[12*k+4] = sn; ops[12*k+5] = c;
+        ops[12*k+10] = 1;
+        ops[12*k+3] = axis[0] - c*axis[0] + sn*axis[1];
+        ops[12*k+7] = axis[1] - sn*axis[0] - c*axis[1];
+    }
+
+    all_xyz = malloc(sizeof(double) * 3 * 4 * n);
+    all_r = malloc(sizeof(double) * 4 * n);
+    for (k = 0; k < 4; ++k) {
+        for (i = 0; i < n; ++i) {
+            for (j = 0; j < 3; ++j) {
+                all_xyz[3*(k*n+i)+j] = ops[12*k+4*j]*xyz[3*i] +
+                    ops[12*k+4*j+1]*xyz[3*i+1] +
+                    ops[12*k+4*j+2]*xyz[3*i+2] + ops[12*k+4*j+3];
+            }
+            all_r[k*n+i] = r[i];
+        }
+    }
+
+    for (a = 0; a < 4; ++a) {
+        p.alg = alg[a];
+        ref = freesasa_calc_coord(all_xyz, all_r, 4*n, &p);
+        res = freesasa_calc_structure_symmetric(st, ops, 4, &p);
+        ck_assert(res != NULL);
+        ck_assert_int_eq(res->n_atoms, n);
+        for (i = 0; i < n; ++i) ck_assert(fabs(res->sasa[i] - ref->sasa[i]) < 1e-8);
+        /* only S&R depends on the orientation of the copies */
+        if (alg[a] != FREESASA_SHRAKE_RUPLEY)
+            ck_assert(fabs(4*res->total - ref->total) < 1e-6);
+        /* the interfaces bury part of the surface */
+        freesasa_result_free(ref);
+        ref = freesasa_calc_structure(st, &p);
+        ck_assert(res->total < ref->total - 100);
+        freesasa_result_free(ref);
+        freesasa_result_free(res);
+    }
+
+    /* the identity alone gives the same result as the structure */
+    p.alg = FREESASA_LEE_RICHARDS;
+    ref = freesasa_calc_structure(st, &p);
+    res = freesasa_calc_coord_symmetric(xyz, r, n, ops, 1, &p);
+    ck_assert(fabs(res->total - ref->total) < 1e-10);
+    freesasa_result_free(res);
+    freesasa_result_free(ref);
+
+    /* operators from PDB and from file */
+    pdb = fopen(DATADIR "1ubq.pdb","r");
+    n_ops = freesasa_symmetry_from_pdb(pdb, &read_ops);
+    fclose(pdb);
+    ck_assert_int_eq(n_ops, 1);
+    for (i = 0; i < 12; ++i) ck_assert(read_ops[i] == ops[i]);
+    free(read_ops);
+
+    tf = tmpfile();
+    fprintf(tf, "# comment\n");
+    for (k = 0; k < 4; ++k) {
+        for (j = 0; j < 3; ++j) {
+            fprintf(tf, "%.17g %.17g %.17g %.17g\n", ops[12*k+4*j],
+                    ops[12*k+4*j+1], ops[12*k+4*j+2], ops[12*k+4*j+3]);
+        }
+    }
+    rewind(tf);
+    n_ops = freesasa_symmetry_from_file(tf, &read_ops);
+    ck_assert_int_eq(n_ops, 4);
+    for (i = 0; i < 48; ++i) ck_assert(read_ops[i] == ops[i]);
+    free(read_ops);
+    fclose(tf);
+
+    /* errors */
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    tf = tmpfile();
+    fprintf(tf, "1 0 0 0\n0 1 0 0\n");
+    rewind(tf);
+    ck_assert_int_eq(freesasa_symmetry_from_file(tf, &read_ops), FREESASA_FAIL);
+    fclose(tf);
+    tf = tmpfile();
+    fprintf(tf, "1 0 0 0\n0 1 0 0\n0 0 1 x\n");
+    rewind(tf);
+    ck_assert_int_eq(freesasa_symmetry_from_file(tf, &read_ops), FREESASA_FAIL);
+    fclose(tf);
+    memcpy(bad, ops, sizeof(bad));
+    bad[0] = 2;
+    ck_assert(freesasa_calc_structure_symmetric(st, bad, 1, &p) == NULL);
+    ck_assert(freesasa_calc_structure_symmetric(st, ops, 0, &p) == NULL);
+    p.calc_gradient = 1;
+    ck_assert(freesasa_calc_structure_symmetric(st, ops, 4, &p) == NULL);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+
+    free(all_xyz);
+    free(all_r);
+    freesasa_structure_free(st);
+}
+END_TEST
+
+START_TEST (test_periodic)
+{
+    FILE *pdb = fopen(DATADIR "1ubq.pdb","r");
+    freesasa_structure *st = freesasa_structure_from_pdb(pdb, NULL, 0);
+    freesasa_parameters p = freesasa_default_parameters;
+    freesasa_algorithm alg[] = {FREESASA_LEE_RICHARDS, FREESASA_SHRAKE_RUPLEY,
+                                FREESASA_GAUSS_BONNET, FREESASA_LCPO};
+    freesasa_result *res, *ref, *open;
+    const int n = freesasa_structure_n(st);
+    const double *xyz = freesasa_structure_coord_array(st),
+        *r = freesasa_structure_radius(st);
+    double box[9], cell[6], lo[3], hi[3], *all_xyz, *all_r, shift[3];
+    int i, j, k, a, ia, ib, ic, m;
+
+    ck_assert_int_eq(freesasa_periodic_box_from_pdb(pdb, box), 0); /* at end of file */
+    rewind(pdb);
+    ck_assert_int_eq(freesasa_periodic_box_from_pdb(pdb, box), 1);
+    fclose(pdb);
+    for (i = 0; i < 9; ++i) {
+        ck_assert(fabs(box[i] - (i == 0 ? 50.84 : i == 4 ? 42.77 : i == 8 ? 28.95 : 0)) < 1e-10);
+    }
+
+    /* a triclinic box where the images are in contact */
+    for (k = 0; k < 3; ++k) lo[k] = hi[k] = xyz[k];
+    for (i = 0; i < n; ++i) {
+        for (k = 0; k < 3; ++k) {
+            lo[k] = fmin(lo[k], xyz[3*i+k]);
+            hi[k] = fmax(hi[k], xyz[3*i+k]);
+        }
+    }
+    memset(box, 0, sizeof(box));
+    box[0] = hi[0] - lo[0] + 1;
+    box[3] = 5; box[4] = hi[1] - lo[1] + 1;
+    box[6] = -3; box[7] = 4; box[8] = hi[2] - lo[2] + 1;
+
+    /* reference with explicit images, the original first */
+    all_xyz = malloc(sizeof(double) * 3 * 27 * n);
+    all_r = malloc(sizeof(double) * 27 * n);
+    m = 0;
+    for (k = 0; k < 27; ++k) {
+        ia = (k % 3 + 1) % 3 - 1;
+        ib = (k / 3 % 3 + 1) % 3 - 1;
+        ic = (k / 9 + 1) % 3 - 1;
+        for (j = 0; j < 3; ++j) shift[j] = ia*box[j] + ib*box[3+j] + ic*box[6+j];
+        for (i = 0; i < n; ++i, ++m) {
+            for (j = 0; j < 3; ++j) all_xyz[3*m+j] = xyz[3*i+j] + shift[j];
+            all_r[m] = r[i];
+        }
+    }
+
+    for (a = 0; a < 4; ++a) {
+        p.alg = alg[a];
+        ref = freesasa_calc_coord(all_xyz, all_r, 27*n, &p);
+        res = freesasa_calc_structure_periodic(st, box, &p);
+        ck_assert(res != NULL);
+        ck_assert_int_eq(res->n_atoms, n);
+        for (i = 0; i < n; ++i) ck_assert(fabs(res->sasa[i] - ref->sasa[i]) < 1e-8);
+        /* the contacts between images bury part of the surface */
+        open = freesasa_calc_structure(st, &p);
+        ck_assert(res->total < open->total - 100);
+        freesasa_result_free(open);
+        freesasa_result_free(ref);
+        freesasa_result_free(res);
+    }
+
+    /* orthorhombic box from cell parameters, far enough that the
+       images don't touch */
+    p.alg = FREESASA_LEE_RICHARDS;
+    for (k = 0; k < 3; ++k) {
+        cell[k] = hi[k] - lo[k] + 10;
+        cell[3+k] = 90;
+    }
+    ck_assert_int_eq(freesasa_periodic_box_from_cell(cell, box), FREESASA_SUCCESS);
+    for (i = 0; i < 9; ++i) {
+        ck_assert(fabs(box[i] - (i % 4 == 0 ? cell[i/4] : 0)) < 1e-10);
+    }
+    open = freesasa_calc_structure(st, &p);
+    res = freesasa_calc_coord_periodic(xyz, r, n, box, &p);
+    ck_assert(fabs(res->total - open->total) < 1e-10);
+    freesasa_result_free(res);
+    freesasa_result_free(open);
+
+    /* errors */
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    cell[0] = cell[1] = cell[2] = 15;
+    ck_assert_int_eq(freesasa_periodic_box_from_cell(cell, box), FREESASA_SUCCESS);
+    ck_assert(freesasa_calc_structure_periodic(st, box, &p) == NULL);
+    cell[3] = 180;
+    ck_assert_int_eq(freesasa_periodic_box_from_cell(cell, box), FREESASA_FAIL);
+    cell[3] = cell[4] = cell[5] = 60;
+    ck_assert_int_eq(freesasa_periodic_box_from_cell(cell, box), FREESASA_SUCCESS);
+    cell[3] = 170;
+    ck_assert_int_eq(freesasa_periodic_box_from_cell(cell, box), FREESASA_FAIL);
+    memset(box, 0, sizeof(box));
+    box[0] = box[3] = 40; box[8] = 40;
+    ck_assert(freesasa_calc_structure_periodic(st, box, &p) == NULL);
+    box[3] = 0; box[4] = 40;
+    res = freesasa_calc_structure_periodic(st, box, &p);
+    ck_assert(res != NULL);
+    freesasa_result_free(res);
+    p.calc_gradient = 1;
+    ck_assert(freesasa_calc_structure_periodic(st, box, &p) == NULL);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+
+    free(all_xyz);
+    free(all_r);
+    freesasa_structure_free(st);
+}
+END_TEST
+
+struct slab_io {
+    const double *xyz, *r;
+    int n, next;
+    double *sasa;
+    int *count;
+    int fail_at;
+};
+
+static int
+slab_read(double *xyz, double *radius, void *data)
+{
+    struct slab_io *io = data;
+    if (io->next == io->fail_at) return FREESASA_FAIL;
+    if (io->next == io->n) return 0;
+    memcpy(xyz, io->xyz + 3*io->next, 3*sizeof(double));
+    *radius = io->r[io->next];
+    ++io->next;
+    return 1;
+}
+
+static int
+slab_write(int index, double sasa, void *data)
+{
+    struct slab_io *io = data;
+    if (index < 0 || index >= io->n) return FREESASA_FAIL;
+    io->sasa[index] = sasa;
+    ++io->count[index];
+    return FREESASA_SUCCESS;
+}
+
+START_TEST (test_slabs)
+{
+    FILE *pdb = fopen(DATADIR "1ubq.pdb","r");
+    freesasa_structure *st = freesasa_structure_from_pdb(pdb, NULL, 0);
+    freesasa_parameters p = freesasa_default_parameters;
+    freesasa_algorithm alg[] = {FREESASA_LEE_RICHARDS, FREESASA_SHRAKE_RUPLEY,
+                                FREESASA_GAUSS_BONNET, FREESASA_LCPO};
+    /* the narrowest slabs are more than there are temporary files
+       open at once */
+    double width[] = {8, 20, 1000, 0.25};
+    const int n = freesasa_structure_n(st);
+    struct slab_io io;
+    freesasa_result *ref;
+    FILE *err = tmpfile();
+    double total;
+    int a, i;
+
+    fclose(pdb);
+
+    io.xyz = freesasa_structure_coord_array(st);
+    io.r = freesasa_structure_radius(st);
+    io.n = n;
+    io.fail_at = -1;
+    io.sasa = malloc(sizeof(double) * n);
+    io.count = malloc(sizeof(int) * n);
+
+    for (a = 0; a < 4; ++a) {
+        p.alg = alg[a];
+        ref = freesasa_calc_structure(st, &p);
+        io.next = 0;
+        memset(io.count, 0, sizeof(int) * n);
+        ck_assert_int_eq(freesasa_calc_slabs(slab_read, &io, slab_write, &io,
+                                             width[a], &total, &p),
+                         FREESASA_SUCCESS);
+        for (i = 0; i < n; ++i) {
+            ck_assert_int_eq(io.count[i], 1);
+            ck_assert(fabs(io.sasa[i] - ref->sasa[i]) < 1e-8);
+        }
+        ck_assert(fabs(total - ref->total) < 1e-6);
+        freesasa_result_free(ref);
+    }
+
+#if USE_THREADS
+    /* slabs with fewer atoms than threads don't give warnings */
+    p.alg = FREESASA_LEE_RICHARDS;
+    p.n_threads = 8;
+    io.next = 0;
+    freesasa_set_err_out(err);
+    ck_assert_int_eq(freesasa_calc_slabs(slab_read, &io, slab_write, &io,
+                                         0.25, &total, &p),
+                     FREESASA_SUCCESS);
+    ck_assert_int_eq(ftell(err), 0);
+    freesasa_set_err_out(stderr);
+    p.n_threads = 1;
+#endif
+    fclose(err);
+
+    /* empty input */
+    io.n = 0; io.next = 0;
+    ck_assert_int_eq(freesasa_calc_slabs(slab_read, &io, slab_write, &io,
+                                         10, &total, &p),
+                     FREESASA_SUCCESS);
+    ck_assert(total == 0);
+
+    /* errors */
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    io.n = n; io.next = 0; io.fail_at = 100;
+    ck_assert_int_eq(freesasa_calc_slabs(slab_read, &io, slab_write, &io,
+                                         10, &total, &p),
+                     FREESASA_FAIL);
+    io.n = 10; io.next = 0; io.fail_at = -1;
+    ck_assert_int_eq(freesasa_calc_slabs(slab_read, &io, slab_write, &io,
+                                         10, &total, &p),
+                     FREESASA_SUCCESS);
+    io.next = 0;
+    ck_assert_int_eq(freesasa_calc_slabs(slab_read, &io, slab_write, &io,
+                                         0, &total, &p),
+                     FREESASA_FAIL);
+    p.calc_gradient = 1;
+    io.next = 0;
+    ck_assert_int_eq(freesasa_calc_slabs(slab_read, &io, slab_write, &io,
+                                         10, &total, &p),
+                     FREESASA_FAIL);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+
+    free(io.sasa);
+    free(io.count);
+    freesasa_structure_free(st);
+}
+END_TEST
+
+START_TEST (test_receptor)
+{
+    FILE *pdb = fopen(DATADIR "1ubq.pdb","r");
+    freesasa_structure *st = freesasa_structure_from_pdb(pdb, NULL, 0);
+    freesasa_parameters p = freesasa_default_parameters;
+    freesasa_algorithm alg[] = {FREESASA_LEE_RICHARDS, FREESASA_SHRAKE_RUPLEY,
+                                FREESASA_GAUSS_BONNET, FREESASA_LCPO};
+    const double *xyz = freesasa_structure_coord_array(st);
+    const double *r = freesasa_structure_radius(st);
+    const int n = freesasa_structure_n(st), n_lig = 40, n_rec = n - n_lig;
+    double far[3*40], delta;
+    freesasa_receptor *rec;
+    freesasa_result *complex, *free_lig;
+    const freesasa_result *free_rec;
+    freesasa_pose_result *pose;
+    int a, i, k, last;
+
+    fclose(pdb);
+
+    /* the last residues of the chain as ligand */
+    for (a = 0; a < 4; ++a) {
+        p.alg = alg[a];
+        rec = freesasa_receptor_from_coord(xyz, r, n_rec, &p);
+        ck_assert_ptr_ne(rec, NULL);
+        free_rec = freesasa_receptor_result(rec);
+        complex = freesasa_calc_coord(xyz, r, n, &p);
+        free_lig = freesasa_calc_coord(xyz + 3*n_rec, r + n_rec, n_lig, &p);
+        pose = freesasa_receptor_calc_pose(rec, xyz + 3*n_rec, r + n_rec, n_lig);
+        ck_assert_ptr_ne(pose, NULL);
+
+        ck_assert_int_eq(pose->n_ligand, n_lig);
+        ck_assert(pose->n_contact > 0 && pose->n_contact < n_rec / 2);
+        for (i = 0; i < n_lig; ++i) {
+            ck_assert(fabs(pose->ligand_sasa[i] - complex->sasa[n_rec + i]) < 1e-8);
+        }
+        ck_assert(fabs(pose->ligand_free - free_lig->total) < 1e-8);
+        last = -1;
+        for (k = 0, i = 0; i < n_rec; ++i) {
+            delta = complex->sasa[i] - free_rec->sasa[i];
+            if (k < pose->n_contact && pose->contact[k] == i) {
+                ck_assert(i > last);
+                last = i;
+                ck_assert(fabs(pose->contact_delta[k] - delta) < 1e-8);
+                ++k;
+            } else {
+                ck_assert(fabs(delta) < 1e-8);
+            }
+        }
+        ck_assert_int_eq(k, pose->n_contact);
+        ck_assert(fabs(pose->delta_total -
+                       (complex->total - free_rec->total - free_lig->total)) < 1e-6);
+
+        freesasa_pose_result_free(pose);
+        freesasa_result_free(free_lig);
+        freesasa_result_free(complex);
+
+        /* a pose far away buries nothing */
+        for (i = 0; i < 3*n_lig; ++i) far[i] = xyz[3*n_rec + i] + (i % 3 == 0 ? 500 : 0);
+        pose = freesasa_receptor_calc_pose(rec, far, r + n_rec, n_lig);
+        ck_assert_int_eq(pose->n_contact, 0);
+        ck_assert(fabs(pose->delta_total) < 1e-8);
+        freesasa_pose_result_free(pose);
+
+        freesasa_receptor_free(rec);
+    }
+
+    /* errors */
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    p = freesasa_default_parameters;
+    rec = freesasa_receptor_from_structure(st, &p);
+    ck_assert_ptr_eq(freesasa_receptor_calc_pose(rec, xyz, r, 0), NULL);
+    freesasa_receptor_free(rec);
+    p.calc_gradient = 1;
+    ck_assert_ptr_eq(freesasa_receptor_from_structure(st, &p), NULL);
+    p.calc_gradient = 0;
+    p.target_total_error = 10;
+    ck_assert_ptr_eq(freesasa_receptor_from_structure(st, &p), NULL);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+
+    freesasa_structure_free(st);
+}
+END_TEST
+
+START_TEST (test_multi_probe)
+{
+    FILE *pdb = fopen(DATADIR "1ubq.pdb","r");
+    freesasa_structure *st = freesasa_structure_from_pdb(pdb, NULL, 0);
+    freesasa_parameters p = freesasa_default_parameters;
+    freesasa_algorithm alg[] = {FREESASA_LEE_RICHARDS, FREESASA_SHRAKE_RUPLEY};
+    double probes[] = {1.4, 0, 3.0, 0.7, 1.4}, bad[] = {1.4, -1};
+    freesasa_probe_result *multi;
+    freesasa_result *single;
+    int a, i, k, n_skipped;
+
+    fclose(pdb);
+
+    for (a = 0; a < 2; ++a) {
+        p.alg = alg[a];
+        multi = freesasa_calc_structure_probes(st, probes, 5, &p);
+        ck_assert_ptr_ne(multi, NULL);
+        ck_assert_int_eq(multi->n_probes, 5);
+        ck_assert_int_eq(multi->n_atoms, freesasa_structure_n(st));
+        n_skipped = 0;
+        for (k = 0; k < 5; ++k) {
+            ck_assert(multi->probe_radius[k] == probes[k]);
+            p.probe_radius = probes[k];
+            single = freesasa_calc_structure(st, &p);
+            ck_assert(float_eq(single->total, multi->total[k], 1e-8));
+            for (i = 0; i < single->n_atoms; ++i) {
+                ck_assert(float_eq(single->sasa[i], multi->sasa[i*5 + k], 1e-10));
+            }
+            n_skipped += single->n_skipped;
+            freesasa_result_free(single);
+        }
+        ck_assert_int_eq(n_skipped, multi->n_skipped);
+        freesasa_probe_result_free(multi);
+    }
+    // repeated probe radii give identical results
+    p.alg = FREESASA_LEE_RICHARDS;
+    multi = freesasa_calc_structure_probes(st, probes, 5, &p);
+    ck_assert(multi->total[0] == multi->total[4]);
+    freesasa_probe_result_free(multi);
+
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    ck_assert_ptr_eq(freesasa_calc_structure_probes(st, bad, 2, &p), NULL);
+    ck_assert_ptr_eq(freesasa_calc_structure_probes(st, probes, 0, &p), NULL);
+    p.alg = FREESASA_GAUSS_BONNET;
+    ck_assert_ptr_eq(freesasa_calc_structure_probes(st, probes, 2, &p), NULL);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+
+    freesasa_structure_free(st);
+}
+END_TEST
+
+START_TEST (test_buried_screen)
+{
+    FILE *pdb = fopen(DATADIR "1ubq.pdb","r");
+    freesasa_structure *st = freesasa_structure_from_pdb(pdb, NULL, 0);
+    freesasa_parameters p = freesasa_default_parameters;
+    freesasa_result *res;
+    int i, n_zero = 0;
+
+    fclose(pdb);
+
+    // skipped atoms must be a subset of the atoms with zero SASA
+    ck_assert((res = freesasa_calc_structure(st, &p)) != NULL);
+    for (i = 0; i < res->n_atoms; ++i) {
+        if (res->sasa[i] == 0) ++n_zero;
+    }
+    ck_assert_int_gt(res->n_skipped, 0);
+    ck_assert_int_le(res->n_skipped, n_zero);
+    freesasa_result_free(res);
+
+    // S&R only uses the screen at high resolution
+    p.alg = FREESASA_SHRAKE_RUPLEY;
+    ck_assert((res = freesasa_calc_structure(st, &p)) != NULL);
+    ck_assert_int_eq(res->n_skipped, 0);
+    freesasa_result_free(res);
+
+    p.shrake_rupley_n_points = 1000;
+    ck_assert((res = freesasa_calc_structure(st, &p)) != NULL);
+    ck_assert_int_gt(res->n_skipped, 0);
+    freesasa_result_free(res);
+
+    p.alg = FREESASA_GAUSS_BONNET;
+    ck_assert((res = freesasa_calc_structure(st, &p)) != NULL);
+    ck_assert_int_eq(res->n_skipped, 0);
+    freesasa_result_free(res);
+
+    freesasa_structure_free(st);
+}
+END_TEST
+
 // test an NMR structure with hydrogens and several models
 START_TEST (test_1d3z)
 {
@@ -518,6 +1804,9 @@ START_TEST (test_memerr)
 END_TEST
 
 extern TCase * test_LR_static();
+extern TCase * test_GB_static();
+extern TCase * test_LCPO_static();
+extern TCase * test_buried_static();
 
 Suite *sasa_suite()
 {
@@ -540,6 +1829,12 @@ Suite *sasa_suite()
     tcase_add_checked_fixture(tc_sr_basic,setup_sr_precision,teardown_sr_precision);
     tcase_add_test(tc_sr_basic, test_sasa_alg_basic);
 
+    TCase *tc_gb_basic = tcase_create("Basic Gauss-Bonnet");
+    tcase_add_checked_fixture(tc_gb_basic,setup_gb_precision,teardown_gb_precision);
+    tcase_add_test(tc_gb_basic, test_sasa_alg_basic);
+
+    TCase *tc_gb_static = test_GB_static();
+
     TCase *tc_lr = tcase_create("1UBQ-L&R");
     tcase_add_checked_fixture(tc_lr,setup_lr,teardown_lr);
     tcase_add_test(tc_lr, test_sasa_1ubq);
@@ -548,6 +1843,61 @@ Suite *sasa_suite()
     tcase_add_checked_fixture(tc_sr,setup_sr,teardown_sr);
     tcase_add_test(tc_sr, test_sasa_1ubq);
 
+    TCase *tc_gb = tcase_create("1UBQ-Gauss-Bonnet");
+    tcase_add_checked_fixture(tc_gb,setup_gb,teardown_gb);
+    tcase_add_test(tc_gb, test_sasa_1ubq);
+
+    TCase *tc_lcpo_static = test_LCPO_static();
+
+    TCase *tc_adaptive = tcase_create("Adaptive resolution");
+    tcase_add_test(tc_adaptive, test_adaptive);
+    tcase_add_test(tc_adaptive, test_adaptive_converge);
+    tcase_set_timeout(tc_adaptive, 30);
+
+    TCase *tc_buried = tcase_create("Buried atoms");
+    tcase_add_test(tc_buried, test_buried_screen);
+
+    TCase *tc_gradient = tcase_create("Gradients");
+    tcase_add_test(tc_gradient, test_gradient);
+
+    TCase *tc_dots = tcase_create("Surface dots");
+    tcase_add_test(tc_dots, test_surface_dots);
+
+    TCase *tc_batch = tcase_create("Batch calculation");
+    tcase_add_test(tc_batch, test_batch);
+
+    TCase *tc_structures = tcase_create("Several structures");
+    tcase_add_test(tc_structures, test_calc_structures);
+
+    TCase *tc_strided = tcase_create("Strided coordinates");
+    tcase_add_test(tc_strided, test_strided);
+
+    TCase *tc_async = tcase_create("Asynchronous calculation");
+    tcase_add_test(tc_async, test_async);
+
+    TCase *tc_symmetry = tcase_create("Symmetric assemblies");
+    tcase_add_test(tc_symmetry, test_symmetry);
+
+    TCase *tc_periodic = tcase_create("Periodic boundary conditions");
+    tcase_add_test(tc_periodic, test_periodic);
+
+    TCase *tc_slabs = tcase_create("Slab calculation");
+    tcase_add_test(tc_slabs, test_slabs);
+
+
+    TCase *tc_receptor = tcase_create("Receptor and ligand poses");
+    tcase_add_test(tc_receptor, test_receptor);
+
+    TCase *tc_multi_probe = tcase_create("Multiple probe radii");
+    tcase_add_test(tc_multi_probe, test_multi_probe);
+
+    TCase *tc_buried_static = test_buried_static();
+
+    TCase *tc_lcpo = tcase_create("1UBQ-LCPO");
+    tcase_add_checked_fixture(tc_lcpo,setup_lcpo,teardown_lcpo);
+    tcase_add_test(tc_lcpo, test_sasa_1ubq);
+    tcase_add_test(tc_lcpo, test_lcpo_accuracy);
+
     TCase *tc_trimmed = tcase_create("Trimmed PDB file");
     tcase_add_test(tc_trimmed, test_trimmed_pdb);
 
@@ -560,6 +1910,25 @@ Suite *sasa_suite()
     suite_add_tcase(s, tc_sr_basic);
     suite_add_tcase(s, tc_lr);
     suite_add_tcase(s, tc_sr);
+    suite_add_tcase(s, tc_gb_basic);
+    suite_add_tcase(s, tc_gb_static);
+    suite_add_tcase(s, tc_gb);
+    suite_add_tcase(s, tc_lcpo_static);
+    suite_add_tcase(s, tc_lcpo);
+    suite_add_tcase(s, tc_adaptive);
+    suite_add_tcase(s, tc_buried_static);
+    suite_add_tcase(s, tc_buried);
+    suite_add_tcase(s, tc_gradient);
+    suite_add_tcase(s, tc_dots);
+    suite_add_tcase(s, tc_batch);
+    suite_add_tcase(s, tc_structures);
+    suite_add_tcase(s, tc_strided);
+    suite_add_tcase(s, tc_async);
+    suite_add_tcase(s, tc_symmetry);
+    suite_add_tcase(s, tc_periodic);
+    suite_add_tcase(s, tc_slabs);
+    suite_add_tcase(s, tc_receptor);
+    suite_add_tcase(s, tc_multi_probe);
     suite_add_tcase(s, tc_trimmed);
     suite_add_tcase(s, tc_1d3z);
 
@@ -567,6 +1936,7 @@ Suite *sasa_suite()
     printf("Using pthread\n");
     TCase *tc_pthr = tcase_create("Pthread");
     tcase_add_test(tc_pthr,test_multi_calc);
+    tcase_add_test(tc_pthr,test_numa);
     suite_add_tcase(s, tc_pthr);
 #endif
     return s;
@@ -25,6 +25,35 @@ START_TEST (test_nb)
 }
 END_TEST
 
+START_TEST (test_nb_refill)
+{
+    coord_t *coord = freesasa_coord_new_linked(v, 6);
+    nb_list *ref = freesasa_nb_new(coord, r), *nb = freesasa_nb_alloc(6);
+    int i, j;
+
+    ck_assert(nb != NULL);
+    ck_assert_int_eq(freesasa_nb_refill(nb, coord, r), FREESASA_SUCCESS);
+    for (i = 0; i < 6; ++i) {
+        ck_assert_int_eq(nb->nn[i], ref->nn[i]);
+        for (j = 0; j < 6; ++j) {
+            if (i == j) continue;
+            ck_assert_int_eq(freesasa_nb_contact(nb, i, j), freesasa_nb_contact(ref, i, j));
+        }
+    }
+
+    /* reuse for a subset */
+    freesasa_coord_relink(coord, v + 3, 2);
+    ck_assert_int_eq(freesasa_nb_refill(nb, coord, r), FREESASA_SUCCESS);
+    ck_assert_int_eq(nb->nn[0], 1);
+    ck_assert_int_eq(nb->nb[0][0], 1);
+    for (i = 2; i < 6; ++i) ck_assert_int_eq(nb->nn[i], 0);
+
+    freesasa_nb_free(nb);
+    freesasa_nb_free(ref);
+    freesasa_coord_free(coord);
+}
+END_TEST
+
 START_TEST (test_memerr)
 {
     freesasa_set_verbosity(FREESASA_V_SILENT);
@@ -49,6 +78,7 @@ Suite* nb_suite() {
 
     TCase *tc_nb = tcase_create("Basic");
     tcase_add_test(tc_nb,test_nb);
+    tcase_add_test(tc_nb,test_nb_refill);
     tcase_add_test(tc_nb,test_memerr);
 
     TCase *tc_static = test_nb_static();
@@ -1,4 +1,5 @@
 #include <check.h>
+#include <stdlib.h>
 #include <freesasa.h>
 #include <freesasa_internal.h>
 #include "tools.h"
@@ -98,6 +99,94 @@ START_TEST (test_result_node)
 }
 END_TEST
 
+// compare two trees node by node
+static void
+cmp_tree(freesasa_node *a, freesasa_node *b)
+{
+    const freesasa_nodearea *aa, *ab;
+
+    while (a != NULL) {
+        ck_assert_ptr_ne(b, NULL);
+        ck_assert_int_eq(freesasa_node_type(a), freesasa_node_type(b));
+        if (freesasa_node_name(a) != NULL) {
+            ck_assert_str_eq(freesasa_node_name(a), freesasa_node_name(b));
+        }
+        if (freesasa_node_type(a) < FREESASA_NODE_RESULT) {
+            aa = freesasa_node_area(a);
+            ab = freesasa_node_area(b);
+            ck_assert_ptr_ne(aa, NULL);
+            ck_assert_ptr_ne(ab, NULL);
+            ck_assert(float_eq(aa->total, ab->total, 1e-10));
+            ck_assert(float_eq(aa->polar, ab->polar, 1e-10));
+            ck_assert(float_eq(aa->main_chain, ab->main_chain, 1e-10));
+        }
+        cmp_tree(freesasa_node_children(a), freesasa_node_children(b));
+        a = freesasa_node_next(a);
+        b = freesasa_node_next(b);
+    }
+    ck_assert_ptr_eq(b, NULL);
+}
+
+// PDB output of a tree as a string
+static char *
+pdb_output(freesasa_node *tree)
+{
+    FILE *tf = tmpfile();
+    char *buf;
+    long n;
+
+    ck_assert_ptr_ne(tf, NULL);
+    ck_assert_int_eq(freesasa_tree_export(tf, tree, FREESASA_PDB), FREESASA_SUCCESS);
+    n = ftell(tf);
+    ck_assert_int_gt(n, 0);
+    buf = malloc(n + 1);
+    ck_assert_ptr_ne(buf, NULL);
+    rewind(tf);
+    ck_assert_int_eq(fread(buf, 1, n, tf), n);
+    buf[n] = '\0';
+    fclose(tf);
+
+    return buf;
+}
+
+START_TEST (test_parallel_tree)
+{
+    FILE *file = fopen(DATADIR "1a0q.pdb","r");
+    freesasa_structure *structure = freesasa_structure_from_pdb(file, NULL, 0);
+    freesasa_parameters param = freesasa_default_parameters;
+    freesasa_result *result;
+    freesasa_node *serial, *parallel;
+    char *ref, *out;
+
+    fclose(file);
+    ck_assert_ptr_ne(structure, NULL);
+    ck_assert_int_gt(freesasa_structure_n_chains(structure), 1);
+    param.n_threads = 1;
+    result = freesasa_calc_structure(structure, &param);
+    ck_assert_ptr_ne(result, NULL);
+
+    serial = freesasa_tree_init(result, structure, "test");
+    ck_assert_ptr_ne(serial, NULL);
+    ref = pdb_output(serial);
+
+    // the tree is built and written in blocks when the result has
+    // several threads
+    result->parameters.n_threads = 4;
+    parallel = freesasa_tree_init(result, structure, "test");
+    ck_assert_ptr_ne(parallel, NULL);
+    cmp_tree(serial, parallel);
+    out = pdb_output(parallel);
+    ck_assert_str_eq(ref, out);
+
+    free(ref);
+    free(out);
+    freesasa_node_free(serial);
+    freesasa_node_free(parallel);
+    freesasa_result_free(result);
+    freesasa_structure_free(structure);
+}
+END_TEST
+
 START_TEST (test_memerr) {
     FILE *file = fopen(DATADIR "1ubq.pdb","r");
     freesasa_structure *structure = freesasa_structure_from_pdb(file, NULL, 0);
@@ -123,6 +212,7 @@ Suite* result_node_suite() {
 
     TCase *tc_core = tcase_create("Core");
     tcase_add_test(tc_core, test_result_node);
+    tcase_add_test(tc_core, test_parallel_tree);
     tcase_add_test(tc_core, test_memerr);
 
     suite_add_tcase(s, tc_core);
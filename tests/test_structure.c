@@ -1,7 +1,14 @@
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
 #include <stdlib.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 #include <check.h>
+#if USE_ZLIB
+# include <zlib.h>
+#endif
 #include <freesasa.h>
 #include <freesasa_internal.h>
 #include <pdb.h>
@@ -405,6 +412,220 @@ START_TEST (test_get_chains) {
 }
 END_TEST
 
+START_TEST (test_views)
+{
+    FILE *pdb = fopen(DATADIR "2jo4.pdb","r");
+    freesasa_structure *s = freesasa_structure_from_pdb(pdb, NULL, 0);
+    freesasa_structure *copy, *view, *view2;
+    freesasa_result *r1, *r2;
+    freesasa_node *tree;
+    int i, first, last;
+
+    fclose(pdb);
+
+    /* a single chain shares all atom data with the parent */
+    view = freesasa_structure_view_chains(s, "B");
+    ck_assert_ptr_ne(view, NULL);
+    ck_assert_int_eq(freesasa_structure_n(view), 129);
+    ck_assert_str_eq(freesasa_structure_chain_labels(view), "B");
+    ck_assert_ptr_eq(freesasa_structure_coord_array(view), freesasa_structure_coord_array(s) + 3*129);
+    ck_assert_ptr_eq(freesasa_structure_radius(view), freesasa_structure_radius(s) + 129);
+    ck_assert_ptr_eq(freesasa_structure_atom_name(view, 0), freesasa_structure_atom_name(s, 129));
+    ck_assert_int_eq(freesasa_structure_chain_residues(view, 'B', &first, &last), FREESASA_SUCCESS);
+    ck_assert_int_eq(first, 0);
+    ck_assert_int_eq(last, freesasa_structure_n_residues(view) - 1);
+    ck_assert_int_eq(freesasa_structure_model(view), freesasa_structure_model(s));
+
+    /* same results as a copy */
+    copy = freesasa_structure_get_chains(s, "B", NULL, 0);
+    ck_assert_int_eq(freesasa_structure_n_residues(view), freesasa_structure_n_residues(copy));
+    for (i = 0; i < freesasa_structure_n_residues(view); ++i) {
+        ck_assert_str_eq(freesasa_structure_residue_number(view, i),
+                         freesasa_structure_residue_number(copy, i));
+        ck_assert_ptr_eq(freesasa_structure_residue_reference(view, i),
+                         freesasa_structure_residue_reference(s, i + freesasa_structure_n_residues(view)));
+    }
+    r1 = freesasa_calc_structure(view, NULL);
+    r2 = freesasa_calc_structure(copy, NULL);
+    ck_assert(float_eq(r1->total, r2->total, 1e-10));
+    freesasa_result_free(r1);
+    freesasa_result_free(r2);
+    freesasa_structure_free(copy);
+
+    /* atoms can't be added to the view or the parent */
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    ck_assert_int_eq(freesasa_structure_add_atom(view, " C  ", "ALA", "   1", 'B', 0, 0, 0),
+                     FREESASA_FAIL);
+    ck_assert_int_eq(freesasa_structure_add_atom(s, " C  ", "ALA", "   1", 'E', 0, 0, 0),
+                     FREESASA_FAIL);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+    ck_assert_int_eq(freesasa_structure_n(s), 4*129);
+
+    /* neighboring chains are shared, others copied */
+    view2 = freesasa_structure_view_chains(s, "CB");
+    ck_assert_str_eq(freesasa_structure_chain_labels(view2), "BC");
+    ck_assert_ptr_eq(freesasa_structure_coord_array(view2), freesasa_structure_coord_array(s) + 3*129);
+    freesasa_structure_free(view2);
+    view2 = freesasa_structure_view_chains(s, "AC");
+    ck_assert_int_eq(freesasa_structure_n(view2), 2*129);
+    ck_assert_str_eq(freesasa_structure_chain_labels(view2), "AC");
+    ck_assert(freesasa_structure_atom_chain(view2, 128) == 'A');
+    ck_assert(freesasa_structure_atom_chain(view2, 129) == 'C');
+    ck_assert_int_eq(freesasa_structure_chain_atoms(view2, 'C', &first, &last), FREESASA_SUCCESS);
+    ck_assert_int_eq(first, 129);
+    ck_assert_int_eq(last, 2*129-1);
+    ck_assert_int_eq(freesasa_structure_n_residues(view2), 2*freesasa_structure_n_residues(view));
+    copy = freesasa_structure_get_chains(s, "AC", NULL, 0);
+    r1 = freesasa_calc_structure(view2, NULL);
+    r2 = freesasa_calc_structure(copy, NULL);
+    ck_assert(float_eq(r1->total, r2->total, 1e-10));
+    freesasa_result_free(r1);
+    freesasa_result_free(r2);
+    freesasa_structure_free(copy);
+
+    /* the views outlive the parent */
+    freesasa_structure_free(s);
+    tree = freesasa_calc_tree(view2, NULL, "view");
+    ck_assert_ptr_ne(tree, NULL);
+    freesasa_node_free(tree);
+
+    /* views of views, and atom ranges splitting residues */
+    freesasa_structure_free(view);
+    view = freesasa_structure_view_atoms(view2, 130, 2*129-1);
+    ck_assert_int_eq(freesasa_structure_n(view), 128);
+    ck_assert_str_eq(freesasa_structure_chain_labels(view), "C");
+    ck_assert_int_eq(freesasa_structure_n_residues(view), freesasa_structure_n_residues(view2) / 2);
+    ck_assert_str_eq(freesasa_structure_atom_name(view, 0), freesasa_structure_atom_name(view2, 130));
+    freesasa_structure_free(view2);
+    r1 = freesasa_calc_structure(view, NULL);
+    ck_assert_ptr_ne(r1, NULL);
+    freesasa_result_free(r1);
+    freesasa_structure_free(view);
+
+    /* errors */
+    pdb = fopen(DATADIR "2jo4.pdb","r");
+    s = freesasa_structure_from_pdb(pdb, NULL, 0);
+    fclose(pdb);
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    ck_assert_ptr_eq(freesasa_structure_view_chains(s, ""), NULL);
+    ck_assert_ptr_eq(freesasa_structure_view_chains(s, "E"), NULL);
+    ck_assert_ptr_eq(freesasa_structure_view_chains(s, "AE"), NULL);
+    ck_assert_ptr_eq(freesasa_structure_view_atoms(s, -1, 10), NULL);
+    ck_assert_ptr_eq(freesasa_structure_view_atoms(s, 10, 9), NULL);
+    ck_assert_ptr_eq(freesasa_structure_view_atoms(s, 0, 4*129), NULL);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+    /* no views left, so atoms can be added again */
+    ck_assert_int_eq(freesasa_structure_add_atom(s, " C  ", "ALA", "   1", 'E', 0, 0, 0),
+                     FREESASA_SUCCESS);
+    freesasa_structure_free(s);
+}
+END_TEST
+
+START_TEST (test_from_arrays)
+{
+    FILE *pdb = fopen(DATADIR "1ubq.pdb","r");
+    freesasa_structure *ref = freesasa_structure_from_pdb(pdb, NULL, 0), *s;
+    const int n = freesasa_structure_n(ref);
+    const char **names = malloc(sizeof(char*) * n), **res_names = malloc(sizeof(char*) * n),
+        **res_numbers = malloc(sizeof(char*) * n);
+    char *chains = malloc(n);
+    double *radii = malloc(sizeof(double) * n);
+    freesasa_atom_class *classes = malloc(sizeof(freesasa_atom_class) * n);
+    const char *short_name[2] = {"CA", "XX"}, *ala[2] = {"ALA", "ALA"}, *one[2] = {"1", "1"};
+    const double xyz2[6] = {0, 0, 0, 5, 0, 0}, bad_radii[2] = {1, -1};
+    freesasa_result *r1, *r2;
+    int i;
+
+    fclose(pdb);
+    for (i = 0; i < n; ++i) {
+        names[i] = freesasa_structure_atom_name(ref, i);
+        res_names[i] = freesasa_structure_atom_res_name(ref, i);
+        res_numbers[i] = freesasa_structure_atom_res_number(ref, i);
+        chains[i] = freesasa_structure_atom_chain(ref, i);
+        radii[i] = 1.5;
+        classes[i] = FREESASA_ATOM_POLAR;
+    }
+
+    /* same as a parsed structure */
+    s = freesasa_structure_from_arrays(n, names, res_names, res_numbers, chains,
+                                       freesasa_structure_coord_array(ref),
+                                       NULL, NULL, NULL, 0);
+    ck_assert_ptr_ne(s, NULL);
+    ck_assert_int_eq(freesasa_structure_n(s), n);
+    ck_assert_int_eq(freesasa_structure_n_residues(s), freesasa_structure_n_residues(ref));
+    ck_assert_str_eq(freesasa_structure_chain_labels(s), freesasa_structure_chain_labels(ref));
+    ck_assert_str_eq(freesasa_structure_classifier_name(s), freesasa_structure_classifier_name(ref));
+    for (i = 0; i < n; ++i) {
+        ck_assert(freesasa_structure_atom_radius(s, i) == freesasa_structure_atom_radius(ref, i));
+        ck_assert_int_eq(freesasa_structure_atom_class(s, i), freesasa_structure_atom_class(ref, i));
+        ck_assert_str_eq(freesasa_structure_atom_symbol(s, i), freesasa_structure_atom_symbol(ref, i));
+        ck_assert_str_eq(freesasa_structure_atom_name(s, i), names[i]);
+        ck_assert_ptr_ne(freesasa_structure_atom_name(s, i), names[i]);
+    }
+    for (i = 0; i < freesasa_structure_n_residues(s); ++i) {
+        ck_assert_str_eq(freesasa_structure_residue_name(s, i), freesasa_structure_residue_name(ref, i));
+        ck_assert(freesasa_structure_residue_reference(ref, i) == NULL ||
+                  freesasa_structure_residue_reference(s, i)->total ==
+                  freesasa_structure_residue_reference(ref, i)->total);
+    }
+    r1 = freesasa_calc_structure(s, NULL);
+    r2 = freesasa_calc_structure(ref, NULL);
+    ck_assert(float_eq(r1->total, r2->total, 1e-10));
+    freesasa_result_free(r1);
+    freesasa_result_free(r2);
+
+    /* atoms can still be added */
+    ck_assert_int_eq(freesasa_structure_add_atom(s, " C  ", "ALA", "   1", 'B', 0, 0, 0),
+                     FREESASA_SUCCESS);
+    ck_assert_int_eq(freesasa_structure_n(s), n + 1);
+    freesasa_structure_free(s);
+
+    /* given radii and classes */
+    s = freesasa_structure_from_arrays(n, names, res_names, res_numbers, chains,
+                                       freesasa_structure_coord_array(ref),
+                                       radii, classes, NULL, 0);
+    for (i = 0; i < n; ++i) {
+        ck_assert(freesasa_structure_atom_radius(s, i) == 1.5);
+        ck_assert_int_eq(freesasa_structure_atom_class(s, i), FREESASA_ATOM_POLAR);
+    }
+    freesasa_structure_free(s);
+
+    /* short names, unknown atoms */
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    s = freesasa_structure_from_arrays(2, short_name, ala, one, "AA", xyz2, NULL, NULL, NULL, 0);
+    ck_assert_int_eq(freesasa_structure_n(s), 2);
+    ck_assert_int_eq(freesasa_structure_n_residues(s), 1);
+    ck_assert_str_eq(freesasa_structure_atom_symbol(s, 0), " C");
+    ck_assert(freesasa_structure_atom_radius(s, 0) == freesasa_structure_atom_radius(ref, 1));
+    freesasa_structure_free(s);
+    s = freesasa_structure_from_arrays(2, short_name, ala, one, "AA", xyz2, NULL, NULL, NULL,
+                                       FREESASA_SKIP_UNKNOWN);
+    ck_assert_int_eq(freesasa_structure_n(s), 1);
+    freesasa_structure_free(s);
+    ck_assert_ptr_eq(freesasa_structure_from_arrays(2, short_name, ala, one, "AA", xyz2,
+                                                    NULL, NULL, NULL, FREESASA_HALT_AT_UNKNOWN),
+                     NULL);
+    ck_assert_ptr_eq(freesasa_structure_from_arrays(1, short_name + 1, ala, one, "A", xyz2,
+                                                    NULL, NULL, NULL, FREESASA_SKIP_UNKNOWN),
+                     NULL);
+    ck_assert_ptr_eq(freesasa_structure_from_arrays(2, short_name, ala, one, "AA", xyz2,
+                                                    bad_radii, NULL, NULL, 0),
+                     NULL);
+    ck_assert_ptr_eq(freesasa_structure_from_arrays(0, short_name, ala, one, "AA", xyz2,
+                                                    NULL, NULL, NULL, 0),
+                     NULL);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+
+    freesasa_structure_free(ref);
+    free(names);
+    free(res_names);
+    free(res_numbers);
+    free(chains);
+    free(radii);
+    free(classes);
+}
+END_TEST
+
 START_TEST (test_occupancy)
 {
     FILE *pdb = fopen(DATADIR "1ubq.occ.pdb", "r");
@@ -423,6 +644,311 @@ START_TEST (test_occupancy)
 END_TEST
 
 
+START_TEST (test_from_pdb_parallel)
+{
+    const char *files[] = {DATADIR "1a0q.pdb", DATADIR "2jo4.pdb", DATADIR "1ubq.occ.pdb"};
+    const int options[] = {FREESASA_INCLUDE_HETATM | FREESASA_INCLUDE_HYDROGEN,
+                           FREESASA_JOIN_MODELS,
+                           FREESASA_RADIUS_FROM_OCCUPANCY};
+    const int threads[] = {2, 3, 8};
+    freesasa_structure *ref, *s;
+    const double *x1, *x2;
+    FILE *pdb, *tf;
+    char line[PDB_MAX_LINE_STRL];
+    int f, t, i, n;
+
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    for (f = 0; f < 3; ++f) {
+        pdb = fopen(files[f], "r");
+        ck_assert_ptr_ne(pdb, NULL);
+        ref = freesasa_structure_from_pdb(pdb, NULL, options[f]);
+        ck_assert_ptr_ne(ref, NULL);
+        n = freesasa_structure_n(ref);
+        for (t = 0; t < 3; ++t) {
+            s = freesasa_structure_from_pdb_parallel(pdb, NULL, options[f], threads[t]);
+            ck_assert_ptr_ne(s, NULL);
+            ck_assert_int_eq(freesasa_structure_n(s), n);
+            ck_assert_int_eq(freesasa_structure_n_residues(s), freesasa_structure_n_residues(ref));
+            ck_assert_int_eq(freesasa_structure_model(s), freesasa_structure_model(ref));
+            ck_assert_str_eq(freesasa_structure_chain_labels(s), freesasa_structure_chain_labels(ref));
+            x1 = freesasa_structure_coord_array(ref);
+            x2 = freesasa_structure_coord_array(s);
+            for (i = 0; i < n; ++i) {
+                ck_assert_str_eq(freesasa_structure_atom_name(s, i), freesasa_structure_atom_name(ref, i));
+                ck_assert_str_eq(freesasa_structure_atom_symbol(s, i), freesasa_structure_atom_symbol(ref, i));
+                ck_assert_str_eq(freesasa_structure_atom_pdb_line(s, i), freesasa_structure_atom_pdb_line(ref, i));
+                ck_assert_int_eq(freesasa_structure_atom_class(s, i), freesasa_structure_atom_class(ref, i));
+                ck_assert(freesasa_structure_atom_radius(s, i) == freesasa_structure_atom_radius(ref, i));
+                ck_assert(x1[3*i] == x2[3*i] && x1[3*i+1] == x2[3*i+1] && x1[3*i+2] == x2[3*i+2]);
+            }
+            for (i = 0; i < freesasa_structure_n_residues(s); ++i) {
+                ck_assert_str_eq(freesasa_structure_residue_number(s, i),
+                                 freesasa_structure_residue_number(ref, i));
+            }
+            freesasa_structure_free(s);
+        }
+        freesasa_structure_free(ref);
+        fclose(pdb);
+    }
+
+    /* an atom without occupancy is an error, wherever it is */
+    pdb = fopen(DATADIR "1ubq.pdb", "r");
+    tf = tmpfile();
+    ck_assert_ptr_ne(pdb, NULL);
+    ck_assert_ptr_ne(tf, NULL);
+    n = 0;
+    while (fgets(line, PDB_MAX_LINE_STRL, pdb)) {
+        if (strncmp(line, "ATOM", 4) == 0 && ++n == 500) {
+            line[54] = '\0';
+            fprintf(tf, "%s\n", line);
+        } else {
+            fputs(line, tf);
+        }
+    }
+    fclose(pdb);
+    ck_assert_ptr_eq(freesasa_structure_from_pdb_parallel(tf, NULL, FREESASA_RADIUS_FROM_OCCUPANCY, 2), NULL);
+    ck_assert_ptr_eq(freesasa_structure_from_pdb(tf, NULL, FREESASA_RADIUS_FROM_OCCUPANCY), NULL);
+    s = freesasa_structure_from_pdb_parallel(tf, NULL, 0, 2);
+    ck_assert_ptr_ne(s, NULL);
+    ck_assert_int_eq(freesasa_structure_n(s), 602);
+    freesasa_structure_free(s);
+    fclose(tf);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+}
+END_TEST
+
+
+static void
+append_file(FILE *out, const char *path)
+{
+    FILE *in = fopen(path, "r");
+    char line[PDB_MAX_LINE_STRL];
+
+    ck_assert_ptr_ne(in, NULL);
+    while (fgets(line, PDB_MAX_LINE_STRL, in)) fputs(line, out);
+    fclose(in);
+}
+
+static void
+assert_same_structure(const freesasa_structure *s1, const freesasa_structure *s2)
+{
+    int i;
+
+    ck_assert_int_eq(freesasa_structure_n(s1), freesasa_structure_n(s2));
+    ck_assert_int_eq(freesasa_structure_n_residues(s1), freesasa_structure_n_residues(s2));
+    ck_assert_int_eq(freesasa_structure_model(s1), freesasa_structure_model(s2));
+    ck_assert_str_eq(freesasa_structure_chain_labels(s1), freesasa_structure_chain_labels(s2));
+    for (i = 0; i < freesasa_structure_n(s1); ++i) {
+        ck_assert_str_eq(freesasa_structure_atom_pdb_line(s1, i), freesasa_structure_atom_pdb_line(s2, i));
+        ck_assert(freesasa_structure_atom_radius(s1, i) == freesasa_structure_atom_radius(s2, i));
+    }
+}
+
+START_TEST (test_structure_stream)
+{
+    const char *files[] = {DATADIR "1ubq.pdb", DATADIR "2jo4.pdb", DATADIR "1a0q.pdb"};
+    const int options[] = {0, FREESASA_JOIN_MODELS, FREESASA_SEPARATE_MODELS,
+                           FREESASA_SEPARATE_CHAINS,
+                           FREESASA_SEPARATE_MODELS | FREESASA_SEPARATE_CHAINS};
+    FILE *cat = tmpfile(), *pdb;
+    freesasa_structure_stream *stream;
+    freesasa_structure *s, *ref, **ss;
+    int f, o, i, n;
+
+    ck_assert_ptr_ne(cat, NULL);
+    for (f = 0; f < 3; ++f) append_file(cat, files[f]);
+
+    /* the stream gives the same structures as the files one by one */
+    for (o = 0; o < 5; ++o) {
+        rewind(cat);
+        stream = freesasa_structure_stream_new(cat, NULL, options[o], 2);
+        ck_assert_ptr_ne(stream, NULL);
+        for (f = 0; f < 3; ++f) {
+            pdb = fopen(files[f], "r");
+            ck_assert_ptr_ne(pdb, NULL);
+            if (options[o] & (FREESASA_SEPARATE_MODELS | FREESASA_SEPARATE_CHAINS)) {
+                ss = freesasa_structure_array(pdb, &n, NULL, options[o]);
+            } else {
+                ss = malloc(sizeof(freesasa_structure *));
+                ss[0] = freesasa_structure_from_pdb(pdb, NULL, options[o]);
+                n = 1;
+            }
+            ck_assert_ptr_ne(ss, NULL);
+            fclose(pdb);
+            for (i = 0; i < n; ++i) {
+                ref = ss[i];
+                ck_assert_int_eq(freesasa_structure_stream_next(stream, &s), 1);
+                ck_assert_ptr_ne(s, NULL);
+                assert_same_structure(s, ref);
+                freesasa_structure_free(s);
+                freesasa_structure_free(ref);
+            }
+            free(ss);
+        }
+        ck_assert_int_eq(freesasa_structure_stream_next(stream, &s), 0);
+        ck_assert_ptr_eq(s, NULL);
+        ck_assert_int_eq(freesasa_structure_stream_next(stream, &s), 0);
+        freesasa_structure_stream_free(stream);
+    }
+
+    /* input without atoms gives no structures, invalid input fails */
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    pdb = fopen(DATADIR "empty.pdb", "r");
+    ck_assert_ptr_ne(pdb, NULL);
+    stream = freesasa_structure_stream_new(pdb, NULL, 0, 1);
+    ck_assert_int_eq(freesasa_structure_stream_next(stream, &s), 0);
+    freesasa_structure_stream_free(stream);
+    fclose(pdb);
+
+    rewind(cat);
+    fputs("ATOM      1  N   MET A   1      xx.xxx  28.080  13.464  1.00  0.00           N\n", cat);
+    rewind(cat);
+    stream = freesasa_structure_stream_new(cat, NULL, 0, 1);
+    ck_assert_int_eq(freesasa_structure_stream_next(stream, &s), FREESASA_FAIL);
+    ck_assert_ptr_eq(s, NULL);
+    freesasa_structure_stream_free(stream);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+
+    fclose(cat);
+}
+END_TEST
+
+#if USE_ZLIB
+/* append the file as a gzip member */
+static void
+gzip_append(FILE *out, const char *path)
+{
+    FILE *in = fopen(path, "r");
+    unsigned char buf[4096], zbuf[4096];
+    z_stream z;
+    int flush;
+
+    ck_assert_ptr_ne(in, NULL);
+    memset(&z, 0, sizeof(z));
+    ck_assert_int_eq(deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16,
+                                  8, Z_DEFAULT_STRATEGY), Z_OK);
+    do {
+        z.avail_in = fread(buf, 1, sizeof(buf), in);
+        z.next_in = buf;
+        flush = feof(in) ? Z_FINISH : Z_NO_FLUSH;
+        do {
+            z.avail_out = sizeof(zbuf);
+            z.next_out = zbuf;
+            deflate(&z, flush);
+            fwrite(zbuf, 1, sizeof(zbuf) - z.avail_out, out);
+        } while (z.avail_out == 0);
+    } while (flush != Z_FINISH);
+    deflateEnd(&z);
+    fclose(in);
+}
+#endif
+
+START_TEST (test_decompress)
+{
+    const char *files[] = {DATADIR "1ubq.pdb", DATADIR "2jo4.pdb"};
+    FILE *pdb = fopen(files[0], "r"), *gz = tmpfile(), *text = tmpfile(), *in;
+    freesasa_structure_stream *stream;
+    freesasa_structure *s, *ref;
+    int f, n_threads;
+#if USE_ZLIB
+    FILE *trunc = tmpfile();
+    char buf[1000];
+    long size;
+    int ret;
+#endif
+
+    ck_assert_ptr_ne(pdb, NULL);
+    ck_assert_ptr_ne(gz, NULL);
+
+    /* uncompressed input is read as it is */
+    ck_assert_ptr_eq(freesasa_decompress(pdb, 2), pdb);
+    s = freesasa_structure_from_pdb(pdb, NULL, 0);
+    ck_assert_int_eq(freesasa_structure_n(s), 602);
+    freesasa_structure_free(s);
+    fclose(pdb);
+
+    /* only the whole magic number marks compressed input */
+    ck_assert_ptr_ne(text, NULL);
+    fputs("\x1f\x8a(\xb5/", text);
+    rewind(text);
+    ck_assert_ptr_eq(freesasa_decompress(text, 1), text);
+    ck_assert_int_eq(getc(text), 0x1f);
+    ck_assert_int_eq(getc(text), 0x8a);
+    ck_assert_int_eq(fseek(text, 2, SEEK_SET), 0);
+    ck_assert_ptr_eq(freesasa_decompress(text, 1), text);
+    ck_assert_int_eq(getc(text), '(');
+    ck_assert_int_eq(fseek(text, 4, SEEK_SET), 0);
+    ck_assert_ptr_eq(freesasa_decompress(text, 1), text);
+    ck_assert_int_eq(getc(text), '/');
+    fclose(text);
+
+#if USE_ZLIB
+    /* concatenated gzip members give the same structures as the
+       files one by one */
+    for (f = 0; f < 2; ++f) gzip_append(gz, files[f]);
+    for (n_threads = 1; n_threads <= 2; ++n_threads) {
+        rewind(gz);
+        in = freesasa_decompress(gz, n_threads);
+        ck_assert_ptr_ne(in, NULL);
+        ck_assert_ptr_ne(in, gz);
+        stream = freesasa_structure_stream_new(in, NULL, 0, n_threads);
+        for (f = 0; f < 2; ++f) {
+            pdb = fopen(files[f], "r");
+            ref = freesasa_structure_from_pdb(pdb, NULL, 0);
+            fclose(pdb);
+            ck_assert_int_eq(freesasa_structure_stream_next(stream, &s), 1);
+            assert_same_structure(s, ref);
+            freesasa_structure_free(s);
+            freesasa_structure_free(ref);
+        }
+        ck_assert_int_eq(freesasa_structure_stream_next(stream, &s), 0);
+        freesasa_structure_stream_free(stream);
+        /* doesn't close the compressed input */
+        ck_assert_int_eq(fclose(in), 0);
+        ck_assert_int_eq(fseek(gz, 0, SEEK_SET), 0);
+    }
+
+    /* truncated input is an error */
+    ck_assert_ptr_ne(trunc, NULL);
+    fseek(gz, 0, SEEK_END);
+    size = ftell(gz) - 100;
+    rewind(gz);
+    while (size > 0) {
+        f = fread(buf, 1, size < 1000 ? size : 1000, gz);
+        fwrite(buf, 1, f, trunc);
+        size -= f;
+    }
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    for (n_threads = 1; n_threads <= 2; ++n_threads) {
+        rewind(trunc);
+        in = freesasa_decompress(trunc, n_threads);
+        ck_assert_ptr_ne(in, NULL);
+        stream = freesasa_structure_stream_new(in, NULL, 0, 1);
+        while ((ret = freesasa_structure_stream_next(stream, &s)) == 1) {
+            freesasa_structure_free(s);
+        }
+        ck_assert_int_eq(ret, FREESASA_FAIL);
+        freesasa_structure_stream_free(stream);
+        fclose(in);
+    }
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+    fclose(trunc);
+#else
+    /* compressed input is not supported */
+    (void) f; (void) n_threads; (void) stream; (void) ref;
+    fputs("\x1f\x8b", gz);
+    rewind(gz);
+    freesasa_set_verbosity(FREESASA_V_SILENT);
+    in = freesasa_decompress(gz, 1);
+    ck_assert_ptr_eq(in, NULL);
+    freesasa_set_verbosity(FREESASA_V_NORMAL);
+#endif
+
+    fclose(gz);
+}
+END_TEST
+
+
 START_TEST (test_memerr)
 {
     FILE *file = fopen(DATADIR "1ubq.pdb","r");
@@ -474,7 +1000,12 @@ Suite* structure_suite() {
     tcase_add_test(tc_pdb,test_hydrogen);
     tcase_add_test(tc_pdb,test_hetatm);
     tcase_add_test(tc_pdb,test_get_chains);
+    tcase_add_test(tc_pdb,test_views);
+    tcase_add_test(tc_pdb,test_from_arrays);
     tcase_add_test(tc_pdb,test_occupancy);
+    tcase_add_test(tc_pdb,test_from_pdb_parallel);
+    tcase_add_test(tc_pdb,test_structure_stream);
+    tcase_add_test(tc_pdb,test_decompress);
 
     TCase *tc_array = tcase_create("Array");
     tcase_add_test(tc_pdb,test_structure_array_err);
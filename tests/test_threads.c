@@ -0,0 +1,340 @@
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#if USE_THREADS
+# include <pthread.h>
+#endif
+
+#include <freesasa.h>
+#include "tools.h"
+
+#define N_THREADS 8
+#define N_ROUNDS 10
+
+static double ref_total, ref_polar, ref_selection;
+
+/* structure that all threads create views of */
+static freesasa_structure *shared = NULL;
+
+struct job {
+    int id;
+    freesasa_verbosity verbosity;
+    FILE *err;
+    int n_errors; /* number of mismatches found */
+};
+
+/* Number of lines in a file, the file is rewound */
+static int
+count_lines(FILE *fp)
+{
+    int c, n = 0;
+
+    fflush(fp);
+    rewind(fp);
+    while ((c = fgetc(fp)) != EOF) {
+        if (c == '\n') ++n;
+    }
+    rewind(fp);
+
+    return n;
+}
+
+/* Parse, classify, calculate and select, and compare to the
+   reference values. Invalid input is used to generate errors and
+   warnings in the thread's error stream. */
+static int
+round_trip(const freesasa_classifier *classifier)
+{
+    FILE *pdb = fopen(DATADIR "1ubq.pdb", "r");
+    freesasa_structure *s = NULL;
+    freesasa_result *result = NULL;
+    freesasa_structure *unknown = NULL, *view = NULL;
+    freesasa_selection *sel = NULL, *bad = NULL;
+    freesasa_nodearea classes;
+    int err = 0;
+
+    if (pdb == NULL) return 1;
+    s = freesasa_structure_from_pdb(pdb, classifier, 0);
+    fclose(pdb);
+    if (s == NULL) return 1;
+
+    result = freesasa_calc_structure(s, NULL);
+    if (result == NULL) {
+        freesasa_structure_free(s);
+        return 1;
+    }
+
+    classes = freesasa_result_classes(s, result);
+    sel = freesasa_selection_new("s1, resn ala+gly and symbol c", s, result);
+
+    err += !float_eq(result->total, ref_total, 1e-10);
+    err += !float_eq(classes.polar, ref_polar, 1e-10);
+    err += (sel == NULL || !float_eq(freesasa_selection_area(sel), ref_selection, 1e-10));
+
+    view = freesasa_structure_view_atoms(shared, 0, 99);
+    err += (view == NULL || freesasa_structure_n(view) != 100);
+    freesasa_structure_free(view);
+
+    /* one error and one warning */
+    bad = freesasa_selection_new("s2, resn ala+", s, result);
+    err += (bad != NULL);
+    unknown = freesasa_structure_new();
+    err += (unknown == NULL);
+    err += (freesasa_structure_add_atom(unknown, " C  ", "XXX", "   1", 'A', 0, 0, 0)
+            != FREESASA_SUCCESS);
+    freesasa_structure_free(unknown);
+
+    freesasa_selection_free(sel);
+    freesasa_selection_free(bad);
+    freesasa_result_free(result);
+    freesasa_structure_free(s);
+
+    return err;
+}
+
+static void *
+run_job(void *arg)
+{
+    struct job *job = arg;
+    int i;
+
+    freesasa_set_thread_verbosity(job->verbosity);
+    freesasa_set_thread_err_out(job->err);
+
+    for (i = 0; i < N_ROUNDS; ++i) {
+        job->n_errors += round_trip(&freesasa_default_classifier);
+    }
+
+    freesasa_clear_thread_state();
+
+    return NULL;
+}
+
+static void
+setup(void)
+{
+    FILE *pdb = fopen(DATADIR "1ubq.pdb", "r");
+    freesasa_structure *s;
+    freesasa_result *result;
+    freesasa_selection *sel;
+
+    ck_assert_ptr_ne(pdb, NULL);
+    s = freesasa_structure_from_pdb(pdb, NULL, 0);
+    fclose(pdb);
+    ck_assert_ptr_ne(s, NULL);
+    result = freesasa_calc_structure(s, NULL);
+    ck_assert_ptr_ne(result, NULL);
+    sel = freesasa_selection_new("s1, resn ala+gly and symbol c", s, result);
+    ck_assert_ptr_ne(sel, NULL);
+
+    ref_total = result->total;
+    ref_polar = freesasa_result_classes(s, result).polar;
+    ref_selection = freesasa_selection_area(sel);
+
+    freesasa_selection_free(sel);
+    freesasa_result_free(result);
+    freesasa_structure_free(s);
+}
+
+START_TEST (test_thread_state)
+{
+    FILE *err = tmpfile(), *global = tmpfile();
+    FILE *pdb = fopen(DATADIR "1ubq.pdb", "r");
+    freesasa_verbosity v = freesasa_get_verbosity();
+    freesasa_structure *s, *unknown = freesasa_structure_new();
+    freesasa_result *result;
+
+    ck_assert_ptr_ne(unknown, NULL);
+    ck_assert_ptr_ne(err, NULL);
+    ck_assert_ptr_ne(global, NULL);
+    ck_assert_ptr_ne(pdb, NULL);
+    s = freesasa_structure_from_pdb(pdb, NULL, 0);
+    fclose(pdb);
+    ck_assert_ptr_ne(s, NULL);
+    result = freesasa_calc_structure(s, NULL);
+    ck_assert_ptr_ne(result, NULL);
+
+    freesasa_set_err_out(global);
+    ck_assert_int_eq(freesasa_set_thread_verbosity(1000), FREESASA_WARN);
+    ck_assert_int_eq(freesasa_set_thread_verbosity(FREESASA_V_NOWARNINGS), FREESASA_SUCCESS);
+    ck_assert_int_eq(freesasa_get_verbosity(), FREESASA_V_NOWARNINGS);
+    ck_assert_int_eq(freesasa_set_thread_err_out(err), FREESASA_SUCCESS);
+    ck_assert_ptr_eq(freesasa_get_err_out(), err);
+
+    // warnings are suppressed, errors go to the thread's stream
+    ck_assert_int_eq(freesasa_structure_add_atom(unknown, " C  ", "XXX", "   1", 'A', 0, 0, 0),
+                     FREESASA_SUCCESS);
+    ck_assert_int_eq(count_lines(err), 0);
+    ck_assert_ptr_eq(freesasa_selection_new("s2, resn ala+", s, result), NULL);
+    ck_assert_int_gt(count_lines(err), 0);
+    ck_assert_int_eq(count_lines(global), 0);
+
+    // unsetting the stream keeps the verbosity
+    freesasa_set_thread_err_out(NULL);
+    ck_assert_ptr_eq(freesasa_get_err_out(), global);
+    ck_assert_int_eq(freesasa_get_verbosity(), FREESASA_V_NOWARNINGS);
+
+    freesasa_clear_thread_state();
+    ck_assert_int_eq(freesasa_get_verbosity(), v);
+
+    // a failure in an asynchronous calculation is reported where
+    // the caller wants it
+    {
+        freesasa_parameters param = freesasa_default_parameters;
+        freesasa_async *async;
+        FILE *async_err = tmpfile();
+
+        ck_assert_ptr_ne(async_err, NULL);
+
+        param.calc_surface_dots = 1; // invalid with L&R
+        freesasa_set_thread_verbosity(FREESASA_V_NORMAL);
+        freesasa_set_thread_err_out(async_err);
+        async = freesasa_calc_structure_async(s, &param);
+        ck_assert_ptr_ne(async, NULL);
+        ck_assert_ptr_eq(freesasa_async_wait(async), NULL);
+        freesasa_async_free(async);
+        freesasa_clear_thread_state();
+
+        ck_assert_int_gt(count_lines(async_err), 0);
+        ck_assert_int_eq(count_lines(global), 0);
+
+        fclose(async_err);
+    }
+
+    // so are warnings from the worker threads of a calculation, here
+    // LCPO warns for each molecule of the batch
+    {
+        freesasa_parameters param = freesasa_default_parameters;
+        const double xyz[] = {0, 0, 0, 10, 0, 0, 20, 0, 0, 30, 0, 0};
+        const double radii[] = {2, 2, 2, 2};
+        const int offsets[] = {0, 1, 2, 3, 4};
+        double sasa[4];
+        FILE *batch_err = tmpfile();
+
+        ck_assert_ptr_ne(batch_err, NULL);
+
+        param.alg = FREESASA_LCPO;
+        param.probe_radius = 1.2;
+        param.n_threads = 4;
+        freesasa_set_thread_verbosity(FREESASA_V_NORMAL);
+        freesasa_set_thread_err_out(batch_err);
+        ck_assert_int_eq(freesasa_calc_coord_batch(xyz, radii, offsets, 4, sasa, NULL, &param),
+                         FREESASA_SUCCESS);
+        freesasa_clear_thread_state();
+
+        ck_assert_int_eq(count_lines(batch_err), 4);
+        ck_assert_int_eq(count_lines(global), 0);
+
+        fclose(batch_err);
+    }
+
+    freesasa_result_free(result);
+    freesasa_structure_free(s);
+    freesasa_structure_free(unknown);
+
+    freesasa_set_err_out(stderr);
+    fclose(err);
+    fclose(global);
+}
+END_TEST
+
+START_TEST (test_concurrent_calls)
+{
+    struct job job[N_THREADS];
+    FILE *global = tmpfile(), *pdb;
+    char line[256];
+    int i, n_lines;
+#if USE_THREADS
+    pthread_t thread[N_THREADS];
+#endif
+
+    ck_assert_ptr_ne(global, NULL);
+    freesasa_set_err_out(global);
+
+    pdb = fopen(DATADIR "1ubq.pdb", "r");
+    ck_assert_ptr_ne(pdb, NULL);
+    shared = freesasa_structure_from_pdb(pdb, NULL, 0);
+    fclose(pdb);
+    ck_assert_ptr_ne(shared, NULL);
+
+    for (i = 0; i < N_THREADS; ++i) {
+        job[i].id = i;
+        job[i].err = tmpfile();
+        job[i].n_errors = 0;
+        ck_assert_ptr_ne(job[i].err, NULL);
+        switch (i % 3) {
+        case 0: job[i].verbosity = FREESASA_V_NORMAL; break;
+        case 1: job[i].verbosity = FREESASA_V_NOWARNINGS; break;
+        default: job[i].verbosity = FREESASA_V_SILENT; break;
+        }
+    }
+
+#if USE_THREADS
+    for (i = 0; i < N_THREADS; ++i) {
+        ck_assert_int_eq(pthread_create(&thread[i], NULL, run_job, &job[i]), 0);
+    }
+    for (i = 0; i < N_THREADS; ++i) {
+        ck_assert_int_eq(pthread_join(thread[i], NULL), 0);
+    }
+#else
+    for (i = 0; i < N_THREADS; ++i) run_job(&job[i]);
+#endif
+
+    // all views have been released
+    freesasa_structure_free(shared);
+    shared = NULL;
+
+    // nothing leaks into the global stream
+    ck_assert_int_eq(count_lines(global), 0);
+
+    for (i = 0; i < N_THREADS; ++i) {
+        ck_assert_int_eq(job[i].n_errors, 0);
+        n_lines = count_lines(job[i].err);
+        switch (job[i].verbosity) {
+        case FREESASA_V_SILENT:
+            ck_assert_int_eq(n_lines, 0);
+            break;
+        case FREESASA_V_NOWARNINGS:
+            ck_assert_int_gt(n_lines, 0);
+            while (fgets(line, sizeof(line), job[i].err)) {
+                ck_assert_ptr_eq(strstr(line, "warning"), NULL);
+            }
+            rewind(job[i].err);
+            break;
+        default:
+            ck_assert_int_gt(n_lines, 0);
+            break;
+        }
+        // every line is a complete message
+        while (fgets(line, sizeof(line), job[i].err)) {
+            if (strncmp(line, "FreeSASA", 8) != 0) {
+                ck_assert_str_eq(line, "\n"); // from parse errors
+            }
+        }
+        fclose(job[i].err);
+    }
+
+    freesasa_set_err_out(stderr);
+    fclose(global);
+}
+END_TEST
+
+Suite *
+threads_suite()
+{
+    Suite *s = suite_create("Threads");
+
+    TCase *tc_core = tcase_create("Core");
+    tcase_add_checked_fixture(tc_core, setup, NULL);
+    tcase_add_test(tc_core, test_thread_state);
+    tcase_add_test(tc_core, test_concurrent_calls);
+    tcase_set_timeout(tc_core, 60);
+
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}